@@ -69,6 +69,7 @@ string ConferenceFactory::DropSound;
 string ConferenceFactory::DialoutSuffix;
 PlayoutType ConferenceFactory::m_PlayoutType = ADAPTIVE_PLAYOUT;
 unsigned int ConferenceFactory::MaxParticipants;
+unsigned int ConferenceFactory::ActiveSpeakers;
 
 bool ConferenceFactory::UseRFC4240Rooms;
 AmConfigReader ConferenceFactory::cfg;
@@ -302,6 +303,12 @@ int ConferenceFactory::onLoad()
     ERROR("while parsing max_participants parameter\n");
   }
 
+  ActiveSpeakers = 0;
+  string active_speakers = cfg.getParameter("active_speakers");
+  if (active_speakers.length() && str2i(active_speakers, ActiveSpeakers)) {
+    ERROR("while parsing active_speakers parameter\n");
+  }
+
   UseRFC4240Rooms = cfg.getParameter("use_rfc4240_rooms")=="yes";
   DBG("%ssing RFC4240 room naming.\n", UseRFC4240Rooms?"U":"Not u");
 
@@ -554,6 +561,8 @@ void ConferenceDialog::setupAudio()
   else {
 
     channel.reset(AmConferenceStatus::getChannel(conf_id,getLocalTag(),RTPStream()->getSampleRate()));
+    if (ConferenceFactory::ActiveSpeakers)
+      AmConferenceStatus::setActiveSpeakers(conf_id, ConferenceFactory::ActiveSpeakers);
 
     if (listen_only) {
 	play_list.addToPlaylist(new AmPlaylistItem(channel.get(),
@@ -84,6 +84,7 @@ public:
   static string DialoutSuffix;
   static PlayoutType m_PlayoutType;
   static unsigned int MaxParticipants;
+  static unsigned int ActiveSpeakers;
   static bool UseRFC4240Rooms;
 
   static void setupSessionTimer(AmSession* s);
@@ -23,6 +23,12 @@ playout_type=adaptive_playout
 # default = 0 (unlimited)
 #max_participants=10
 
+# Mix only the N loudest participants of a conference; listeners
+# who are not speaking all get the same mix, which saves mixing
+# and (for G.711) encoding work in large conferences.
+# default = 0 (mix all participants)
+#active_speakers=3
+
 # use_rfc4240_rooms=[yes|no]
 #
 # RFC4240 specifies for Conference service that the conference 
@@ -70,7 +70,7 @@ int replaceParsedParam(const string& s, size_t p,
       
       const string& uri_params = parsed.uri_param;
       const char* c = uri_params.c_str();
-      list<sip_avp*> params;
+      sip_avp_list params;
       if(parse_gen_params(&params,&c,uri_params.length(),0) < 0) {
 	DBG("could not parse URI parameters");
 	free_gen_params(&params);
@@ -78,7 +78,7 @@ int replaceParsedParam(const string& s, size_t p,
       }
 
       string param;
-      for(list<sip_avp*>::iterator it = params.begin(); 
+      for(sip_avp_list::iterator it = params.begin(); 
 	  it != params.end(); it++) {
 
 	if(lower_cmp_n((*it)->name.s,(*it)->name.len,
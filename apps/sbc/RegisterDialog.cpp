@@ -301,7 +301,7 @@ void RegisterDialog::fixUacContactHosts(const AmSipRequest& req,
 
 int RegisterDialog::removeTransport(AmUriParser& uri)
 {
-  list<sip_avp*> uri_params;
+  sip_avp_list uri_params;
   string old_params = uri.uri_param;
   const char* c = old_params.c_str();
 
@@ -316,7 +316,7 @@ int RegisterDialog::removeTransport(AmUriParser& uri)
   // Suppress transport parameter
   // hack to suppress transport=tcp
   string new_params;
-  for(list<sip_avp*>::iterator p_it = uri_params.begin();
+  for(sip_avp_list::iterator p_it = uri_params.begin();
       p_it != uri_params.end(); p_it++) {
 
     DBG("parsed");
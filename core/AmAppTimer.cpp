@@ -28,6 +28,7 @@
 #include "AmSessionContainer.h"
 
 #include "AmAppTimer.h"
+#include "sip/hash.h"
 #include "log.h"
 
 using std::map;
@@ -38,8 +39,11 @@ class app_timer : public timer
   int    timer_id;
 
  public:
-  app_timer(const string& q_id, int timer_id, unsigned int expires)
-    : timer(expires), timer_id(timer_id), q_id(q_id) {}
+  unsigned int shard;
+
+  app_timer(const string& q_id, int timer_id, unsigned int expires,
+	    unsigned int shard)
+    : timer(expires), q_id(q_id), timer_id(timer_id), shard(shard) {}
 
   ~app_timer() {}
 
@@ -57,9 +61,11 @@ class direct_app_timer
 {
 public:
   DirectAppTimer* dt;
+  unsigned int shard;
   
-  direct_app_timer(DirectAppTimer* dt, unsigned int expires)
-    : timer(expires), dt(dt) {}
+  direct_app_timer(DirectAppTimer* dt, unsigned int expires,
+		   unsigned int shard)
+    : timer(expires), dt(dt), shard(shard) {}
 
   ~direct_app_timer() {}
 
@@ -69,17 +75,32 @@ public:
 };
 
 _AmAppTimer::_AmAppTimer()
-  : direct_timers_mut(true)
 {
+  for (unsigned int i=0; i<get_shards(); i++)
+    shards.push_back(new timer_shard());
 }
 
 _AmAppTimer::~_AmAppTimer() {
+  for (unsigned int i=0; i<shards.size(); i++)
+    delete shards[i];
+}
+
+unsigned int _AmAppTimer::queue_hash(const string& q_id)
+{
+  return hashlittle(q_id.c_str(), q_id.length(), 0);
+}
+
+unsigned int _AmAppTimer::direct_hash(DirectAppTimer* t)
+{
+  return (unsigned int)((unsigned long)t >> 4);
 }
 
 void _AmAppTimer::app_timer_cb(app_timer* at)
 {
-  user_timers_mut.lock();
-  app_timer* at_local = erase_timer(at->get_q_id(), at->get_id());
+  timer_shard* s = shards[at->shard];
+
+  s->user_timers_mut.lock();
+  app_timer* at_local = erase_timer(s, at->get_q_id(), at->get_id());
 
   if (NULL != at_local) {
 
@@ -87,7 +108,7 @@ void _AmAppTimer::app_timer_cb(app_timer* at)
       DBG("timer was reset while expiring - not firing timer\n");
       // we'd better re-insert at_local into user_timers
       // what happens else, when at_local get fired ???
-      user_timers[at->get_q_id()][at->get_id()] = at_local;
+      s->user_timers[at->get_q_id()][at->get_id()] = at_local;
     } else {
       DBG("timer fired: %d for '%s'\n", at->get_id(), at->get_q_id().c_str());
       AmSessionContainer::instance()->postEvent(at->get_q_id(),
@@ -101,16 +122,17 @@ void _AmAppTimer::app_timer_cb(app_timer* at)
     // will be deleted by wheeltimer
   }
 
-  user_timers_mut.unlock();
+  s->user_timers_mut.unlock();
 }
 
 void _AmAppTimer::direct_app_timer_cb(direct_app_timer* t)
 {
   DirectAppTimer* dt = t->dt;
+  timer_shard* s = shards[t->shard];
 
-  direct_timers_mut.lock();
-  DirectTimers::iterator dt_it = direct_timers.find(dt);
-  if(dt_it != direct_timers.end()){
+  s->direct_timers_mut.lock();
+  DirectTimers::iterator dt_it = s->direct_timers.find(dt);
+  if(dt_it != s->direct_timers.end()){
     if(dt_it->second != t) {
       // timer has been re-initialized
       // with the same pointer... do not trigger!
@@ -120,42 +142,43 @@ void _AmAppTimer::direct_app_timer_cb(direct_app_timer* t)
       // everything ok:
 
       // remove stuff
-      direct_timers.erase(dt_it);
+      s->direct_timers.erase(dt_it);
       delete t;
 
       // finally fire this timer!
       dt->fire();
     }
   }
-  direct_timers_mut.unlock();
+  s->direct_timers_mut.unlock();
 }
 
-app_timer* _AmAppTimer::erase_timer(const string& q_id, int id) 
+app_timer* _AmAppTimer::erase_timer(timer_shard* s, const string& q_id, int id) 
 {
   app_timer* res = NULL;
 
-  map<string, map<int, app_timer*> >::iterator it=user_timers.find(q_id);
-  if (it != user_timers.end()) {
-    map<int, app_timer*>::iterator t_it = it->second.find(id);
+  TimerQueues::iterator it=s->user_timers.find(q_id);
+  if (it != s->user_timers.end()) {
+    AppTimers::iterator t_it = it->second.find(id);
     if (t_it != it->second.end()) {
       res = t_it->second;
       it->second.erase(t_it);
       if (it->second.empty())
-	user_timers.erase(it);
+	s->user_timers.erase(it);
     }
   }
 
   return res;
 }
 
-app_timer* _AmAppTimer::create_timer(const string& q_id, int id, 
+app_timer* _AmAppTimer::create_timer(timer_shard* s, unsigned int hash,
+				     const string& q_id, int id, 
 				     unsigned int expires) 
 {
-  app_timer* timer = new app_timer(q_id, id, expires);
+  app_timer* timer = new app_timer(q_id, id, expires, get_shard(hash));
   if (!timer)
     return NULL;
 
-  user_timers[q_id][id] = timer;
+  s->user_timers[q_id][id] = timer;
 
   return timer;
 }
@@ -178,41 +201,48 @@ void _AmAppTimer::setTimer(const string& eventqueue_name, int timer_id, double t
 
   expires += wall_clock;
 
-  user_timers_mut.lock();
-  app_timer* t = erase_timer(eventqueue_name, timer_id);
+  unsigned int hash = queue_hash(eventqueue_name);
+  timer_shard* s = shards[get_shard(hash)];
+
+  s->user_timers_mut.lock();
+  app_timer* t = erase_timer(s, eventqueue_name, timer_id);
   if (NULL != t) {
     remove_timer(t);
   }
-  t = create_timer(eventqueue_name, timer_id, expires);
+  t = create_timer(s, hash, eventqueue_name, timer_id, expires);
   if (NULL != t) {
-    insert_timer(t);
+    insert_timer(t, hash);
   }
-  user_timers_mut.unlock();
+  s->user_timers_mut.unlock();
 }
 
 void _AmAppTimer::removeTimer(const string& eventqueue_name, int timer_id) 
 {
-  user_timers_mut.lock();
-  app_timer* t = erase_timer(eventqueue_name, timer_id);
+  timer_shard* s = shards[get_shard(queue_hash(eventqueue_name))];
+
+  s->user_timers_mut.lock();
+  app_timer* t = erase_timer(s, eventqueue_name, timer_id);
   if (NULL != t) {
     remove_timer(t);
   }
-  user_timers_mut.unlock();
+  s->user_timers_mut.unlock();
 }
 
 void _AmAppTimer::removeTimers(const string& eventqueue_name) 
 {
-  user_timers_mut.lock();
-  TimerQueues::iterator it=user_timers.find(eventqueue_name);
-  if (it != user_timers.end()) {
+  timer_shard* s = shards[get_shard(queue_hash(eventqueue_name))];
+
+  s->user_timers_mut.lock();
+  TimerQueues::iterator it=s->user_timers.find(eventqueue_name);
+  if (it != s->user_timers.end()) {
     for (AppTimers::iterator t_it =
 	   it->second.begin(); t_it != it->second.end(); t_it++) {
       if (NULL != t_it->second)
 	remove_timer(t_it->second);
     }
-    user_timers.erase(it);
+    s->user_timers.erase(it);
   }
-  user_timers_mut.unlock();
+  s->user_timers_mut.unlock();
 }
 
 void _AmAppTimer::setTimer_unsafe(DirectAppTimer* t, double timeout)
@@ -220,39 +250,48 @@ void _AmAppTimer::setTimer_unsafe(DirectAppTimer* t, double timeout)
   unsigned int expires = timeout*1000.0*1000.0 / (double)TIMER_RESOLUTION;
   expires += wall_clock;
 
-  direct_app_timer* dt = new direct_app_timer(t,expires);
+  unsigned int hash = direct_hash(t);
+  timer_shard* s = shards[get_shard(hash)];
+
+  direct_app_timer* dt = new direct_app_timer(t,expires,get_shard(hash));
   if(!dt) return;
 
-  DirectTimers::iterator dt_it = direct_timers.find(t);
-  if(dt_it != direct_timers.end()){
+  DirectTimers::iterator dt_it = s->direct_timers.find(t);
+  if(dt_it != s->direct_timers.end()){
     remove_timer(dt_it->second);
     dt_it->second = dt;
   }
   else {
-    direct_timers[t] = dt;
+    s->direct_timers[t] = dt;
   }
-  insert_timer(dt);
+  insert_timer(dt,hash);
 }
 
 void _AmAppTimer::setTimer(DirectAppTimer* t, double timeout)
 {
-  direct_timers_mut.lock();
+  timer_shard* s = shards[get_shard(direct_hash(t))];
+
+  s->direct_timers_mut.lock();
   setTimer_unsafe(t,timeout);
-  direct_timers_mut.unlock();
+  s->direct_timers_mut.unlock();
 }
 
 void _AmAppTimer::removeTimer_unsafe(DirectAppTimer* t)
 {
-  DirectTimers::iterator dt_it = direct_timers.find(t);
-  if(dt_it != direct_timers.end()){
+  timer_shard* s = shards[get_shard(direct_hash(t))];
+
+  DirectTimers::iterator dt_it = s->direct_timers.find(t);
+  if(dt_it != s->direct_timers.end()){
     remove_timer(dt_it->second);
-    direct_timers.erase(dt_it);
+    s->direct_timers.erase(dt_it);
   }
 }
 
 void _AmAppTimer::removeTimer(DirectAppTimer* t)
 {
-  direct_timers_mut.lock();
+  timer_shard* s = shards[get_shard(direct_hash(t))];
+
+  s->direct_timers_mut.lock();
   removeTimer_unsafe(t);
-  direct_timers_mut.unlock();
+  s->direct_timers_mut.unlock();
 }
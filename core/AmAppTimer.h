@@ -34,6 +34,7 @@ using std::string;
 
 #include <map>
 #include <set>
+#include <vector>
 
 #define TICKS_PER_SEC (1000000 / TIMER_RESOLUTION)
 
@@ -54,16 +55,29 @@ class _AmAppTimer
   typedef std::map<string, AppTimers> TimerQueues;
   typedef std::map<DirectAppTimer*,direct_app_timer*> DirectTimers;
 
-  AmMutex user_timers_mut;
-  TimerQueues user_timers;
+  /** timers placed on one shard of the wheel timer */
+  struct timer_shard {
+    AmMutex user_timers_mut;
+    TimerQueues user_timers;
 
-  AmMutex direct_timers_mut;
-  DirectTimers direct_timers;
+    AmMutex direct_timers_mut;
+    DirectTimers direct_timers;
+
+    timer_shard() : direct_timers_mut(true) {}
+  };
+
+  /** one per shard */
+  std::vector<timer_shard*> shards;
+
+  /** the timers of an event queue are all placed on the same shard */
+  unsigned int queue_hash(const string& q_id);
+  unsigned int direct_hash(DirectAppTimer* t);
 
   /** creates timer object and inserts it into our container */
-  app_timer* create_timer(const string& q_id, int id, unsigned int expires);
+  app_timer* create_timer(timer_shard* s, unsigned int hash,
+			  const string& q_id, int id, unsigned int expires);
   /** erases timer - does not delete timer object @return timer object pointer, if found */
-  app_timer* erase_timer(const string& q_id, int id);
+  app_timer* erase_timer(timer_shard* s, const string& q_id, int id);
 
   /* callback used by app_timer */
   void app_timer_cb(app_timer* at);
@@ -89,9 +103,11 @@ class _AmAppTimer
   /* remove a timer which directly calls your handler */
   void removeTimer(DirectAppTimer* t);
 
-  /* ONLY use this from inside the timer handler of a direct timer */
+  /* ONLY use this from inside the timer handler of a direct timer,
+     for that same timer (others may fire in another thread) */
   void setTimer_unsafe(DirectAppTimer* t, double timeout);
-  /* ONLY use this from inside the timer handler of a direct timer */
+  /* ONLY use this from inside the timer handler of a direct timer,
+     for that same timer (others may fire in another thread) */
   void removeTimer_unsafe(DirectAppTimer* t);
 };
 
@@ -31,6 +31,7 @@
 #include "AmSdp.h"
 #include "AmRtpStream.h"
 #include "AmConfig.h"
+#include "AmPolyphaseResampler.h"
 #include "amci/codecs.h"
 #include "log.h"
 
@@ -432,6 +433,10 @@ unsigned int AmAudio::resampleInput(unsigned char* buffer, unsigned int s, int i
 	input_resampling_state.reset(new AmLibSamplerateResamplingState());
       } else
 #endif
+      if (AmConfig::ResamplingImplementationType == AmAudio::POLYPHASE_RESAMPLER) {
+	DBG("using polyphase resampler for input");
+	input_resampling_state.reset(new AmPolyphaseResampler());
+      } else
 	{
 	  return s;
 	}
@@ -459,6 +464,10 @@ unsigned int AmAudio::resampleOutput(unsigned char* buffer, unsigned int s, int
 	output_resampling_state.reset(new AmLibSamplerateResamplingState());
       } else
 #endif
+      if (AmConfig::ResamplingImplementationType == AmAudio::POLYPHASE_RESAMPLER) {
+	DBG("using polyphase resampler for output");
+	output_resampling_state.reset(new AmPolyphaseResampler());
+      } else
 	{
 	  return s;
 	}
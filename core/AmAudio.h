@@ -248,6 +248,7 @@ public:
   enum ResamplingImplementationType {
 	LIBSAMPLERATE,
 	INTERNAL_RESAMPLER,
+	POLYPHASE_RESAMPLER,
 	UNAVAILABLE
   };
 
@@ -366,6 +367,16 @@ public:
    */
   virtual int put(unsigned long long system_ts, unsigned char* buffer, 
 		  int input_sample_rate, unsigned int size);
+
+  /**
+   * Get the next nb_samples at output_sample_rate already encoded
+   * with codec 'codec_id' (see AmFileCache::getEncoded()), instead
+   * of get()ting them as PCM.
+   * @return # bytes read, 0 if not available (use get())
+   */
+  virtual int getEncoded(unsigned long long system_ts, unsigned char* buffer,
+			 int codec_id, unsigned int output_sample_rate,
+			 unsigned int nb_samples) { return 0; }
   
   int  getSampleRate();
 
@@ -5,6 +5,7 @@
 #include <strings.h>
 #include "AmB2BSession.h"
 #include "AmRtpReceiver.h"
+#include "AmRtpRepacketizer.h"
 #include "sip/msg_logger.h"
 
 #include <algorithm>
@@ -184,7 +185,7 @@ AudioStreamData::AudioStreamData(AmB2BSession *session):
   incoming_payload(UNDEFINED_PAYLOAD),
   force_symmetric_rtp(false),
   enable_dtmf_transcoding(false),
-  muted(false), relay_paused(false), receiving(true)
+  muted(false), relay_paused(false), relay_ptime(0), receiving(true)
 {
   if (session) initialize(session);
   else stream = NULL; // not initialized yet
@@ -257,6 +258,8 @@ void AudioStreamData::setRelayStream(AmRtpStream *other)
   if (relay_enabled && other) {
     stream->setRelayStream(other);
     stream->setRelayPayloads(relay_mask);
+    stream->setRelayRepacketizer(relay_ptime ?
+        AmRtpRepacketizer::create(relay_ptime_payload, relay_ptime) : NULL);
     if (!relay_paused)
       stream->enableRtpRelay();
 
@@ -272,6 +275,42 @@ void AudioStreamData::setRelayPayloads(const SdpMedia &m, RelayController *ctrl)
   ctrl->computeRelayMask(m, relay_enabled, relay_mask);
 }
 
+void AudioStreamData::setRelayPtime(const AmSdp &local_sdp, const AmSdp &peer_remote_sdp, int media_idx)
+{
+  relay_ptime = 0;
+  if ((media_idx < 0) ||
+      ((size_t)media_idx >= local_sdp.media.size()) ||
+      ((size_t)media_idx >= peer_remote_sdp.media.size())) return;
+
+  const SdpMedia &in = local_sdp.media[media_idx];
+  const SdpMedia &out = peer_remote_sdp.media[media_idx];
+
+  // the first relayed payload accepted by the other side is the one in use
+  for (vector<SdpPayload>::const_iterator p = out.payloads.begin(); p != out.payloads.end(); ++p) {
+    if ((p->payload_type < 0) || !relay_mask.get(p->payload_type)) continue;
+
+    vector<SdpPayload>::const_iterator l = in.payloads.begin();
+    while ((l != in.payloads.end()) && (l->payload_type != p->payload_type)) ++l;
+    if (l == in.payloads.end()) return;
+
+    // both sides must use the same frames (iLBC mode)
+    unsigned int in_bytes, in_ts, out_bytes, out_ts;
+    if (!AmRtpRepacketizer::getFrameFormat(*l, in_bytes, in_ts) ||
+        !AmRtpRepacketizer::getFrameFormat(*p, out_bytes, out_ts) ||
+        (in_bytes != out_bytes) || (in_ts != out_ts)) return;
+
+    unsigned int in_ptime = AmRtpRepacketizer::getPtime(in, *l);
+    unsigned int out_ptime = AmRtpRepacketizer::getPtime(out, *p);
+    if (in_ptime != out_ptime) {
+      DBG("repacketizing relayed payload %d from %u ms to %u ms\n",
+          p->payload_type, in_ptime, out_ptime);
+      relay_ptime_payload = *p;
+      relay_ptime = out_ptime;
+    }
+    return;
+  }
+}
+
 void AudioStreamData::setRelayDestination(const string& connection_address, int port) {
   relay_address = connection_address; relay_port = port;
 }
@@ -447,7 +486,15 @@ int AudioStreamData::writeStream(unsigned long long ts, unsigned char *buffer, A
     // A leg is ready to send data
     int sample_rate = stream->getSampleRate();
     int got = 0;
-    if (in) got = in->get(ts, buffer, sample_rate, f_size);
+    if (in) {
+      // prompts cached pre-encoded for this payload are sent as they are
+      int sent = stream->putEncoded(ts, in);
+      if (sent) {
+        if (sent > 0) updateSendStats();
+        return sent;
+      }
+      got = in->get(ts, buffer, sample_rate, f_size);
+    }
     else {
       if (!src.isInitialized()) return 0;
       AmRtpAudio *src_stream = src.getStream();
@@ -872,6 +919,11 @@ void AmB2BMedia::updateStreamPair(AudioStreamPair &pair)
   bool have_a = have_a_leg_local_sdp && have_a_leg_remote_sdp;
   bool have_b = have_b_leg_local_sdp && have_b_leg_remote_sdp;
 
+  if (have_a && have_b) {
+    pair.a.setRelayPtime(a_leg_local_sdp, b_leg_remote_sdp, pair.media_idx);
+    pair.b.setRelayPtime(b_leg_local_sdp, a_leg_remote_sdp, pair.media_idx);
+  }
+
   TRACE("updating stream in A leg\n");
   pair.a.setDtmfSink(b);
   if (pair.b.getInput()) pair.a.setRelayStream(NULL); // don't mix relayed RTP into the other's input
@@ -95,6 +95,11 @@ class AudioStreamData {
      * relay stream may still be set up and updated */
     bool relay_paused;
 
+    /** relayed payload to be repacketized to relay_ptime (if not 0) because
+     * the other leg wants another ptime */
+    SdpPayload relay_ptime_payload;
+    unsigned int relay_ptime;
+
     bool muted;
 
     bool receiving;
@@ -153,6 +158,12 @@ class AudioStreamData {
      * other remote end directly) */
     void setRelayPayloads(const SdpMedia &m, RelayController *ctrl);
 
+    /** compares the ptime we asked for in local SDP with the one the other
+     * leg's remote wants (peer_remote_sdp) for the relayed codec; if they
+     * differ the payload is repacketized instead of being transcoded or sent
+     * with the wrong ptime (see AmRtpRepacketizer) */
+    void setRelayPtime(const AmSdp &local_sdp, const AmSdp &peer_remote_sdp, int media_idx);
+
     void setRelayDestination(const string& connection_address, int port);
 
     /** set relay temporarily to paused (stream relation may still be up) */
@@ -256,8 +267,9 @@ class AudioStreamData {
  *
  *  - RTCP
  *
- *  - correct sampling periods when relaying/transcoding according to values
- *    advertised in local SDP (i.e. the relayed one)
+ *  - correct sampling periods when transcoding according to values
+ *    advertised in local SDP (i.e. the relayed one); relayed payloads are
+ *    repacketized if the ptime differs (AudioStreamData::setRelayPtime)
  *
  *  - Is non-transparent SSRC & seq. no needed if some payloads can be transcoded and
  *    some relayed? Couldn't be confusing to have transparent ones for relayed but our
@@ -27,65 +27,140 @@
 #include "AmUtils.h"
 #include "log.h"
 #include "AmPlugIn.h"
+#include "AmConfig.h"
+#include "amci/codecs.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <errno.h>
+
+#include <map>
+#include <list>
 
 
 
 using std::string;
 
-AmFileCache::AmFileCache() 
-  : data(NULL), 
-    data_size(0)
+static AmMutex mappings_mut;
+static std::map<std::pair<dev_t,ino_t>, AmFileMapping*> mappings;
+
+AmFileMapping::AmFileMapping(const std::string& name)
+  : data(NULL), data_size(0), name(name),
+    dev(0), ino(0), mtime(0), refs(1)
 { }
 
-AmFileCache::~AmFileCache() {
+AmFileMapping::~AmFileMapping() {
+  for (std::vector<AmEncodedPrompt*>::iterator it = encoded.begin();
+       it != encoded.end(); ++it)
+    delete *it;
+
   if ((data != NULL) && 
       munmap(data, data_size)) {
-    ERROR("while unmapping file.\n");
+    ERROR("while unmapping file '%s'.\n", name.c_str());
   }
 }
 
-int AmFileCache::load(const std::string& filename) {
+int AmFileMapping::map(int fd, const struct stat& sbuf) {
+  int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+  if (AmConfig::PromptCachePopulate)
+    flags |= MAP_POPULATE;
+#endif
+
+  void* p = mmap(NULL, sbuf.st_size, PROT_READ, flags, fd, 0);
+  if (p == MAP_FAILED) {
+    ERROR("cannot mmap file '%s': %s.\n", name.c_str(), strerror(errno));
+    return -3;
+  }
+
+#ifdef MADV_HUGEPAGE
+  if (AmConfig::PromptCacheHugePages &&
+      madvise(p, sbuf.st_size, MADV_HUGEPAGE)) {
+    DBG("no huge pages for '%s': %s\n", name.c_str(), strerror(errno));
+  }
+#endif
+
+  data = (unsigned char*)p;
+  data_size = sbuf.st_size;
+  dev = sbuf.st_dev;
+  ino = sbuf.st_ino;
+  mtime = sbuf.st_mtime;
+  return 0;
+}
+
+AmFileMapping* AmFileMapping::get(const std::string& filename) {
   int fd; 
   struct stat sbuf;
 
-  name = filename;
-
-  if ((fd = open(name.c_str(), O_RDONLY)) == -1) {
+  if ((fd = open(filename.c_str(), O_RDONLY)) == -1) {
     ERROR("while opening file '%s' for caching.\n", 
 	  filename.c_str());
-    return -1;
+    return NULL;
   }
 
   if (fstat(fd,  &sbuf) == -1) {
     ERROR("cannot stat file '%s'.\n", 
-	  name.c_str());
+	  filename.c_str());
     close(fd);
-    return -2;
+    return NULL;
   }
-	
-  if ((data = mmap((caddr_t)0, sbuf.st_size, PROT_READ, MAP_PRIVATE, 
-		   fd, 0)) == (caddr_t)(-1)) {
-    ERROR("cannot mmap file '%s'.\n", 
-	  name.c_str());
+
+  std::pair<dev_t,ino_t> key(sbuf.st_dev, sbuf.st_ino);
+
+  AmLock l(mappings_mut);
+
+  std::map<std::pair<dev_t,ino_t>, AmFileMapping*>::iterator it =
+    mappings.find(key);
+  if ((it != mappings.end()) &&
+      (it->second->data_size == (size_t)sbuf.st_size) &&
+      (it->second->mtime == sbuf.st_mtime)) {
     close(fd);
-    return -3;
+    it->second->refs++;
+    DBG("sharing mapping of '%s' (%u references)\n",
+	filename.c_str(), it->second->refs);
+    return it->second;
   }
 
-  data_size = sbuf.st_size;
+  AmFileMapping* m = new AmFileMapping(filename);
+  if (m->map(fd, sbuf)) {
+    close(fd);
+    delete m;
+    return NULL;
+  }
   close(fd);
 
-  return 0;
+  // a changed file replaces the old mapping for new users
+  mappings[key] = m;
+  return m;
 }
 
-int AmFileCache::read(void* buf, 
-		      size_t* pos, 
-		      size_t size) {
+AmFileMapping* AmFileMapping::ref(AmFileMapping* m) {
+  AmLock l(mappings_mut);
+  m->refs++;
+  return m;
+}
+
+void AmFileMapping::release(AmFileMapping* m) {
+  {
+    AmLock l(mappings_mut);
+    if (--m->refs)
+      return;
+
+    std::map<std::pair<dev_t,ino_t>, AmFileMapping*>::iterator it =
+      mappings.find(std::make_pair(m->dev, m->ino));
+    if ((it != mappings.end()) && (it->second == m))
+      mappings.erase(it);
+  }
+
+  delete m;
+}
+
+int AmFileMapping::read(void* buf,
+			size_t* pos,
+			size_t size) const {
 
   if (*pos >= data_size)
     return -1; // eof
@@ -95,33 +170,263 @@ int AmFileCache::read(void* buf,
     r_size = data_size-*pos;
 
   if (r_size>0) {
-    memcpy(buf, (unsigned char*)data + *pos, r_size);
+    memcpy(buf, data + *pos, r_size);
     *pos+=r_size;
   }
   return r_size;
 }
 
+AmFileCache::AmFileCache() 
+  : mapping(NULL)
+{ }
+
+AmFileCache::~AmFileCache() {
+  if (mapping)
+    AmFileMapping::release(mapping);
+}
+
+int AmFileCache::load(const std::string& filename) {
+  name = filename;
+
+  AmFileMapping* m = AmFileMapping::get(filename);
+  if (!m)
+    return -1;
+
+  if (mapping)
+    AmFileMapping::release(mapping);
+  mapping = m;
+
+  return 0;
+}
+
+int AmFileCache::read(void* buf, 
+		      size_t* pos, 
+		      size_t size) {
+  if (!mapping)
+    return -1;
+  return mapping->read(buf, pos, size);
+}
+
 inline size_t AmFileCache::getSize() {
-  return data_size;
+  return mapping ? mapping->getSize() : 0;
 }
 
 inline const string& AmFileCache::getFilename() {
   return name;
 }
 
+bool AmFileCache::isPrecodable(int codec_id) {
+  // not G.722 & co: their frames depend on the frames sent before
+  switch (codec_id) {
+  case CODEC_ULAW:
+  case CODEC_ALAW:
+  case CODEC_L16:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/** \brief encodes PCM16 frames with a codec */
+class AmPromptEncoder
+  : public AmAudio
+{
+protected:
+  int read(unsigned int user_ts, unsigned int size) { return -1; }
+  int write(unsigned int user_ts, unsigned int size) { return -1; }
+
+public:
+  AmPromptEncoder(int codec_id, unsigned int rate)
+    : AmAudio(new AmAudioFormat(codec_id, rate)) {}
+
+  bool is_good() { return fmt->getCodec() != NULL; }
+
+  /** encode 'size' bytes in place @return encoded size */
+  int encode(unsigned char* buffer, unsigned int size) {
+    memcpy((unsigned char*)samples,buffer,size);
+    int s = AmAudio::encode(size);
+    if (s > 0)
+      memcpy(buffer,(unsigned char*)samples,s);
+    return s;
+  }
+};
+
+bool AmEncodedPrompt::encode(AmAudio* src, const std::string& name) {
+  AmPromptEncoder enc(codec_id, rate);
+
+  unsigned int frame_bytes = PCM16_S2B(frame_size);
+  if (!enc.is_good() || (frame_bytes > AUDIO_BUFFER_SIZE))
+    return false;
+
+  unsigned char buf[AUDIO_BUFFER_SIZE];
+  unsigned long long ts = 0;
+  data.clear();
+  offsets.assign(1, 0);
+
+  while (true) {
+    int got = src->get(ts, buf, rate, frame_size);
+    if (got <= 0)
+      break;
+
+    if ((unsigned int)got < frame_bytes) {
+      memset(buf + got, 0, frame_bytes - got);
+      got = frame_bytes;
+    }
+
+    int s = enc.encode(buf, got);
+    if (s <= 0) {
+      ERROR("encoding '%s' with codec %i failed\n", name.c_str(), codec_id);
+      data.clear();
+      offsets.clear();
+      return false;
+    }
+
+    data.insert(data.end(), buf, buf + s);
+    offsets.push_back(data.size());
+    ts += frame_size * WALLCLOCK_RATE / rate;
+  }
+
+  return true;
+}
+
+/**
+ * \brief encodes cached prompts in the background
+ *
+ * Started on first use; runs until SEMS exits.
+ */
+class AmPromptEncoderThread
+  : public AmThread
+{
+  struct Job {
+    /** own reference */
+    AmFileMapping*   mapping;
+    AmEncodedPrompt* e;
+  };
+
+  std::list<Job>    jobs;
+  AmMutex           jobs_mut;
+  AmCondition<bool> has_jobs;
+
+  static AmPromptEncoderThread* _instance;
+  static AmMutex _instance_mut;
+
+  void run() {
+    while (true) {
+      has_jobs.wait_for();
+
+      jobs_mut.lock();
+      if (jobs.empty()) {
+	has_jobs.set(false);
+	jobs_mut.unlock();
+	continue;
+      }
+      Job j = jobs.front();
+      jobs.pop_front();
+      jobs_mut.unlock();
+
+      j.mapping->encode(j.e);
+      AmFileMapping::release(j.mapping);
+    }
+  }
+
+  void on_stop() { }
+
+public:
+  AmPromptEncoderThread() : has_jobs(false) { }
+
+  static AmPromptEncoderThread* instance() {
+    AmLock l(_instance_mut);
+    if (!_instance) {
+      _instance = new AmPromptEncoderThread();
+      _instance->start();
+    }
+    return _instance;
+  }
+
+  void post(AmFileMapping* m, AmEncodedPrompt* e) {
+    Job j = { AmFileMapping::ref(m), e };
+    AmLock l(jobs_mut);
+    jobs.push_back(j);
+    has_jobs.set(true);
+  }
+};
+
+AmPromptEncoderThread* AmPromptEncoderThread::_instance = NULL;
+AmMutex AmPromptEncoderThread::_instance_mut;
+
+void AmFileMapping::encode(AmEncodedPrompt* e) {
+  AmCachedAudioFile src(this);
+  if (src.is_good())
+    e->encode(&src, name);
+
+  AmLock l(encoded_mut);
+  e->ready = true;
+
+  DBG("encoded '%s' with codec %i (%u Hz, %u samples per frame): "
+      "%u frames, %u bytes\n", name.c_str(), e->codec_id, e->rate,
+      e->frame_size, e->frames(), (unsigned int)e->data.size());
+}
+
+const AmEncodedPrompt* AmFileCache::getEncoded(int codec_id, unsigned int rate,
+					       unsigned int frame_size) {
+  if (!mapping)
+    return NULL;
+  return mapping->getEncoded(codec_id, rate, frame_size);
+}
+
+const AmEncodedPrompt* AmFileMapping::getEncoded(int codec_id, unsigned int rate,
+						 unsigned int frame_size) {
+  AmLock l(encoded_mut);
+
+  AmEncodedPrompt* e = NULL;
+  for (std::vector<AmEncodedPrompt*>::iterator it = encoded.begin();
+       it != encoded.end(); ++it) {
+    if (((*it)->codec_id == codec_id) && ((*it)->rate == rate) &&
+	((*it)->frame_size == frame_size)) {
+      e = *it;
+      break;
+    }
+  }
+
+  if (!e) {
+    // not in the media processing thread asking for it; failures
+    // are kept as well, not to try again for every session
+    e = new AmEncodedPrompt(codec_id, rate, frame_size);
+    encoded.push_back(e);
+    AmPromptEncoderThread::instance()->post(this, e);
+    return NULL;
+  }
+
+  return (e->ready && e->frames()) ? e : NULL;
+}
+
 
 AmCachedAudioFile::AmCachedAudioFile(AmFileCache* cache) 
-  : cache(cache), loop(false), fpos(0), begin(0), good(false)
+  : mapping(NULL), fpos(0), begin(0), good(false),
+    encoded(NULL), encoded_codec_id(-1), encoded_frame_size(0), loop(false)
 {
-  if (!cache) {
+  if (!cache || !cache->getMapping()) {
     ERROR("Need open file cache.\n");
     return;
   }
 
-  AmAudioFileFormat* f_fmt = fileName2Fmt(cache->getFilename());
+  mapping = AmFileMapping::ref(cache->getMapping());
+  init();
+}
+
+AmCachedAudioFile::AmCachedAudioFile(AmFileMapping* mapping)
+  : mapping(AmFileMapping::ref(mapping)), fpos(0), begin(0), good(false),
+    encoded(NULL), encoded_codec_id(-1), encoded_frame_size(0), loop(false)
+{
+  init();
+}
+
+void AmCachedAudioFile::init()
+{
+  AmAudioFileFormat* f_fmt = fileName2Fmt(mapping->getFilename());
   if(!f_fmt){
     ERROR("while trying to determine the format of '%s'\n",
-	  cache->getFilename().c_str());
+	  mapping->getFilename().c_str());
     return;
   }
   fmt.reset(f_fmt);
@@ -136,7 +441,7 @@ AmCachedAudioFile::AmCachedAudioFile(AmFileCache* cache)
   long unsigned int ofpos = fpos;
 
   if( iofmt->mem_open && 
-      !(ret = (*iofmt->mem_open)((unsigned char*)cache->getData(),cache->getSize(),&ofpos,
+      !(ret = (*iofmt->mem_open)((unsigned char*)mapping->getData(),mapping->getSize(),&ofpos,
 				 &fd,AmAudioFile::Read,f_fmt->getHCodecNoInit())) ) {
     f_fmt->setSubtypeId(fd.subtype);
     f_fmt->channels = fd.channels;
@@ -154,11 +459,11 @@ AmCachedAudioFile::AmCachedAudioFile(AmFileCache* cache)
   }
 
   good = true;
-
-  return;
 }
 
 AmCachedAudioFile::~AmCachedAudioFile() {
+  if (mapping)
+    AmFileMapping::release(mapping);
 }
 
 AmAudioFileFormat* AmCachedAudioFile::fileName2Fmt(const string& name)
@@ -198,13 +503,13 @@ int AmCachedAudioFile::read(unsigned int user_ts, unsigned int size) {
     return -1;
   }
 
-  int ret = cache->read((void*)((unsigned char*)samples),&fpos,size);
+  int ret = mapping->read((void*)((unsigned char*)samples),&fpos,size);
 	
   //DBG("s = %i; ret = %i\n",s,ret);
-  if(loop.get() && (ret <= 0) && fpos==cache->getSize()){
+  if(loop.get() && (ret <= 0) && fpos==mapping->getSize()){
     DBG("rewinding audio file...\n");
     rewind();
-    ret = cache->read((void*)((unsigned char*)samples),&fpos, size);
+    ret = mapping->read((void*)((unsigned char*)samples),&fpos, size);
   }
 
   if(ret > 0 && (unsigned int)ret < size){
@@ -213,7 +518,51 @@ int AmCachedAudioFile::read(unsigned int user_ts, unsigned int size) {
     return size;
   }
 
-  return (fpos==cache->getSize() && !loop.get() ? -2 : ret);
+  return (fpos==mapping->getSize() && !loop.get() ? -2 : ret);
+}
+
+int AmCachedAudioFile::getEncoded(unsigned long long system_ts, unsigned char* buffer,
+				  int codec_id, unsigned int rate, unsigned int nb_samples) {
+  if (!good || (fmt->channels != 1) || (rate != (unsigned int)getSampleRate()) ||
+      !AmFileCache::isPrecodable(codec_id))
+    return 0;
+
+  if ((codec_id != encoded_codec_id) || (nb_samples != encoded_frame_size)) {
+    encoded = NULL;
+    encoded_codec_id = codec_id;
+    encoded_frame_size = nb_samples;
+  }
+
+  if (!encoded) {
+    // PCM is played until the background encoding is done
+    encoded = mapping->getEncoded(codec_id, rate, nb_samples);
+    if (!encoded)
+      return 0;
+  }
+
+  if (fpos >= mapping->getSize()) {
+    if (!loop.get())
+      return 0; // get() reports EOF
+    rewind();
+  }
+
+  // only on frame boundaries, else get() catches up
+  size_t frame_bytes = calcBytesToRead(nb_samples);
+  if (!frame_bytes || ((fpos - begin) % frame_bytes))
+    return 0;
+
+  size_t i = (fpos - begin) / frame_bytes;
+  if (i >= encoded->frames())
+    return 0;
+
+  unsigned int len = encoded->frameLength(i);
+  memcpy(buffer, encoded->frame(i), len);
+
+  fpos += frame_bytes;
+  if (fpos > mapping->getSize())
+    fpos = mapping->getSize();
+
+  return len;
 }
 
 int AmCachedAudioFile::write(unsigned int user_ts, unsigned int size) {
@@ -27,19 +27,130 @@
 #define _AMFILECACHE_H
 
 #include "AmAudioFile.h"
+#include "AmThread.h"
 
 #include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/**
+ * \brief a cached file encoded for one payload
+ *
+ * Frame i holds the file's samples [i*frame_size, (i+1)*frame_size),
+ * the last one filled up with silence.
+ */
+struct AmEncodedPrompt
+{
+  int          codec_id;
+  unsigned int rate;
+  unsigned int frame_size;
+
+  std::vector<unsigned char> data;
+  /** frame i: data[offsets[i]] .. data[offsets[i+1]] */
+  std::vector<unsigned int>  offsets;
+
+  /** encoding done (AmFileMapping::encoded_mut) */
+  bool ready;
+
+  AmEncodedPrompt(int codec_id, unsigned int rate, unsigned int frame_size)
+    : codec_id(codec_id), rate(rate), frame_size(frame_size), ready(false) {}
+
+  /**
+   * Encode all of 'src' (mono, PCM16 at 'rate' after get()).
+   * @return false on error (no frames then)
+   */
+  bool encode(AmAudio* src, const std::string& name);
+
+  unsigned int frames() const {
+    return offsets.empty() ? 0 : offsets.size() - 1;
+  }
+  const unsigned char* frame(unsigned int i) const {
+    return &data[offsets[i]];
+  }
+  unsigned int frameLength(unsigned int i) const {
+    return offsets[i+1] - offsets[i];
+  }
+};
+
+/**
+ * \brief read-only mapping of a file
+ *
+ * Shared by all AmFileCache instances of the same file (same
+ * device, inode, size and modification time), so that modules
+ * loading the same prompts, or reloading them, do not map the
+ * file again. Users still playing a replaced file keep their
+ * reference.
+ *
+ * For codecs whose output does not depend on the session
+ * (see AmFileCache::isPrecodable()), the file is also encoded
+ * once per codec, rate and frame size, in the background after
+ * the first request. These frames are sent as they are by all
+ * sessions playing the file; until they are ready, the file is
+ * played as PCM.
+ */
+class AmFileMapping
+{
+  unsigned char* data;
+  size_t         data_size;
+  std::string    name;
+
+  dev_t  dev;
+  ino_t  ino;
+  time_t mtime;
+
+  /** references (mappings_mut) */
+  unsigned int refs;
+
+  /** encoded variants */
+  std::vector<AmEncodedPrompt*> encoded;
+  AmMutex encoded_mut;
+
+  AmFileMapping(const std::string& name);
+  ~AmFileMapping();
+
+  int map(int fd, const struct stat& sbuf);
+
+  /** encode 'e' (prompt encoder thread) */
+  void encode(AmEncodedPrompt* e);
+
+  friend class AmPromptEncoderThread;
+
+ public:
+  /**
+   * Map 'filename', or share the existing mapping.
+   * @return NULL on error
+   */
+  static AmFileMapping* get(const std::string& filename);
+
+  /** take another reference */
+  static AmFileMapping* ref(AmFileMapping* m);
+
+  /** drop a reference (get() or ref()) */
+  static void release(AmFileMapping* m);
+
+  const unsigned char* getData() const { return data; }
+  size_t getSize() const { return data_size; }
+  const std::string& getFilename() const { return name; }
+
+  /** read size bytes from pos into buf @return -1 at EOF */
+  int read(void* buf, size_t* pos, size_t size) const;
+
+  /** @see AmFileCache::getEncoded */
+  const AmEncodedPrompt* getEncoded(int codec_id, unsigned int rate,
+				    unsigned int frame_size);
+};
 
 /**
  * \brief memory cache for AmAudioFile 
  * 
- * The AmFileCache class loads a file once into memory 
+ * The AmFileCache class maps a file once into memory 
  * to be used e.g. by AmCachedAudioFile.
  */
 class AmFileCache 
 {
-  void* data;
-  size_t data_size;
+  AmFileMapping* mapping;
   std::string name;
 
  public:
@@ -57,7 +168,25 @@ class AmFileCache
   /** get the filename */
   const string& getFilename();
   /** get a pointer to the file's data - use with caution! */
-  void* getData() { return data; }
+  void* getData() { return mapping ? (void*)mapping->getData() : NULL; }
+  /** the (shared) mapping of the file, NULL if not loaded */
+  AmFileMapping* getMapping() { return mapping; }
+
+  /**
+   * may codec 'codec_id' be fed with pre-encoded frames? Only
+   * for stateless codecs, whose frames do not depend on what
+   * the session has sent before.
+   */
+  static bool isPrecodable(int codec_id);
+
+  /**
+   * Get the file encoded in frames of frame_size samples at
+   * 'rate' (the file's sample rate) with codec 'codec_id'.
+   * The first request starts encoding in the background.
+   * @return NULL if not encoded (yet)
+   */
+  const AmEncodedPrompt* getEncoded(int codec_id, unsigned int rate,
+				    unsigned int frame_size);
 };
 
 /**
@@ -69,13 +198,19 @@ class AmFileCache
 class AmCachedAudioFile 
 : public AmAudio
 {
-  AmFileCache* cache;
+  /** own reference: outlives the AmFileCache if need be */
+  AmFileMapping* mapping;
   /** current position */
   size_t fpos;
   /** beginning of data in file */
   size_t begin; 
   bool good;
 
+  /** encoded variant last asked for by getEncoded() */
+  const AmEncodedPrompt* encoded;
+  int          encoded_codec_id;
+  unsigned int encoded_frame_size;
+
   /** @see AmAudio::read */
   int read(unsigned int user_ts, unsigned int size);
 
@@ -85,11 +220,14 @@ class AmCachedAudioFile
   /** get the file format from the file name */
   AmAudioFileFormat* fileName2Fmt(const string& name);
 
+  void init();
+
   /** Format of that file. @see fp, open(). */
   amci_inoutfmt_t* iofmt;
 
  public:
   AmCachedAudioFile(AmFileCache* cache);
+  AmCachedAudioFile(AmFileMapping* mapping);
   ~AmCachedAudioFile();
 
   /** loop the file? */
@@ -105,5 +243,9 @@ class AmCachedAudioFile
 
   /** everything ok? */	
   bool is_good() { return good; }
+
+  /** @see AmAudio::getEncoded */
+  int getEncoded(unsigned long long system_ts, unsigned char* buffer,
+		 int codec_id, unsigned int rate, unsigned int nb_samples);
 };
 #endif //_AMFILECACHE_H
@@ -99,6 +99,22 @@ int AmConferenceChannel::get(unsigned long long system_ts, unsigned char* buffer
   return size;
 }
 
+int AmConferenceChannel::getEncoded(unsigned long long system_ts, unsigned char* buffer,
+				    int codec_id, unsigned int output_sample_rate,
+				    unsigned int nb_samples)
+{
+  // streams are dumped from the PCM path
+  if (AmConfig::DumpConferenceStreams)
+    return 0;
+
+  AmMultiPartyMixer* mixer = status->getMixer();
+  mixer->lock();
+  int size = mixer->GetEncodedChannelPacket(channel_id,system_ts,buffer,codec_id,
+					    output_sample_rate,nb_samples);
+  mixer->unlock();
+  return size;
+}
+
 ChannelWritingFile::ChannelWritingFile(const char* path) 
   : async_file(256*1024) // 256k buffer
 {
@@ -85,6 +85,11 @@ class AmConferenceChannel: public AmAudio
 
   ~AmConferenceChannel();
 
+  /** shared pre-encoded mix for non-speakers (N-best mode) */
+  int getEncoded(unsigned long long system_ts, unsigned char* buffer,
+		 int codec_id, unsigned int output_sample_rate,
+		 unsigned int nb_samples);
+
   string getConfID() { return conf_id; }
 };
 
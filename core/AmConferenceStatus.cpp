@@ -79,6 +79,23 @@ size_t AmConferenceStatus::getConferenceSize(const string& cid) {
   return res;
 }
 
+void AmConferenceStatus::setActiveSpeakers(const string& cid, unsigned int n)
+{
+  cid2s_mut.lock();
+  std::map<std::string,AmConferenceStatus*>::iterator it = cid2status.find(cid);
+
+  if(it != cid2status.end()){
+    if(it->second->mixer.getActiveSpeakers() != n) {
+      DBG("conference '%s': mixing %u active speakers\n",cid.c_str(),n);
+      it->second->mixer.setActiveSpeakers(n);
+    }
+  }
+  else {
+    ERROR("conference '%s' does not exists\n",cid.c_str());
+  }
+  cid2s_mut.unlock();
+}
+
 void AmConferenceStatus::postConferenceEvent(const string& cid, 
 					     int event_id, const string& sess_id) {
   AmConferenceStatus*  st = 0;
@@ -114,6 +114,12 @@ public:
 				  const string& sess_id);
 
   static size_t getConferenceSize(const string& cid);
+
+  /**
+   * Mix only the 'n' loudest participants of an existing
+   * conference (0: mix all). @see AmMultiPartyMixer::setActiveSpeakers
+   */
+  static void setActiveSpeakers(const string& cid, unsigned int n);
 };
 
 #endif
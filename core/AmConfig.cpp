@@ -40,6 +40,7 @@
 #include "log.h"
 #include "AmConfigReader.h"
 #include "AmUtils.h"
+#include "AmCpuAffinity.h"
 #include "AmSessionContainer.h"
 #include "Am100rel.h"
 #include "sip/transport.h"
@@ -51,6 +52,8 @@
 #include <cctype>
 #include <algorithm>
 
+#include <sys/time.h>
+
 using std::make_pair;
 
 string       AmConfig::ConfigurationFile       = CONFIG_FILE;
@@ -80,8 +83,20 @@ unsigned int AmConfig::MaxShutdownTime         = DEFAULT_MAX_SHUTDOWN_TIME;
 
 int          AmConfig::SessionProcessorThreads = NUM_SESSION_PROCESSORS;
 int          AmConfig::MediaProcessorThreads   = NUM_MEDIA_PROCESSORS;
+unsigned int AmConfig::MediaRebalanceInterval  = MEDIA_REBALANCE_INTERVAL;
+unsigned int AmConfig::MediaRebalanceThreshold = MEDIA_REBALANCE_THRESHOLD;
 int          AmConfig::RTPReceiverThreads      = NUM_RTP_RECEIVERS;
 int          AmConfig::SIPServerThreads        = NUM_SIP_SERVERS;
+int          AmConfig::TimerThreads            = NUM_TIMER_THREADS;
+unsigned int AmConfig::RtpPacketPoolSize       = RTP_PACKET_POOL_SIZE;
+unsigned int AmConfig::RtpPacketQuota          = RTP_PACKET_QUOTA;
+bool         AmConfig::PromptCachePopulate     = false;
+bool         AmConfig::PromptCacheHugePages    = false;
+bool         AmConfig::NumaThreadAffinity      = false;
+vector<int>  AmConfig::MediaProcessorCpus;
+vector<int>  AmConfig::RtpReceiverCpus;
+vector<int>  AmConfig::SipServerCpus;
+vector<int>  AmConfig::SessionProcessorCpus;
 string       AmConfig::OutboundProxy           = "";
 bool         AmConfig::ForceOutboundProxy      = false;
 string       AmConfig::NextHop                 = "";
@@ -120,6 +135,14 @@ string       AmConfig::OptionsSessionLimitErrReason   = "Server overload";
 unsigned int AmConfig::CPSLimitErrCode     = 503;
 string       AmConfig::CPSLimitErrReason   = "Server overload";
 
+unsigned int AmConfig::OverloadInterval         = OVERLOAD_INTERVAL;
+unsigned int AmConfig::OverloadMaxRxDrops       = 0;
+unsigned int AmConfig::OverloadMaxSipLatency    = 0;
+unsigned int AmConfig::OverloadMaxEventBacklog  = 0;
+unsigned int AmConfig::OverloadMaxMediaOverruns = 0;
+unsigned int AmConfig::OverloadRetryAfter       = 0;
+vector<string> AmConfig::OverloadExemptNumbers;
+
 bool         AmConfig::AcceptForkedDialogs     = true;
 
 bool         AmConfig::ShutdownMode            = false;
@@ -153,7 +176,7 @@ AmAudio::ResamplingImplementationType AmConfig::ResamplingImplementationType = A
 #endif
 #ifndef USE_LIBSAMPLERATE
 #ifndef USE_INTERNAL_RESAMPLER
-AmAudio::ResamplingImplementationType AmConfig::ResamplingImplementationType = AmAudio::UNAVAILABLE;
+AmAudio::ResamplingImplementationType AmConfig::ResamplingImplementationType = AmAudio::POLYPHASE_RESAMPLER;
 #endif
 #endif
 
@@ -180,31 +203,150 @@ AmConfig::RTP_interface::RTP_interface()
   : IP_interface(),
     RtpLowPort(RTP_LOWPORT),
     RtpHighPort(RTP_HIGHPORT),
-    next_rtp_port(-1)
+    RtpRecvBatch(0),
+    RtpPortQuarantine(0),
+    first_rtp_port(0),
+    n_port_pairs(0),
+    n_free_pairs(0),
+    n_alloc_failed(0),
+    next_pair(0)
+{
+}
+
+void AmConfig::RTP_interface::initPortPool()
+{
+  // RTP on even ports, RTCP on port+1 (both <= RtpHighPort)
+  first_rtp_port = (RtpLowPort + 1) & ~1;
+  if(RtpHighPort > first_rtp_port)
+    n_port_pairs = (RtpHighPort - first_rtp_port + 1) / 2;
+  else
+    n_port_pairs = 0;
+
+  port_map.assign((n_port_pairs + 63) / 64, ~0ULL);
+  if(n_port_pairs % 64)
+    port_map.back() = (1ULL << (n_port_pairs % 64)) - 1;
+
+  n_free_pairs = n_port_pairs;
+  next_pair = 0;
+
+  DBG("RTP port pool on interface '%s': %u port pairs starting at %i\n",
+      name.c_str(),n_port_pairs,first_rtp_port);
+}
+
+void AmConfig::RTP_interface::releaseQuarantinedPorts(const struct timeval& now)
 {
+  while(!port_quarantine.empty() &&
+	!timercmp(&now,&port_quarantine.front().second,<)) {
+
+    unsigned int idx = port_quarantine.front().first;
+    port_map[idx / 64] |= 1ULL << (idx % 64);
+    n_free_pairs++;
+    port_quarantine.pop_front();
+  }
 }
 
 int AmConfig::RTP_interface::getNextRtpPort()
 {
-    
-  int port=0;
+  AmLock l(next_rtp_port_mut);
+
+  if(port_map.empty()) {
+    initPortPool();
+    if(port_map.empty())
+      return 0;
+  }
 
-  next_rtp_port_mut.lock();
-  if(next_rtp_port < 0){
-    next_rtp_port = RtpLowPort;
+  if(!port_quarantine.empty()) {
+    struct timeval now;
+    gettimeofday(&now,NULL);
+    releaseQuarantinedPorts(now);
   }
-    
-  port = next_rtp_port & 0xfffe;
-  next_rtp_port += 2;
 
-  if(next_rtp_port >= RtpHighPort){
-    next_rtp_port = RtpLowPort;
+  if(!n_free_pairs) {
+    n_alloc_failed++;
+    return 0;
   }
-  next_rtp_port_mut.unlock();
-    
-  return port;
+
+  // search from where the last allocation stopped
+  unsigned int n_words = port_map.size();
+  unsigned int w = next_pair / 64;
+  unsigned long long mask = ~0ULL << (next_pair % 64);
+
+  for(unsigned int i=0; i <= n_words; i++) {
+
+    unsigned long long bits = port_map[w] & mask;
+    if(bits) {
+      unsigned int idx = w*64 + __builtin_ctzll(bits);
+      port_map[w] &= ~(1ULL << (idx % 64));
+      n_free_pairs--;
+
+      next_pair = idx + 1;
+      if(next_pair >= n_port_pairs)
+	next_pair = 0;
+
+      return first_rtp_port + 2*idx;
+    }
+
+    mask = ~0ULL;
+    if(++w >= n_words)
+      w = 0;
+  }
+
+  ERROR("BUG: RTP port pool bitmap inconsistent (free pairs = %u)\n",
+	n_free_pairs);
+  n_alloc_failed++;
+  return 0;
 }
 
+void AmConfig::RTP_interface::freeRtpPort(int port)
+{
+  AmLock l(next_rtp_port_mut);
+
+  if((port < first_rtp_port) || (port & 1) ||
+     ((unsigned int)(port - first_rtp_port)/2 >= n_port_pairs)) {
+    ERROR("freeing RTP port %i which is not in the pool of '%s'\n",
+	  port,name.c_str());
+    return;
+  }
+
+  unsigned int idx = (port - first_rtp_port) / 2;
+  if(port_map[idx / 64] & (1ULL << (idx % 64))) {
+    ERROR("BUG: RTP port %i freed twice\n",port);
+    return;
+  }
+
+  if(!RtpPortQuarantine) {
+    port_map[idx / 64] |= 1ULL << (idx % 64);
+    n_free_pairs++;
+    return;
+  }
+
+  struct timeval expire;
+  gettimeofday(&expire,NULL);
+  expire.tv_sec  += RtpPortQuarantine / 1000;
+  expire.tv_usec += (RtpPortQuarantine % 1000) * 1000;
+  if(expire.tv_usec >= 1000000) {
+    expire.tv_sec++;
+    expire.tv_usec -= 1000000;
+  }
+
+  port_quarantine.push_back(std::make_pair(idx,expire));
+}
+
+void AmConfig::RTP_interface::getRtpPortStats(unsigned int& total,
+					      unsigned int& used,
+					      unsigned int& quarantined,
+					      unsigned int& failed)
+{
+  AmLock l(next_rtp_port_mut);
+
+  if(port_map.empty())
+    initPortPool();
+
+  total       = n_port_pairs;
+  quarantined = port_quarantine.size();
+  used        = n_port_pairs - n_free_pairs - quarantined;
+  failed      = n_alloc_failed;
+}
 
 int AmConfig::setLogLevel(const string& level, bool apply)
 {
@@ -399,6 +541,33 @@ int AmConfig::readConfiguration()
   if(cfg.hasParameter("disable_dns_srv")) {
     _resolver::disable_srv = (cfg.getParameter("disable_dns_srv") == "yes");
   }
+
+  if(cfg.hasParameter("dns_servers")) {
+    vector<string> servers = explode(cfg.getParameter("dns_servers"), ",");
+    for(vector<string>::iterator it = servers.begin();
+        it != servers.end(); ++it) {
+
+      string server = trim(*it, " \t");
+      unsigned int port = NS_DEFAULTPORT;
+      sockaddr_storage ss;
+      memset(&ss, 0, sizeof(sockaddr_storage));
+
+      if(am_inet_pton(server.c_str(), &ss) != 1) {
+        // address:port
+        size_t colon = server.rfind(':');
+        if((colon == string::npos) ||
+           str2i(server.substr(colon+1), port) ||
+           (am_inet_pton(server.substr(0,colon).c_str(), &ss) != 1)) {
+          ERROR("invalid DNS server '%s' in dns_servers\n", server.c_str());
+          ret = -1;
+          continue;
+        }
+      }
+
+      am_set_port(&ss, port);
+      _resolver::dns_servers.push_back(ss);
+    }
+  }
   
 
   for (int t = STIMER_A; t < __STIMER_MAX; t++) {
@@ -555,6 +724,22 @@ int AmConfig::readConfiguration()
     }
   }
 
+  if(cfg.hasParameter("media_rebalance_interval")){
+    if(str2i(cfg.getParameter("media_rebalance_interval"),
+	     MediaRebalanceInterval)) {
+      ERROR("invalid media_rebalance_interval value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("media_rebalance_threshold")){
+    if(str2i(cfg.getParameter("media_rebalance_threshold"),
+	     MediaRebalanceThreshold)) {
+      ERROR("invalid media_rebalance_threshold value specified");
+      ret = -1;
+    }
+  }
+
   if(cfg.hasParameter("rtp_receiver_threads")){
     if(!setRTPReceiverThreads(cfg.getParameter("rtp_receiver_threads"))){
       ERROR("invalid rtp_receiver_threads value specified");
@@ -562,6 +747,29 @@ int AmConfig::readConfiguration()
     }
   }
 
+  if(cfg.hasParameter("rtp_packet_pool_size")){
+    if(str2i(cfg.getParameter("rtp_packet_pool_size"), RtpPacketPoolSize)) {
+      ERROR("invalid rtp_packet_pool_size value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("rtp_packet_quota")){
+    if(str2i(cfg.getParameter("rtp_packet_quota"), RtpPacketQuota) ||
+       !RtpPacketQuota) {
+      ERROR("invalid rtp_packet_quota value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("prompt_cache_populate")) {
+    PromptCachePopulate = (cfg.getParameter("prompt_cache_populate") == "yes");
+  }
+
+  if(cfg.hasParameter("prompt_cache_hugepages")) {
+    PromptCacheHugePages = (cfg.getParameter("prompt_cache_hugepages") == "yes");
+  }
+
   if(cfg.hasParameter("sip_server_threads")){
     if(!setSIPServerThreads(cfg.getParameter("sip_server_threads"))){
       ERROR("invalid sip_server_threads value specified");
@@ -569,6 +777,47 @@ int AmConfig::readConfiguration()
     }
   }
 
+  if(cfg.hasParameter("timer_threads")){
+    if(!str2int(cfg.getParameter("timer_threads"), TimerThreads) ||
+       TimerThreads < 1) {
+      ERROR("invalid timer_threads value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("thread_affinity")){
+    string affinity = cfg.getParameter("thread_affinity");
+    if(affinity == "numa") {
+      NumaThreadAffinity = true;
+      if(AmCpuAffinity::getNumaNodes().size() < 2)
+	WARN("thread_affinity=numa, but less than two NUMA nodes found: "
+	     "threads will not be pinned\n");
+    } else if(affinity != "none") {
+      ERROR("invalid thread_affinity value specified");
+      ret = -1;
+    }
+  }
+
+  struct {
+    const char*  param;
+    vector<int>* cpus;
+  } cpu_params[] = {
+    { "media_processor_cpus",   &MediaProcessorCpus },
+    { "rtp_receiver_cpus",      &RtpReceiverCpus },
+    { "sip_server_cpus",        &SipServerCpus },
+    { "session_processor_cpus", &SessionProcessorCpus }
+  };
+
+  for(unsigned int i=0; i<sizeof(cpu_params)/sizeof(cpu_params[0]); i++) {
+    if(cfg.hasParameter(cpu_params[i].param)){
+      if(!AmCpuAffinity::parseCpuList(cfg.getParameter(cpu_params[i].param),
+				      *cpu_params[i].cpus)) {
+	ERROR("invalid %s value specified", cpu_params[i].param);
+	ret = -1;
+      }
+    }
+  }
+
   // single codec in 200 OK
   if(cfg.hasParameter("single_codec_in_ok")){
     SingleCodecInOK = (cfg.getParameter("single_codec_in_ok") == "yes");
@@ -646,6 +895,59 @@ int AmConfig::readConfiguration()
     }
   }
 
+  if(cfg.hasParameter("overload_interval")){
+    if(str2i(cfg.getParameter("overload_interval"), OverloadInterval) ||
+       !OverloadInterval) {
+      ERROR("invalid overload_interval value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("overload_max_rx_drops")){
+    if(str2i(cfg.getParameter("overload_max_rx_drops"), OverloadMaxRxDrops)) {
+      ERROR("invalid overload_max_rx_drops value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("overload_max_sip_latency")){
+    if(str2i(cfg.getParameter("overload_max_sip_latency"), OverloadMaxSipLatency)) {
+      ERROR("invalid overload_max_sip_latency value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("overload_max_event_backlog")){
+    if(str2i(cfg.getParameter("overload_max_event_backlog"), OverloadMaxEventBacklog)) {
+      ERROR("invalid overload_max_event_backlog value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("overload_max_media_overruns")){
+    if(str2i(cfg.getParameter("overload_max_media_overruns"), OverloadMaxMediaOverruns)) {
+      ERROR("invalid overload_max_media_overruns value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("overload_retry_after")){
+    if(str2i(cfg.getParameter("overload_retry_after"), OverloadRetryAfter)) {
+      ERROR("invalid overload_retry_after value specified");
+      ret = -1;
+    }
+  }
+
+  if(cfg.hasParameter("overload_exempt_numbers")){
+    OverloadExemptNumbers.clear();
+    vector<string> n = explode(cfg.getParameter("overload_exempt_numbers"), ",");
+    for(vector<string>::iterator it = n.begin(); it != n.end(); ++it) {
+      string num = trim(*it, " \t");
+      if(!num.empty())
+	OverloadExemptNumbers.push_back(num);
+    }
+  }
+
   if(cfg.hasParameter("accept_forked_dialogs"))
     AcceptForkedDialogs = !(cfg.getParameter("accept_forked_dialogs") == "no");
 
@@ -693,7 +995,27 @@ int AmConfig::readConfiguration()
   if (cfg.hasParameter("resampling_library")) {
 	string resamplings = cfg.getParameter("resampling_library");
 	if (resamplings == "libsamplerate") {
+#ifdef USE_LIBSAMPLERATE
 	  ResamplingImplementationType = AmAudio::LIBSAMPLERATE;
+#else
+	  WARN("libsamplerate support not compiled in, "
+	       "using the polyphase resampler.\n");
+	  ResamplingImplementationType = AmAudio::POLYPHASE_RESAMPLER;
+#endif
+	} else if (resamplings == "internal") {
+#ifdef USE_INTERNAL_RESAMPLER
+	  ResamplingImplementationType = AmAudio::INTERNAL_RESAMPLER;
+#else
+	  WARN("internal resampler not compiled in, "
+	       "using the polyphase resampler.\n");
+	  ResamplingImplementationType = AmAudio::POLYPHASE_RESAMPLER;
+#endif
+	} else if (resamplings == "polyphase") {
+	  ResamplingImplementationType = AmAudio::POLYPHASE_RESAMPLER;
+	} else {
+	  ERROR("unknown setting for 'resampling_library' config option: '%s'.\n",
+		resamplings.c_str());
+	  ret = -1;
 	}
   }
 
@@ -887,6 +1209,28 @@ static int readRTPInterface(AmConfigReader& cfg, const string& i_name)
     }
   }
 
+  // rtp_port_quarantine
+  if(cfg.hasParameter("rtp_port_quarantine" + suffix)){
+    string rtp_port_quarantine_str = cfg.getParameter("rtp_port_quarantine" + suffix);
+    if(sscanf(rtp_port_quarantine_str.c_str(),"%u",
+	      &(intf.RtpPortQuarantine)) != 1){
+      ERROR("rtp_port_quarantine%s: invalid value (%s)\n",
+	    suffix.c_str(),rtp_port_quarantine_str.c_str());
+      ret = -1;
+    }
+  }
+
+  // rtp_recv_batch
+  if(cfg.hasParameter("rtp_recv_batch" + suffix)){
+    string rtp_recv_batch_str = cfg.getParameter("rtp_recv_batch" + suffix);
+    if(sscanf(rtp_recv_batch_str.c_str(),"%u",
+	      &(intf.RtpRecvBatch)) != 1){
+      ERROR("rtp_recv_batch%s: invalid value (%s)\n",
+	    suffix.c_str(),rtp_recv_batch_str.c_str());
+      ret = -1;
+    }
+  }
+
   if(!i_name.empty())
     intf.name = i_name;
   else
@@ -1239,9 +1583,9 @@ void AmConfig::dump_Ifs()
     RTP_interface& it_ref = RTP_Ifs[i];
 
     INFO("\t(%i) name='%s'" ";LocalIP='%s'" 
-	 ";Ports=[%u;%u]" ";PublicIP='%s'",
+	 ";Ports=[%u;%u]" ";PublicIP='%s'" ";RecvBatch=%u",
 	 i,it_ref.name.c_str(),it_ref.LocalIP.c_str(),
 	 it_ref.RtpLowPort,it_ref.RtpHighPort,
-	 it_ref.PublicIP.c_str());
+	 it_ref.PublicIP.c_str(),it_ref.RtpRecvBatch);
   }
 }
@@ -40,6 +40,7 @@ using std::string;
 using std::map;
 using std::multimap;
 #include <utility>
+#include <deque>
 
 /**
  * \brief holds the current configuration.
@@ -126,13 +127,51 @@ struct AmConfig
     /** Highest local RTP port */
     int RtpHighPort;
 
+    /** 
+     * Max. number of RTP packets drained from a socket
+     * per receive call (recvmmsg); 0 or 1 disables batching.
+     */
+    unsigned int RtpRecvBatch;
+
+    /** 
+     * Time (in ms) a released port pair is kept out of use,
+     * so that late packets do not reach the next call.
+     */
+    unsigned int RtpPortQuarantine;
+
     RTP_interface();
 
+    /**
+     * Allocate a free RTP port (even, RTCP on port+1).
+     * @return the RTP port, 0 if the range is exhausted.
+     */
     int getNextRtpPort();
 
+    /** Return a port obtained from getNextRtpPort() to the pool */
+    void freeRtpPort(int port);
+
+    /** Port pool utilisation (in port pairs) */
+    void getRtpPortStats(unsigned int& total, unsigned int& used,
+			 unsigned int& quarantined, unsigned int& failed);
+
   private:
-    int next_rtp_port;
+    /** first (even) port of the pool */
+    int first_rtp_port;
+    /** number of port pairs in the pool */
+    unsigned int n_port_pairs;
+    unsigned int n_free_pairs;
+    /** allocation failures (pool exhausted) */
+    unsigned int n_alloc_failed;
+    /** bitmap of free port pairs (bit set = free) */
+    vector<unsigned long long> port_map;
+    /** where to continue searching for a free pair */
+    unsigned int next_pair;
+    /** released pairs waiting for their quarantine to expire */
+    std::deque<std::pair<unsigned int,struct timeval> > port_quarantine;
     AmMutex next_rtp_port_mut;
+
+    void initPortPool();
+    void releaseQuarantinedPorts(const struct timeval& now);
   };
 
   static vector<SIP_interface>      SIP_Ifs;
@@ -173,10 +212,34 @@ struct AmConfig
   static int SessionProcessorThreads;
   /** number of media processor threads */
   static int MediaProcessorThreads;
+  /** seconds between media processor rebalancing runs (0: disabled) */
+  static unsigned int MediaRebalanceInterval;
+  /** min. processing time difference for rebalancing (% of a tick) */
+  static unsigned int MediaRebalanceThreshold;
   /** number of RTP receiver threads */
   static int RTPReceiverThreads;
   /** number of SIP server threads */
   static int SIPServerThreads;
+  /** number of timer threads (SIP stack and application timers each) */
+  static int TimerThreads;
+  /** RTP receive buffers preallocated per RTP receiver thread */
+  static unsigned int RtpPacketPoolSize;
+  /** max. number of RTP receive buffers held by a stream */
+  static unsigned int RtpPacketQuota;
+  /** read cached audio files in completely when mapping them */
+  static bool PromptCachePopulate;
+  /** back cached audio files with transparent huge pages */
+  static bool PromptCacheHugePages;
+  /** spread RTP receiver and media processor threads over NUMA nodes */
+  static bool NumaThreadAffinity;
+  /** CPUs of the media processor threads (empty: not pinned) */
+  static vector<int> MediaProcessorCpus;
+  /** CPUs of the RTP receiver threads (empty: not pinned) */
+  static vector<int> RtpReceiverCpus;
+  /** CPUs of the SIP server threads (empty: not pinned) */
+  static vector<int> SipServerCpus;
+  /** CPUs of the session processor threads (empty: not pinned) */
+  static vector<int> SessionProcessorCpus;
   /** Outbound Proxy (optional, outgoing calls only) */
   static string OutboundProxy;
   /** force Outbound Proxy to be used for in dialog requests */
@@ -237,6 +300,18 @@ struct AmConfig
   static unsigned int CPSLimitErrCode;
   static string CPSLimitErrReason;
 
+  /** ms between overload control samples */
+  static unsigned int OverloadInterval;
+  /** overload thresholds (0: not used) */
+  static unsigned int OverloadMaxRxDrops;       // per second
+  static unsigned int OverloadMaxSipLatency;    // ms
+  static unsigned int OverloadMaxEventBacklog;  // events
+  static unsigned int OverloadMaxMediaOverruns; // per second
+  /** Retry-After of the overload replies [s] (0: none) */
+  static unsigned int OverloadRetryAfter;
+  /** R-URI user parts never rejected on overload */
+  static vector<string> OverloadExemptNumbers;
+
   static bool AcceptForkedDialogs;
 
   static bool ShutdownMode;
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * For a license to use the sems software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmCpuAffinity.h"
+#include "AmConfig.h"
+#include "AmThread.h"
+#include "AmUtils.h"
+#include "log.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYSFS_NODE_DIR "/sys/devices/system/node"
+
+static bool parse_cpu(const string& s, int& cpu)
+{
+  string n = trim(s, " \t");
+  return !n.empty() && str2int(n, cpu);
+}
+
+bool AmCpuAffinity::parseCpuList(const string& s, vector<int>& cpus)
+{
+  cpus.clear();
+
+  vector<string> ranges = explode(s, ",");
+  for(vector<string>::iterator it = ranges.begin();
+      it != ranges.end(); ++it) {
+
+    string r = trim(*it, " \t\n");
+    if(r.empty())
+      continue;
+
+    int first, last;
+    size_t dash = r.find('-');
+    if(dash == string::npos) {
+      if(!parse_cpu(r, first))
+	return false;
+      last = first;
+    }
+    else {
+      if(!parse_cpu(r.substr(0,dash), first) ||
+	 !parse_cpu(r.substr(dash+1), last))
+	return false;
+    }
+
+    if(first < 0 || last < first)
+      return false;
+
+    for(int cpu = first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+  }
+
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return true;
+}
+
+string AmCpuAffinity::printCpuList(const vector<int>& cpus)
+{
+  string res;
+
+  for(size_t i = 0; i < cpus.size();) {
+    size_t j = i;
+    while(j + 1 < cpus.size() && cpus[j+1] == cpus[j] + 1)
+      j++;
+
+    if(!res.empty())
+      res += ",";
+    res += int2str(cpus[i]);
+    if(j > i)
+      res += "-" + int2str(cpus[j]);
+
+    i = j + 1;
+  }
+
+  return res;
+}
+
+static vector<vector<int> > read_numa_nodes()
+{
+  vector<vector<int> > nodes;
+
+  DIR* dir = opendir(SYSFS_NODE_DIR);
+  if(!dir)
+    return nodes;
+
+  vector<int> node_ids;
+  struct dirent* e;
+  while((e = readdir(dir)) != NULL) {
+    int id;
+    if(!strncmp(e->d_name, "node", 4) && str2int(e->d_name + 4, id))
+      node_ids.push_back(id);
+  }
+  closedir(dir);
+
+  std::sort(node_ids.begin(), node_ids.end());
+  for(vector<int>::iterator it = node_ids.begin();
+      it != node_ids.end(); ++it) {
+
+    std::ifstream f((SYSFS_NODE_DIR "/node" + int2str(*it) + "/cpulist").c_str());
+    string line;
+    vector<int> cpus;
+    if(!std::getline(f, line) || !AmCpuAffinity::parseCpuList(line, cpus))
+      continue;
+
+    // skip memory-only nodes
+    if(!cpus.empty())
+      nodes.push_back(cpus);
+  }
+
+  return nodes;
+}
+
+const vector<vector<int> >& AmCpuAffinity::getNumaNodes()
+{
+  static const vector<vector<int> > nodes = read_numa_nodes();
+  return nodes;
+}
+
+vector<int> AmCpuAffinity::getCpus(ThreadClass cls, unsigned int idx)
+{
+  const vector<int>* cpus = NULL;
+  switch(cls) {
+  case MediaProcessor:   cpus = &AmConfig::MediaProcessorCpus; break;
+  case RtpReceiver:      cpus = &AmConfig::RtpReceiverCpus; break;
+  case SipServer:        cpus = &AmConfig::SipServerCpus; break;
+  case SessionProcessor: cpus = &AmConfig::SessionProcessorCpus; break;
+  default: break;
+  }
+
+  if(cpus && !cpus->empty())
+    return *cpus;
+
+  if(AmConfig::NumaThreadAffinity &&
+     (cls == MediaProcessor || cls == RtpReceiver)) {
+
+    const vector<vector<int> >& nodes = getNumaNodes();
+    if(nodes.size() > 1)
+      return nodes[idx % nodes.size()];
+  }
+
+  return vector<int>();
+}
+
+void AmCpuAffinity::apply(AmThread* t, ThreadClass cls, unsigned int idx)
+{
+  static const char* cls_names[ThreadClasses] = {
+    "media processor", "RTP receiver", "SIP server", "session processor"
+  };
+
+  vector<int> cpus = getCpus(cls, idx);
+  if(cpus.empty())
+    return;
+
+  DBG("%s thread %u: CPUs %s\n", cls_names[cls], idx,
+      printCpuList(cpus).c_str());
+  t->setAffinity(cpus);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * For a license to use the sems software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmCpuAffinity.h */
+#ifndef _AmCpuAffinity_h_
+#define _AmCpuAffinity_h_
+
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+class AmThread;
+
+/**
+ * \brief CPU placement of the core's thread classes
+ *
+ * A thread class is either pinned to the CPU set configured for it
+ * (e.g. media_processor_cpus), or, with thread_affinity=numa, the
+ * RTP receiver and media processor threads are spread round robin
+ * over the NUMA nodes and pinned to the CPUs of their node, so that
+ * every node runs both receivers and media processors. Streams and
+ * sessions are not assigned by node, so the threads handling one
+ * call may still run on different nodes.
+ *
+ * Applications may place their own threads with
+ * AmThread::setAffinity(), using the helpers below.
+ */
+class AmCpuAffinity
+{
+public:
+  enum ThreadClass {
+    MediaProcessor=0,
+    RtpReceiver,
+    SipServer,
+    SessionProcessor,
+    ThreadClasses
+  };
+
+  /**
+   * Parse a CPU list like "0-3,8,10-11" (as used by taskset
+   * and sysfs) into a sorted list of CPU numbers.
+   * @return false on syntax error
+   */
+  static bool parseCpuList(const string& s, vector<int>& cpus);
+
+  /** print a CPU list in the format parsed by parseCpuList() */
+  static string printCpuList(const vector<int>& cpus);
+
+  /**
+   * CPUs of each NUMA node (empty if the topology
+   * cannot be read, e.g. on non-NUMA kernels)
+   */
+  static const vector<vector<int> >& getNumaNodes();
+
+  /**
+   * CPUs configured for thread 'idx' of class 'cls',
+   * empty if the thread is not to be pinned.
+   */
+  static vector<int> getCpus(ThreadClass cls, unsigned int idx);
+
+  /** set the configured CPUs of thread 'idx' of class 'cls' on 't' */
+  static void apply(AmThread* t, ThreadClass cls, unsigned int idx);
+};
+
+#endif
+
+// Local Variables:
+// mode:C++
+// End:
@@ -29,6 +29,7 @@
 #define AmEvent_h
 
 #include "AmArg.h"
+#include "AmEventPool.h"
 
 #include <string>
 using std::string;
@@ -45,6 +46,9 @@ struct AmEvent
   int event_id;
   bool processed;
 
+  /** link in the AmEventQueue the event is posted to */
+  AmEvent* volatile next_event;
+
   AmEvent(int event_id);
   AmEvent(const AmEvent& rhs);
 
@@ -81,6 +85,8 @@ class AmTimeoutEvent : public AmPluginEvent
 {
  public:
   AmTimeoutEvent(int timer_id);
+
+  AM_EVENT_POOLED(AmTimeoutEvent);
 };
 
 /**
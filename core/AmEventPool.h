@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmEventPool.h */
+#ifndef _AmEventPool_h_
+#define _AmEventPool_h_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <new>
+
+/** objects moved at once between a thread's cache and the depot */
+#define EVENT_POOL_BATCH       32
+/** batches kept in the depot at most (others are freed) */
+#define EVENT_POOL_MAX_BATCHES 64
+
+/**
+ * \brief Free lists for frequently posted events
+ *
+ * Events are mostly allocated by one thread (SIP, timers, media)
+ * and deleted by another one (session). Deleted objects go to a
+ * per-thread cache; once it holds two batches, one is handed over
+ * to the depot, from which allocating threads refill their cache.
+ * The depot lock is thus taken once per EVENT_POOL_BATCH objects.
+ *
+ * Put AM_EVENT_POOLED(cls) into the class declaration. Objects of
+ * derived classes (other size) still come from the heap.
+ */
+template<class T>
+class AmEventPool
+{
+  struct node {
+    node* next;       // within a cache or batch
+    node* next_batch; // within the depot
+  };
+
+  struct cache {
+    node*        head;
+    unsigned int n;
+    bool         registered;
+  };
+
+  static __thread cache local;
+
+  // plain pthread objects: usable during static initialization
+  static pthread_mutex_t depot_mut;
+  static node*           depot;
+  static unsigned int    depot_batches;
+
+  static pthread_key_t   key;
+  static pthread_once_t  key_once;
+
+  static void create_key() {
+    pthread_key_create(&key,thread_exit);
+  }
+
+  /** hands the cache over to the depot when the thread exits */
+  static void thread_exit(void*) {
+    cache& c = local;
+    while(c.n >= EVENT_POOL_BATCH)
+      flush(c);
+
+    while(c.head) {
+      node* n = c.head;
+      c.head = n->next;
+      ::operator delete(n);
+    }
+    c.n = 0;
+  }
+
+  static void register_thread(cache& c) {
+    pthread_once(&key_once,create_key);
+    pthread_setspecific(key,&c);
+    c.registered = true;
+  }
+
+  /** moves the first EVENT_POOL_BATCH objects of the cache to the depot */
+  static void flush(cache& c) {
+    node* batch = c.head;
+    node* last = batch;
+    for(unsigned int i=1; i<EVENT_POOL_BATCH; i++)
+      last = last->next;
+
+    c.head = last->next;
+    c.n -= EVENT_POOL_BATCH;
+    last->next = NULL;
+
+    pthread_mutex_lock(&depot_mut);
+    if(depot_batches < EVENT_POOL_MAX_BATCHES) {
+      batch->next_batch = depot;
+      depot = batch;
+      depot_batches++;
+      batch = NULL;
+    }
+    pthread_mutex_unlock(&depot_mut);
+
+    while(batch) {
+      node* n = batch;
+      batch = n->next;
+      ::operator delete(n);
+    }
+  }
+
+  /** @return false if the depot is empty */
+  static bool refill(cache& c) {
+    pthread_mutex_lock(&depot_mut);
+    node* batch = depot;
+    if(batch) {
+      depot = batch->next_batch;
+      depot_batches--;
+    }
+    pthread_mutex_unlock(&depot_mut);
+
+    if(!batch)
+      return false;
+
+    if(!c.registered)
+      register_thread(c);
+
+    c.head = batch;
+    c.n = EVENT_POOL_BATCH;
+    return true;
+  }
+
+public:
+  static void* alloc(size_t size) {
+    cache& c = local;
+    if((size != sizeof(T)) || (!c.head && !refill(c)))
+      return ::operator new(size);
+
+    node* n = c.head;
+    c.head = n->next;
+    c.n--;
+    return n;
+  }
+
+  static void release(void* p, size_t size) {
+    if(!p)
+      return;
+
+    if(size != sizeof(T)) {
+      ::operator delete(p);
+      return;
+    }
+
+    cache& c = local;
+    if(!c.registered)
+      register_thread(c);
+
+    node* n = (node*)p;
+    n->next = c.head;
+    c.head = n;
+    if(++c.n >= 2*EVENT_POOL_BATCH)
+      flush(c);
+  }
+
+  /** objects available in the depot (not counting the thread caches) */
+  static unsigned int depot_size() {
+    pthread_mutex_lock(&depot_mut);
+    unsigned int n = depot_batches * EVENT_POOL_BATCH;
+    pthread_mutex_unlock(&depot_mut);
+    return n;
+  }
+};
+
+template<class T>
+__thread typename AmEventPool<T>::cache AmEventPool<T>::local;
+
+template<class T>
+pthread_mutex_t AmEventPool<T>::depot_mut = PTHREAD_MUTEX_INITIALIZER;
+
+template<class T>
+typename AmEventPool<T>::node* AmEventPool<T>::depot = NULL;
+
+template<class T>
+unsigned int AmEventPool<T>::depot_batches = 0;
+
+template<class T>
+pthread_key_t AmEventPool<T>::key;
+
+template<class T>
+pthread_once_t AmEventPool<T>::key_once = PTHREAD_ONCE_INIT;
+
+/** allocate objects of 'cls' from AmEventPool<cls> */
+#define AM_EVENT_POOLED(cls)					\
+  static void* operator new(size_t size)			\
+  { return AmEventPool<cls>::alloc(size); }			\
+  static void operator delete(void* p, size_t size)		\
+  { AmEventPool<cls>::release(p,size); }
+
+#endif
@@ -30,22 +30,98 @@
 #include "AmConfig.h"
 
 #include <typeinfo>
+#include <sched.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <limits.h>
+#endif
+
+atomic_int AmEventQueue::pending_events;
+
 AmEventQueue::AmEventQueue(AmEventHandler* handler)
   : handler(handler),
     wakeup_handler(NULL),
-    ev_pending(false),
+    ev_head(&ev_stub),
+    ev_tail(&ev_stub),
+    ev_stub(-1),
+    ev_pending(0),
+#ifdef __linux__
+    ev_waiting(0),
+#else
+    ev_wakeup(false),
+#endif
     finalized(false)
 {
 }
 
 AmEventQueue::~AmEventQueue()
 {
-  m_queue.lock();
-  while(!ev_queue.empty()){
-    delete ev_queue.front();
-    ev_queue.pop();
+  AmEvent* event;
+  while((event = pop()) != NULL) {
+    delete event;
+    pending_events.dec();
   }
-  m_queue.unlock();
+}
+
+void AmEventQueue::push(AmEvent* event)
+{
+  event->next_event = NULL;
+  AmEvent* prev = __atomic_exchange_n(&ev_head,event,__ATOMIC_SEQ_CST);
+  // until linked, the consumer sees the queue as being in between
+  __atomic_store_n(&prev->next_event,event,__ATOMIC_RELEASE);
+}
+
+AmEvent* AmEventQueue::pop()
+{
+  AmEvent* tail = ev_tail;
+  AmEvent* next = __atomic_load_n(&tail->next_event,__ATOMIC_ACQUIRE);
+
+  if(tail == &ev_stub) {
+    if(!next) {
+      if(__atomic_load_n(&ev_head,__ATOMIC_SEQ_CST) == &ev_stub)
+	return NULL;
+
+      // a producer is about to link the first event
+      while((next = __atomic_load_n(&tail->next_event,__ATOMIC_ACQUIRE)) == NULL)
+	sched_yield();
+    }
+    ev_tail = next;
+    tail = next;
+    next = __atomic_load_n(&tail->next_event,__ATOMIC_ACQUIRE);
+  }
+
+  if(!next) {
+    if(__atomic_load_n(&ev_head,__ATOMIC_SEQ_CST) == tail) {
+      // last one: keep the stub as tail
+      push(&ev_stub);
+    }
+
+    while((next = __atomic_load_n(&tail->next_event,__ATOMIC_ACQUIRE)) == NULL)
+      sched_yield();
+  }
+
+  ev_tail = next;
+  return tail;
+}
+
+bool AmEventQueue::empty()
+{
+  return (ev_tail == &ev_stub) &&
+    (__atomic_load_n(&ev_head,__ATOMIC_SEQ_CST) == &ev_stub);
+}
+
+bool AmEventQueue::clearPending()
+{
+  __atomic_store_n(&ev_pending,0,__ATOMIC_SEQ_CST);
+  if(empty())
+    return true;
+
+  // a producer might have seen the old value and not notified
+  __atomic_store_n(&ev_pending,1,__ATOMIC_SEQ_CST);
+  return false;
 }
 
 void AmEventQueue::postEvent(AmEvent* event)
@@ -53,18 +129,26 @@ void AmEventQueue::postEvent(AmEvent* event)
   if (AmConfig::LogEvents) 
     DBG("AmEventQueue: trying to post event\n");
 
-  m_queue.lock();
+  if(event) {
+    pending_events.inc();
+    push(event);
+  }
 
-  if(event)
-    ev_queue.push(event);
+  if(!__atomic_load_n(&ev_pending,__ATOMIC_SEQ_CST) &&
+     __sync_bool_compare_and_swap(&ev_pending,0,1)) {
 
-  if(!ev_pending.get()) {
-    ev_pending.set(true);
-    if (NULL != wakeup_handler)
-      wakeup_handler->notify(this);
-  }
+    AmEventNotificationSink* sink =
+      __atomic_load_n(&wakeup_handler,__ATOMIC_SEQ_CST);
+    if (NULL != sink)
+      sink->notify(this);
 
-  m_queue.unlock();
+#ifdef __linux__
+    if(__atomic_load_n(&ev_waiting,__ATOMIC_SEQ_CST))
+      syscall(SYS_futex,&ev_pending,FUTEX_WAKE_PRIVATE,INT_MAX,NULL,NULL,0);
+#else
+    ev_wakeup.set(true);
+#endif
+  }
 
   if (AmConfig::LogEvents) 
     DBG("AmEventQueue: event posted\n");
@@ -72,43 +156,45 @@ void AmEventQueue::postEvent(AmEvent* event)
 
 void AmEventQueue::processEvents()
 {
-  m_queue.lock();
-
-  while(!ev_queue.empty()) {
-	
-    AmEvent* event = ev_queue.front();
-    ev_queue.pop();
-    m_queue.unlock();
-
-    if (AmConfig::LogEvents) 
-      DBG("before processing event (%s)\n",
-	  typeid(*event).name());
-    handler->process(event);
-    if (AmConfig::LogEvents) 
-      DBG("event processed (%s)\n",
-	  typeid(*event).name());
-    delete event;
-    m_queue.lock();
-  }
-    
-  ev_pending.set(false);
-  m_queue.unlock();
+  do {
+    AmEvent* event;
+    while((event = pop()) != NULL) {
+      pending_events.dec();
+
+      if (AmConfig::LogEvents)
+	DBG("before processing event (%s)\n",
+	    typeid(*event).name());
+      handler->process(event);
+      if (AmConfig::LogEvents)
+	DBG("event processed (%s)\n",
+	    typeid(*event).name());
+      delete event;
+    }
+  } while(!clearPending());
 }
 
 void AmEventQueue::waitForEvent()
 {
-  ev_pending.wait_for();
+#ifdef __linux__
+  while(!__atomic_load_n(&ev_pending,__ATOMIC_SEQ_CST)) {
+    __atomic_store_n(&ev_waiting,1,__ATOMIC_SEQ_CST);
+    if(!__atomic_load_n(&ev_pending,__ATOMIC_SEQ_CST))
+      syscall(SYS_futex,&ev_pending,FUTEX_WAIT_PRIVATE,0,NULL,NULL,0);
+    __atomic_store_n(&ev_waiting,0,__ATOMIC_SEQ_CST);
+  }
+#else
+  while(!__atomic_load_n(&ev_pending,__ATOMIC_SEQ_CST)) {
+    ev_wakeup.wait_for();
+    ev_wakeup.set(false);
+  }
+#endif
 }
 
 void AmEventQueue::processSingleEvent()
 {
-  m_queue.lock();
-
-  if (!ev_queue.empty()) {
-
-    AmEvent* event = ev_queue.front();
-    ev_queue.pop();
-    m_queue.unlock();
+  AmEvent* event = pop();
+  if (event) {
+    pending_events.dec();
 
     if (AmConfig::LogEvents) 
       DBG("before processing event\n");
@@ -116,28 +202,19 @@ void AmEventQueue::processSingleEvent()
     if (AmConfig::LogEvents) 
       DBG("event processed\n");
     delete event;
-
-    m_queue.lock();
-    if (ev_queue.empty())
-      ev_pending.set(false);
   }
 
-  m_queue.unlock();
+  if (empty())
+    clearPending();
 }
 
 bool AmEventQueue::eventPending() {
-  m_queue.lock();
-  bool res = !ev_queue.empty();
-  m_queue.unlock();
-  return res;
+  return !empty();
 }
 
 void AmEventQueue::setEventNotificationSink(AmEventNotificationSink* 
 					    _wakeup_handler) {
-  // locking actually not necessary - if replacing pointer is atomic 
-  m_queue.lock(); 
-  wakeup_handler = _wakeup_handler;
-  if(wakeup_handler && ev_pending.get())
-    wakeup_handler->notify(this);
-  m_queue.unlock();
+  __atomic_store_n(&wakeup_handler,_wakeup_handler,__ATOMIC_SEQ_CST);
+  if(_wakeup_handler && __atomic_load_n(&ev_pending,__ATOMIC_SEQ_CST))
+    _wakeup_handler->notify(this);
 }
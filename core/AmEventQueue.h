@@ -32,8 +32,6 @@
 #include "AmEvent.h"
 #include "atomic_types.h"
 
-#include <queue>
-
 class AmEventQueueInterface
 {
  public:
@@ -58,6 +56,12 @@ class AmEventNotificationSink
  * \ref AmEvent can safely be posted at any time from any 
  * thread, which are then processed by the registered event
  *  handler.
+ *
+ * Posting is lock-free (intrusive multi-producer/single-consumer
+ * queue linked through AmEvent::next_event). Only the thread
+ * turning the queue from idle to pending notifies the
+ * AmEventNotificationSink resp. wakes up waitForEvent() (futex).
+ * Events must be processed by one thread at a time.
  */
 class AmEventQueue
   : public AmEventQueueInterface,
@@ -65,14 +69,35 @@ class AmEventQueue
 {
 protected:
   AmEventHandler*           handler;
-  AmEventNotificationSink*  wakeup_handler;
+  AmEventNotificationSink* volatile wakeup_handler;
 
-  std::queue<AmEvent*>      ev_queue;
-  AmMutex                   m_queue;
-  AmCondition<bool>         ev_pending;
+  // producers append at ev_head, the consumer takes from ev_tail
+  AmEvent* volatile         ev_head;
+  AmEvent*                  ev_tail;
+  AmEvent                   ev_stub;
+
+  // 1 from the first event posted until the queue has been
+  // found empty by the consumer
+  volatile int              ev_pending;
+#ifdef __linux__
+  // consumer sleeping in waitForEvent()
+  volatile int              ev_waiting;
+#else
+  AmCondition<bool>         ev_wakeup;
+#endif
 
   bool finalized;
 
+  /** events posted to all queues, but not processed yet */
+  static atomic_int pending_events;
+
+  void push(AmEvent* event);
+  AmEvent* pop();
+  bool empty();
+
+  /** @return false if events arrived meanwhile (still pending) */
+  bool clearPending();
+
 public:
   AmEventQueue(AmEventHandler* handler);
   virtual ~AmEventQueue();
@@ -87,6 +112,9 @@ public:
 
   bool is_finalized() { return finalized; }
 
+  /** Backlog over all event queues (see AmOverloadControl) */
+  static unsigned int getPendingEvents() { return pending_events.get(); }
+
   // return true to continue processing
   virtual bool startup() { return true; }
   virtual bool processingCycle() { processEvents(); return true; }
@@ -26,14 +26,17 @@
 #include "AmMediaProcessor.h"
 #include "AmSession.h"
 #include "AmRtpStream.h"
+#include "AmArg.h"
+#include "AmCpuAffinity.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <sys/time.h>
 #include <signal.h>
-
-// Solaris seems to need this for nanosleep().
-#if defined (__SVR4) && defined (__sun)
 #include <time.h>
+
+#if defined(__linux__)
+#define HAVE_CLOCK_NANOSLEEP
 #endif
 
 /** \brief Request event to the MediaProcessor (remove,...) */
@@ -46,12 +49,45 @@ struct SchedRequest :
     : AmEvent(id), s(s) {}
 };
 
+/** \brief Request to hand over a session to another thread */
+struct SchedMigrateRequest :
+  public SchedRequest
+{
+  string callgroup;
+  unsigned int from_thread;
+  unsigned int to_thread;
+
+  SchedMigrateRequest(AmMediaSession* s, const string& callgroup,
+		      unsigned int from_thread, unsigned int to_thread)
+    : SchedRequest(AmMediaProcessor::MigrateSession, s),
+      callgroup(callgroup), from_thread(from_thread), to_thread(to_thread) {}
+};
+
+/** \brief periodically triggers AmMediaProcessor::rebalance() */
+class AmMediaRebalancer
+  : public AmThread
+{
+  AmCondition<bool> stop_requested;
+
+  void run() {
+    while(!stop_requested.wait_for_to(AmConfig::MediaRebalanceInterval*1000))
+      AmMediaProcessor::instance()->rebalance();
+  }
+
+  void on_stop() {
+    stop_requested.set(true);
+  }
+
+public:
+  AmMediaRebalancer() : stop_requested(false) {}
+};
+
 /*         session scheduler              */
 
 AmMediaProcessor* AmMediaProcessor::_instance = NULL;
 
 AmMediaProcessor::AmMediaProcessor()
-  : threads(NULL),num_threads(0)
+  : threads(NULL),num_threads(0),rebalancer(NULL)
 {
 }
 
@@ -66,10 +102,17 @@ void AmMediaProcessor::init() {
   assert(num_threads > 0);
   DBG("Starting %u MediaProcessorThreads.\n", num_threads);
   threads = new AmMediaProcessorThread*[num_threads];
+  thread_members.assign(num_threads,0);
   for (unsigned int i=0;i<num_threads;i++) {
     threads[i] = new AmMediaProcessorThread();
+    AmCpuAffinity::apply(threads[i], AmCpuAffinity::MediaProcessor, i);
     threads[i]->start();
   }
+
+  if((num_threads > 1) && AmConfig::MediaRebalanceInterval) {
+    rebalancer = new AmMediaRebalancer();
+    rebalancer->start();
+  }
 }
 
 AmMediaProcessor* AmMediaProcessor::instance()
@@ -87,7 +130,7 @@ void AmMediaProcessor::addSession(AmMediaSession* s,
  
   // evaluate correct scheduler
   unsigned int sched_thread = 0;
-  group_mut.lock();
+  AmLock l(group_mut);
     
   // callgroup already in a thread? 
   std::map<std::string, unsigned int>::iterator it =
@@ -96,14 +139,8 @@ void AmMediaProcessor::addSession(AmMediaSession* s,
     // yes, use it
     sched_thread = it->second; 
   } else {
-    // no, find the thread with lowest load
-    unsigned int lowest_load = threads[0]->getLoad();
-    for (unsigned int i=1;i<num_threads;i++) {
-      unsigned int lower = threads[i]->getLoad();
-      if (lower < lowest_load) {
-	lowest_load = lower; sched_thread = i;
-      }
-    }
+    // no, find the thread with lowest processing cost
+    sched_thread = getLeastLoadedThread();
     // create callgroup->thread mapping
     callgroup2thread[callgroup] = sched_thread;
   }
@@ -111,14 +148,42 @@ void AmMediaProcessor::addSession(AmMediaSession* s,
   // join the callgroup
   callgroupmembers.insert(make_pair(callgroup, s));
   session2callgroup[s]=callgroup;
+  session2thread[s]=sched_thread;
+  thread_members[sched_thread]++;
     
-  group_mut.unlock();
-    
-  // add the session to selected thread
+  // add the session to selected thread; posted with group_mut held,
+  // so that no move of the call group can come in between
   threads[sched_thread]->
     postRequest(new SchedRequest(InsertSession,s));
 }
 
+unsigned int AmMediaProcessor::getLeastLoadedThread()
+{
+  // average cost of the sessions measured so far
+  unsigned long long total = 0, n_measured = 0;
+  for (unsigned int i=0;i<num_threads;i++) {
+    total += threads[i]->getCost();
+    n_measured += threads[i]->getSessions();
+  }
+  unsigned long long avg_cost = n_measured ? total / n_measured : 1;
+
+  // measured cost, plus the sessions added since the last tick
+  unsigned int sched_thread = 0;
+  unsigned long long min_cost = 0;
+  for (unsigned int i=0;i<num_threads;i++) {
+    unsigned long long c = threads[i]->getCost();
+    unsigned int measured = threads[i]->getSessions();
+    if (thread_members[i] > measured)
+      c += (thread_members[i] - measured) * avg_cost;
+
+    if (!i || (c < min_cost)) {
+      min_cost = c;
+      sched_thread = i;
+    }
+  }
+  return sched_thread;
+}
+
 void AmMediaProcessor::clearSession(AmMediaSession* s) {
   removeFromProcessor(s, ClearSession);
 }
@@ -143,10 +208,18 @@ void AmMediaProcessor::changeCallgroup(AmMediaSession* s,
 void AmMediaProcessor::removeFromProcessor(AmMediaSession* s, 
 					   unsigned int r_type) {
   DBG("AmMediaProcessor::removeSession\n");
-  group_mut.lock();
-  // get scheduler
+  AmLock l(group_mut);
+  // get scheduler: the thread the session has been inserted to,
+  // which is not yet the call group's while it is being moved
   string callgroup = session2callgroup[s];
-  unsigned int sched_thread = callgroup2thread[callgroup];
+  unsigned int sched_thread = 0;
+  std::map<AmMediaSession*, unsigned int>::iterator t_it =
+    session2thread.find(s);
+  if (t_it != session2thread.end()) {
+    sched_thread = t_it->second;
+    thread_members[sched_thread]--;
+    session2thread.erase(t_it);
+  }
   DBG("  callgroup is '%s', thread %u\n", callgroup.c_str(), sched_thread);
   // erase callgroup membership entry
   std::multimap<std::string, AmMediaSession*>::iterator it = 
@@ -166,13 +239,166 @@ void AmMediaProcessor::removeFromProcessor(AmMediaSession* s,
   }
   // erase session entry
   session2callgroup.erase(s);
-  group_mut.unlock();    
 
   threads[sched_thread]->postRequest(new SchedRequest(r_type,s));
 }
 
+void AmMediaProcessor::getCosts(std::vector<unsigned long long>& thread_costs,
+				std::map<string, unsigned long long>& group_costs)
+{
+  thread_costs.assign(num_threads,0);
+  group_costs.clear();
+
+  // average cost of the sessions measured so far
+  unsigned long long total = 0, n_measured = 0;
+  for(std::multimap<string, AmMediaSession*>::iterator it = 
+	callgroupmembers.begin(); it != callgroupmembers.end(); ++it) {
+    unsigned int c = it->second->getMediaCost();
+    if(c) {
+      total += c;
+      n_measured++;
+    }
+  }
+  unsigned long long avg_cost = n_measured ? total / n_measured : 1;
+
+  for(std::multimap<string, AmMediaSession*>::iterator it = 
+	callgroupmembers.begin(); it != callgroupmembers.end(); ++it) {
+    unsigned long long c = it->second->getMediaCost();
+    group_costs[it->first] += c ? c : avg_cost;
+  }
+
+  for(std::map<string, unsigned long long>::iterator it = 
+	group_costs.begin(); it != group_costs.end(); ++it) {
+    std::map<string, unsigned int>::iterator t_it =
+      callgroup2thread.find(it->first);
+    if(t_it != callgroup2thread.end())
+      thread_costs[t_it->second] += it->second;
+  }
+}
+
+void AmMediaProcessor::rebalance()
+{
+  AmLock l(group_mut);
+  if(num_threads < 2)
+    return;
+
+  std::vector<unsigned long long> thread_costs;
+  std::map<string, unsigned long long> group_costs;
+  getCosts(thread_costs,group_costs);
+
+  unsigned int max_thread = 0, min_thread = 0;
+  for (unsigned int i=1;i<num_threads;i++) {
+    if (thread_costs[i] > thread_costs[max_thread]) max_thread = i;
+    if (thread_costs[i] < thread_costs[min_thread]) min_thread = i;
+  }
+
+  // threshold: percentage of the tick interval (in ns)
+  unsigned long long imbalance = 
+    thread_costs[max_thread] - thread_costs[min_thread];
+  if(imbalance <= AmConfig::MediaRebalanceThreshold * WC_INC_MS * 10000ULL)
+    return;
+
+  // the call group which gets both threads closest to each other
+  string best_group;
+  unsigned long long best_diff = imbalance;
+  for(std::map<string, unsigned long long>::iterator it = 
+	group_costs.begin(); it != group_costs.end(); ++it) {
+    if(callgroup2thread[it->first] != max_thread)
+      continue;
+
+    unsigned long long c = it->second;
+    if(c >= imbalance)
+      continue;
+
+    // new difference between both threads
+    unsigned long long diff = imbalance - 2*c;
+    if(2*c > imbalance)
+      diff = 2*c - imbalance;
+
+    if(diff < best_diff) {
+      best_diff = diff;
+      best_group = it->first;
+    }
+  }
+
+  if(best_group.empty() || !moveCallgroup(best_group,min_thread))
+    return;
+
+  INFO("media processor imbalance %llu/%llu ns per tick: moving callgroup "
+       "'%s' (%llu ns) from thread %u to thread %u\n",
+       thread_costs[max_thread], thread_costs[min_thread],
+       best_group.c_str(), group_costs[best_group], max_thread, min_thread);
+}
+
+bool AmMediaProcessor::moveCallgroup(const string& callgroup,
+				     unsigned int to_thread)
+{
+  unsigned int from_thread = callgroup2thread[callgroup];
+
+  std::vector<AmMediaSession*> members;
+  std::pair<std::multimap<string, AmMediaSession*>::iterator,
+	    std::multimap<string, AmMediaSession*>::iterator> range =
+    callgroupmembers.equal_range(callgroup);
+  for(; range.first != range.second; ++range.first) {
+    // not handed over yet from a previous move
+    if(session2thread[range.first->second] != from_thread)
+      return false;
+    members.push_back(range.first->second);
+  }
+
+  if(members.empty())
+    return false;
+
+  // new members go to the new thread right away; the old thread hands
+  // over its sessions at the end of its tick. Requests for them posted
+  // meanwhile still go to the old thread, which gets them after the
+  // migration request.
+  callgroup2thread[callgroup] = to_thread;
+  for(std::vector<AmMediaSession*>::iterator it = members.begin();
+      it != members.end(); ++it) {
+    threads[from_thread]->
+      postRequest(new SchedMigrateRequest(*it,callgroup,from_thread,to_thread));
+  }
+  return true;
+}
+
+bool AmMediaProcessor::handOverSession(AmMediaSession* s,
+				       const string& callgroup,
+				       unsigned int from_thread,
+				       unsigned int to_thread)
+{
+  AmLock l(group_mut);
+
+  // removed, or moved to another call group meanwhile?
+  std::map<AmMediaSession*, string>::iterator cg_it =
+    session2callgroup.find(s);
+  if((cg_it == session2callgroup.end()) || (cg_it->second != callgroup))
+    return false;
+
+  std::map<string, unsigned int>::iterator t_it =
+    callgroup2thread.find(callgroup);
+  if((t_it == callgroup2thread.end()) || (t_it->second != to_thread) ||
+     (session2thread[s] != from_thread))
+    return false;
+
+  session2thread[s] = to_thread;
+  thread_members[from_thread]--;
+  thread_members[to_thread]++;
+  threads[to_thread]->postRequest(new SchedRequest(InsertSession,s));
+  return true;
+}
+
 void AmMediaProcessor::stop() {
   assert(threads);
+
+  if(rebalancer) {
+    rebalancer->stop();
+    while(!rebalancer->is_stopped())
+      usleep(10000);
+    delete rebalancer;
+    rebalancer = NULL;
+  }
+
   for (unsigned int i=0;i<num_threads;i++) {
     if(threads[i] != NULL) {
       threads[i]->stop();
@@ -200,6 +426,31 @@ void AmMediaProcessor::stop() {
   threads = NULL;
 }
 
+void AmMediaProcessor::getStats(AmArg& ret)
+{
+  ret.assertArray();
+  if(!threads)
+    return;
+
+  for (unsigned int i=0;i<num_threads;i++) {
+    AmArg t;
+    threads[i]->getStats(t);
+    ret.push(t);
+  }
+}
+
+unsigned long long AmMediaProcessor::getOverruns()
+{
+  if(!threads)
+    return 0;
+
+  unsigned long long res = 0;
+  for (unsigned int i=0;i<num_threads;i++)
+    res += threads[i]->getOverruns();
+
+  return res;
+}
+
 void AmMediaProcessor::dispose() 
 {
   if(_instance != NULL) {
@@ -227,45 +478,114 @@ void AmMediaProcessorThread::on_stop()
   stop_requested.set(true);
 }
 
+static inline void timespec_add_us(struct timespec* t, long long us)
+{
+  t->tv_sec  += us / 1000000;
+  t->tv_nsec += (us % 1000000) * 1000;
+  if(t->tv_nsec >= 1000000000) {
+    t->tv_sec++;
+    t->tv_nsec -= 1000000000;
+  }
+}
+
+/** a - b in nanoseconds */
+static inline long long timespec_diff_ns(const struct timespec* a,
+					 const struct timespec* b)
+{
+  return (long long)(a->tv_sec - b->tv_sec) * 1000000000LL
+    + (a->tv_nsec - b->tv_nsec);
+}
+
+/** a - b in microseconds */
+static inline long long timespec_diff_us(const struct timespec* a,
+					 const struct timespec* b)
+{
+  return (long long)(a->tv_sec - b->tv_sec) * 1000000LL
+    + (a->tv_nsec - b->tv_nsec) / 1000;
+}
+
 void AmMediaProcessorThread::run()
 {
   stop_requested = false;
-  struct timeval now,next_tick,diff,tick;
+  struct timespec now,next_tick,done;
 
   // wallclock time
   unsigned long long ts = 0;//4294417296;
 
-  tick.tv_sec  = 0;
-  tick.tv_usec = 1000*WC_INC_MS;
+  clock_gettime(CLOCK_MONOTONIC,&next_tick);
+  timespec_add_us(&next_tick,WC_INC_MS*1000);
 
-  gettimeofday(&now,NULL);
-  timeradd(&tick,&now,&next_tick);
-    
   while(!stop_requested.get()){
 
-    gettimeofday(&now,NULL);
-
-    if(timercmp(&now,&next_tick,<)){
-
-      struct timespec sdiff,rem;
-      timersub(&next_tick,&now,&diff);
-
-      sdiff.tv_sec  = diff.tv_sec;
-      sdiff.tv_nsec = diff.tv_usec * 1000;
-
-      if(sdiff.tv_nsec > 2000000) // 2 ms
-	nanosleep(&sdiff,&rem);
+    // sleep until the deadline of this tick; if we are
+    // behind, the missed ticks are processed right away
+#ifdef HAVE_CLOCK_NANOSLEEP
+    while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,
+			  &next_tick,NULL) == EINTR);
+#else
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    long long wait_us = timespec_diff_us(&next_tick,&now);
+    if(wait_us > 0) {
+      struct timespec sdiff;
+      sdiff.tv_sec  = wait_us / 1000000;
+      sdiff.tv_nsec = (wait_us % 1000000) * 1000;
+      while(nanosleep(&sdiff,&sdiff) && (errno == EINTR));
     }
+#endif
+
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    unsigned int n_processed = sessions.size();
 
     processAudio(ts);
     events.processEvents();
     processDtmfEvents();
 
+    clock_gettime(CLOCK_MONOTONIC,&done);
+    updateTickStats(timespec_diff_us(&now,&next_tick),
+		    timespec_diff_us(&done,&now),n_processed);
+
     ts = (ts + WC_INC) & WALLCLOCK_MASK;
-    timeradd(&tick,&next_tick,&next_tick);
+    timespec_add_us(&next_tick,WC_INC_MS*1000);
   }
 }
 
+void AmMediaProcessorThread::updateTickStats(long long late_us,
+					     long long proc_us,
+					     unsigned int n_processed)
+{
+  if(proc_us < 0)
+    proc_us = 0;
+
+  ticks.inc();
+  if(late_us > MEDIA_TICK_LATE_US)
+    late_ticks.inc();
+  if(proc_us > WC_INC_MS*1000)
+    overruns.inc();
+
+  proc_time_us.inc(proc_us);
+  if((unsigned long long)proc_us > max_proc_time_us.get())
+    max_proc_time_us.set(proc_us);
+
+  sessions_processed.inc(n_processed);
+  n_sessions.set(sessions.size());
+}
+
+void AmMediaProcessorThread::getStats(AmArg& ret)
+{
+  unsigned long long n_ticks = ticks.get();
+
+  ret["ticks"] = (long long)n_ticks;
+  ret["late_ticks"] = (long long)late_ticks.get();
+  ret["overruns"] = (long long)overruns.get();
+  ret["avg_proc_us"] = 
+    n_ticks ? (long long)(proc_time_us.get() / n_ticks) : 0LL;
+  ret["max_proc_us"] = (long long)max_proc_time_us.get();
+  ret["avg_sessions"] =
+    n_ticks ? (double)sessions_processed.get() / n_ticks : 0.0;
+  ret["sessions"] = (int)n_sessions.get();
+  ret["cost_us"] = (int)(cost.get() / 1000);
+}
+
 /**
  * process pending DTMF events
  */
@@ -281,21 +601,43 @@ void AmMediaProcessorThread::processDtmfEvents()
 
 void AmMediaProcessorThread::processAudio(unsigned long long ts)
 {
+  struct timespec start,end;
+  clock_gettime(CLOCK_MONOTONIC,&start);
+
   // receiving
   for(set<AmMediaSession*>::iterator it = sessions.begin();
       it != sessions.end(); it++)
   {
-    if ((*it)->readStreams(ts, buffer) < 0)
-      postRequest(new SchedRequest(AmMediaProcessor::ClearSession, *it));
+    AmMediaSession* s = *it;
+    if (s->readStreams(ts, buffer) < 0)
+      postRequest(new SchedRequest(AmMediaProcessor::ClearSession, s));
+
+    clock_gettime(CLOCK_MONOTONIC,&end);
+    s->tick_cost = timespec_diff_ns(&end,&start);
+    start = end;
   }
 
   // sending
+  unsigned int total_cost = 0;
   for(set<AmMediaSession*>::iterator it = sessions.begin();
       it != sessions.end(); it++)
   {
-    if ((*it)->writeStreams(ts, buffer) < 0)
-      postRequest(new SchedRequest(AmMediaProcessor::ClearSession, *it));
+    AmMediaSession* s = *it;
+    if (s->writeStreams(ts, buffer) < 0)
+      postRequest(new SchedRequest(AmMediaProcessor::ClearSession, s));
+
+    clock_gettime(CLOCK_MONOTONIC,&end);
+    s->tick_cost += timespec_diff_ns(&end,&start);
+    start = end;
+
+    // moving average over ~32 ticks
+    unsigned int c = s->media_cost.get();
+    c = c - (c >> 5) + (s->tick_cost >> 5);
+    s->media_cost.set(c);
+    total_cost += c;
   }
+
+  cost.set(total_cost);
 }
 
 void AmMediaProcessorThread::process(AmEvent* e)
@@ -348,6 +690,22 @@ void AmMediaProcessorThread::process(AmEvent* e)
   }
     break;
 
+  case AmMediaProcessor::MigrateSession:{
+    // the session might already be gone if it has been removed
+    // before; if it is removed afterwards, it is left here for the
+    // remove request queued after this one
+    SchedMigrateRequest* mr = static_cast<SchedMigrateRequest*>(sr);
+    set<AmMediaSession*>::iterator s_it = sessions.find(mr->s);
+    if((s_it != sessions.end()) &&
+       AmMediaProcessor::instance()->
+       handOverSession(mr->s,mr->callgroup,mr->from_thread,mr->to_thread)) {
+      sessions.erase(s_it);
+      DBG("Session handed over to media processor thread %u\n",
+	  mr->to_thread);
+    }
+  }
+    break;
+
   default:
     ERROR("AmMediaProcessorThread::process: unknown event id.");
     break;
@@ -29,13 +29,20 @@
 #define _AmMediaProcessor_h_
 
 #include "AmEventQueue.h"
+#include "atomic_types.h"
 #include "amci/amci.h" // AUDIO_BUFFER_SIZE
 
 #include <set>
 using std::set;
 #include <map>
+#include <vector>
 
 struct SchedRequest;
+class AmArg;
+class AmMediaRebalancer;
+
+/** a tick starting later than this after its deadline is counted as late */
+#define MEDIA_TICK_LATE_US 2000
 
 /** Interface for basic media session processing.
  *
@@ -56,10 +63,21 @@ class AmMediaSession
   private:
     AmCondition<bool> processing_media;
 
+    /** processing time in the current tick [ns] (media processor only) */
+    unsigned int tick_cost;
+    /** moving average of the processing time per tick [ns] */
+    atomic_int media_cost;
+
+    friend class AmMediaProcessorThread;
+
   public:
-    AmMediaSession(): processing_media(false) { }
+    AmMediaSession(): processing_media(false), tick_cost(0) { }
     virtual ~AmMediaSession() { }
 
+    /** Average time spent per tick in readStreams() and writeStreams() 
+     * (in ns), as measured by the media processor. 0 until measured. */
+    unsigned int getMediaCost() { return media_cost.get(); }
+
     /** Read from all media streams.
      *
      * To preserve current media processing scheme it is needed to read from all
@@ -153,6 +171,11 @@ class AmMediaSession
  * This class implements a media processing thread.
  * It processes the media and triggers the sending of RTP
  * of all sessions added to it.
+ *
+ * Ticks are scheduled on absolute deadlines of the monotonic
+ * clock; a tick which is late or takes longer than the tick 
+ * interval is counted (see getStats()). The processing time of
+ * every session is measured (see AmMediaSession::getMediaCost()).
  */
 class AmMediaProcessorThread :
   public AmThread,
@@ -161,6 +184,20 @@ class AmMediaProcessorThread :
   AmEventQueue    events;
   unsigned char   buffer[AUDIO_BUFFER_SIZE];
   set<AmMediaSession*> sessions;
+
+  /** tick statistics (written by the thread only) */
+  atomic_int64 ticks;
+  atomic_int64 late_ticks;
+  atomic_int64 overruns;
+  atomic_int64 proc_time_us;
+  atomic_int64 max_proc_time_us;
+  atomic_int64 sessions_processed;
+  atomic_int   n_sessions;
+  /** sum of the sessions' average processing time [ns] */
+  atomic_int   cost;
+
+  void updateTickStats(long long late_us, long long proc_us,
+		       unsigned int n_processed);
   
   void processAudio(unsigned long long ts);
   /**
@@ -182,6 +219,21 @@ public:
   inline void postRequest(SchedRequest* sr);
   
   unsigned int getLoad();
+
+  /**
+   * Get tick statistics: ticks, late ticks, overruns, 
+   * average/max. processing time and sessions per tick.
+   */
+  void getStats(AmArg& ret);
+
+  /** ticks which took longer than the tick interval so far */
+  unsigned long long getOverruns() { return overruns.get(); }
+
+  /** sum of the sessions' average processing time per tick [ns] */
+  unsigned int getCost() { return cost.get(); }
+
+  /** sessions processed in the last tick */
+  unsigned int getSessions() { return n_sessions.get(); }
 };
 
 /**
@@ -191,6 +243,10 @@ public:
  * the Sessions to the various \ref MediaProcessorThreads, 
  * according to their call group. This class contains the API 
  * for the MediaProcessor.
+ *
+ * New call groups are assigned to the thread with the lowest
+ * measured processing cost. If enabled, the rebalancer periodically
+ * moves a call group from the most to the least loaded thread.
  */
 class AmMediaProcessor
 {
@@ -202,20 +258,48 @@ class AmMediaProcessor
   std::map<string, unsigned int> callgroup2thread;
   std::multimap<string, AmMediaSession*> callgroupmembers;
   std::map<AmMediaSession*, string> session2callgroup;
+  /** thread a session has been inserted to (differs from the call
+      group's thread while the call group is being moved) */
+  std::map<AmMediaSession*, unsigned int> session2thread;
+  /** sessions per thread according to session2thread */
+  std::vector<unsigned int> thread_members;
   AmMutex group_mut;
 
+  AmMediaRebalancer* rebalancer;
+
   AmMediaProcessor();
   ~AmMediaProcessor();
 	
   void removeFromProcessor(AmMediaSession* s, unsigned int r_type);
+
+  /** 
+   * Estimate the processing cost per thread and call group (group_mut 
+   * locked). Sessions not measured yet count with the average cost.
+   */
+  void getCosts(std::vector<unsigned long long>& thread_costs,
+		std::map<string, unsigned long long>& group_costs);
+
+  /**
+   * Move all sessions of a call group to another thread (group_mut
+   * locked). The old thread hands over the sessions with
+   * handOverSession() when it processes the request.
+   * @return false if a move of the call group is still in progress
+   */
+  bool moveCallgroup(const string& callgroup, unsigned int to_thread);
+
+  /** thread with the lowest estimated processing cost (group_mut locked) */
+  unsigned int getLeastLoadedThread();
+
 public:
   /** 
    * InsertSession     : inserts the session to the processor
    * RemoveSession     : remove the session from the processor
    * SoftRemoveSession : remove the session from the processor but leave it attached
    * ClearSession      : remove the session from processor and clear audio
+   * MigrateSession    : hand over the session to another thread
    */
-  enum { InsertSession, RemoveSession, SoftRemoveSession, ClearSession };
+  enum { InsertSession, RemoveSession, SoftRemoveSession, ClearSession,
+	 MigrateSession };
 
   static AmMediaProcessor* instance();
 
@@ -232,6 +316,29 @@ public:
   void changeCallgroup(AmMediaSession* s, 
 		       const string& new_callgroup);
 
+  /**
+   * Called by media processor thread 'from_thread' for a session to be
+   * moved to 'to_thread' along with 'callgroup'. If the session is
+   * still a member of the call group on that thread, the insert
+   * request is posted to 'to_thread' and further requests for the
+   * session go there.
+   * @return true if the session has been handed over
+   */
+  bool handOverSession(AmMediaSession* s, const string& callgroup,
+		       unsigned int from_thread, unsigned int to_thread);
+
+  /** get tick statistics of all media processor threads */
+  void getStats(AmArg& ret);
+
+  /** tick overruns of all media processor threads so far */
+  unsigned long long getOverruns();
+
+  /** 
+   * Move one call group from the most to the least loaded thread 
+   * if the difference exceeds the configured threshold.
+   */
+  void rebalance();
+
   void stop();
   static void dispose();
 };
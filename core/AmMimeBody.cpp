@@ -288,13 +288,13 @@ int AmContentType::parse(const string& ct)
 
 int  AmContentType::parseParams(const char* c, const char* end)
 {
-  list<sip_avp*> avp_params;
+  sip_avp_list avp_params;
   if(parse_gen_params_sc(&avp_params, &c, end-c, '\0') < 0) {
     if(!avp_params.empty()) free_gen_params(&avp_params);
     return -1;
   }
   
-  for(list<sip_avp*>::iterator it_ct_param = avp_params.begin();
+  for(sip_avp_list::iterator it_ct_param = avp_params.begin();
       it_ct_param != avp_params.end();++it_ct_param) {
 
     DBG("parsed new content-type parameter: <%.*s>=<%.*s>",
@@ -479,7 +479,7 @@ int AmMimeBody::findNextBoundary(unsigned char** beg, unsigned char** end)
 
 int AmMimeBody::parseSinglePart(unsigned char* buf, unsigned int len)
 {
-  list<sip_header*> hdrs;
+  sip_header_list hdrs;
   char* c = (char*)buf;
   char* end = c + len;
 
@@ -494,7 +494,7 @@ int AmMimeBody::parseSinglePart(unsigned char* buf, unsigned int len)
 
   string sub_part_hdrs;
   string sub_part_ct;
-  for(list<sip_header*>::iterator it = hdrs.begin();
+  for(sip_header_list::iterator it = hdrs.begin();
       it != hdrs.end(); ++it) {
 
     DBG("Part header: <%.*s>: <%.*s>\n",
@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * For a license to use the sems software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmMixerKernels.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__)
+#define MIXER_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/*
+ * portable implementation
+ */
+
+static void mix_add_scalar(int* dest, const int* src1, const short* src2,
+			   unsigned int size)
+{
+  int* end_dest = dest + size;
+
+  while(dest != end_dest)
+    *(dest++) = *(src1++) + int(*(src2++));
+}
+
+static void mix_sub_scalar(int* dest, const int* src1, const short* src2,
+			   unsigned int size)
+{
+  int* end_dest = dest + size;
+
+  while(dest != end_dest)
+    *(dest++) = *(src1++) - int(*(src2++));
+}
+
+/** scale without raising the scaling factor */
+static inline void scale_samples(short* buffer, const int* tmp_buf,
+				 unsigned int size, int& scaling_factor)
+{
+  short* end_dest = buffer + size;
+
+  while(buffer != end_dest){
+
+    int s = (*tmp_buf * scaling_factor) >> 6;
+    if(abs(s) > MAX_LINEAR_SAMPLE){
+      scaling_factor = abs( (MAX_LINEAR_SAMPLE<<6) / (*tmp_buf) );
+      if(s < 0)
+	s = -MAX_LINEAR_SAMPLE;
+      else
+	s = MAX_LINEAR_SAMPLE;
+    }
+    *(buffer++) = short(s);
+    tmp_buf++;
+  }
+}
+
+static void scale_scalar(short* buffer, const int* tmp_buf, unsigned int size,
+			 int& scaling_factor)
+{
+  if(scaling_factor<64)
+    scaling_factor++;
+
+  scale_samples(buffer,tmp_buf,size,scaling_factor);
+}
+
+#ifdef MIXER_X86_SIMD
+
+/*
+ * SSE2
+ *
+ * The scaling factor may change from one sample to the next, which
+ * happens only when clipping. Blocks are thus computed with the
+ * current factor and stored if no sample of the block clips;
+ * otherwise the block is redone sample by sample.
+ */
+
+__attribute__((target("sse2")))
+static inline __m128i mullo_epi32_sse2(__m128i a, __m128i b)
+{
+  __m128i p02 = _mm_mul_epu32(a,b);
+  __m128i p13 = _mm_mul_epu32(_mm_srli_si128(a,4),_mm_srli_si128(b,4));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(p02,_MM_SHUFFLE(0,0,2,0)),
+			    _mm_shuffle_epi32(p13,_MM_SHUFFLE(0,0,2,0)));
+}
+
+__attribute__((target("sse2")))
+static void mix_add_sse2(int* dest, const int* src1, const short* src2,
+			 unsigned int size)
+{
+  unsigned int i = 0;
+  for(; i + 8 <= size; i += 8) {
+    __m128i s  = _mm_loadu_si128((const __m128i*)(src2 + i));
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s,s),16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s,s),16);
+    __m128i d0 = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(src1 + i)),lo);
+    __m128i d1 = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(src1 + i + 4)),hi);
+    _mm_storeu_si128((__m128i*)(dest + i),d0);
+    _mm_storeu_si128((__m128i*)(dest + i + 4),d1);
+  }
+
+  mix_add_scalar(dest + i, src1 + i, src2 + i, size - i);
+}
+
+__attribute__((target("sse2")))
+static void mix_sub_sse2(int* dest, const int* src1, const short* src2,
+			 unsigned int size)
+{
+  unsigned int i = 0;
+  for(; i + 8 <= size; i += 8) {
+    __m128i s  = _mm_loadu_si128((const __m128i*)(src2 + i));
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s,s),16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s,s),16);
+    __m128i d0 = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(src1 + i)),lo);
+    __m128i d1 = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(src1 + i + 4)),hi);
+    _mm_storeu_si128((__m128i*)(dest + i),d0);
+    _mm_storeu_si128((__m128i*)(dest + i + 4),d1);
+  }
+
+  mix_sub_scalar(dest + i, src1 + i, src2 + i, size - i);
+}
+
+__attribute__((target("sse2")))
+static void scale_sse2(short* buffer, const int* tmp_buf, unsigned int size,
+		       int& scaling_factor)
+{
+  if(scaling_factor<64)
+    scaling_factor++;
+
+  const __m128i max_s = _mm_set1_epi32(MAX_LINEAR_SAMPLE);
+  const __m128i min_s = _mm_set1_epi32(-MAX_LINEAR_SAMPLE);
+
+  unsigned int i = 0;
+  for(; i + 8 <= size; i += 8) {
+    __m128i f  = _mm_set1_epi32(scaling_factor);
+    __m128i s0 = _mm_srai_epi32(mullo_epi32_sse2(_mm_loadu_si128((const __m128i*)(tmp_buf + i)),f),6);
+    __m128i s1 = _mm_srai_epi32(mullo_epi32_sse2(_mm_loadu_si128((const __m128i*)(tmp_buf + i + 4)),f),6);
+
+    __m128i clip = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(s0,max_s),
+					     _mm_cmplt_epi32(s0,min_s)),
+				_mm_or_si128(_mm_cmpgt_epi32(s1,max_s),
+					     _mm_cmplt_epi32(s1,min_s)));
+    if(_mm_movemask_epi8(clip)) {
+      scale_samples(buffer + i, tmp_buf + i, 8, scaling_factor);
+      continue;
+    }
+
+    _mm_storeu_si128((__m128i*)(buffer + i),_mm_packs_epi32(s0,s1));
+  }
+
+  scale_samples(buffer + i, tmp_buf + i, size - i, scaling_factor);
+}
+
+/*
+ * AVX2
+ */
+
+__attribute__((target("avx2")))
+static void mix_add_avx2(int* dest, const int* src1, const short* src2,
+			 unsigned int size)
+{
+  unsigned int i = 0;
+  for(; i + 16 <= size; i += 16) {
+    __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src2 + i)));
+    __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src2 + i + 8)));
+    __m256i d0 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(src1 + i)),lo);
+    __m256i d1 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(src1 + i + 8)),hi);
+    _mm256_storeu_si256((__m256i*)(dest + i),d0);
+    _mm256_storeu_si256((__m256i*)(dest + i + 8),d1);
+  }
+
+  mix_add_scalar(dest + i, src1 + i, src2 + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void mix_sub_avx2(int* dest, const int* src1, const short* src2,
+			 unsigned int size)
+{
+  unsigned int i = 0;
+  for(; i + 16 <= size; i += 16) {
+    __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src2 + i)));
+    __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src2 + i + 8)));
+    __m256i d0 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(src1 + i)),lo);
+    __m256i d1 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(src1 + i + 8)),hi);
+    _mm256_storeu_si256((__m256i*)(dest + i),d0);
+    _mm256_storeu_si256((__m256i*)(dest + i + 8),d1);
+  }
+
+  mix_sub_scalar(dest + i, src1 + i, src2 + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void scale_avx2(short* buffer, const int* tmp_buf, unsigned int size,
+		       int& scaling_factor)
+{
+  if(scaling_factor<64)
+    scaling_factor++;
+
+  const __m256i max_s = _mm256_set1_epi32(MAX_LINEAR_SAMPLE);
+  const __m256i min_s = _mm256_set1_epi32(-MAX_LINEAR_SAMPLE);
+
+  unsigned int i = 0;
+  for(; i + 16 <= size; i += 16) {
+    __m256i f  = _mm256_set1_epi32(scaling_factor);
+    __m256i s0 = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(tmp_buf + i)),f),6);
+    __m256i s1 = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(tmp_buf + i + 8)),f),6);
+
+    __m256i clip = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi32(s0,max_s),
+						   _mm256_cmpgt_epi32(min_s,s0)),
+				   _mm256_or_si256(_mm256_cmpgt_epi32(s1,max_s),
+						   _mm256_cmpgt_epi32(min_s,s1)));
+    if(_mm256_movemask_epi8(clip)) {
+      scale_samples(buffer + i, tmp_buf + i, 16, scaling_factor);
+      continue;
+    }
+
+    // packs works per 128 bit lane: restore the sample order
+    __m256i p = _mm256_permute4x64_epi64(_mm256_packs_epi32(s0,s1),
+					 _MM_SHUFFLE(3,1,2,0));
+    _mm256_storeu_si256((__m256i*)(buffer + i),p);
+  }
+
+  scale_samples(buffer + i, tmp_buf + i, size - i, scaling_factor);
+}
+
+#endif // MIXER_X86_SIMD
+
+static const AmMixerKernels kernels_scalar =
+  { "scalar", mix_add_scalar, mix_sub_scalar, scale_scalar };
+
+#ifdef MIXER_X86_SIMD
+static const AmMixerKernels kernels_sse2 =
+  { "sse2", mix_add_sse2, mix_sub_sse2, scale_sse2 };
+
+static const AmMixerKernels kernels_avx2 =
+  { "avx2", mix_add_avx2, mix_sub_avx2, scale_avx2 };
+#endif
+
+const AmMixerKernels* AmMixerKernels::get(const char* name)
+{
+  if(!strcmp(name,"scalar"))
+    return &kernels_scalar;
+
+#ifdef MIXER_X86_SIMD
+  if(!strcmp(name,"sse2") && __builtin_cpu_supports("sse2"))
+    return &kernels_sse2;
+
+  if(!strcmp(name,"avx2") && __builtin_cpu_supports("avx2"))
+    return &kernels_avx2;
+#endif
+
+  return NULL;
+}
+
+static const AmMixerKernels* select_kernels()
+{
+  const AmMixerKernels* k = NULL;
+  if(!(k = AmMixerKernels::get("avx2")) &&
+     !(k = AmMixerKernels::get("sse2")))
+    k = &kernels_scalar;
+
+  DBG("using '%s' conference mixer kernels\n",k->name);
+  return k;
+}
+
+const AmMixerKernels& AmMixerKernels::get()
+{
+  static const AmMixerKernels* k = select_kernels();
+  return *k;
+}
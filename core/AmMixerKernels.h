@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * For a license to use the sems software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmMixerKernels.h */
+#ifndef _AmMixerKernels_h_
+#define _AmMixerKernels_h_
+
+// PCM16 range: [-32767:32768]
+#define MAX_LINEAR_SAMPLE 32737
+
+/**
+ * \brief sample processing kernels of the conference mixer
+ *
+ * There is a portable implementation and, on x86, SSE2 and AVX2
+ * implementations selected at runtime according to the CPU. All of
+ * them produce exactly the same output.
+ */
+struct AmMixerKernels
+{
+  /** implementation name ("scalar", "sse2", "avx2") */
+  const char* name;
+
+  /** dest[i] = src1[i] + src2[i] (dest may be src1) */
+  void (*mix_add)(int* dest, const int* src1, const short* src2,
+		  unsigned int size);
+
+  /** dest[i] = src1[i] - src2[i] (dest may be src1) */
+  void (*mix_sub)(int* dest, const int* src1, const short* src2,
+		  unsigned int size);
+
+  /**
+   * Scale the mixed samples by scaling_factor/64 into 'buffer'.
+   * The scaling factor is raised by one per call (up to 64) and
+   * lowered whenever a sample would exceed MAX_LINEAR_SAMPLE,
+   * which is then clipped.
+   */
+  void (*scale)(short* buffer, const int* tmp_buf, unsigned int size,
+		int& scaling_factor);
+
+  /** best implementation supported by this CPU */
+  static const AmMixerKernels& get();
+
+  /** implementation by name, NULL if not supported by this CPU */
+  static const AmMixerKernels* get(const char* name);
+};
+
+#endif
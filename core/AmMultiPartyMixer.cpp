@@ -24,20 +24,75 @@
  */
 
 #include "AmMultiPartyMixer.h"
+#include "AmMixerKernels.h"
 #include "AmRtpStream.h"
 #include "log.h"
 
+#include "amci/codecs.h"
+
 #include <assert.h>
 #include <math.h>
 
-// PCM16 range: [-32767:32768]
-#define MAX_LINEAR_SAMPLE 32737
+#include <algorithm>
+#include <functional>
 
 // the internal delay of the mixer (between put and get)
 #define MIXER_DELAY_MS 20
 
 #define MAX_BUFFER_STATES 50 // 1 sec max @ 20ms
 
+// N-best mode: channels quieter than this (~ -52 dBFS) are never mixed
+#define NBEST_SILENCE_LEVEL (1<<13)
+
+/**
+ * \brief encoder of the mix shared by the non-speaking channels
+ *
+ * Only for codecs without state (G.711): a channel may switch
+ * between its own stream and the shared one at any packet.
+ */
+class AmMixerEncoder
+  : public AmAudio
+{
+protected:
+  int read(unsigned int user_ts, unsigned int size) { return -1; }
+  int write(unsigned int user_ts, unsigned int size) { return -1; }
+
+public:
+  int                codec_id;
+  unsigned int       frame_size;
+
+  /** last encoded packet and its system ts */
+  bool               valid;
+  unsigned long long ts;
+  int                len;
+  unsigned char      data[AUDIO_BUFFER_SIZE];
+
+  AmMixerEncoder(int codec_id, unsigned int rate, unsigned int frame_size)
+    : AmAudio(new AmAudioFormat(codec_id, rate)),
+      codec_id(codec_id), frame_size(frame_size),
+      valid(false), ts(0), len(0)
+  {}
+
+  bool is_good() { return fmt->getCodec() != NULL; }
+
+  static bool canShare(int codec_id) {
+    return (codec_id == CODEC_ULAW) || (codec_id == CODEC_ALAW);
+  }
+
+  void encode(const short* pcm, unsigned int size, int input_sample_rate,
+	      unsigned long long system_ts) {
+    memcpy((unsigned char*)samples,pcm,size);
+    size = resampleInput((unsigned char*)samples,size,
+			 input_sample_rate,getSampleRate());
+    len = AmAudio::encode(size);
+    if(len > 0)
+      memcpy(data,(unsigned char*)samples,len);
+
+    ts = system_ts;
+    valid = true;
+  }
+};
+
 void DEBUG_MIXER_BUFFER_STATE(const MixerBufferState& mbs, const string& context)
 {
   DBG("XXDebugMixerXX: dump of MixerBufferState %s", context.c_str());
@@ -52,7 +107,9 @@ void DEBUG_MIXER_BUFFER_STATE(const MixerBufferState& mbs, const string& context
 AmMultiPartyMixer::AmMultiPartyMixer()
   : sampleratemap(), samplerates(),
     channelids(), scaling_factor(16),
-    buffer_state(), audio_mut()
+    buffer_state(), audio_mut(),
+    active_speakers(0), n_speakers(0),
+    nbest_valid(false), nbest_rate(0), nbest_ts(0), nbest_samples(0)
 {
 }
 
@@ -62,6 +119,14 @@ AmMultiPartyMixer::~AmMultiPartyMixer()
        it != buffer_state.end(); it++) {
     it->free_channels();
   }
+
+  for (std::vector<Speaker*>::iterator it = speakers.begin();
+       it != speakers.end(); it++)
+    delete *it;
+
+  for (std::vector<AmMixerEncoder*>::iterator it = encoders.begin();
+       it != encoders.end(); it++)
+    delete *it;
 }
 
 unsigned int AmMultiPartyMixer::addChannel(unsigned int external_sample_rate)
@@ -101,6 +166,8 @@ void AmMultiPartyMixer::removeChannel(unsigned int channel_id)
   }
 
   channelids.erase(channel_id);
+  channel_levels.erase(channel_id);
+  nbest_valid = false;
 
   SampleRateMap::iterator sit = sampleratemap.find(channel_id);
   if (sit != sampleratemap.end()) {
@@ -131,10 +198,16 @@ void AmMultiPartyMixer::PutChannelPacket(unsigned int   channel_id,
     unsigned long long user_put_ts = put_ts * (GetCurrentSampleRate()/100) / (WALLCLOCK_RATE/100);
 
     channel->put(user_put_ts,(short*)buffer,samples);
-    bstate->mixed_channel->get(user_put_ts,tmp_buffer,samples);
 
-    mix_add(tmp_buffer,tmp_buffer,(short*)buffer,samples);
-    bstate->mixed_channel->put(user_put_ts,tmp_buffer,samples);
+    if(active_speakers) {
+      // mixed when read, if among the loudest
+      updateLevel(channel_id,(short*)buffer,samples);
+    }
+    else {
+      bstate->mixed_channel->get(user_put_ts,tmp_buffer,samples);
+      AmMixerKernels::get().mix_add(tmp_buffer,tmp_buffer,(short*)buffer,samples);
+      bstate->mixed_channel->put(user_put_ts,tmp_buffer,samples);
+    }
     bstate->last_ts = put_ts + (samples * (WALLCLOCK_RATE/100) / (GetCurrentSampleRate()/100));
   } else {
     /*
@@ -167,11 +240,26 @@ void AmMultiPartyMixer::GetChannelPacket(unsigned int   channel_id,
     assert(samples <= PCM16_B2S(AUDIO_BUFFER_SIZE));
 
     unsigned long long cur_ts = system_ts * (bstate->sample_rate/100) / (WALLCLOCK_RATE/100);
-    bstate->mixed_channel->get(cur_ts,tmp_buffer,samples);
-    channel->get(cur_ts,(short*)buffer,samples);
+    const AmMixerKernels& mix = AmMixerKernels::get();
+
+    if(active_speakers) {
+      mixSpeakers(*bstate,cur_ts,samples);
+      const Speaker* sp = findSpeaker(channel_id);
+      if(sp) {
+	mix.mix_sub(tmp_buffer,nbest_mixed,sp->samples,samples);
+	mix.scale((short*)buffer,tmp_buffer,samples,scaling_factor);
+      }
+      else {
+	memcpy(buffer,nbest_common,PCM16_S2B(samples));
+      }
+    }
+    else {
+      bstate->mixed_channel->get(cur_ts,tmp_buffer,samples);
+      channel->get(cur_ts,(short*)buffer,samples);
 
-    mix_sub(tmp_buffer,tmp_buffer,(short*)buffer,samples);
-    scale((short*)buffer,tmp_buffer,samples);
+      mix.mix_sub(tmp_buffer,tmp_buffer,(short*)buffer,samples);
+      mix.scale((short*)buffer,tmp_buffer,samples,scaling_factor);
+    }
     size = PCM16_S2B(samples);
     output_sample_rate = bstate->sample_rate;
   } else if (bstate != buffer_state.end()) {
@@ -191,55 +279,165 @@ void AmMultiPartyMixer::GetChannelPacket(unsigned int   channel_id,
   cleanupBufferStates(last_ts);
 }
 
-int AmMultiPartyMixer::GetCurrentSampleRate()
+int AmMultiPartyMixer::GetEncodedChannelPacket(unsigned int   channel_id,
+					       unsigned long long system_ts,
+					       unsigned char* buffer,
+					       int            codec_id,
+					       unsigned int   output_sample_rate,
+					       unsigned int   nb_samples)
 {
-  SampleRateSet::reverse_iterator sit = samplerates.rbegin();
-  if (sit != samplerates.rend()) {
-	return *sit;
-  } else {
-	return -1;
+  int mixer_sample_rate = GetCurrentSampleRate();
+  if (!active_speakers || !AmMixerEncoder::canShare(codec_id) ||
+      !nb_samples || !output_sample_rate || (mixer_sample_rate <= 0))
+    return 0;
+
+  unsigned int size = PCM16_S2B(nb_samples * mixer_sample_rate / output_sample_rate);
+  if (!size || (size > AUDIO_BUFFER_SIZE))
+    return 0;
+
+  unsigned int last_ts = system_ts + (PCM16_B2S(size) * (WALLCLOCK_RATE/100) / (mixer_sample_rate/100));
+  std::deque<MixerBufferState>::iterator bstate = findBufferStateForReading(mixer_sample_rate, last_ts);
+  if ((bstate == buffer_state.end()) || !bstate->get_channel(channel_id))
+    return 0;
+
+  unsigned int samples = PCM16_B2S(size) * (bstate->sample_rate/100) / (mixer_sample_rate/100);
+  unsigned long long cur_ts = system_ts * (bstate->sample_rate/100) / (WALLCLOCK_RATE/100);
+
+  mixSpeakers(*bstate,cur_ts,samples);
+  if (findSpeaker(channel_id))
+    return 0; // gets its own mix
+
+  AmMixerEncoder* enc = NULL;
+  for (std::vector<AmMixerEncoder*>::iterator it = encoders.begin();
+       it != encoders.end(); it++) {
+    if (((*it)->codec_id == codec_id) &&
+	((unsigned int)(*it)->getSampleRate() == output_sample_rate) &&
+	((*it)->frame_size == nb_samples)) {
+      enc = *it;
+      break;
+    }
   }
+
+  if (!enc) {
+    enc = new AmMixerEncoder(codec_id, output_sample_rate, nb_samples);
+    encoders.push_back(enc);
+    DBG("shared mix encoder for codec %i, %u Hz, %u samples\n",
+	codec_id, output_sample_rate, nb_samples);
+  }
+
+  if (!enc->is_good())
+    return 0;
+
+  if (!enc->valid || (enc->ts != system_ts))
+    enc->encode(nbest_common,PCM16_S2B(samples),bstate->sample_rate,system_ts);
+
+  cleanupBufferStates(last_ts);
+
+  if (enc->len <= 0)
+    return 0;
+
+  memcpy(buffer,enc->data,enc->len);
+  return enc->len;
+}
+
+void AmMultiPartyMixer::updateLevel(unsigned int channel_id,
+				    const short* samples, unsigned int size)
+{
+  unsigned long long sum = 0;
+  for (unsigned int i = 0; i < size; i++)
+    sum += int(samples[i]) * int(samples[i]);
+  unsigned int e = size ? (unsigned int)(sum / size) : 0;
+
+  // fast attack, slow release
+  unsigned int& level = channel_levels[channel_id];
+  if (e > level)
+    level = e;
+  else
+    level -= (level - e) >> 3;
 }
 
-// int   dest[size/2]
-// int   src1[size/2]
-// short src2[size/2]
-//
-void AmMultiPartyMixer::mix_add(int* dest,int* src1,short* src2,unsigned int size)
+void AmMultiPartyMixer::mixSpeakers(MixerBufferState& bstate,
+				    unsigned long long ts,
+				    unsigned int samples)
 {
-  int* end_dest = dest + size;
+  if (nbest_valid && (nbest_rate == bstate.sample_rate) &&
+      (nbest_ts == ts) && (nbest_samples == samples))
+    return;
+
+  // loudest channels first; current speakers count double,
+  // so that similar levels do not switch them every tick
+  std::vector<std::pair<unsigned long long,int> > ranking;
+  for (MixerBufferState::ChannelMap::iterator it = bstate.channels.begin();
+       it != bstate.channels.end(); it++) {
 
-  while(dest != end_dest)
-    *(dest++) = *(src1++) + int(*(src2++));
+    std::map<int,unsigned int>::iterator l = channel_levels.find(it->first);
+    if ((l == channel_levels.end()) || (l->second < NBEST_SILENCE_LEVEL))
+      continue;
+
+    unsigned long long score = l->second;
+    if (findSpeaker(it->first))
+      score *= 2;
+    ranking.push_back(std::make_pair(score,it->first));
+  }
+
+  unsigned int n = std::min((size_t)active_speakers, ranking.size());
+  std::partial_sort(ranking.begin(), ranking.begin() + n, ranking.end(),
+		    std::greater<std::pair<unsigned long long,int> >());
+
+  while (speakers.size() < n)
+    speakers.push_back(new Speaker());
+
+  const AmMixerKernels& mix = AmMixerKernels::get();
+  memset(nbest_mixed,0,samples * sizeof(int));
+  for (unsigned int i = 0; i < n; i++) {
+    Speaker* sp = speakers[i];
+    sp->channel_id = ranking[i].second;
+    bstate.get_channel(sp->channel_id)->get(ts,sp->samples,samples);
+    mix.mix_add(nbest_mixed,nbest_mixed,sp->samples,samples);
+  }
+  n_speakers = n;
+
+  mix.scale(nbest_common,nbest_mixed,samples,scaling_factor);
+
+  nbest_valid = true;
+  nbest_rate = bstate.sample_rate;
+  nbest_ts = ts;
+  nbest_samples = samples;
 }
 
-void AmMultiPartyMixer::mix_sub(int* dest,int* src1,short* src2,unsigned int size)
+const AmMultiPartyMixer::Speaker*
+AmMultiPartyMixer::findSpeaker(unsigned int channel_id) const
 {
-  int* end_dest = dest + size;
+  for (unsigned int i = 0; i < n_speakers; i++) {
+    if (speakers[i]->channel_id == (int)channel_id)
+      return speakers[i];
+  }
+  return NULL;
+}
 
-  while(dest != end_dest)
-    *(dest++) = *(src1++) - int(*(src2++));
+bool AmMultiPartyMixer::isSpeaker(unsigned int channel_id)
+{
+  return active_speakers && findSpeaker(channel_id);
 }
 
-void AmMultiPartyMixer::scale(short* buffer,int* tmp_buf,unsigned int size)
+void AmMultiPartyMixer::setActiveSpeakers(unsigned int n)
 {
-  short* end_dest = buffer + size;
-    
-  if(scaling_factor<64)
-    scaling_factor++;
-    
-  while(buffer != end_dest){
-	
-    int s = (*tmp_buf * scaling_factor) >> 6;
-    if(abs(s) > MAX_LINEAR_SAMPLE){
-      scaling_factor = abs( (MAX_LINEAR_SAMPLE<<6) / (*tmp_buf) );
-      if(s < 0)
-	s = -MAX_LINEAR_SAMPLE;
-      else
-	s = MAX_LINEAR_SAMPLE;
-    }
-    *(buffer++) = short(s);
-    tmp_buf++;
+  audio_mut.lock();
+  if (n > MIXER_MAX_ACTIVE_SPEAKERS)
+    n = MIXER_MAX_ACTIVE_SPEAKERS;
+  active_speakers = n;
+  n_speakers = 0;
+  nbest_valid = false;
+  audio_mut.unlock();
+}
+
+int AmMultiPartyMixer::GetCurrentSampleRate()
+{
+  SampleRateSet::reverse_iterator sit = samplerates.rbegin();
+  if (sit != samplerates.rend()) {
+	return *sit;
+  } else {
+	return -1;
   }
 }
 
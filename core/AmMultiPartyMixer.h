@@ -38,6 +38,7 @@
 
 #include <map>
 #include <set>
+#include <vector>
 
 struct MixerBufferState
 {
@@ -59,11 +60,20 @@ struct MixerBufferState
   void free_channels();
 };
 
+/** N-best mode: active speakers mixed at most */
+#define MIXER_MAX_ACTIVE_SPEAKERS 16
+
+class AmMixerEncoder;
+
 /**
  * \brief Mixer for one conference.
  * 
  * AmMultiPartyMixer mixes the audio from all channels,
  * and returns the audio of all other channels. 
+ *
+ * With active speakers set (N-best mode), only the N loudest
+ * channels are mixed, once per tick. Every other channel gets
+ * the same mix, which is encoded only once per codec.
  */
 class AmMultiPartyMixer
 {
@@ -71,6 +81,12 @@ class AmMultiPartyMixer
   typedef std::map<int,int> SampleRateMap;
   typedef std::multiset<int> SampleRateSet;
 
+  /** a channel mixed in N-best mode and its samples for the tick */
+  struct Speaker {
+    int   channel_id;
+    short samples[PCM16_B2S(AUDIO_BUFFER_SIZE)];
+  };
+
   SampleRateMap    sampleratemap;
   SampleRateSet    samplerates;
   ChannelIdSet     channelids;
@@ -80,14 +96,34 @@ class AmMultiPartyMixer
   int              scaling_factor; 
   int              tmp_buffer[AUDIO_BUFFER_SIZE/2];
 
+  /** N-best mode: channels mixed at most (0: all) */
+  unsigned int     active_speakers;
+  /** smoothed energy (mean square) per channel */
+  std::map<int,unsigned int> channel_levels;
+  std::vector<Speaker*> speakers;
+  unsigned int     n_speakers;
+
+  /** tick (rate, ts, samples) nbest_mixed and nbest_common are for */
+  bool             nbest_valid;
+  unsigned int     nbest_rate;
+  unsigned long long nbest_ts;
+  unsigned int     nbest_samples;
+  int              nbest_mixed[PCM16_B2S(AUDIO_BUFFER_SIZE)];
+  short            nbest_common[PCM16_B2S(AUDIO_BUFFER_SIZE)];
+
+  /** shared encoded output of the non-speaking channels */
+  std::vector<AmMixerEncoder*> encoders;
+
   std::deque<MixerBufferState>::iterator findOrCreateBufferState(unsigned int sample_rate);
   std::deque<MixerBufferState>::iterator findBufferStateForReading(unsigned int sample_rate, 
 								   unsigned long long last_ts);
   void cleanupBufferStates(unsigned int last_ts);
 
-  void mix_add(int* dest,int* src1,short* src2,unsigned int size);
-  void mix_sub(int* dest,int* src1,short* src2,unsigned int size);
-  void scale(short* buffer,int* tmp_buf,unsigned int size);
+  void updateLevel(unsigned int channel_id, const short* samples,
+		   unsigned int size);
+  void mixSpeakers(MixerBufferState& bstate, unsigned long long ts,
+		   unsigned int samples);
+  const Speaker* findSpeaker(unsigned int channel_id) const;
 
 public:
   AmMultiPartyMixer();
@@ -107,8 +143,28 @@ public:
 			unsigned int&  size,
 			unsigned int&  output_sample_rate);
 
+  /**
+   * Encoded packet for a channel not among the active speakers,
+   * shared by all such channels with the same codec, rate and
+   * frame size.
+   * @return encoded size, 0 if the PCM path must be used
+   */
+  int GetEncodedChannelPacket(unsigned int   channel_id,
+			      unsigned long long system_ts,
+			      unsigned char* buffer,
+			      int            codec_id,
+			      unsigned int   output_sample_rate,
+			      unsigned int   nb_samples);
+
   int GetCurrentSampleRate();
 
+  /** mix only the 'n' loudest channels (0: mix all channels) */
+  void setActiveSpeakers(unsigned int n);
+  unsigned int getActiveSpeakers() { return active_speakers; }
+
+  /** is the channel among the active speakers of the last tick? */
+  bool isSpeaker(unsigned int channel_id);
+
   void lock();
   void unlock();
 };
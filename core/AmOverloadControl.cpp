@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmOverloadControl.h"
+#include "AmConfig.h"
+#include "AmEventQueue.h"
+#include "AmMediaProcessor.h"
+#include "AmArg.h"
+#include "SipCtrlInterface.h"
+#include "sip/trans_layer.h"
+#include "sip/overload_filter.h"
+#include "log.h"
+
+#include <string.h>
+#include <time.h>
+
+static const char* signal_names[AmOverloadControl::Signals] = {
+  "rx_drops_per_sec",
+  "sip_latency_us",
+  "event_backlog",
+  "media_overruns_per_sec"
+};
+
+AmOverloadControl* AmOverloadControl::_instance = NULL;
+
+AmOverloadControl::AmOverloadControl()
+  : stop_requested(false), filter(NULL),
+    last_rx_drops(0), last_latency_us(0), last_latency_n(0),
+    last_overruns(0), cause(-1), reject_pct(0),
+    overloaded_intervals(0)
+{
+  thresholds[RxDrops]       = AmConfig::OverloadMaxRxDrops;
+  thresholds[SipLatency]    = AmConfig::OverloadMaxSipLatency * 1000;
+  thresholds[EventBacklog]  = AmConfig::OverloadMaxEventBacklog;
+  thresholds[MediaOverruns] = AmConfig::OverloadMaxMediaOverruns;
+
+  memset(values,0,sizeof(values));
+  memset(&last_sample,0,sizeof(last_sample));
+}
+
+AmOverloadControl::~AmOverloadControl()
+{
+}
+
+AmOverloadControl* AmOverloadControl::instance()
+{
+  if(!_instance)
+    _instance = new AmOverloadControl();
+
+  return _instance;
+}
+
+void AmOverloadControl::dispose()
+{
+  if(_instance != NULL) {
+    if(_instance->filter) {
+      _instance->stop();
+      _instance->join();
+      _instance->filter->set_reject(0,0);
+    }
+    delete _instance;
+    _instance = NULL;
+  }
+}
+
+bool AmOverloadControl::enabled()
+{
+  return AmConfig::OverloadMaxRxDrops || AmConfig::OverloadMaxSipLatency ||
+    AmConfig::OverloadMaxEventBacklog || AmConfig::OverloadMaxMediaOverruns;
+}
+
+void AmOverloadControl::init()
+{
+  if(!enabled()) {
+    DBG("overload control disabled\n");
+    return;
+  }
+
+  filter = &trans_layer::instance()->get_overload_filter();
+  filter->configure(AmConfig::OverloadRetryAfter,
+		    AmConfig::OverloadExemptNumbers,
+		    AmConfig::Signature);
+
+  // start from the current counters
+  unsigned int v[Signals];
+  sample(v);
+
+  INFO("overload control: every %u ms, max. %u rx drops/s, %u ms SIP latency, "
+       "%u events backlog, %u media overruns/s\n",
+       AmConfig::OverloadInterval,AmConfig::OverloadMaxRxDrops,
+       AmConfig::OverloadMaxSipLatency,AmConfig::OverloadMaxEventBacklog,
+       AmConfig::OverloadMaxMediaOverruns);
+
+  start();
+}
+
+void AmOverloadControl::sample(unsigned int* v)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+
+  unsigned long long elapsed_ms =
+    (now.tv_sec - last_sample.tv_sec) * 1000ULL
+    + now.tv_nsec / 1000000 - last_sample.tv_nsec / 1000000;
+  if(!elapsed_ms)
+    elapsed_ms = 1;
+  last_sample = now;
+
+  unsigned int rx_drops = SipCtrlInterface::instance()->getRxDrops();
+  v[RxDrops] = (rx_drops - last_rx_drops) * 1000ULL / elapsed_ms;
+  last_rx_drops = rx_drops;
+
+  // both counters wrap around
+  const trans_stats& ts = trans_layer::instance()->get_stats();
+  unsigned int latency_us = ts.get_received_latency_us();
+  unsigned int latency_n  = ts.get_received_latency_n();
+  v[SipLatency] = (latency_n != last_latency_n) ?
+    (latency_us - last_latency_us) / (latency_n - last_latency_n) : 0;
+  last_latency_us = latency_us;
+  last_latency_n  = latency_n;
+
+  v[EventBacklog] = AmEventQueue::getPendingEvents();
+
+  unsigned long long overruns = AmMediaProcessor::instance()->getOverruns();
+  v[MediaOverruns] = (overruns - last_overruns) * 1000ULL / elapsed_ms;
+  last_overruns = overruns;
+}
+
+void AmOverloadControl::update()
+{
+  unsigned int v[Signals];
+  sample(v);
+
+  int c = -1;
+  for(int i=0; i<Signals; i++) {
+    if(thresholds[i] && (v[i] > thresholds[i])) {
+      c = i;
+      break;
+    }
+  }
+
+  stats_mut.lock();
+
+  unsigned int pct = reject_pct;
+  if(c >= 0) {
+    pct = (pct + OVERLOAD_STEP_UP > 100) ? 100 : pct + OVERLOAD_STEP_UP;
+    overloaded_intervals++;
+  }
+  else {
+    pct = (pct > OVERLOAD_STEP_DOWN) ? pct - OVERLOAD_STEP_DOWN : 0;
+  }
+
+  if(!reject_pct && pct) {
+    WARN("overload: %s = %u (max. %u), rejecting %u%% of new requests\n",
+	 signal_names[c],v[c],thresholds[c],pct);
+  }
+  else if(reject_pct && !pct) {
+    INFO("overload is over: accepting all new requests again\n");
+  }
+  else if(pct != reject_pct) {
+    DBG("overload: rejecting %u%% of new requests\n",pct);
+  }
+
+  memcpy(values,v,sizeof(values));
+  cause = c;
+  reject_pct = pct;
+
+  stats_mut.unlock();
+
+  // RFC 7339 clients apply it until the next but one sample
+  filter->set_reject(pct,2*AmConfig::OverloadInterval);
+}
+
+void AmOverloadControl::run()
+{
+  while(!stop_requested.wait_for_to(AmConfig::OverloadInterval))
+    update();
+}
+
+void AmOverloadControl::on_stop()
+{
+  stop_requested.set(true);
+}
+
+void AmOverloadControl::getStats(AmArg& ret)
+{
+  ret["enabled"] = enabled();
+
+  AmLock l(stats_mut);
+  ret["reject_pct"] = (int)reject_pct;
+  ret["overloaded_intervals"] = (int)overloaded_intervals;
+  ret["cause"] = (cause >= 0) ? signal_names[cause] : "";
+
+  for(int i=0; i<Signals; i++) {
+    ret["signals"][signal_names[i]] = (int)values[i];
+    ret["thresholds"][signal_names[i]] = (int)thresholds[i];
+  }
+
+  if(filter) {
+    AmArg f;
+    filter->getStats(f);
+    ret["admitted"] = f["admitted"];
+    ret["rejected"] = f["rejected"];
+    ret["exempted"] = f["exempted"];
+  }
+}
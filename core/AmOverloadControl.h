@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmOverloadControl.h */
+#ifndef _AmOverloadControl_h_
+#define _AmOverloadControl_h_
+
+#include "AmThread.h"
+
+class AmArg;
+class overload_filter;
+
+/** reject ratio increase per overloaded interval [%] */
+#define OVERLOAD_STEP_UP   20
+/** reject ratio decrease per normal interval [%] */
+#define OVERLOAD_STEP_DOWN 5
+
+/**
+ * \brief Overload control
+ *
+ * Samples every AmConfig::OverloadInterval ms how far behind the
+ * server is:
+ *  - datagrams dropped by the kernel on the SIP/UDP sockets,
+ *  - average latency from the reception of a SIP/UDP message by the
+ *    kernel until the transaction layer is done with it,
+ *  - events posted, but not yet processed (all event queues),
+ *  - media processor ticks which took longer than the tick interval.
+ *
+ * While any signal exceeds its threshold, the share of new INVITE
+ * and REGISTER requests rejected statelessly by the transaction layer
+ * (see overload_filter) is raised by OVERLOAD_STEP_UP per interval;
+ * otherwise it is lowered by OVERLOAD_STEP_DOWN.
+ *
+ * Unlike session_limit and cps_limit, this does not need to know the
+ * capacity of the server beforehand.
+ */
+class AmOverloadControl
+  : public AmThread
+{
+public:
+  enum Signal {
+    RxDrops=0,     // per second
+    SipLatency,    // us
+    EventBacklog,  // events
+    MediaOverruns, // per second
+    Signals
+  };
+
+private:
+  static AmOverloadControl* _instance;
+
+  AmCondition<bool> stop_requested;
+
+  overload_filter* filter;
+
+  unsigned int thresholds[Signals];
+
+  // cumulative counters at the last sample
+  unsigned int       last_rx_drops;
+  unsigned int       last_latency_us;
+  unsigned int       last_latency_n;
+  unsigned long long last_overruns;
+  struct timespec    last_sample;
+
+  // last sample (stats_mut)
+  AmMutex      stats_mut;
+  unsigned int values[Signals];
+  int          cause;
+  unsigned int reject_pct;
+  unsigned int overloaded_intervals;
+
+  void sample(unsigned int* v);
+  void update();
+
+  AmOverloadControl();
+  ~AmOverloadControl();
+
+  // AmThread interface
+  void run();
+  void on_stop();
+
+public:
+  static AmOverloadControl* instance();
+  static void dispose();
+
+  /** Any threshold configured? */
+  static bool enabled();
+
+  /**
+   * Configure the filter of the transaction layer and start
+   * sampling (once the SIP stack has been loaded).
+   */
+  void init();
+
+  /** last sample, thresholds and current reject ratio */
+  void getStats(AmArg& ret);
+};
+
+#endif
@@ -85,6 +85,23 @@ int AmPlaylist::get(unsigned long long system_ts, unsigned char* buffer,
   return ret;
 }
 
+int AmPlaylist::getEncoded(unsigned long long system_ts, unsigned char* buffer,
+			   int codec_id, unsigned int output_sample_rate,
+			   unsigned int nb_samples)
+{
+  int ret = 0;
+
+  // the end of an item is left to get()
+  cur_mut.lock();
+  updateCurrentItem();
+  if(cur_item && cur_item->play)
+    ret = cur_item->play->getEncoded(system_ts,buffer,codec_id,
+				     output_sample_rate,nb_samples);
+  cur_mut.unlock();
+
+  return ret;
+}
+
 int AmPlaylist::put(unsigned long long system_ts, unsigned char* buffer, 
 		    int input_sample_rate, unsigned int size)
 {
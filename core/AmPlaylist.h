@@ -81,6 +81,10 @@ class AmPlaylist: public AmAudio
 
   int put(unsigned long long system_ts, unsigned char* buffer, 
 	  int input_sample_rate, unsigned int size);
+
+  int getEncoded(unsigned long long system_ts, unsigned char* buffer,
+		 int codec_id, unsigned int output_sample_rate,
+		 unsigned int nb_samples);
 	
   /** from AmAudio */
   void close();
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmPolyphaseResampler.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vector>
+using std::vector;
+
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__)
+#define POLYPHASE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/** filter taps per output sample when upsampling (more when downsampling) */
+#define POLYPHASE_BASE_TAPS 48
+/** passband edge relative to the lower Nyquist frequency */
+#define POLYPHASE_CUTOFF    0.91
+/** Kaiser window parameter (~70 dB stopband attenuation) */
+#define POLYPHASE_BETA      7.0
+
+/** samples per call at most (size of the AmAudio buffers) */
+#define POLYPHASE_MAX_SAMPLES PCM16_B2S(AUDIO_BUFFER_SIZE)
+
+/*
+ * inner products of 'size' samples with a row of filter
+ * coefficients; size is a multiple of 16.
+ */
+
+typedef int (*dot_func)(const short* coefs, const short* samples,
+			unsigned int size);
+
+static int dot_scalar(const short* coefs, const short* samples,
+		      unsigned int size)
+{
+  int acc = 0;
+  for(unsigned int i = 0; i < size; i++)
+    acc += int(coefs[i]) * int(samples[i]);
+  return acc;
+}
+
+#ifdef POLYPHASE_X86_SIMD
+
+__attribute__((target("sse2")))
+static int dot_sse2(const short* coefs, const short* samples,
+		    unsigned int size)
+{
+  __m128i acc = _mm_setzero_si128();
+  for(unsigned int i = 0; i < size; i += 8) {
+    __m128i c = _mm_load_si128((const __m128i*)(coefs + i));
+    __m128i s = _mm_loadu_si128((const __m128i*)(samples + i));
+    acc = _mm_add_epi32(acc,_mm_madd_epi16(c,s));
+  }
+
+  acc = _mm_add_epi32(acc,_mm_shuffle_epi32(acc,_MM_SHUFFLE(1,0,3,2)));
+  acc = _mm_add_epi32(acc,_mm_shuffle_epi32(acc,_MM_SHUFFLE(2,3,0,1)));
+  return _mm_cvtsi128_si32(acc);
+}
+
+__attribute__((target("avx2")))
+static int dot_avx2(const short* coefs, const short* samples,
+		    unsigned int size)
+{
+  __m256i acc = _mm256_setzero_si256();
+  for(unsigned int i = 0; i < size; i += 16) {
+    __m256i c = _mm256_load_si256((const __m256i*)(coefs + i));
+    __m256i s = _mm256_loadu_si256((const __m256i*)(samples + i));
+    acc = _mm256_add_epi32(acc,_mm256_madd_epi16(c,s));
+  }
+
+  __m128i a = _mm_add_epi32(_mm256_castsi256_si128(acc),
+			    _mm256_extracti128_si256(acc,1));
+  a = _mm_add_epi32(a,_mm_shuffle_epi32(a,_MM_SHUFFLE(1,0,3,2)));
+  a = _mm_add_epi32(a,_mm_shuffle_epi32(a,_MM_SHUFFLE(2,3,0,1)));
+  return _mm_cvtsi128_si32(a);
+}
+
+#endif // POLYPHASE_X86_SIMD
+
+struct dot_kernel
+{
+  const char* name;
+  dot_func    dot;
+};
+
+static dot_kernel select_kernel()
+{
+  dot_kernel k = { "scalar", dot_scalar };
+
+#ifdef POLYPHASE_X86_SIMD
+  if(__builtin_cpu_supports("avx2")) {
+    k.name = "avx2";
+    k.dot = dot_avx2;
+  }
+  else if(__builtin_cpu_supports("sse2")) {
+    k.name = "sse2";
+    k.dot = dot_sse2;
+  }
+#endif
+
+  DBG("using '%s' polyphase resampler kernel\n",k.name);
+  return k;
+}
+
+static const dot_kernel& get_kernel()
+{
+  static const dot_kernel k = select_kernel();
+  return k;
+}
+
+/*
+ * filter design
+ */
+
+/** modified Bessel function of the first kind, order 0 */
+static double bessel_i0(double x)
+{
+  double sum = 1.0, term = 1.0;
+  for(int k = 1; k < 50; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if(term < sum * 1e-12)
+      break;
+  }
+  return sum;
+}
+
+/**
+ * Build the coefficient table for upsampling by 'l' and decimating
+ * by 'm': one row of 'taps' coefficients per phase, in reversed
+ * order so that a row is applied to consecutive input samples.
+ */
+static short* build_filter(unsigned int l, unsigned int m, unsigned int taps)
+{
+  unsigned int n = l * taps;
+  double fc = POLYPHASE_CUTOFF / (2.0 * (l > m ? l : m));
+  double center = (n - 1) / 2.0;
+  double i0_beta = bessel_i0(POLYPHASE_BETA);
+
+  vector<double> h(n);
+  for(unsigned int i = 0; i < n; i++) {
+    double x = i - center;
+    double sinc = (x == 0.0) ? 2.0 * fc : sin(2.0 * M_PI * fc * x) / (M_PI * x);
+    double r = 2.0 * x / (n - 1);
+    double w = bessel_i0(POLYPHASE_BETA * sqrt(1.0 - r * r)) / i0_beta;
+    h[i] = l * sinc * w;
+  }
+
+  void* p = NULL;
+  if(posix_memalign(&p,32,n * sizeof(short))) {
+    ERROR("cannot allocate polyphase filter table (%u:%u)\n",l,m);
+    return NULL;
+  }
+
+  short* table = (short*)p;
+  for(unsigned int ph = 0; ph < l; ph++) {
+    short* row = table + ph * taps;
+    int sum = 0;
+    unsigned int peak = 0;
+    for(unsigned int j = 0; j < taps; j++) {
+      long c = lrint(h[ph + (taps - 1 - j) * l] * 32768.0);
+      if(c > 32767) c = 32767;
+      else if(c < -32767) c = -32767;
+      row[j] = (short)c;
+      sum += c;
+      if(abs(row[j]) > abs(row[peak]))
+	peak = j;
+    }
+    // unity gain at DC for every phase despite rounding
+    row[peak] += 32768 - sum;
+  }
+
+  DBG("built polyphase filter %u:%u with %u taps per phase\n",l,m,taps);
+  return table;
+}
+
+/**
+ * \brief polyphase resampler for output rate / input rate = L/M
+ */
+template<unsigned int L, unsigned int M>
+class AmPolyphaseFilter: public AmResamplingState
+{
+public:
+  enum {
+    TAPS = ((POLYPHASE_BASE_TAPS * (L > M ? L : M) / L) + 15) & ~15
+  };
+
+  static const short* table()
+  {
+    static const short* t = build_filter(L,M,TAPS);
+    return t;
+  }
+
+private:
+  /** TAPS-1 samples of history followed by the input */
+  short work[TAPS - 1 + POLYPHASE_MAX_SAMPLES];
+  /** next output: input sample (relative to the next call) and phase */
+  unsigned int pos;
+  unsigned int phase;
+
+  const short* coefs;
+  dot_func     dot;
+
+public:
+  AmPolyphaseFilter()
+    : pos(0), phase(0), coefs(table()), dot(get_kernel().dot)
+  {
+    memset(work,0,(TAPS - 1) * sizeof(short));
+  }
+
+  unsigned int resample(unsigned char* samples, unsigned int s, double ratio)
+  {
+    unsigned int in = PCM16_B2S(s);
+    if(!coefs || !in)
+      return s;
+
+    if((in > POLYPHASE_MAX_SAMPLES) ||
+       ((unsigned long long)in * L / M + 1 > POLYPHASE_MAX_SAMPLES)) {
+      WARN("resample: %u samples too much for the buffer\n",in);
+      return s;
+    }
+
+    memcpy(work + TAPS - 1,samples,in * sizeof(short));
+
+    short* out = (short*)samples;
+    unsigned int n = pos, p = phase, o = 0;
+    while(n < in) {
+      int acc = (dot(coefs + p * TAPS,work + n,TAPS) + (1 << 14)) >> 15;
+      if(acc > 32767) acc = 32767;
+      else if(acc < -32768) acc = -32768;
+      out[o++] = (short)acc;
+
+      p += M;
+      n += p / L;
+      p %= L;
+    }
+
+    pos = n - in;
+    phase = p;
+    memmove(work,work + in,(TAPS - 1) * sizeof(short));
+
+    return PCM16_S2B(o);
+  }
+};
+
+/*
+ * supported ratios
+ */
+
+struct polyphase_ratio
+{
+  unsigned int l, m;
+  AmResamplingState* (*create)();
+  const short* (*table)();
+};
+
+template<unsigned int L, unsigned int M>
+static AmResamplingState* create_filter()
+{
+  return new AmPolyphaseFilter<L,M>();
+}
+
+#define POLYPHASE_RATIO(l,m)						\
+  { l, m, create_filter<l,m>, AmPolyphaseFilter<l,m>::table }
+
+static const polyphase_ratio ratios[] = {
+  POLYPHASE_RATIO(2,1),   POLYPHASE_RATIO(1,2),
+  POLYPHASE_RATIO(3,1),   POLYPHASE_RATIO(1,3),
+  POLYPHASE_RATIO(6,1),   POLYPHASE_RATIO(1,6),
+  // 48000:44100
+  POLYPHASE_RATIO(160,147), POLYPHASE_RATIO(147,160),
+  { 0, 0, NULL, NULL }
+};
+
+static const polyphase_ratio* find_ratio(double ratio)
+{
+  for(const polyphase_ratio* r = ratios; r->l; r++) {
+    if(fabs(ratio - double(r->l) / double(r->m)) < 1e-6)
+      return r;
+  }
+  return NULL;
+}
+
+AmPolyphaseResampler::AmPolyphaseResampler()
+  : impl_ratio(0.0)
+{
+}
+
+AmPolyphaseResampler::~AmPolyphaseResampler()
+{
+}
+
+unsigned int AmPolyphaseResampler::resample(unsigned char* samples, unsigned int s, double ratio)
+{
+  if(!impl.get() || (ratio != impl_ratio)) {
+
+    impl.reset();
+    impl_ratio = ratio;
+
+    const polyphase_ratio* r = find_ratio(ratio);
+    if(r) {
+      impl.reset(r->create());
+    }
+    else {
+#ifdef USE_INTERNAL_RESAMPLER
+      DBG("no polyphase filter for ratio %f, using internal resampler\n",ratio);
+      impl.reset(new AmInternalResamplerState());
+#elif defined(USE_LIBSAMPLERATE)
+      DBG("no polyphase filter for ratio %f, using libsamplerate\n",ratio);
+      impl.reset(new AmLibSamplerateResamplingState());
+#else
+      WARN("no resampler for ratio %f\n",ratio);
+#endif
+    }
+  }
+
+  if(!impl.get())
+    return s;
+
+  return impl->resample(samples,s,ratio);
+}
+
+bool AmPolyphaseResampler::isSupported(double ratio)
+{
+  return find_ratio(ratio) != NULL;
+}
+
+void AmPolyphaseResampler::init()
+{
+  for(const polyphase_ratio* r = ratios; r->l; r++)
+    r->table();
+
+  DBG("polyphase resampler uses '%s' kernel\n",get_kernel().name);
+}
+
+const char* AmPolyphaseResampler::getKernelName()
+{
+  return get_kernel().name;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmPolyphaseResampler.h */
+#ifndef _AmPolyphaseResampler_h_
+#define _AmPolyphaseResampler_h_
+
+#include "AmAudio.h"
+
+#include <memory>
+
+/**
+ * \brief fixed-point polyphase resampler for the usual telephony rates
+ *
+ * Converts between rates in the ratios 2:1, 3:1, 6:1 and 441:480
+ * (8/16/24/32/48 kHz and 44.1 <-> 48 kHz) in both directions. Each
+ * ratio is a template instance with its filter table (Kaiser
+ * windowed sinc, Q15) built once; the inner products run on SSE2 or
+ * AVX2 if the CPU has them.
+ *
+ * Other ratios are handed to the internal resampler or libsamplerate
+ * if SEMS is built with one of them, or left alone otherwise.
+ */
+class AmPolyphaseResampler: public AmResamplingState
+{
+  /** resampler for the current ratio */
+  std::unique_ptr<AmResamplingState> impl;
+  double impl_ratio;
+
+public:
+  AmPolyphaseResampler();
+  virtual ~AmPolyphaseResampler();
+
+  virtual unsigned int resample(unsigned char* samples, unsigned int size, double ratio);
+
+  /** is 'ratio' (output rate / input rate) done by the polyphase filters? */
+  static bool isSupported(double ratio);
+
+  /** build the filter tables (otherwise done on first use) */
+  static void init();
+
+  /** inner product implementation ("scalar", "sse2", "avx2") */
+  static const char* getKernelName();
+};
+
+#endif
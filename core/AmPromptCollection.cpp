@@ -77,7 +77,17 @@ int AmPromptCollection::setPrompt(const std::string& name,
   }
   DBG("adding prompt '%s' to prompt collection.\n", 
       name.c_str());
+
+  // audio files in use keep their own reference to the mapping
+  AudioFileEntry* old_af = NULL;
+  store_mut.lock();
+  std::map<std::string, AudioFileEntry*>::iterator it = store.find(name);
+  if (it != store.end())
+    old_af = it->second;
   store[name]=af;
+  store_mut.unlock();
+
+  delete old_af;
   return 0;
 }
 
@@ -105,6 +115,7 @@ AmCachedAudioFile* AudioFileEntry::getAudio(){
 
 bool AmPromptCollection::hasPrompt(const string& name) {
   string s = name;
+  AmLock l(store_mut);
   std::map<std::string, AudioFileEntry*>::iterator it=store.begin();
 
   while (it != store.end()) {
@@ -120,6 +131,7 @@ int AmPromptCollection::addToPlaylist(const std::string& name, long sess_id,
 				      AmPlaylist& list, bool front, 
 				      bool loop) {
   string s = name;
+  store_mut.lock();
   std::map<std::string, AudioFileEntry*>::iterator it=store.begin();
 
   while (it != store.end()) {
@@ -128,6 +140,7 @@ int AmPromptCollection::addToPlaylist(const std::string& name, long sess_id,
     it++;
   }
   if (it == store.end()) {
+    store_mut.unlock();
     WARN("'%s' prompt not found!\n", name.c_str());
     return -1;
   }
@@ -135,7 +148,10 @@ int AmPromptCollection::addToPlaylist(const std::string& name, long sess_id,
   DBG("adding '%s' prompt to playlist at the %s'\n", it->first.c_str(), 
       front ? "front":"back");
 
+  // holds its own reference to the mapping: the entry may be
+  // replaced by a reload once the lock is released
   AmCachedAudioFile* af = it->second->getAudio();
+  store_mut.unlock();
   if (NULL == af) {
     return -2;
   }
@@ -66,6 +66,8 @@ class AmPromptCollection {
 
   // loaded files
   std::map<string, AudioFileEntry*> store;
+  // mutex for the above: prompts may be reloaded while in use
+  AmMutex store_mut;
 
   // opened objects
   std::map<long, vector<AmCachedAudioFile*> > items;
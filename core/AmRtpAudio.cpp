@@ -314,6 +314,32 @@ int AmRtpAudio::put(unsigned long long system_ts, unsigned char* buffer,
   return send((unsigned int)user_ts,(unsigned char*)samples,s);
 }
 
+int AmRtpAudio::putEncoded(unsigned long long system_ts, AmAudio* src)
+{
+  if (mute || !fmt.get())
+    return 0;
+
+  amci_codec_t* codec = fmt->getCodec();
+  if (!codec || (fmt->channels != 1))
+    return 0;
+
+  int s = src->getEncoded(system_ts, (unsigned char*)samples, codec->id,
+			  getSampleRate(), getFrameSize());
+  if (s <= 0)
+    return 0;
+
+  last_send_ts_i = true;
+  last_send_ts = system_ts;
+
+  AmAudioRtpFormat* rtp_fmt = (AmAudioRtpFormat*)fmt.get();
+  unsigned long long user_ts =
+    system_ts * ((unsigned long long)rtp_fmt->getTSRate() / 100)
+    / (WALLCLOCK_RATE/100);
+
+  int ret = send((unsigned int)user_ts,(unsigned char*)samples,s);
+  return ret < 0 ? ret : s;
+}
+
 void AmRtpAudio::getSdpOffer(unsigned int index, SdpMedia& offer)
 {
   if (offer.type != MT_AUDIO) return;
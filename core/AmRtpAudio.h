@@ -145,6 +145,15 @@ public:
   int put(unsigned long long system_ts, unsigned char* buffer, 
 	  int input_sample_rate, unsigned int size);
 
+  /**
+   * Send the next frame of 'src' if it is available encoded for
+   * the current payload (AmAudio::getEncoded()), bypassing
+   * decoding, resampling and encoding.
+   * @return # bytes taken from src, 0 if not available (use get() and
+   *         put()), <0 on error
+   */
+  int putEncoded(unsigned long long system_ts, AmAudio* src);
+
   unsigned int bytes2samples(unsigned int) const;
 
   // AmRtpStream interface
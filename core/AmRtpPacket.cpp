@@ -32,8 +32,10 @@
 #include "rtp/rtp.h"
 #include "log.h"
 #include "AmConfig.h"
+#include "AmUtils.h"
 
 #include "sip/raw_sender.h"
+#include "sip/raw_sock.h"
 #include "sip/ip_util.h"
 
 #include <assert.h>
@@ -46,15 +48,49 @@
 #include "sip/msg_logger.h"
 
 AmRtpPacket::AmRtpPacket()
-  : data_offset(0)
+  : buffer(NULL),
+    buffer_len(0),
+    ext_buffer(NULL),
+    b_size(0),
+    data_offset(0)
 {
   // buffer will be overwritten by received packet 
   // of hdr+data - does not need to be set to 0s
-  //    memset(buffer,0,4096);
 }
 
 AmRtpPacket::~AmRtpPacket()
 {
+  if(buffer != ext_buffer)
+    delete [] buffer;
+}
+
+void AmRtpPacket::setBuffer(unsigned char* buf, unsigned int len)
+{
+  if(buffer != ext_buffer)
+    delete [] buffer;
+
+  buffer = ext_buffer = buf;
+  buffer_len = len;
+}
+
+unsigned char* AmRtpPacket::releaseBuffer()
+{
+  unsigned char* buf = ext_buffer;
+  setBuffer(NULL,0);
+  return buf;
+}
+
+void AmRtpPacket::expandBuffer(const unsigned char* spill, unsigned int size)
+{
+  unsigned char* buf = new unsigned char[size];
+  memcpy(buf,buffer,buffer_len);
+  memcpy(buf+buffer_len,spill,size-buffer_len);
+
+  if(buffer != ext_buffer)
+    delete [] buffer;
+
+  buffer = buf;
+  buffer_len = size;
 }
 
 void AmRtpPacket::setAddr(struct sockaddr_storage* a)
@@ -142,12 +178,11 @@ int AmRtpPacket::compile(unsigned char* data_buf, unsigned int size)
 
   d_size = size;
   b_size = d_size + sizeof(rtp_hdr_t);
-  assert(b_size <= 4096);
   rtp_hdr_t* hdr = (rtp_hdr_t*)buffer;
 
-  if(b_size>sizeof(buffer)){
-    ERROR("builtin buffer size (%d) exceeded: %d\n",
-	  (int)sizeof(buffer), b_size);
+  if(b_size>buffer_len){
+    ERROR("buffer size (%u) exceeded: %u\n",
+	  buffer_len, b_size);
     return -1;
   }
 
@@ -171,9 +206,9 @@ int AmRtpPacket::compile_raw(unsigned char* data_buf, unsigned int size)
   if ((!size) || (!data_buf))
     return -1;
 
-  if(size>sizeof(buffer)){
-    ERROR("builtin buffer size (%d) exceeded: %d\n",
-	  (int)sizeof(buffer), size);
+  if(size>buffer_len){
+    ERROR("buffer size (%u) exceeded: %u\n",
+	  buffer_len, size);
     return -1;
   }
 
@@ -264,24 +299,91 @@ int AmRtpPacket::send(int sd, unsigned int sys_if_idx,
   return sendto(sd);
 }
 
-int AmRtpPacket::recv(int sd)
+int AmRtpPacket::recv(int sd, unsigned char* spill, unsigned int spill_len)
 {
-  socklen_t recv_addr_len = sizeof(struct sockaddr_storage);
-  int ret = recvfrom(sd,buffer,sizeof(buffer),0,
-		     (struct sockaddr*)&addr,
-		     &recv_addr_len);
+  struct iovec iov[2];
+  iov[0].iov_base = buffer;
+  iov[0].iov_len  = buffer_len;
+  iov[1].iov_base = spill;
+  iov[1].iov_len  = spill_len;
+
+  struct msghdr hdr;
+  memset(&hdr,0,sizeof(hdr));
+  hdr.msg_name    = &addr;
+  hdr.msg_namelen = sizeof(struct sockaddr_storage);
+  hdr.msg_iov     = iov;
+  hdr.msg_iovlen  = spill ? 2 : 1;
+
+  int ret = ::recvmsg(sd,&hdr,0);
 
   if(ret > 0){
 
-    if(ret > 4096)
+    if(hdr.msg_flags & MSG_TRUNC)
       return -1;
 
+    if((unsigned int)ret > buffer_len)
+      expandBuffer(spill,ret);
+
     b_size = ret;
   }
     
   return ret;
 }
 
+int AmRtpPacket::recv_batch(int sd, AmRtpPacket** pkts, unsigned int n,
+			    unsigned char* spill)
+{
+  if(n > MAX_RECV_BATCH)
+    n = MAX_RECV_BATCH;
+
+#ifdef HAVE_RECVMMSG
+  struct mmsghdr msgs[MAX_RECV_BATCH];
+  struct iovec   iovs[MAX_RECV_BATCH][2];
+
+  memset(msgs,0,n*sizeof(struct mmsghdr));
+  for(unsigned int i=0; i<n; i++) {
+    iovs[i][0].iov_base = pkts[i]->buffer;
+    iovs[i][0].iov_len  = pkts[i]->buffer_len;
+    if(spill) {
+      iovs[i][1].iov_base = spill + i*RTP_PACKET_SPILL_SIZE;
+      iovs[i][1].iov_len  = RTP_PACKET_SPILL_SIZE;
+    }
+
+    msgs[i].msg_hdr.msg_name    = &pkts[i]->addr;
+    msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+    msgs[i].msg_hdr.msg_iov     = iovs[i];
+    msgs[i].msg_hdr.msg_iovlen  = spill ? 2 : 1;
+  }
+
+  int ret = recvmmsg(sd,msgs,n,MSG_DONTWAIT,NULL);
+  for(int i=0; i<ret; i++) {
+
+    AmRtpPacket* p = pkts[i];
+    if(msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+      // drop
+      p->b_size = 0;
+      continue;
+    }
+
+    if(msgs[i].msg_len > p->buffer_len)
+      p->expandBuffer(spill + i*RTP_PACKET_SPILL_SIZE,msgs[i].msg_len);
+
+    p->b_size = msgs[i].msg_len;
+  }
+
+  return ret;
+#else
+  unsigned int i=0;
+  for(; i<n; i++) {
+    if(pkts[i]->recv(sd, spill ? spill + i*RTP_PACKET_SPILL_SIZE : NULL,
+		     spill ? RTP_PACKET_SPILL_SIZE : 0) <= 0)
+      break;
+  }
+
+  return i ? (int)i : -1;
+#endif
+}
+
 void AmRtpPacket::logReceived(msg_logger *logger, struct sockaddr_storage *laddr)
 {
   static const cstring empty;
@@ -294,3 +396,281 @@ void AmRtpPacket::logSent(msg_logger *logger, struct sockaddr_storage *laddr)
   logger->log((const char *)buffer, b_size, laddr, &addr, empty);
 }
 
+
+AmRtpPacketPool* AmRtpPacketPool::pools = NULL;
+unsigned int     AmRtpPacketPool::n_pools = 0;
+AmMutex          AmRtpPacketPool::pools_mut;
+
+/** number of buffers added when a pool runs empty */
+#define RTP_PACKET_POOL_SLAB 256
+
+AmRtpPacketPool::AmRtpPacketPool()
+  : n_bufs(0)
+{
+  spill = new unsigned char[MAX_RECV_BATCH * RTP_PACKET_SPILL_SIZE];
+  grow(AmConfig::RtpPacketPoolSize ? 
+       AmConfig::RtpPacketPoolSize : RTP_PACKET_POOL_SLAB);
+}
+
+AmRtpPacketPool::~AmRtpPacketPool()
+{
+  for(std::vector<unsigned char*>::iterator it = slabs.begin();
+      it != slabs.end(); ++it)
+    delete [] *it;
+
+  delete [] spill;
+}
+
+void AmRtpPacketPool::grow(unsigned int n)
+{
+  unsigned char* slab = new unsigned char[n * RTP_PACKET_BUF_SIZE];
+  slabs.push_back(slab);
+
+  n_bufs += n;
+  free_bufs.reserve(n_bufs);
+  for(unsigned int i=0; i<n; i++)
+    free_bufs.push_back(slab + i*RTP_PACKET_BUF_SIZE);
+}
+
+unsigned char* AmRtpPacketPool::alloc()
+{
+  AmLock l(mut);
+
+  if(free_bufs.empty()) {
+    DBG("RTP packet pool [%p] exhausted (%u buffers), growing\n",
+	this,n_bufs);
+    grow(RTP_PACKET_POOL_SLAB);
+  }
+
+  unsigned char* buf = free_bufs.back();
+  free_bufs.pop_back();
+  return buf;
+}
+
+void AmRtpPacketPool::free(unsigned char* buf)
+{
+  if(!buf) return;
+
+  AmLock l(mut);
+  free_bufs.push_back(buf);
+}
+
+void AmRtpPacketPool::touch()
+{
+  AmLock l(mut);
+
+  for(std::vector<unsigned char*>::iterator it = free_bufs.begin();
+      it != free_bufs.end(); ++it)
+    memset(*it, 0, RTP_PACKET_BUF_SIZE);
+
+  memset(spill, 0, MAX_RECV_BATCH * RTP_PACKET_SPILL_SIZE);
+}
+
+AmRtpPacketPool* AmRtpPacketPool::getPool(int sd)
+{
+  AmLock l(pools_mut);
+
+  if(!pools) {
+    // same distribution as the RTP receiver threads
+    n_pools = AmConfig::RTPReceiverThreads > 0 ?
+      AmConfig::RTPReceiverThreads : 1;
+    pools = new AmRtpPacketPool[n_pools];
+  }
+
+  return &pools[sd % n_pools];
+}
+
+void AmRtpPacketPool::getStats(unsigned int& total, unsigned int& free,
+			       unsigned int& oversized)
+{
+  total = free = oversized = 0;
+
+  AmLock l(pools_mut);
+  for(unsigned int i=0; i<n_pools; i++) {
+    AmRtpPacketPool& pool = pools[i];
+
+    pool.mut.lock();
+    total += pool.n_bufs;
+    free  += pool.free_bufs.size();
+    pool.mut.unlock();
+
+    oversized += pool.n_oversized.get();
+  }
+}
+
+
+AmThreadLocalStorage<AmRtpTxQueue> AmRtpTxQueue::current;
+
+AmRtpTxQueue::AmRtpTxQueue()
+  : n_entries(0),
+    sd(-1),
+    mode(TX_SENDTO),
+    sys_if_idx(0)
+{
+  entries = new Entry[MAX_SEND_BATCH];
+}
+
+AmRtpTxQueue::~AmRtpTxQueue()
+{
+  delete [] entries;
+}
+
+int AmRtpTxQueue::send(AmRtpPacket* p, int sd, unsigned int sys_if_idx,
+		       sockaddr_storage* l_saddr)
+{
+#ifdef HAVE_SENDMMSG
+  SendMode p_mode = TX_SENDTO;
+  if(sys_if_idx && AmConfig::UseRawSockets)
+    p_mode = TX_RAW;
+  else if(sys_if_idx && AmConfig::ForceOutboundIf)
+    p_mode = TX_SENDMSG;
+  else
+    sys_if_idx = 0;
+
+  unsigned int len = p->getBufferSize();
+  if(len <= RTP_PACKET_BUF_SIZE) {
+
+    // only packets for the same socket
+    // can be sent with one system call
+    if(n_entries && 
+       ((p_mode != mode) || (sys_if_idx != this->sys_if_idx) ||
+	((p_mode != TX_RAW) && (sd != this->sd))))
+      flush();
+
+    Entry& e = entries[n_entries];
+    if((p_mode != TX_RAW) ||
+       (raw_sender::mk_hdr((char*)e.hdr,(const char*)p->getBuffer(),len,
+			   sys_if_idx,l_saddr,&p->addr) == RAW_IPHDR_UDP4_HDR_LEN)) {
+
+      memcpy(e.buf,p->getBuffer(),len);
+      memcpy(&e.to,&p->addr,sizeof(struct sockaddr_storage));
+      e.len = len;
+
+      this->sd = sd;
+      this->mode = p_mode;
+      this->sys_if_idx = sys_if_idx;
+
+      if(++n_entries == MAX_SEND_BATCH)
+	flush();
+
+      return 0;
+    }
+  }
+
+  // oversized or fragmented: keep the order
+  flush();
+#endif
+
+  tx_calls.inc();
+  if(p->send(sd,sys_if_idx,l_saddr) < 0)
+    return -1;
+
+  tx_packets.inc();
+  return 0;
+}
+
+void AmRtpTxQueue::flush()
+{
+  if(!n_entries)
+    return;
+
+#ifdef HAVE_SENDMMSG
+  struct mmsghdr msgs[MAX_SEND_BATCH];
+  struct iovec   iovs[MAX_SEND_BATCH][2];
+
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(struct in_pktinfo))];
+  } cmsg4_buf;
+
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
+  } cmsg6_buf;
+
+  if(mode == TX_SENDMSG) {
+    // same outbound interface for all queued packets
+    memset(&cmsg4_buf,0,sizeof(cmsg4_buf));
+    struct cmsghdr* cmsg = (struct cmsghdr*)cmsg4_buf.buf;
+    cmsg->cmsg_level = IPPROTO_IP;
+    cmsg->cmsg_type = IP_PKTINFO;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+    ((struct in_pktinfo*)CMSG_DATA(cmsg))->ipi_ifindex = sys_if_idx;
+
+    memset(&cmsg6_buf,0,sizeof(cmsg6_buf));
+    cmsg = (struct cmsghdr*)cmsg6_buf.buf;
+    cmsg->cmsg_level = IPPROTO_IPV6;
+    cmsg->cmsg_type = IPV6_PKTINFO;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
+    ((struct in6_pktinfo*)CMSG_DATA(cmsg))->ipi6_ifindex = sys_if_idx;
+  }
+
+  memset(msgs,0,n_entries*sizeof(struct mmsghdr));
+  for(unsigned int i=0; i<n_entries; i++) {
+
+    Entry& e = entries[i];
+    struct msghdr& hdr = msgs[i].msg_hdr;
+
+    hdr.msg_name = &e.to;
+    hdr.msg_namelen = SA_len(&e.to);
+    hdr.msg_iov = iovs[i];
+
+    if(mode == TX_RAW) {
+      iovs[i][0].iov_base = e.hdr;
+      iovs[i][0].iov_len  = RAW_IPHDR_UDP4_HDR_LEN;
+      iovs[i][1].iov_base = e.buf;
+      iovs[i][1].iov_len  = e.len;
+      hdr.msg_iovlen = 2;
+    }
+    else {
+      iovs[i][0].iov_base = e.buf;
+      iovs[i][0].iov_len  = e.len;
+      hdr.msg_iovlen = 1;
+    }
+
+    if(mode == TX_SENDMSG) {
+      if(e.to.ss_family == AF_INET6) {
+	hdr.msg_control = &cmsg6_buf;
+	hdr.msg_controllen = CMSG_LEN(sizeof(struct in6_pktinfo));
+      }
+      else {
+	hdr.msg_control = &cmsg4_buf;
+	hdr.msg_controllen = CMSG_LEN(sizeof(struct in_pktinfo));
+      }
+    }
+  }
+
+  unsigned int i = 0;
+  while(i < n_entries) {
+
+    int ret;
+    if(mode == TX_RAW)
+      ret = raw_sender::send_batch(msgs + i, n_entries - i);
+    else
+      ret = sendmmsg(sd, msgs + i, n_entries - i, 0);
+
+    tx_calls.inc();
+
+    if(ret <= 0) {
+      // skip the packet which failed
+      ERROR("while sending RTP packet to '%s':%i: %s\n",
+	    get_addr_str(&entries[i].to).c_str(),
+	    am_get_port(&entries[i].to),strerror(errno));
+      i++;
+      continue;
+    }
+
+    tx_packets.inc(ret);
+    i += ret;
+  }
+#endif
+
+  n_entries = 0;
+}
+
+void AmRtpTxQueue::getStats(unsigned long long& calls,
+			    unsigned long long& packets)
+{
+  calls = tx_calls.get();
+  packets = tx_packets.get();
+}
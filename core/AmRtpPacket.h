@@ -28,17 +28,51 @@
 #ifndef _AmRtpPacket_h_
 #define _AmRtpPacket_h_
 
+#include "AmThread.h"
+#include "atomic_types.h"
+
 #include <sys/time.h>
 #include <sys/types.h>
 #include <netinet/in.h>
 
+#include <vector>
+
+#if defined(__linux__)
+#define HAVE_RECVMMSG
+#define HAVE_SENDMMSG
+#endif
+
+/** max. number of packets read with one recv_batch() call */
+#define MAX_RECV_BATCH 32
+
+/** max. number of packets queued for one AmRtpTxQueue flush */
+#define MAX_SEND_BATCH 32
+
+/** size of the pooled (MTU sized) receive buffers */
+#define RTP_PACKET_BUF_SIZE 1536
+/** max. size of RTP packets (larger ones are truncated/dropped) */
+#define RTP_PACKET_MAX_SIZE 4096
+/** receive overflow area per packet for oversized datagrams */
+#define RTP_PACKET_SPILL_SIZE (RTP_PACKET_MAX_SIZE - RTP_PACKET_BUF_SIZE)
+
 class AmRtpPacketTracer;
 class msg_logger;
 
-/** \brief RTP packet implementation */
+/** 
+ * \brief RTP packet implementation 
+ *
+ * The packet does not own its buffer: it has to be attached 
+ * with setBuffer() (pool or stack memory). Only a datagram which
+ * does not fit into the attached buffer is copied into a buffer 
+ * allocated by the packet itself.
+ */
 class AmRtpPacket {
 
-  unsigned char  buffer[4096];
+  unsigned char* buffer;
+  unsigned int   buffer_len;
+  /** buffer attached with setBuffer() */
+  unsigned char* ext_buffer;
+
   unsigned int   b_size;
 
   unsigned int   data_offset;
@@ -47,6 +81,10 @@ class AmRtpPacket {
   int sendto(int sd);
   int sendmsg(int sd, unsigned int sys_if_idx);
 
+  /** move the packet into an own buffer of 'size' bytes,
+      appending the received bytes from 'spill' */
+  void expandBuffer(const unsigned char* spill, unsigned int size);
+
 public:
   unsigned char  payload;
   bool           marker;
@@ -61,6 +99,11 @@ public:
   AmRtpPacket();
   ~AmRtpPacket();
 
+  /** attach a buffer of 'len' bytes */
+  void setBuffer(unsigned char* buf, unsigned int len);
+  /** detach and return the buffer attached with setBuffer() */
+  unsigned char* releaseBuffer();
+
   void setAddr(struct sockaddr_storage* a);
   void getAddr(struct sockaddr_storage* a);
 
@@ -70,7 +113,23 @@ public:
   int compile_raw(unsigned char* data_buf, unsigned int size);
 
   int send(int sd, unsigned int sys_if_idx, sockaddr_storage* l_saddr);
-  int recv(int sd);
+
+  /**
+   * Receive a packet into the attached buffer. A datagram which does
+   * not fit is received partly into 'spill' (if given) and moved into
+   * an own buffer.
+   */
+  int recv(int sd, unsigned char* spill = NULL, 
+	   unsigned int spill_len = 0);
+
+  /**
+   * Receive up to 'n' packets (max. MAX_RECV_BATCH) into 'pkts'
+   * with a single system call if possible (recvmmsg). If given, 
+   * 'spill' must provide n*RTP_PACKET_SPILL_SIZE bytes.
+   * @return number of packets received, -1 on error
+   */
+  static int recv_batch(int sd, AmRtpPacket** pkts, unsigned int n,
+			unsigned char* spill = NULL);
 
   int parse();
 
@@ -81,10 +140,133 @@ public:
   unsigned char* getBuffer();
   void setBufferSize(unsigned int b) { b_size = b; }
 
+  /** packet has been moved into an own (oversized) buffer */
+  bool isOversized() const { return buffer != ext_buffer; }
+
   void logReceived(msg_logger *logger, struct sockaddr_storage *laddr);
   void logSent(msg_logger *logger, struct sockaddr_storage *laddr);
 };
 
+/**
+ * \brief slab pool of RTP receive buffers
+ *
+ * There is one pool per RTP receiver thread (selected like the 
+ * receiver thread itself, by socket descriptor). Buffers are taken
+ * by the receiver thread and given back by whichever thread consumes
+ * the packet. Pools are created on first use and live until exit.
+ */
+class AmRtpPacketPool
+{
+  AmMutex mut;
+
+  std::vector<unsigned char*> slabs;
+  std::vector<unsigned char*> free_bufs;
+  unsigned int n_bufs;
+
+  /** overflow area for the receiver thread using this pool */
+  unsigned char* spill;
+
+  atomic_int n_oversized;
+
+  static AmRtpPacketPool* pools;
+  static unsigned int     n_pools;
+  static AmMutex          pools_mut;
+
+  /** add a slab of 'n' buffers (mut locked) */
+  void grow(unsigned int n);
+
+public:
+  AmRtpPacketPool();
+  ~AmRtpPacketPool();
+
+  /** get a RTP_PACKET_BUF_SIZE buffer (grows the pool if empty) */
+  unsigned char* alloc();
+  void free(unsigned char* buf);
+
+  /** MAX_RECV_BATCH*RTP_PACKET_SPILL_SIZE bytes overflow area */
+  unsigned char* getSpill() { return spill; }
+
+  void incOversized() { n_oversized.inc(); }
+
+  /**
+   * Write the free buffers from the calling (receiver) thread, so
+   * that they are faulted in before use and, as far as they have
+   * not been touched yet, allocated on the thread's NUMA node.
+   */
+  void touch();
+
+  /** get the pool used for socket 'sd' */
+  static AmRtpPacketPool* getPool(int sd);
+
+  /** sum up buffer statistics over all pools */
+  static void getStats(unsigned int& total, unsigned int& free,
+		       unsigned int& oversized);
+};
+
+/**
+ * \brief transmit queue for relayed RTP packets
+ *
+ * Each RTP receiver thread owns a queue and registers it as its
+ * current queue. Packets relayed from within the receiver thread
+ * are copied into the queue and sent with one system call per 
+ * socket (sendmmsg) when the receiver flushes the queue at the end 
+ * of the read callback. The queue is flushed earlier if it is full
+ * or if a packet for another socket is queued, so that no packet 
+ * waits longer than the callback which relayed it.
+ */
+class AmRtpTxQueue
+{
+  enum SendMode {
+    TX_SENDTO=0,
+    TX_SENDMSG,
+    TX_RAW
+  };
+
+  struct Entry {
+    struct sockaddr_storage to;
+    unsigned int  len;
+    /** ip & udp headers (raw mode) */
+    unsigned long long hdr[4];
+    unsigned char buf[RTP_PACKET_BUF_SIZE];
+  };
+
+  Entry*       entries;
+  unsigned int n_entries;
+
+  /** socket and mode of the queued packets */
+  int          sd;
+  SendMode     mode;
+  unsigned int sys_if_idx;
+
+  atomic_int64 tx_calls;
+  atomic_int64 tx_packets;
+
+  static AmThreadLocalStorage<AmRtpTxQueue> current;
+
+public:
+  AmRtpTxQueue();
+  ~AmRtpTxQueue();
+
+  /** 
+   * Queue the packet for sending (same parameters as 
+   * AmRtpPacket::send()). Packets which cannot be queued
+   * are sent immediately.
+   * @return -1 on error, else 0
+   */
+  int send(AmRtpPacket* p, int sd, unsigned int sys_if_idx, 
+	   sockaddr_storage* l_saddr);
+
+  /** send all queued packets */
+  void flush();
+
+  /** send system calls and packets sent */
+  void getStats(unsigned long long& calls, unsigned long long& packets);
+
+  /** queue of the calling thread (NULL if none) */
+  static AmRtpTxQueue* getCurrent() { return current.get(); }
+  static void setCurrent(AmRtpTxQueue* q) { current.set(q); }
+};
+
 #endif
 
 
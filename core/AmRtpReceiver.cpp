@@ -30,18 +30,31 @@
 #include "AmRtpPacket.h"
 #include "log.h"
 #include "AmConfig.h"
+#include "AmArg.h"
+#include "AmCpuAffinity.h"
 
 #include <errno.h>
+#include <string.h>
+#include <sched.h>
 
 // Not on Solaris!
 #if !defined (__SVR4) && !defined (__sun)
 #include <strings.h>
 #endif
 
+AmRtpRecvStats::AmRtpRecvStats()
+  : calls(0), packets(0),
+    tx_calls(0), tx_packets(0)
+{
+  memset(hist,0,sizeof(hist));
+}
+
 _AmRtpReceiver::_AmRtpReceiver()
 {
   n_receivers = AmConfig::RTPReceiverThreads;
   receivers = new AmRtpReceiverThread[n_receivers];
+  for(unsigned int i=0; i<n_receivers; i++)
+    receivers[i].index = i;
 }
 
 _AmRtpReceiver::~_AmRtpReceiver()
@@ -50,7 +63,8 @@ _AmRtpReceiver::~_AmRtpReceiver()
 }
 
 AmRtpReceiverThread::AmRtpReceiverThread()
-  : stop_requested(false)
+  : index(0),
+    stop_requested(false)
 {
   // libevent event base
   ev_base = event_base_new();
@@ -58,6 +72,13 @@ AmRtpReceiverThread::AmRtpReceiverThread()
 
 AmRtpReceiverThread::~AmRtpReceiverThread()
 {
+  for(Streams::iterator it = streams.begin();
+      it != streams.end(); ++it) {
+    event_free(it->second->ev_read);
+    delete it->second;
+  }
+  streams.clear();
+
   event_base_free(ev_base);
   INFO("RTP receiver has been recycled.\n");
 }
@@ -96,9 +117,17 @@ void AmRtpReceiverThread::run()
 	      NULL,NULL);
   event_add(ev_default,NULL);
 
+  AmRtpTxQueue::setCurrent(&tx_queue);
+
+  // the pool receiving into socket 'sd' is the one
+  // of receiver (sd % n_receivers), i.e. this one
+  AmRtpPacketPool::getPool(index)->touch();
+
   // run the event loop
   event_base_loop(ev_base,0);
 
+  AmRtpTxQueue::setCurrent(NULL);
+
   // clean-up fake fds/event
   event_free(ev_default);
   close(fake_fds[0]);
@@ -110,15 +139,69 @@ void AmRtpReceiverThread::_rtp_receiver_read_cb(evutil_socket_t sd,
 {
   AmRtpReceiverThread::StreamInfo* p_si =
     static_cast<AmRtpReceiverThread::StreamInfo*>(arg);
+  AmRtpReceiverThread* thread = p_si->thread;
+
+  // enter callback (full barrier)
+  thread->cb_epoch.inc();
+
+  int n = 0;
+  AmRtpStream* stream = p_si->stream;
+  if(stream) {
+    n = stream->recvPacket(sd);
+  }
+  // else: we are about to get removed...
 
-  p_si->thread->streams_mut.lock();
-  if(!p_si->stream) {
-    // we are about to get removed...
-    p_si->thread->streams_mut.unlock();
+  // send what has been relayed
+  thread->tx_queue.flush();
+
+  // leave callback: quiescent point
+  thread->cb_epoch.inc();
+
+  thread->updateRecvStats(n);
+}
+
+void AmRtpReceiverThread::waitQuiescent()
+{
+  // removing from within the receiver thread:
+  // we are either at a quiescent point or processing
+  // another stream, which is safe as well.
+  if((unsigned long)pthread_self() == _pid)
     return;
+
+  unsigned int epoch = cb_epoch.get();
+  if(!(epoch & 1))
+    return;
+
+  while(cb_epoch.get() == epoch)
+    sched_yield();
+}
+
+void AmRtpReceiverThread::updateRecvStats(int n_packets)
+{
+  unsigned int bucket = 0;
+  if(n_packets > 0) {
+    bucket = 1;
+    for(unsigned int n = n_packets - 1; n && (bucket < RTP_RECV_HIST_BUCKETS-1);
+	n >>= 1)
+      bucket++;
+    recv_packets.inc(n_packets);
   }
-  p_si->stream->recvPacket(sd);
-  p_si->thread->streams_mut.unlock();
+
+  recv_calls.inc();
+  recv_hist[bucket].inc();
+}
+
+void AmRtpReceiverThread::addRecvStats(AmRtpRecvStats& stats)
+{
+  stats.calls   += recv_calls.get();
+  stats.packets += recv_packets.get();
+  for(unsigned int i=0; i<RTP_RECV_HIST_BUCKETS; i++)
+    stats.hist[i] += recv_hist[i].get();
+
+  unsigned long long tx_calls, tx_packets;
+  tx_queue.getStats(tx_calls,tx_packets);
+  stats.tx_calls   += tx_calls;
+  stats.tx_packets += tx_packets;
 }
 
 void AmRtpReceiverThread::addStream(int sd, AmRtpStream* stream)
@@ -131,17 +214,15 @@ void AmRtpReceiverThread::addStream(int sd, AmRtpStream* stream)
     return;
   }
 
-  StreamInfo& si = streams[sd];
-  si.stream = stream;
-  event* ev_read = event_new(ev_base,sd,EV_READ|EV_PERSIST,
-			     AmRtpReceiverThread::_rtp_receiver_read_cb,&si);
-  si.ev_read = ev_read;
-  si.thread = this;
+  StreamInfo* si = new StreamInfo();
+  si->stream = stream;
+  si->thread = this;
+  si->ev_read = event_new(ev_base,sd,EV_READ|EV_PERSIST,
+			  AmRtpReceiverThread::_rtp_receiver_read_cb,si);
+  streams[sd] = si;
   streams_mut.unlock();
 
-  // This must be done when 
-  // streams_mut is NOT locked
-  event_add(ev_read,NULL);
+  event_add(si->ev_read,NULL);
 }
 
 void AmRtpReceiverThread::removeStream(int sd)
@@ -153,35 +234,28 @@ void AmRtpReceiverThread::removeStream(int sd)
     return;
   }
 
-  StreamInfo& si = sit->second;
-  if(!si.stream || !si.ev_read){
-    streams_mut.unlock();
-    return;
-  }
-
-  si.stream = NULL;
-  event* ev_read = si.ev_read;
-  si.ev_read = NULL;
-
+  StreamInfo* si = sit->second;
+  streams.erase(sit);
   streams_mut.unlock();
 
-  // This must be done while
-  // streams_mut is NOT locked
-  event_free(ev_read);
+  // unlink the stream, then wait until the receiver thread 
+  // cannot be using it anymore
+  si->stream = NULL;
+  __sync_synchronize();
+  waitQuiescent();
 
-  streams_mut.lock();
-  // this must be done AFTER event_free()
-  // so that the StreamInfo does not get
-  // deleted while in recvPaket()
-  // (see recv callback)
-  streams.erase(sd);
-  streams_mut.unlock();
+  // event_free() waits for a running callback of this
+  // event to finish, so that 'si' can be reclaimed afterwards
+  event_free(si->ev_read);
+  delete si;
 }
 
 void _AmRtpReceiver::start()
 {
-  for(unsigned int i=0; i<n_receivers; i++)
+  for(unsigned int i=0; i<n_receivers; i++) {
+    AmCpuAffinity::apply(&receivers[i], AmCpuAffinity::RtpReceiver, i);
     receivers[i].start();
+  }
 }
 
 void _AmRtpReceiver::addStream(int sd, AmRtpStream* stream)
@@ -195,3 +269,27 @@ void _AmRtpReceiver::removeStream(int sd)
   unsigned int i = sd % n_receivers;
   receivers[i].removeStream(sd);
 }
+
+void _AmRtpReceiver::getRecvStats(AmArg& ret)
+{
+  AmRtpRecvStats stats;
+  for(unsigned int i=0; i<n_receivers; i++)
+    receivers[i].addRecvStats(stats);
+
+  ret["calls"] = (long long)stats.calls;
+  ret["packets"] = (long long)stats.packets;
+
+  AmArg& hist = ret["batch_hist"];
+  hist.assertArray(RTP_RECV_HIST_BUCKETS);
+  for(int i=0; i<RTP_RECV_HIST_BUCKETS; i++)
+    hist[i] = (long long)stats.hist[i];
+
+  ret["tx_calls"] = (long long)stats.tx_calls;
+  ret["tx_packets"] = (long long)stats.tx_packets;
+
+  unsigned int pool_total, pool_free, oversized;
+  AmRtpPacketPool::getStats(pool_total,pool_free,oversized);
+  ret["pool_buffers"] = (int)pool_total;
+  ret["pool_free"] = (int)pool_free;
+  ret["oversized"] = (int)oversized;
+}
@@ -29,6 +29,7 @@
 #define _AmRtpReceiver_h_
 
 #include "AmThread.h"
+#include "AmRtpPacket.h"
 #include "atomic_types.h"
 #include "singleton.h"
 
@@ -39,6 +40,27 @@ using std::greater;
 
 class AmRtpStream;
 class _AmRtpReceiver;
+class AmArg;
+
+/** 
+ * Number of batch size histogram buckets: bucket 0 counts
+ * empty reads, bucket i counts reads of (2^(i-2),2^(i-1)] packets.
+ */
+#define RTP_RECV_HIST_BUCKETS 8
+
+/** \brief RTP receive statistics */
+struct AmRtpRecvStats
+{
+  unsigned long long calls;
+  unsigned long long packets;
+  unsigned long long hist[RTP_RECV_HIST_BUCKETS];
+
+  /** relay transmit queue: system calls and packets sent */
+  unsigned long long tx_calls;
+  unsigned long long tx_packets;
+
+  AmRtpRecvStats();
+};
 
 /**
  * \brief receiver for RTP for all streams.
@@ -46,13 +68,24 @@ class _AmRtpReceiver;
  * The RtpReceiver receives RTP packets for all streams 
  * that are registered to it. It places the received packets in 
  * the stream's buffer. 
+ *
+ * The read callback does not take any lock: removeStream() unlinks
+ * the stream and then waits until the receiver thread has passed a
+ * quiescent point (left the callback it might be executing) before
+ * the stream info is reclaimed.
+ *
+ * Packets relayed while processing a stream are collected in the
+ * thread's transmit queue, which is flushed before the callback 
+ * is left.
  */
 class AmRtpReceiverThread
   : public AmThread
 {
+  friend class _AmRtpReceiver;
+
   struct StreamInfo 
   {
-    AmRtpStream* stream;
+    AmRtpStream* volatile stream;
     struct event* ev_read;
     AmRtpReceiverThread* thread;
 
@@ -63,16 +96,39 @@ class AmRtpReceiverThread
     {}
   };
 
-  typedef std::map<int, StreamInfo> Streams;
+  typedef std::map<int, StreamInfo*> Streams;
 
   struct event_base* ev_base;
   struct event*      ev_default;
 
+  /** position in _AmRtpReceiver::receivers */
+  unsigned int index;
+
+  /** registry (sd -> stream), not used by the receiver thread */
   Streams  streams;
   AmMutex  streams_mut;
 
+  /** 
+   * Incremented when entering and when leaving the read callback,
+   * thus odd while the receiver thread is processing a stream.
+   */
+  atomic_int cb_epoch;
+
   AmSharedVar<bool> stop_requested;
 
+  /** receive statistics */
+  atomic_int64 recv_calls;
+  atomic_int64 recv_packets;
+  atomic_int64 recv_hist[RTP_RECV_HIST_BUCKETS];
+
+  /** relayed packets to be sent */
+  AmRtpTxQueue tx_queue;
+
+  void updateRecvStats(int n_packets);
+
+  /** wait until the receiver thread is outside of the read callback */
+  void waitQuiescent();
+
   static void _rtp_receiver_read_cb(evutil_socket_t sd, short what, void* arg);
 
 public:    
@@ -86,6 +142,9 @@ public:
   void removeStream(int sd);
 
   void stop_and_wait();
+
+  /** add this thread's receive statistics to 'stats' */
+  void addRecvStats(AmRtpRecvStats& stats);
 };
 
 class _AmRtpReceiver
@@ -106,6 +165,13 @@ public:
 
   void addStream(int sd, AmRtpStream* stream);
   void removeStream(int sd);
+
+  /**
+   * Get receive statistics: number of receive calls, 
+   * packets and histogram of packets per call, packet 
+   * pool usage.
+   */
+  void getRecvStats(AmArg& ret);
 };
 
 typedef singleton<_AmRtpReceiver> AmRtpReceiver;
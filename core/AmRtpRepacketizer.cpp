@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "AmRtpRepacketizer.h"
+#include "AmSdp.h"
+#include "AmUtils.h"
+#include "rtp/rtp.h"
+#include "log.h"
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <arpa/inet.h>
+
+AmRtpRepacketizer::AmRtpRepacketizer(int payload, unsigned int frame_bytes,
+				     unsigned int frame_ts, unsigned int out_frames)
+  : payload(payload), frame_bytes(frame_bytes), frame_ts(frame_ts),
+    out_bytes(out_frames * frame_bytes),
+    len(0), head(0), head_ts(0), marker(false), ssrc(0),
+    seq_delta(0), next_seq(0), next_chunk(0)
+{
+  out.setBuffer(out_buf,sizeof(out_buf));
+  chunks.reserve(RTP_PACKET_MAX_SIZE / out_bytes + 2);
+}
+
+void AmRtpRepacketizer::emit(unsigned int size, unsigned short& seq)
+{
+  Chunk c = { NULL, head, size, head_ts, seq++, marker };
+  chunks.push_back(c);
+
+  marker = false;
+  head += size;
+  head_ts += size / frame_bytes * frame_ts;
+}
+
+void AmRtpRepacketizer::push(AmRtpPacket* p)
+{
+  chunks.clear();
+  next_chunk = 0;
+
+  // drop what has been sent after the last push()
+  if(head) {
+    memmove(buf,buf + head,len - head);
+    len -= head;
+    head = 0;
+  }
+
+  unsigned short seq = p->sequence + seq_delta;
+  unsigned int size = p->getDataSize();
+
+  if((p->payload != payload) || !size || (size % frame_bytes) ||
+     (len + size > sizeof(buf))) {
+    // passed on as it is, after what is left
+    if(len > head)
+      emit(len - head,seq);
+
+    Chunk c = { p, 0, size, p->timestamp, seq++, p->marker };
+    chunks.push_back(c);
+  }
+  else {
+    if((len > head) &&
+       (p->marker || (p->ssrc != ssrc) ||
+	(p->timestamp != head_ts + (len - head) / frame_bytes * frame_ts))) {
+      // does not continue the buffered payload
+      emit(len - head,seq);
+    }
+
+    if(len == head)
+      head_ts = p->timestamp;
+    if(p->marker)
+      marker = true;
+    ssrc = p->ssrc;
+
+    memcpy(buf + len,p->getData(),size);
+    len += size;
+
+    while(len - head >= out_bytes)
+      emit(out_bytes,seq);
+  }
+
+  seq_delta = seq - p->sequence - 1;
+  next_seq = seq;
+}
+
+void AmRtpRepacketizer::flush()
+{
+  chunks.clear();
+  next_chunk = 0;
+
+  if(len > head) {
+    unsigned short seq = next_seq;
+    emit(len - head,seq);
+    seq_delta += (unsigned short)(seq - next_seq);
+    next_seq = seq;
+  }
+}
+
+bool AmRtpRepacketizer::hasFormatOf(const AmRtpRepacketizer& r) const
+{
+  return (payload == r.payload) && (frame_bytes == r.frame_bytes) &&
+    (frame_ts == r.frame_ts) && (out_bytes == r.out_bytes);
+}
+
+AmRtpPacket* AmRtpRepacketizer::pop()
+{
+  while(next_chunk < chunks.size()) {
+    const Chunk& c = chunks[next_chunk++];
+
+    if(c.orig) {
+      rtp_hdr_t* hdr = (rtp_hdr_t*)c.orig->getBuffer();
+      hdr->seq = htons(c.seq);
+      c.orig->sequence = c.seq;
+      return c.orig;
+    }
+
+    out.payload = payload;
+    out.marker = c.marker;
+    out.sequence = c.seq;
+    out.timestamp = c.ts;
+    out.ssrc = ssrc;
+    if(out.compile(buf + c.offset,c.size) == 0)
+      return &out;
+  }
+
+  return NULL;
+}
+
+/** name of 'pl', also for static payload types without rtpmap */
+static string payload_name(const SdpPayload& pl)
+{
+  if(!pl.encoding_name.empty())
+    return pl.encoding_name;
+
+  switch(pl.payload_type) {
+  case 0:  return "PCMU";
+  case 8:  return "PCMA";
+  case 9:  return "G722";
+  case 18: return "G729";
+  }
+  return "";
+}
+
+/** RTP clock rate of 'pl' */
+static unsigned int payload_ts_rate(const SdpPayload& pl)
+{
+  if(pl.encoding_name.empty() || (pl.clock_rate <= 0))
+    return 8000;
+  return pl.clock_rate;
+}
+
+bool AmRtpRepacketizer::getFrameFormat(const SdpPayload& pl,
+				       unsigned int& frame_bytes,
+				       unsigned int& frame_ts)
+{
+  string name = payload_name(pl);
+  const char* n = name.c_str();
+
+  if(!strcasecmp(n,"PCMU") || !strcasecmp(n,"PCMA") ||
+     !strcasecmp(n,"G722")) {
+    // G.722: one byte per tick of its 8 kHz RTP clock
+    frame_bytes = 1;
+    frame_ts = 1;
+  }
+  else if(!strcasecmp(n,"L16")) {
+    frame_bytes = 2 * (pl.encoding_param > 0 ? pl.encoding_param : 1);
+    frame_ts = 1;
+  }
+  else if(!strcasecmp(n,"G729")) {
+    frame_bytes = 10;
+    frame_ts = 80;
+  }
+  else if(!strcasecmp(n,"iLBC")) {
+    // RFC 3952: 30 ms mode unless "mode=20" is given
+    size_t pos = pl.sdp_format_parameters.find("mode=");
+    if((pos != string::npos) &&
+       (atoi(pl.sdp_format_parameters.c_str() + pos + 5) == 20)) {
+      frame_bytes = 38;
+      frame_ts = 160;
+    }
+    else {
+      frame_bytes = 50;
+      frame_ts = 240;
+    }
+  }
+  else {
+    return false;
+  }
+
+  return true;
+}
+
+unsigned int AmRtpRepacketizer::getPtime(const SdpMedia& m, const SdpPayload& pl)
+{
+  for(std::vector<SdpAttribute>::const_iterator a = m.attributes.begin();
+      a != m.attributes.end(); ++a) {
+    unsigned int ptime = 0;
+    if((a->attribute == "ptime") && !str2i(a->value,ptime) && ptime)
+      return ptime;
+  }
+
+  // 20 ms, or one frame if that is longer
+  unsigned int frame_bytes, frame_ts;
+  if(getFrameFormat(pl,frame_bytes,frame_ts)) {
+    unsigned int frame_ms = frame_ts * 1000 / payload_ts_rate(pl);
+    if(frame_ms > 20)
+      return frame_ms;
+  }
+  return 20;
+}
+
+AmRtpRepacketizer* AmRtpRepacketizer::create(const SdpPayload& pl, unsigned int ptime)
+{
+  unsigned int frame_bytes, frame_ts;
+  if(!getFrameFormat(pl,frame_bytes,frame_ts))
+    return NULL;
+
+  unsigned int ts = ptime * payload_ts_rate(pl) / 1000;
+  if(!ts || (ts % frame_ts)) {
+    DBG("ptime %u ms is not a multiple of the %s frame size\n",
+	ptime,payload_name(pl).c_str());
+    return NULL;
+  }
+
+  unsigned int frames = ts / frame_ts;
+  if(frames * frame_bytes + sizeof(rtp_hdr_t) > RTP_PACKET_BUF_SIZE) {
+    DBG("ptime %u ms too long for repacketizing %s\n",
+	ptime,payload_name(pl).c_str());
+    return NULL;
+  }
+
+  return new AmRtpRepacketizer(pl.payload_type,frame_bytes,frame_ts,frames);
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/** @file AmRtpRepacketizer.h */
+#ifndef _AmRtpRepacketizer_h_
+#define _AmRtpRepacketizer_h_
+
+#include "AmRtpPacket.h"
+
+#include <vector>
+
+struct SdpPayload;
+struct SdpMedia;
+
+/**
+ * \brief re-chunks relayed RTP payload to another packet time
+ *
+ * Used for relaying between legs which agreed on the same codec but
+ * on different ptime. The payload of one codec is cut into packets
+ * of the wanted length (or collected into them) without decoding;
+ * this works for codecs whose payload is a plain sequence of
+ * samples or fixed size frames (PCMU, PCMA, G.722, L16, G.729,
+ * iLBC).
+ *
+ * A packet which does not continue the buffered payload (timestamp
+ * gap, marker bit, new SSRC) first flushes what is left as a shorter
+ * packet. Packets of other payload types (telephone-event, CN) and
+ * G.729 SID frames are passed on as they are. Sequence numbers are
+ * shifted by the number of packets added or merged, so that gaps
+ * from packet loss are kept.
+ *
+ * Not thread safe: the stream using it locks it against changes
+ * from the signaling side.
+ */
+class AmRtpRepacketizer
+{
+  struct Chunk {
+    /** passed on as it is if set */
+    AmRtpPacket*   orig;
+    unsigned int   offset;
+    unsigned int   size;
+    unsigned int   ts;
+    unsigned short seq;
+    bool           marker;
+  };
+
+  int          payload;
+  /** size and duration (timestamp units) of a frame */
+  unsigned int frame_bytes;
+  unsigned int frame_ts;
+  /** payload size of the packets sent */
+  unsigned int out_bytes;
+
+  /** payload not sent yet is buf[head..len) */
+  unsigned char buf[RTP_PACKET_BUF_SIZE + RTP_PACKET_MAX_SIZE];
+  unsigned int  len;
+  unsigned int  head;
+  /** timestamp of buf[head] */
+  unsigned int  head_ts;
+  /** marker bit for the next packet */
+  bool          marker;
+  unsigned int  ssrc;
+
+  /** output sequence number - input sequence number */
+  unsigned short seq_delta;
+  /** sequence number of the next packet sent */
+  unsigned short next_seq;
+
+  std::vector<Chunk> chunks;
+  unsigned int next_chunk;
+
+  AmRtpPacket   out;
+  unsigned char out_buf[RTP_PACKET_BUF_SIZE];
+
+  /** queue buf[head..head+size) for sending */
+  void emit(unsigned int size, unsigned short& seq);
+
+public:
+  AmRtpRepacketizer(int payload, unsigned int frame_bytes,
+		    unsigned int frame_ts, unsigned int out_frames);
+
+  int getPayloadType() const { return payload; }
+
+  /** payload size of the packets sent */
+  unsigned int getPacketSize() const { return out_bytes; }
+
+  /** same payload type, frames and packet size as 'r' */
+  bool hasFormatOf(const AmRtpRepacketizer& r) const;
+
+  /** add a received packet */
+  void push(AmRtpPacket* p);
+
+  /**
+   * Send what is buffered as a shorter packet (when relaying stops),
+   * to be fetched with pop().
+   */
+  void flush();
+
+  /**
+   * Next packet to be sent, NULL if none is left from the last
+   * push(). The returned packet is valid until the next call.
+   */
+  AmRtpPacket* pop();
+
+  /**
+   * Frame size (bytes and timestamp units) of 'pl', if its payload
+   * can be cut at frame boundaries.
+   */
+  static bool getFrameFormat(const SdpPayload& pl, unsigned int& frame_bytes,
+			     unsigned int& frame_ts);
+
+  /** ptime of 'm' or the default ptime of 'pl' if 'm' has none */
+  static unsigned int getPtime(const SdpMedia& m, const SdpPayload& pl);
+
+  /**
+   * Create a repacketizer for 'pl' sending packets of 'ptime' ms.
+   * @return NULL if the codec cannot be repacketized to 'ptime'
+   */
+  static AmRtpRepacketizer* create(const SdpPayload& pl, unsigned int ptime);
+};
+
+#endif
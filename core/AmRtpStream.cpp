@@ -38,6 +38,7 @@
 #include "rtp/telephone_event.h"
 #include "amci/codecs.h"
 #include "AmJitterBuffer.h"
+#include "AmRtpRepacketizer.h"
 
 #include "sip/resolver.h"
 #include "sip/ip_util.h"
@@ -162,8 +163,18 @@ void AmRtpStream::setLocalPort(unsigned short p)
     if (!getLocalSocket())
       return;
 
-    if(!p)
+    if(!p) {
       port = AmConfig::RTP_Ifs[l_if].getNextRtpPort();
+      if(!port) {
+	// pool exhausted, no need to retry
+	retry = 0;
+	close(l_sd);
+	l_sd = 0;
+	close(l_rtcp_sd);
+	l_rtcp_sd = 0;
+	break;
+      }
+    }
     else
       port = p;
 
@@ -187,6 +198,11 @@ void AmRtpStream::setLocalPort(unsigned short p)
       l_sd = 0;
       close(l_rtcp_sd);
       l_rtcp_sd = 0;
+
+      // port in use outside of SEMS: 
+      // give it back (quarantined) and try the next one
+      if(!p)
+	AmConfig::RTP_Ifs[l_if].freeRtpPort(port);
   }
 
   int true_opt = 1;
@@ -202,11 +218,16 @@ void AmRtpStream::setLocalPort(unsigned short p)
     ERROR("%s\n",strerror(errno));
     close(l_sd);
     l_sd = 0;
+    if(!p)
+      AmConfig::RTP_Ifs[l_if].freeRtpPort(port);
     throw string ("while setting local address reusable.");
   }
 
   l_port = port;
   l_rtcp_port = port+1;
+  l_port_pooled = !p;
+
+  mem.setPool(AmRtpPacketPool::getPool(l_sd));
 
   if(!p) {
     AmRtpReceiver::instance()->addStream(l_sd, this);
@@ -230,7 +251,9 @@ int AmRtpStream::ping()
   ping_chr[0] = 0;
   ping_chr[1] = 0;
 
+  unsigned char pkt_buf[RTP_PACKET_BUF_SIZE];
   AmRtpPacket rp;
+  rp.setBuffer(pkt_buf,sizeof(pkt_buf));
   rp.payload = payload;
   rp.marker = true;
   rp.sequence = sequence++;
@@ -249,7 +272,9 @@ int AmRtpStream::ping()
 
 int AmRtpStream::compile_and_send(const int payload, bool marker, unsigned int ts, 
 				  unsigned char* buffer, unsigned int size) {
+  unsigned char pkt_buf[RTP_PACKET_MAX_SIZE];
   AmRtpPacket rp;
+  rp.setBuffer(pkt_buf,sizeof(pkt_buf));
   rp.payload = payload;
   rp.timestamp = ts;
   rp.marker = marker;
@@ -328,7 +353,9 @@ int AmRtpStream::send_raw( char* packet, unsigned int length )
   if ((mute) || (hold))
     return 0;
 
+  unsigned char pkt_buf[RTP_PACKET_MAX_SIZE];
   AmRtpPacket rp;
+  rp.setBuffer(pkt_buf,sizeof(pkt_buf));
   rp.compile_raw((unsigned char*)packet, length);
   rp.setAddr(&r_saddr);
 
@@ -397,6 +424,7 @@ AmRtpStream::AmRtpStream(AmSession* _s, int _if)
   : r_port(0),
     l_if(_if),
     l_port(0),
+    l_port_pooled(false),
     l_sd(0), 
     r_ssrc_i(false),
     session(_s),
@@ -440,6 +468,8 @@ AmRtpStream::~AmRtpStream()
     close(l_sd);
     close(l_rtcp_sd);
   }
+  if(l_port && l_port_pooled)
+    AmConfig::RTP_Ifs[l_if].freeRtpPort(l_port);
   if (logger) dec_ref(logger);
 }
 
@@ -781,10 +811,16 @@ void AmRtpStream::resume()
   DBG("RTP Stream instance [%p] resuming (receiving=true, clearing biffers/TS/TO)\n", this);
   clearRTPTimeout();
   receive_mut.lock();
-  mem.clear();
+  // packets currently held by the RTP receiver
+  // will be freed by it
+  for(ReceiveBuffer::iterator it = receive_buf.begin();
+      it != receive_buf.end(); ++it)
+    mem.freePacket(it->second);
   receive_buf.clear();
-  while (!rtp_ev_qu.empty())
+  while (!rtp_ev_qu.empty()) {
+    mem.freePacket(rtp_ev_qu.front());
     rtp_ev_qu.pop();
+  }
   receive_mut.unlock();
   receiving = true;
 
@@ -855,7 +891,16 @@ void AmRtpStream::bufferPacket(AmRtpPacket* p)
 
       if (NULL != relay_stream &&
 	  (!(relay_filter_dtmf && is_dtmf_packet))) {
-        relay_stream->relay(p);
+	AmLock l(relay_mut);
+	if (relay_repacketizer.get() && !relay_raw) {
+	  relay_repacketizer->push(p);
+	  for (AmRtpPacket* r = relay_repacketizer->pop(); r != NULL;
+	       r = relay_repacketizer->pop())
+	    relay_stream->relay(r);
+	}
+	else {
+	  relay_stream->relay(p);
+	}
       }
 
       mem.freePacket(p);
@@ -1024,11 +1069,82 @@ AmRtpPacket *AmRtpStream::reuseBufferedPacket()
   return p;
 }
 
-void AmRtpStream::recvPacket(int fd)
+void AmRtpStream::processPacket(AmRtpPacket* p)
+{
+  int parse_res = 0;
+
+  if (logger) p->logReceived(logger, &l_saddr);
+
+  if(!relay_raw
+#ifdef WITH_ZRTP
+     && !(session && session->enable_zrtp)
+#endif
+     ) {
+    parse_res = p->parse();
+  }
+
+  if (parse_res == -1) {
+    DBG("error while parsing RTP packet.\n");
+    clearRTPTimeout(&p->recv_time);
+    mem.freePacket(p);
+  } else {
+    bufferPacket(p);
+  }
+}
+
+int AmRtpStream::recvPacketBatch(unsigned int batch)
+{
+  AmRtpPacket* pkts[MAX_RECV_BATCH];
+
+  if(batch > MAX_RECV_BATCH)
+    batch = MAX_RECV_BATCH;
+
+  unsigned int n = 0;
+  for(; n < batch; n++) {
+    if(!(pkts[n] = mem.newPacket()))
+      break;
+  }
+
+  if(!n)
+    return -1;
+
+  int ret = AmRtpPacket::recv_batch(l_sd,pkts,n,mem.getPool()->getSpill());
+
+  struct timeval recv_time;
+  if(ret > 0)
+    gettimeofday(&recv_time,NULL);
+
+  for(unsigned int i=0; i < n; i++) {
+
+    AmRtpPacket* p = pkts[i];
+    if(((int)i >= ret) || !p->getBufferSize()) {
+      mem.freePacket(p);
+      continue;
+    }
+
+    if(p->isOversized())
+      mem.getPool()->incOversized();
+
+    p->recv_time = recv_time;
+    processPacket(p);
+  }
+
+  return ret > 0 ? ret : 0;
+}
+
+int AmRtpStream::recvPacket(int fd)
 {
   if(fd == l_rtcp_sd){
     recvRtcpPacket();
-    return;
+    return 1;
+  }
+
+  unsigned int batch = AmConfig::RTP_Ifs[l_if].RtpRecvBatch;
+  if(batch > 1) {
+    int ret = recvPacketBatch(batch);
+    if(ret >= 0)
+      return ret;
+    // no free buffer: fall back to single packet handling
   }
 
   AmRtpPacket* p = mem.newPacket();
@@ -1039,34 +1155,21 @@ void AmRtpStream::recvPacket(int fd)
     // drop received data
     AmRtpPacket dummy;
     dummy.recv(l_sd);
-    return;
+    return 1;
   }
   
-  if(p->recv(l_sd) > 0){
-    int parse_res = 0;
-
-    if (logger) p->logReceived(logger, &l_saddr);
+  AmRtpPacketPool* pool = mem.getPool();
+  if(p->recv(l_sd,pool->getSpill(),RTP_PACKET_SPILL_SIZE) > 0){
+    if(p->isOversized())
+      pool->incOversized();
 
     gettimeofday(&p->recv_time,NULL);
-    
-    if(!relay_raw
-#ifdef WITH_ZRTP
-       && !(session && session->enable_zrtp)
-#endif
-       ) {
-      parse_res = p->parse();
-    }
-
-    if (parse_res == -1) {
-      DBG("error while parsing RTP packet.\n");
-      clearRTPTimeout(&p->recv_time);
-      mem.freePacket(p);	  
-    } else {
-      bufferPacket(p);
-    }
-  } else {
-    mem.freePacket(p);
+    processPacket(p);
+    return 1;
   }
+
+  mem.freePacket(p);
+  return 0;
 }
 
 void AmRtpStream::recvRtcpPacket()
@@ -1151,7 +1254,13 @@ void AmRtpStream::relay(AmRtpPacket* p)
     hdr->ssrc = htonl(l_ssrc);
   p->setAddr(&r_saddr);
 
-  if(p->send(l_sd, AmConfig::RTP_Ifs[l_if].NetIfIdx, &l_saddr) < 0){
+  // batched if relaying from within a receiver thread
+  AmRtpTxQueue* tx_queue = AmRtpTxQueue::getCurrent();
+  int err = tx_queue ?
+    tx_queue->send(p, l_sd, AmConfig::RTP_Ifs[l_if].NetIfIdx, &l_saddr) :
+    p->send(l_sd, AmConfig::RTP_Ifs[l_if].NetIfIdx, &l_saddr);
+
+  if(err < 0){
     ERROR("while sending RTP packet to '%s':%i\n",
 	  get_addr_str(&r_saddr).c_str(),am_get_port(&r_saddr));
   }
@@ -1202,6 +1311,8 @@ void AmRtpStream::enableRtpRelay() {
 
 void AmRtpStream::disableRtpRelay() {
   DBG("disabled RTP relay for RTP stream instance [%p]\n", this);
+  AmLock l(relay_mut);
+  flushRelayRepacketizer();
   relay_enabled = false;
 }
 
@@ -1235,6 +1346,35 @@ void AmRtpStream::setRtpRelayFilterRtpDtmf(bool filter) {
   relay_filter_dtmf = filter;
 }
 
+void AmRtpStream::setRelayRepacketizer(AmRtpRepacketizer* r) {
+  AmLock l(relay_mut);
+  if (r && relay_repacketizer.get() && relay_repacketizer->hasFormatOf(*r)) {
+    // keep the buffered payload and sequence numbers
+    delete r;
+    return;
+  }
+  if (!r && !relay_repacketizer.get())
+    return;
+
+  DBG("%sabled RTP relay repacketizing for RTP stream instance [%p]\n",
+      r ? "en":"dis", this);
+  flushRelayRepacketizer();
+  relay_repacketizer.reset(r);
+}
+
+void AmRtpStream::flushRelayRepacketizer() {
+  if (!relay_repacketizer.get())
+    return;
+
+  relay_repacketizer->flush();
+  for (AmRtpPacket* r = relay_repacketizer->pop(); r != NULL;
+       r = relay_repacketizer->pop()) {
+    // not if relaying has been off and relay_stream might be gone
+    if (relay_enabled && relay_stream && !relay_raw)
+      relay_stream->relay(r);
+  }
+}
+
 void AmRtpStream::stopReceiving()
 {
   if (hasLocalSocket()){
@@ -1265,23 +1405,37 @@ string AmRtpStream::getPayloadName(int payload_type)
 }
 
 PacketMem::PacketMem()
-  : cur_idx(0), n_used(0)
+  : pool(NULL), cur_idx(0)
 {
   memset(used, 0, sizeof(used));
 }
 
+PacketMem::~PacketMem()
+{
+  for(int i=0; i<MAX_PACKETS; i++) {
+    if(used[i])
+      pool->free(packets[i].releaseBuffer());
+  }
+}
+
 inline AmRtpPacket* PacketMem::newPacket() 
 {
-  if(n_used >= MAX_PACKETS)
+  unsigned int quota = AmConfig::RtpPacketQuota;
+  if(quota > MAX_PACKETS)
+    quota = MAX_PACKETS;
+
+  if(!pool || (n_used.get() >= quota))
     return NULL; // full
 
   while(used[cur_idx])
     cur_idx = (cur_idx + 1) & MAX_PACKETS_MASK;
 
+  AmRtpPacket* p = &packets[cur_idx];
+  p->setBuffer(pool->alloc(),RTP_PACKET_BUF_SIZE);
+
   used[cur_idx] = true;
-  n_used++;
+  n_used.inc();
 
-  AmRtpPacket* p = &packets[cur_idx];
   cur_idx = (cur_idx + 1) & MAX_PACKETS_MASK;
 
   return p;
@@ -1296,18 +1450,14 @@ inline void PacketMem::freePacket(AmRtpPacket* p)
   assert(idx < MAX_PACKETS);
 
   if(!used[idx]) {
-    ERROR("freePacket() double free: n_used = %d, idx = %d",n_used,idx);
+    ERROR("freePacket() double free: n_used = %d, idx = %d",n_used.get(),idx);
     return;
   }
 
-  used[p-packets] = false;
-  n_used--;
-}
+  pool->free(p->releaseBuffer());
 
-inline void PacketMem::clear() 
-{
-  memset(used, 0, sizeof(used));
-  n_used = cur_idx = 0;
+  used[idx] = false;
+  n_used.dec();
 }
 
 void AmRtpStream::setLogger(msg_logger* _logger)
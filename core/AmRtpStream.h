@@ -35,6 +35,7 @@
 #include "AmRtpPacket.h"
 #include "AmEvent.h"
 #include "AmDtmfSender.h"
+#include "atomic_types.h"
 
 #include <netinet/in.h>
 
@@ -61,12 +62,15 @@ using std::pair;
  */
 class  AmAudio;
 class  AmSession;
+class  AmRtpRepacketizer;
 struct SdpPayload;
 struct amci_payload_t;
 class msg_logger;
 
 /**
- * This provides the memory for the receive buffer.
+ * This provides the packets for the receive buffer. Packet 
+ * buffers are borrowed from the RTP receiver's packet pool,
+ * at most AmConfig::RtpPacketQuota at a time.
  */
 struct PacketMem {
 #define MAX_PACKETS_BITS 5
@@ -77,14 +81,19 @@ struct PacketMem {
   bool        used[MAX_PACKETS];
 
   PacketMem();
+  ~PacketMem();
+
+  /** set the buffer pool (before first newPacket()) */
+  void setPool(AmRtpPacketPool* p) { pool = p; }
+  AmRtpPacketPool* getPool() { return pool; }
 
   inline AmRtpPacket* newPacket();
   inline void freePacket(AmRtpPacket* p);
-  inline void clear();
 
 private:
+  AmRtpPacketPool* pool;
   unsigned int cur_idx;
-  unsigned int n_used;
+  atomic_int   n_used;
 };
 
 /** \brief event fired on RTP timeout */
@@ -96,6 +105,8 @@ public:
   AmRtpTimeoutEvent() 
     : AmEvent(0) { }
   ~AmRtpTimeoutEvent() { }
+
+  AM_EVENT_POOLED(AmRtpTimeoutEvent);
 };
 
 /** helper class for assigning boolean floag to a payload ID
@@ -208,6 +219,9 @@ protected:
   /** Local port */
   unsigned short     l_port;
 
+  /** l_port has been allocated from the interface's port pool */
+  bool               l_port_pooled;
+
   /** Local socket */
   int                l_sd;
 
@@ -270,6 +284,14 @@ protected:
   bool            relay_transparent_ssrc;
   /** filter RTP DTMF (2833 / 4733) in relaying */
   bool            relay_filter_dtmf;
+  /** re-chunks relayed packets to the relay stream's ptime (if set) */
+  unique_ptr<AmRtpRepacketizer> relay_repacketizer;
+  /** protects relay_repacketizer and sending to relay_stream against
+      changes from the signaling side */
+  AmMutex         relay_mut;
+
+  /** send what relay_repacketizer has buffered (relay_mut locked) */
+  void flushRelayRepacketizer();
 
   /** Session owning this stream */
   AmSession*         session;
@@ -290,6 +312,15 @@ protected:
   /** Try to reuse oldest buffered packet for newly coming packet */
   AmRtpPacket *reuseBufferedPacket();
 
+  /** Log, parse and buffer a packet that has just been received */
+  void processPacket(AmRtpPacket* p);
+
+  /** 
+   * Drain up to 'batch' packets from the RTP socket in one go.
+   * @return number of packets received, -1 if no buffer is free
+   */
+  int recvPacketBatch(unsigned int batch);
+
   /** handle symmetric RTP/RTCP - if in passive mode, update raddr from rp */
   void handleSymmetricRtp(struct sockaddr_storage* recv_addr, bool rtcp);
 
@@ -355,7 +386,11 @@ public:
   int receive( unsigned char* buffer, unsigned int size,
 	       unsigned int& ts, int& payload );
 
-  void recvPacket(int fd);
+  /**
+   * Read from the RTP or RTCP socket 'fd'.
+   * @return number of packets read by this call
+   */
+  int recvPacket(int fd);
 
   void recvRtcpPacket();
 
@@ -502,6 +537,12 @@ public:
   /** enable or disable filtering of RTP DTMF for relay */
   void setRtpRelayFilterRtpDtmf(bool filter);
 
+  /**
+   * repacketize relayed RTP with 'r' (takes ownership), NULL: relay as
+   * received. The current one is kept if 'r' has the same format.
+   */
+  void setRelayRepacketizer(AmRtpRepacketizer* r);
+
   /** remove from RTP receiver */
   void stopReceiving();
 
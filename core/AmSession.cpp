@@ -1330,9 +1330,13 @@ int AmSession::writeStreams(unsigned long long ts, unsigned char *buffer)
   if (stream->sendIntReached()) { // FIXME: shouldn't depend on checkInterval call before!
     unsigned int f_size = stream->getFrameSize();
     int got = 0;
-    if (output) got = output->get(ts, buffer, stream->getSampleRate(), f_size);
-    if (got < 0) res = -1;
-    if (got > 0) res = stream->put(ts, buffer, stream->getSampleRate(), got);
+    // prompts cached pre-encoded for this payload are sent as they are
+    if (output) res = stream->putEncoded(ts, output);
+    if (!res) {
+      if (output) got = output->get(ts, buffer, stream->getSampleRate(), f_size);
+      if (got < 0) res = -1;
+      if (got > 0) res = stream->put(ts, buffer, stream->getSampleRate(), got);
+    }
   }
   
   unlockAudio();
@@ -31,6 +31,7 @@
 
 #include "AmSessionProcessor.h"
 #include "AmSession.h"
+#include "AmCpuAffinity.h"
 
 #include <vector>
 #include <list>
@@ -64,6 +65,8 @@ void AmSessionProcessor::addThreads(unsigned int num_threads) {
   threads_mut.lock();
   for (unsigned int i=0; i < num_threads;i++) {
     threads.push_back(new AmSessionProcessorThread());
+    AmCpuAffinity::apply(threads.back(), AmCpuAffinity::SessionProcessor,
+			 threads.size() - 1);
     threads.back()->start();
   }
   threads_it = threads.begin();
@@ -32,6 +32,7 @@
 
 #include "AmSipDispatcher.h"
 #include "AmEventDispatcher.h"
+#include "AmSipEvent.h"
 
 AmSipDispatcher *AmSipDispatcher::_instance;
 
@@ -40,10 +41,10 @@ AmSipDispatcher* AmSipDispatcher::instance()
   return _instance ? _instance : ((_instance = new AmSipDispatcher()));
 }
 
-void AmSipDispatcher::handleSipMsg(const string& dialog_id, AmSipReply &reply)
+void AmSipDispatcher::handleSipMsg(const string& dialog_id, AmSipReplyEvent* ev)
 {
+  AmSipReply& reply = ev->reply;
   const string& id = dialog_id.empty() ? reply.from_tag : dialog_id;
-  AmSipReplyEvent* ev = new AmSipReplyEvent(reply);
 
   if(!AmEventDispatcher::instance()->post(id,ev)){
     if ((reply.code >= 100) && (reply.code < 300)) {
@@ -58,37 +59,35 @@ void AmSipDispatcher::handleSipMsg(const string& dialog_id, AmSipReply &reply)
   }
 }
 
-void AmSipDispatcher::handleSipMsg(AmSipRequest &req)
+void AmSipDispatcher::handleSipMsg(AmSipRequestEvent* ev)
 {
-  string callid     = req.callid;
-  string remote_tag = req.from_tag;
-  string local_tag  = req.to_tag;
+  // once posted, the event (and the request) belong to the session
+  AmSipRequest& req = ev->req;
 
   AmEventDispatcher* ev_disp = AmEventDispatcher::instance();
 
   if(req.method == SIP_METH_CANCEL){
       
-    if(ev_disp->postSipRequest(req)){
+    if(ev_disp->post(req.callid,req.from_tag,req.via_branch,ev)){
       return;
     }
   
     // CANCEL of a (here) non-existing dialog
     AmSipDialog::reply_error(req,481,SIP_REPLY_NOT_EXIST);
+    delete ev;
     return;
   } 
-  else if(!local_tag.empty()) {
+  else if(!req.to_tag.empty()) {
     // in-dlg request
-    AmSipRequestEvent* ev = new AmSipRequestEvent(req);
 
     // Contact-user may contain internal dialog ID (must be tried before using
     // local_tag for identification)
     if(!req.user.empty() && ev_disp->post(req.user,ev))
       return;
 
-    if(ev_disp->post(local_tag,ev))
+    if(ev_disp->post(req.to_tag,ev))
       return;
 
-    delete ev;
     if(req.method != SIP_METH_ACK) {
       AmSipDialog::reply_error(req,481,
 			       "Call leg/Transaction does not exist");
@@ -96,9 +95,10 @@ void AmSipDispatcher::handleSipMsg(AmSipRequest &req)
     else {
       DBG("received ACK for non-existing dialog "
 	  "(callid=%s;remote_tag=%s;local_tag=%s)\n",
-	  callid.c_str(),remote_tag.c_str(),local_tag.c_str());
+	  req.callid.c_str(),req.from_tag.c_str(),req.to_tag.c_str());
     }
 
+    delete ev;
     return;
   }
 
@@ -112,7 +112,6 @@ void AmSipDispatcher::handleSipMsg(AmSipRequest &req)
     
     // BYE/PRACK of a (here) non-existing dialog
     AmSipDialog::reply_error(req,481,SIP_REPLY_NOT_EXIST);
-    return;
 
   } else {
 
@@ -121,20 +120,18 @@ void AmSipDispatcher::handleSipMsg(AmSipRequest &req)
     if (sess_fact) {
       try {
 	sess_fact->onOoDRequest(req);
-	return;
       } catch (AmSession::Exception& e) {
 	AmSipDialog::reply_error(req,e.code,e.reason, e.hdrs);
 	ERROR("%i %s %s\n",e.code,e.reason.c_str(), e.hdrs.c_str());
-	return;
       }
     }
-	
-    if (req.method == SIP_METH_OPTIONS) {
+    else if (req.method == SIP_METH_OPTIONS) {
       AmSessionFactory::replyOptions(req);
-      return;
     }
-      
-    AmSipDialog::reply_error(req,404,"Not found");
+    else {
+      AmSipDialog::reply_error(req,404,"Not found");
+    }
   }
 
+  delete ev;
 }
@@ -29,14 +29,22 @@
 
 #include "AmSipMsg.h"
 
+class AmSipRequestEvent;
+class AmSipReplyEvent;
+
 class AmSipDispatcher
 {
   private:
     static AmSipDispatcher *_instance;
 
   public:
-    void handleSipMsg(AmSipRequest &);
-    void handleSipMsg(const string& dialog_id, AmSipReply &);
+    /**
+     * Dispatch a received request (or reply), converted
+     * into the event delivered to the session: the event
+     * is consumed either way.
+     */
+    void handleSipMsg(AmSipRequestEvent* ev);
+    void handleSipMsg(const string& dialog_id, AmSipReplyEvent* ev);
 
     static AmSipDispatcher* instance();
 };
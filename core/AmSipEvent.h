@@ -80,12 +80,19 @@ class AmSipRequestEvent: public AmSipEvent
 {
  public:
   AmSipRequest req;
+
+  /** the request is filled in by the receiver (see AmSipDispatcher) */
+  AmSipRequestEvent()
+    : AmSipEvent()
+    {}
     
   AmSipRequestEvent(const AmSipRequest& r)
     : AmSipEvent(), req(r)
     {}
 
   virtual void operator() (AmBasicSipDialog* dlg);
+
+  AM_EVENT_POOLED(AmSipRequestEvent);
 };
 
 /** \brief SIP reply event */
@@ -94,10 +101,16 @@ class AmSipReplyEvent: public AmSipEvent
  public:
   AmSipReply reply;
 
+  /** the reply is filled in by the receiver (see AmSipDispatcher) */
+  AmSipReplyEvent()
+    : AmSipEvent() {}
+
   AmSipReplyEvent(const AmSipReply& r) 
     : AmSipEvent(),reply(r) {}
 
   virtual void operator() (AmBasicSipDialog* dlg);
+
+  AM_EVENT_POOLED(AmSipReplyEvent);
 };
 
 
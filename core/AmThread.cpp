@@ -29,6 +29,8 @@
 #include "log.h"
 
 #include <unistd.h>
+#include <string.h>
+#include <sched.h>
 #include "errno.h"
 #include <string>
 using std::string;
@@ -62,6 +64,11 @@ void AmMutex::unlock()
   pthread_mutex_unlock(&m);
 }
 
+bool AmMutex::trylock()
+{
+  return pthread_mutex_trylock(&m) == 0;
+}
+
 AmThread::AmThread()
   : _stopped(true)
 {
@@ -72,6 +79,12 @@ void * AmThread::_start(void * _t)
   AmThread* _this = (AmThread*)_t;
   _this->_pid = (unsigned long) _this->_td;
   DBG("Thread %lu is starting.\n", (unsigned long) _this->_pid);
+
+  _this->_m_td.lock();
+  if(!_this->_cpus.empty())
+    _this->applyAffinity(pthread_self());
+  _this->_m_td.unlock();
+
   _this->run();
 
   DBG("Thread %lu is ending.\n", (unsigned long) _this->_pid);
@@ -189,6 +202,50 @@ int AmThread::setRealtime() {
   return 0;
 }
 
+void AmThread::setAffinity(const std::vector<int>& cpus)
+{
+  AmLock l(_m_td);
+  _cpus = cpus;
+
+  if(!is_stopped() && _pid)
+    applyAffinity(_td);
+}
+
+int AmThread::applyAffinity(pthread_t td)
+{
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  if(_cpus.empty()) {
+    // no restriction: all configured CPUs
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      CPU_SET(cpu, &set);
+  }
+  else {
+    for(std::vector<int>::iterator it = _cpus.begin();
+	it != _cpus.end(); ++it) {
+      if(*it >= 0 && *it < CPU_SETSIZE)
+	CPU_SET(*it, &set);
+    }
+  }
+
+  int res = pthread_setaffinity_np(td, sizeof(set), &set);
+  if(res != 0) {
+    ERROR("could not set CPU affinity of thread %lu: %s\n",
+	  (unsigned long) td, strerror(res));
+    return -1;
+  }
+
+  DBG("Thread %lu restricted to %zu CPUs.\n",
+      (unsigned long) td, _cpus.empty() ? (size_t)CPU_SETSIZE : _cpus.size());
+  return 0;
+#else
+  WARN("CPU affinity is not supported on this platform\n");
+  return -1;
+#endif
+}
+
 
 AmThreadWatcher* AmThreadWatcher::_instance=0;
 AmMutex AmThreadWatcher::_inst_mut;
@@ -34,6 +34,7 @@
 #include <errno.h>
 
 #include <queue>
+#include <vector>
 
 /**
  * \brief C++ Wrapper class for pthread mutex
@@ -47,6 +48,9 @@ public:
   ~AmMutex();
   void lock();
   void unlock();
+
+  /** @return true if the mutex has been locked */
+  bool trylock();
 };
 
 /**
@@ -194,8 +198,14 @@ class AmThread
 
   AmSharedVar<bool> _stopped;
 
+  /** CPUs this thread is restricted to (empty: any) */
+  std::vector<int> _cpus;
+
   static void* _start(void*);
 
+  /** restrict thread 'td' to _cpus (_m_td locked) */
+  int applyAffinity(pthread_t td);
+
 protected:
   virtual void run()=0;
   virtual void on_stop()=0;
@@ -219,6 +229,14 @@ public:
   void cancel();
 
   int setRealtime();
+
+  /**
+   * Restrict this thread to the given CPUs (empty: no restriction).
+   * Takes effect when the thread starts, or immediately if it is
+   * already running. Memory first touched by the thread afterwards
+   * is then allocated on the NUMA node of these CPUs.
+   */
+  void setAffinity(const std::vector<int>& cpus);
 };
 
 /**
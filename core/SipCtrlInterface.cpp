@@ -32,6 +32,7 @@
 #include "AmSipMsg.h"
 #include "AmMimeBody.h"
 #include "AmSipHeaders.h"
+#include "AmCpuAffinity.h"
 
 #include "sip/trans_layer.h"
 #include "sip/sip_parser.h"
@@ -60,10 +61,14 @@
 
 bool _SipCtrlInterface::log_parsed_messages = true;
 int _SipCtrlInterface::udp_rcvbuf = -1;
+bool _SipCtrlInterface::udp_reuseport = false;
+bool _SipCtrlInterface::udp_cpu_steering = false;
 
 int _SipCtrlInterface::alloc_udp_structs()
 {
-    udp_sockets = new udp_trsp_socket*[ AmConfig::SIP_Ifs.size() ];
+    udp_sockets = new udp_trsp_socket*[ (udp_reuseport ?
+					 AmConfig::SIPServerThreads : 1)
+					* AmConfig::SIP_Ifs.size() ];
     udp_servers = new udp_trsp* [ AmConfig::SIPServerThreads
 				  * AmConfig::SIP_Ifs.size() ];
 
@@ -73,14 +78,16 @@ int _SipCtrlInterface::alloc_udp_structs()
     return -1;
 }
 
-int _SipCtrlInterface::init_udp_servers(int if_num)
+udp_trsp_socket* _SipCtrlInterface::create_udp_socket(int if_num)
 {
     udp_trsp_socket* udp_socket = 
 	new udp_trsp_socket(if_num,AmConfig::SIP_Ifs[if_num].SigSockOpts
 			    | (AmConfig::ForceOutboundIf ? 
 			       trsp_socket::force_outbound_if : 0)
 			    | (AmConfig::UseRawSockets ?
-			       trsp_socket::use_raw_sockets : 0),
+			       trsp_socket::use_raw_sockets : 0)
+			    | (udp_reuseport ?
+			       trsp_socket::reuse_port : 0),
 			    AmConfig::SIP_Ifs[if_num].NetIfIdx);
 	
     if(!AmConfig::SIP_Ifs[if_num].PublicIP.empty()) {
@@ -95,19 +102,46 @@ int _SipCtrlInterface::init_udp_servers(int if_num)
 	      AmConfig::SIP_Ifs[if_num].LocalPort);
 
 	delete udp_socket;
-	return -1;
+	return NULL;
     }
 
     if(udp_rcvbuf > 0) {
 	udp_socket->set_recvbuf_size(udp_rcvbuf);
     }
 
-    trans_layer::instance()->register_transport(udp_socket);
-    udp_sockets[if_num] = udp_socket;
+    // for the latency measured by the overload control
+    if(AmConfig::OverloadMaxSipLatency) {
+	udp_socket->set_timestamping();
+    }
+
+    udp_sockets[nr_udp_sockets++] = udp_socket;
     inc_ref(udp_socket);
-    nr_udp_sockets++;
+
+    return udp_socket;
+}
+
+int _SipCtrlInterface::init_udp_servers(int if_num)
+{
+    udp_trsp_socket* udp_socket = create_udp_socket(if_num);
+    if(!udp_socket)
+	return -1;
+
+    // with SO_REUSEPORT, every server thread receives on its own
+    // socket; messages are sent through the first one.
+    trans_layer::instance()->register_transport(udp_socket);
+
+    if(udp_reuseport && udp_cpu_steering &&
+       (udp_socket->set_cpu_steering(AmConfig::SIPServerThreads) < 0)) {
+	return -1;
+    }
 
     for(int j=0; j<AmConfig::SIPServerThreads;j++){
+	if(udp_reuseport && j) {
+	    udp_socket = create_udp_socket(if_num);
+	    if(!udp_socket)
+		return -1;
+	}
+
 	udp_servers[if_num * AmConfig::SIPServerThreads + j] = 
 	    new udp_trsp(udp_socket);
 	nr_udp_servers++;
@@ -218,6 +252,67 @@ int _SipCtrlInterface::load()
 	    DBG("udp_rcvbuf = %d\n", udp_rcvbuf);
 	}
 
+	if (cfg.hasParameter("udp_reuseport")) {
+	    udp_reuseport = cfg.getParameter("udp_reuseport") == "yes";
+	}
+	DBG("udp_reuseport = %s\n", udp_reuseport?"yes":"no");
+
+	if (cfg.hasParameter("udp_reuseport_steering")) {
+	    string steering = cfg.getParameter("udp_reuseport_steering");
+	    if (steering == "cpu") udp_cpu_steering = true;
+	    else if (steering != "hash") {
+		ERROR("invalid value specified for udp_reuseport_steering\n");
+		return -1;
+	    }
+	}
+
+	if (cfg.hasParameter("trans_table_size")) {
+	    unsigned int ht_size = 0;
+	    if (str2i(cfg.getParameter("trans_table_size"), ht_size) || !ht_size) {
+		ERROR("invalid value specified for trans_table_size\n");
+		return -1;
+	    }
+	    set_trans_table_size(ht_size);
+	    DBG("trans_table_size = %u\n", ht_size);
+	}
+
+	if (cfg.hasParameter("stateless_keepalive")) {
+	    unsigned int methods = 0;
+	    vector<string> m = explode(cfg.getParameter("stateless_keepalive"), ",");
+	    for (vector<string>::iterator it = m.begin(); it != m.end(); ++it) {
+		string meth = trim(*it, " \t");
+		if (meth == "options") methods |= SL_RESP_OPTIONS;
+		else if (meth == "notify") methods |= SL_RESP_NOTIFY;
+		else if (meth != "no") {
+		    ERROR("invalid value specified for stateless_keepalive\n");
+		    return -1;
+		}
+	    }
+
+	    unsigned int rate = DEFAULT_SL_KEEPALIVE_RATE;
+	    if (cfg.hasParameter("stateless_keepalive_rate") &&
+		str2i(cfg.getParameter("stateless_keepalive_rate"), rate)) {
+		ERROR("invalid value specified for stateless_keepalive_rate\n");
+		return -1;
+	    }
+
+	    bool any_user = cfg.getParameter("stateless_keepalive_any_user") == "yes";
+
+	    if ((methods & SL_RESP_OPTIONS) &&
+		(AmConfig::OptionsSessionLimit ||
+		 !AmConfig::OptionsTranscoderInStatsHdr.empty() ||
+		 !AmConfig::OptionsTranscoderOutStatsHdr.empty())) {
+		WARN("stateless_keepalive: OPTIONS are answered by the application "
+		     "(options_session_limit or transcoder statistics headers set)\n");
+		methods &= ~SL_RESP_OPTIONS;
+	    }
+
+	    trans_layer::instance()->get_sl_responder().
+		configure(methods, any_user, rate, AmConfig::Signature);
+	    DBG("stateless_keepalive: methods = 0x%x, rate = %u/s, any_user = %s\n",
+		methods, rate, any_user?"yes":"no");
+	}
+
     } else {
 	DBG("assuming SIP default settings.\n");
     }
@@ -383,6 +478,7 @@ int _SipCtrlInterface::run()
 
     if (NULL != udp_servers) {
 	for(int i=0; i<nr_udp_servers;i++){
+	    AmCpuAffinity::apply(udp_servers[i], AmCpuAffinity::SipServer, i);
 	    udp_servers[i]->start();
 	}
     }
@@ -401,6 +497,15 @@ int _SipCtrlInterface::run()
     return 0;
 }
 
+unsigned int _SipCtrlInterface::getRxDrops()
+{
+    unsigned int drops = 0;
+    for(int i=0; i<nr_udp_sockets; i++) {
+	drops += udp_sockets[i]->get_rx_drops();
+    }
+    return drops;
+}
+
 void _SipCtrlInterface::stop()
 {
     stopped.set(true);
@@ -509,6 +614,42 @@ int _SipCtrlInterface::send(const AmSipReply &rep, const string& dialog_id,
 }
 
 
+/** append "<name>: <value>\r\n" of each header of 'type' */
+static inline void append_hdrs(string& str, const sip_header_list& hdrs,
+			       int type1, int type2 = -1)
+{
+    size_t len = str.length();
+    for (sip_header_list::const_iterator it = hdrs.begin();
+	 it != hdrs.end(); ++it) {
+	if((*it)->type == type1 || (*it)->type == type2)
+	    len += (*it)->name.len + (*it)->value.len + 4;
+    }
+    // single allocation
+    str.reserve(len);
+
+    for (sip_header_list::const_iterator it = hdrs.begin();
+	 it != hdrs.end(); ++it) {
+	if((*it)->type == type1 || (*it)->type == type2) {
+	    str.append((*it)->name.s,(*it)->name.len);
+	    str.append(": ",2);
+	    str.append((*it)->value.s,(*it)->value.len);
+	    str.append(CRLF,2);
+	}
+    }
+}
+
+/** append the contacts, separated by 'sep' */
+static inline void append_contacts(string& str, const sip_header_list& contacts,
+				   const char* sep)
+{
+    for(sip_header_list::const_iterator c_it = contacts.begin();
+	c_it != contacts.end(); ++c_it){
+	if(c_it != contacts.begin())
+	    str += sep;
+	str.append((*c_it)->value.s,(*c_it)->value.len);
+    }
+}
+
 inline bool _SipCtrlInterface::sip_msg2am_request(const sip_msg *msg, 
 						 const trans_ticket& tt,
 						 AmSipRequest &req)
@@ -553,13 +694,7 @@ inline bool _SipCtrlInterface::sip_msg2am_request(const sip_msg *msg,
 	    req.from_uri = c2stlstr(na.addr);
 	}
 
-	list<sip_header*>::const_iterator c_it = msg->contacts.begin();
-	req.contact = c2stlstr((*c_it)->value);
-	++c_it;
-
-	for(;c_it!=msg->contacts.end(); ++c_it){
-	    req.contact += ", " + c2stlstr((*c_it)->value);
-	}
+	append_contacts(req.contact,msg->contacts,", ");
     }
     else {
 	if (req.method == SIP_METH_INVITE) {
@@ -575,11 +710,16 @@ inline bool _SipCtrlInterface::sip_msg2am_request(const sip_msg *msg,
 	req.from_uri = c2stlstr(get_from(msg)->nameaddr.addr);
     }
 
-    if(get_from(msg)->nameaddr.name.len){
-	req.from += c2stlstr(get_from(msg)->nameaddr.name) + ' ';
+    const sip_nameaddr& from_na = get_from(msg)->nameaddr;
+    req.from.reserve(from_na.name.len + from_na.addr.len + 3);
+    if(from_na.name.len){
+	req.from.append(from_na.name.s,from_na.name.len);
+	req.from += ' ';
     }
 
-    req.from += '<' + c2stlstr(get_from(msg)->nameaddr.addr) + '>';
+    req.from += '<';
+    req.from.append(from_na.addr.s,from_na.addr.len);
+    req.from += '>';
 
     req.to       = c2stlstr(msg->to->value);
     req.callid   = c2stlstr(msg->callid->value);
@@ -609,21 +749,14 @@ inline bool _SipCtrlInterface::sip_msg2am_request(const sip_msg *msg,
     }
 
     prepare_routes_uas(msg->record_route, req.route);
+
+    append_hdrs(req.hdrs, msg->hdrs, sip_header::H_OTHER, sip_header::H_REQUIRE);
+    append_hdrs(req.vias, msg->hdrs, sip_header::H_VIA);
 	
     for (list<sip_header *>::const_iterator it = msg->hdrs.begin(); 
 	 it != msg->hdrs.end(); ++it) {
 
-	switch((*it)->type) {
-	case sip_header::H_OTHER:
-	case sip_header::H_REQUIRE:
-	    req.hdrs += c2stlstr((*it)->name) + ": " 
-		+ c2stlstr((*it)->value) + CRLF;
-	    break;
-	case sip_header::H_VIA:
-	    req.vias += c2stlstr((*it)->name) + ": " 
-		+ c2stlstr((*it)->value) + CRLF;
-	    break;
-	case sip_header::H_MAX_FORWARDS:
+	if((*it)->type == sip_header::H_MAX_FORWARDS) {
 	    if(!str2int(c2stlstr((*it)->value),req.max_forwards) ||
 	       (req.max_forwards < 0) ||
 	       (req.max_forwards > 255)) {
@@ -631,7 +764,6 @@ inline bool _SipCtrlInterface::sip_msg2am_request(const sip_msg *msg,
 		    send_sf_error_reply(&tt, msg, 400, "Incorrect Max-Forwards");
 		return false;
 	    }
-	    break;
 	}
     }
 
@@ -695,13 +827,7 @@ inline bool _SipCtrlInterface::sip_msg2am_reply(sip_msg *msg, AmSipReply &reply)
 	    reply.to_uri = c2stlstr(na.addr);
 	}
 
-	list<sip_header*>::iterator c_it = msg->contacts.begin();
-	reply.contact = c2stlstr((*c_it)->value);
-	++c_it;
-
-	for(;c_it!=msg->contacts.end(); ++c_it){
-	    reply.contact += "," + c2stlstr((*c_it)->value);
-	}
+	append_contacts(reply.contact,msg->contacts,",");
     }
 
     reply.callid = c2stlstr(msg->callid->value);
@@ -712,18 +838,15 @@ inline bool _SipCtrlInterface::sip_msg2am_reply(sip_msg *msg, AmSipReply &reply)
 
     prepare_routes_uac(msg->record_route, reply.route);
 
+    append_hdrs(reply.hdrs, msg->hdrs, sip_header::H_OTHER, sip_header::H_REQUIRE);
+
     unsigned rseq;
-    for (list<sip_header*>::iterator it = msg->hdrs.begin(); 
+    for (sip_header_list::iterator it = msg->hdrs.begin(); 
 	 it != msg->hdrs.end(); ++it) {
 #ifdef PROPAGATE_UNPARSED_REPLY_HEADERS
         reply.unparsed_headers.push_back(AmSipHeader((*it)->name, (*it)->value));
 #endif
         switch ((*it)->type) {
-          case sip_header::H_OTHER:
-          case sip_header::H_REQUIRE:
-	      reply.hdrs += c2stlstr((*it)->name) + ": " 
-                  + c2stlstr((*it)->value) + CRLF;
-              break;
           case sip_header::H_RSEQ:
               if (! parse_rseq(&rseq, (*it)->value.s, (*it)->value.len)) {
                   ERROR("failed to parse (rcvd) '" SIP_HDR_RSEQ "' hdr.\n");
@@ -756,10 +879,14 @@ void _SipCtrlInterface::handle_sip_request(const trans_ticket& tt, sip_msg* msg)
     assert(msg->from && msg->from->p);
     assert(msg->to && msg->to->p);
     
-    AmSipRequest req;
+    // converted straight into the event posted to the session
+    AmSipRequestEvent* ev = new AmSipRequestEvent();
+    AmSipRequest& req = ev->req;
 
-    if(!sip_msg2am_request(msg, tt, req))
+    if(!sip_msg2am_request(msg, tt, req)) {
+	delete ev;
 	return;
+    }
 
     DBG("Received new request from <%s:%i/%s> on intf #%i\n",
 	req.remote_ip.c_str(),req.remote_port,req.trsp.c_str(),req.local_if);
@@ -782,10 +909,13 @@ void _SipCtrlInterface::handle_sip_request(const trans_ticket& tt, sip_msg* msg)
 	DBG("body-ct = <%s>\n",req.body.getCTStr().c_str());
     }
 
-    AmSipDispatcher::instance()->handleSipMsg(req);
+    AmSipDispatcher::instance()->handleSipMsg(ev);
 
-    DBG("^^ M [%s|%s] Ru SIP request %s handled ^^\n",
-	req.callid.c_str(), req.to_tag.c_str(), req.method.c_str());
+    // 'req' is gone with the event: log from the message
+    DBG("^^ M [%.*s|%.*s] Ru SIP request %.*s handled ^^\n",
+	msg->callid->value.len, msg->callid->value.s,
+	get_to(msg)->tag.len, get_to(msg)->tag.s,
+	msg->u.request->method_str.len, msg->u.request->method_str.s);
 }
 
 void _SipCtrlInterface::handle_sip_reply(const string& dialog_id, sip_msg* msg)
@@ -793,8 +923,9 @@ void _SipCtrlInterface::handle_sip_reply(const string& dialog_id, sip_msg* msg)
     assert(msg->from && msg->from->p);
     assert(msg->to && msg->to->p);
     
-    AmSipReply   reply;
-
+    // converted straight into the event posted to the session
+    AmSipReplyEvent* ev = new AmSipReplyEvent();
+    AmSipReply& reply = ev->reply;
 
     if (! sip_msg2am_reply(msg, reply)) {
       ERROR("failed to convert sip_msg to AmSipReply\n");
@@ -806,7 +937,7 @@ void _SipCtrlInterface::handle_sip_reply(const string& dialog_id, sip_msg* msg)
       reply.callid = c2stlstr(msg->callid->value);
       reply.to_tag = c2stlstr(((sip_from_to*)msg->to->p)->tag);
       reply.from_tag  = c2stlstr(((sip_from_to*)msg->from->p)->tag);
-      AmSipDispatcher::instance()->handleSipMsg(dialog_id, reply);
+      AmSipDispatcher::instance()->handleSipMsg(dialog_id, ev);
       return;
     }
     
@@ -821,11 +952,14 @@ void _SipCtrlInterface::handle_sip_reply(const string& dialog_id, sip_msg* msg)
     DBG("hdrs = <%s>\n",reply.hdrs.c_str());
     DBG("body-ct = <%s>\n",reply.body.getCTStr().c_str());
 
-    AmSipDispatcher::instance()->handleSipMsg(dialog_id, reply);
+    AmSipDispatcher::instance()->handleSipMsg(dialog_id, ev);
 
-    DBG("^^ M [%s|%s] ru SIP reply %u %s handled ^^\n",
-	reply.callid.c_str(), reply.from_tag.c_str(),
-	reply.code, reply.reason.c_str());
+    // 'reply' is gone with the event: log from the message
+    DBG("^^ M [%.*s|%.*s] ru SIP reply %u %.*s handled ^^\n",
+	msg->callid->value.len, msg->callid->value.s,
+	get_from(msg)->tag.len, get_from(msg)->tag.s,
+	msg->u.reply->code,
+	msg->u.reply->reason.len, msg->u.reply->reason.s);
 }
 
 void _SipCtrlInterface::handle_reply_timeout(AmSipTimeoutEvent::EvType evt,
@@ -893,12 +1027,12 @@ void _SipCtrlInterface::handle_reply_timeout(AmSipTimeoutEvent::EvType evt,
 
 #undef DBG_PARAM
 
-void _SipCtrlInterface::prepare_routes_uac(const list<sip_header*>& routes, string& route_field)
+void _SipCtrlInterface::prepare_routes_uac(const sip_header_list& routes, string& route_field)
 {
     if(routes.empty())
 	return;
 	
-    list<sip_header*>::const_reverse_iterator it_rh = routes.rbegin();
+    sip_header_list::const_reverse_iterator it_rh = routes.rbegin();
     if(parse_route(*it_rh) < 0){
 	DBG("Could not parse route header [%.*s]\n",
 	    (*it_rh)->value.len,(*it_rh)->value.s);
@@ -906,7 +1040,7 @@ void _SipCtrlInterface::prepare_routes_uac(const list<sip_header*>& routes, stri
     }
     sip_route* route = (sip_route*)(*it_rh)->p;
 
-    list<route_elmt*>::const_reverse_iterator it_re = route->elmts.rbegin();
+    route_elmt_list::const_reverse_iterator it_re = route->elmts.rbegin();
     route_field = c2stlstr((*it_re)->route);
     
     while(true) {
@@ -933,11 +1067,11 @@ void _SipCtrlInterface::prepare_routes_uac(const list<sip_header*>& routes, stri
 
 }
 
-void _SipCtrlInterface::prepare_routes_uas(const list<sip_header*>& routes, string& route_field)
+void _SipCtrlInterface::prepare_routes_uas(const sip_header_list& routes, string& route_field)
 {
     if(!routes.empty()){
 	
-	list<sip_header*>::const_iterator it = routes.begin();
+	sip_header_list::const_iterator it = routes.begin();
 
 	route_field = c2stlstr((*it)->value);
 	++it;
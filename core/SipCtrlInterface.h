@@ -30,6 +30,7 @@
 #define _SipCtrlInterface_h_
 
 #include "sip/sip_ua.h"
+#include "sip/parse_header.h"
 #include "AmThread.h"
 
 #include <string>
@@ -41,7 +42,6 @@ class AmSipRequest;
 class AmSipReply;
 
 struct sip_msg;
-struct sip_header;
 class trans_ticket;
 
 
@@ -57,8 +57,8 @@ class _SipCtrlInterface:
     bool sip_msg2am_request(const sip_msg *msg, const trans_ticket& tt, AmSipRequest &request);
     bool sip_msg2am_reply(sip_msg *msg, AmSipReply &reply);
     
-    void prepare_routes_uac(const list<sip_header*>& routes, string& route_field);
-    void prepare_routes_uas(const list<sip_header*>& routes, string& route_field);
+    void prepare_routes_uac(const sip_header_list& routes, string& route_field);
+    void prepare_routes_uas(const sip_header_list& routes, string& route_field);
 
     friend class udp_trsp;
 
@@ -77,6 +77,7 @@ class _SipCtrlInterface:
     tcp_trsp**        tcp_servers;
 
     int alloc_udp_structs();
+    udp_trsp_socket* create_udp_socket(int if_num);
     int init_udp_servers(int if_num);
 
     int alloc_tcp_structs();
@@ -88,6 +89,10 @@ public:
     static unsigned int outbound_port;
     static bool log_parsed_messages;
     static int udp_rcvbuf;
+    /** one SO_REUSEPORT socket per SIP/UDP server thread */
+    static bool udp_reuseport;
+    /** distribute the messages over these sockets by CPU */
+    static bool udp_cpu_steering;
 
     _SipCtrlInterface();
     ~_SipCtrlInterface(){}
@@ -98,6 +103,9 @@ public:
     void stop();
     void cleanup();
 
+    /** datagrams dropped by the kernel on the SIP/UDP sockets so far */
+    unsigned int getRxDrops();
+
     /**
      * Sends a SIP request.
      *
@@ -104,6 +104,31 @@ rtp_low_port=10000
 # - sets highest for RTP used port 
 rtp_high_port=60000
 
+# optional parameter: rtp_port_quarantine=<milliseconds>
+#
+# - time a released RTP/RTCP port pair is kept out of use
+#   before it is handed out again, so that late packets of
+#   the previous call do not reach the new one. Port pool
+#   utilisation is available via the stats plug-in 
+#   ('get_rtpportstats').
+#   Default: 0 (released ports are reusable immediately)
+#
+# rtp_port_quarantine=5000
+
+# optional parameter: rtp_recv_batch=<num_value>
+#
+# - max. number of RTP packets read from a socket with one
+#   system call (recvmmsg) whenever it becomes readable
+#   (max. 32). 0 or 1 reads one packet at a time (default).
+#   Batch size statistics are available via the stats
+#   plug-in ('get_rtprecvstats').
+#   Packets relayed while processing a batch are sent with
+#   one system call (sendmmsg) per outgoing socket; the
+#   number of sending calls and packets is reported as
+#   'tx_calls' and 'tx_packets' by 'get_rtprecvstats'.
+#
+# rtp_recv_batch=8
+
 # Additional IFs (optional): 
 #   additional_interface = <list of interfaces>
 #
@@ -287,8 +312,96 @@ loglevel=2
 #   parameter to 1 (default), on MP systems to a higher
 #   value
 #
+#   Per thread tick statistics (late ticks, ticks taking longer
+#   than 10 ms, processing time and sessions per tick) are
+#   available via the stats plug-in ('get_mediastats').
+#
 # media_processor_threads=1
 
+# optional parameter: media_rebalance_interval=<seconds>
+#
+# - new call groups are assigned to the media processor thread
+#   with the lowest measured processing time. Every 
+#   media_rebalance_interval seconds, one call group is moved 
+#   from the most to the least loaded thread if their difference
+#   exceeds media_rebalance_threshold percent of the 10 ms tick.
+#   0 disables rebalancing.
+#   Default: 10 (seconds), threshold 10 (percent)
+#
+# media_rebalance_interval=10
+# media_rebalance_threshold=10
+
+# optional parameter: rtp_packet_pool_size=<num_value>
+#
+# - number of RTP receive buffers (1.5 kB each) preallocated per
+#   RTP receiver thread. RTP streams borrow their receive buffers 
+#   from this pool; it grows if it runs empty.
+#   Default: 1024
+#
+# rtp_packet_pool_size=4096
+
+# optional parameter: rtp_packet_quota=<num_value>
+#
+# - max. number of RTP receive buffers a single RTP stream may
+#   hold (max. 32). If reached, the oldest buffered packet is
+#   reused.
+#   Default: 16
+#
+# rtp_packet_quota=16
+
+# optional parameters: prompt_cache_populate=yes
+#                      prompt_cache_hugepages=yes
+#
+# - cached audio files (prompt collections etc.) are mapped
+#   read-only into memory, once per file however many modules
+#   load it. With prompt_cache_populate=yes, they are read in
+#   completely when loaded (MAP_POPULATE), not on first use.
+#   With prompt_cache_hugepages=yes, the kernel is asked to back
+#   them with transparent huge pages (MADV_HUGEPAGE; depends on
+#   the file system and kernel configuration).
+#   Default: no
+#
+# prompt_cache_populate=yes
+
+# optional parameter: timer_threads=<num_value>
+#
+# - number of timer wheels, each turned by its own thread, of the
+#   SIP stack (transaction timers, blacklist) and - as many again -
+#   of the application timers. The timers of a transaction (or
+#   event queue) always fire in the same thread; a timer taking
+#   long to fire only delays the timers of its wheel.
+#   Per thread statistics on how late the timers fire are
+#   available via the stats plug-in ('get_timerstats').
+#   Default: 2
+#
+# timer_threads=4
+
+# optional parameter: thread_affinity={none|numa}
+#
+# - numa: pin RTP receiver and media processor threads to the CPUs
+#   of a NUMA node, spreading them round robin over the nodes, so
+#   that every node runs receivers and media processors, and their
+#   packet buffers are allocated from node local memory.
+#   Calls are not placed by node: the RTP receiver and the media
+#   processor of a call share a node only by chance.
+#   Has no effect on hosts with a single NUMA node.
+#   Default: none (threads are not pinned)
+#
+# thread_affinity=numa
+
+# optional parameters: media_processor_cpus=<cpu list>
+#                      rtp_receiver_cpus=<cpu list>
+#                      sip_server_cpus=<cpu list>
+#                      session_processor_cpus=<cpu list>
+#
+# - restrict the threads of a class to a set of CPUs, e.g.
+#   "0-3,8" (format of taskset and /sys/devices/system/cpu).
+#   Overrides thread_affinity for that class.
+#   Default: not set (any CPU)
+#
+# media_processor_cpus=2-7
+# rtp_receiver_cpus=0,1
+
 
 # optional parameter: session_limit=<limit>;<err code>;<err reason>
 # 
@@ -323,6 +436,55 @@ loglevel=2
 # Example:
 #  cps_limit="100;503;Server overload"
 
+# optional parameters: overload_max_rx_drops=<num_value>
+#                      overload_max_sip_latency=<ms>
+#                      overload_max_event_backlog=<num_value>
+#                      overload_max_media_overruns=<num_value>
+#
+# - overload control, based on how far behind SEMS actually is:
+#   datagrams dropped per second by the kernel on the SIP/UDP
+#   sockets, average time from the reception of a SIP/UDP message
+#   until the transaction layer is done with it, events queued
+#   for the sessions but not processed yet, and media processor
+#   ticks per second which took longer than the tick interval.
+#   While one of them is above its limit, a growing share of new
+#   INVITE and REGISTER requests is rejected statelessly with
+#   '503 Server overload'; once all are below again, the share
+#   goes down. In-dialog requests are never rejected. Clients
+#   which support RFC 7339 (';oc' in their Via) get the share
+#   in the 'oc' Via parameter of the reply.
+#   The current values: 'get_overloadstats' (stats plug-in).
+#
+# Default: 0 (not used)
+#
+# Example:
+#  overload_max_rx_drops=100
+#  overload_max_sip_latency=200
+
+# optional parameter: overload_interval=<ms>
+#
+# - how often the overload signals are sampled; the share of
+#   rejected requests goes up by 20% per sample above a limit
+#   and down by 5% per sample below all limits.
+#
+# Default: 500
+
+# optional parameter: overload_retry_after=<seconds>
+#
+# - adds a Retry-After header to the overload replies. Note that
+#   upstream proxies may then stop sending any request to SEMS
+#   for that long.
+#
+# Default: 0 (no Retry-After)
+
+# optional parameter: overload_exempt_numbers=<user>[,<user>,...]
+#
+# - R-URI user parts (e.g. emergency numbers) which are never
+#   rejected on overload.
+#
+# Example:
+#  overload_exempt_numbers=112,911,sos
+
 # optional parameter: dead_rtp_time=<unsigned int>
 #
 # - if != 0, after this time (in seconds) of no RTP
@@ -388,6 +550,21 @@ use_default_signature=yes
 #
 # ignore_rtpxheaders=yes
 
+# optional parameter: resampling_library={internal|libsamplerate|polyphase}
+#
+# sets the implementation used to convert between sample rates.
+# 'polyphase' is a fixed-point filter for the ratios 2:1, 3:1, 6:1
+# and 441:480 (8/16/24/32/48 kHz, 44.1 kHz), which are the ones
+# commonly met with G.711, G.722 and Opus; other ratios are passed
+# to the internal resampler or libsamplerate, if compiled in.
+# 'internal' and 'libsamplerate' fall back to 'polyphase' if they
+# are not compiled in.
+#
+# default: internal (polyphase if neither internal resampler nor
+#          libsamplerate are compiled in)
+#
+# resampling_library=polyphase
+
 # optional parameter: dtmf_detector={spandsp|internal}
 #
 # sets inband DTMF detector to use. spandsp support must be compiled in
@@ -468,3 +645,67 @@ use_default_signature=yes
 # Default: 4
 #
 # sip_server_threads=8
+
+# SIP UDP sockets per interface
+#
+# - yes: every SIP UDP receiver thread (sip_server_threads) receives
+#   on its own socket, bound with SO_REUSEPORT to the interface's
+#   address, instead of all threads sharing one socket. The kernel
+#   distributes the messages over these sockets by hashing source
+#   and destination address, so that the messages of one peer are
+#   received by the same thread.
+#   Note: other sockets bound with SO_REUSEPORT to the same address
+#   by the same user will share the traffic.
+#
+# Default: no
+#
+# udp_reuseport = yes
+
+# Distribution of SIP UDP messages with udp_reuseport=yes
+#
+# - hash: by source and destination address (default)
+# - cpu:  by the CPU which received the message (the socket of
+#   thread n receives what CPUs n, n+sip_server_threads, ...
+#   received). Use together with NIC queue/IRQ affinity and
+#   sip_server_cpus.
+#
+# udp_reuseport_steering = cpu
+
+# Stateless keep-alive responder: [options][,notify] | no
+#
+# Answers keep-alive requests statelessly from the receiving thread,
+# without creating a transaction or involving the application:
+# - options: out-of-dialog OPTIONS (without user part in the R-URI,
+#   see stateless_keepalive_any_user)
+# - notify:  out-of-dialog NOTIFY with 'Event: keep-alive'
+# The reply is 200 OK (shutdown mode: the configured error code).
+# Not used for OPTIONS if options_session_limit or the transcoder
+# statistics headers are set.
+#
+# Default: no
+#
+# stateless_keepalive = options,notify
+
+# Answer OPTIONS to any R-URI statelessly? [yes|no]
+#
+# Default: no
+#
+# stateless_keepalive_any_user = yes
+
+# Max. keep-alives per second and source IP answered statelessly
+#
+# Requests above the rate are dropped. 0 disables the limit.
+#
+# Default: 10
+#
+# stateless_keepalive_rate = 20
+
+# Number of buckets of the SIP transaction table
+#
+# Transactions are hashed on Call-ID and CSeq number.
+# The occupancy and lock waits of the buckets are reported by the
+# stats interface (get_hashstats).
+#
+# Default: 1024
+#
+# trans_table_size = 8192
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program; if not, write to the Free Software 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "hash_table.h"
+#include "AmArg.h"
+
+#include <time.h>
+
+static unsigned long long monotonic_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void ht_lock::lock_contended()
+{
+    unsigned long long start = monotonic_us();
+    AmMutex::lock();
+
+    unsigned long long w = monotonic_us() - start;
+    locks++;
+    contended++;
+    wait_us += w;
+    if(w > max_wait_us)
+	max_wait_us = w;
+}
+
+void ht_lock::add_lock_stats(ht_stats& s) const
+{
+    s.locks += locks;
+    s.contended += contended;
+    s.wait_us += wait_us;
+    if(max_wait_us > s.max_wait_us)
+	s.max_wait_us = max_wait_us;
+}
+
+ht_stats::ht_stats()
+    : buckets(0), elements(0), max_occupancy(0),
+      locks(0), contended(0), wait_us(0), max_wait_us(0)
+{
+    for(int i=0; i<HT_OCC_SLOTS; i++)
+	occupancy[i] = 0;
+}
+
+void ht_stats::add_bucket(unsigned long elmts)
+{
+    buckets++;
+    elements += elmts;
+    if(elmts > max_occupancy)
+	max_occupancy = elmts;
+
+    if(elmts < 4)      occupancy[elmts]++;
+    else if(elmts < 8) occupancy[4]++;
+    else               occupancy[5]++;
+}
+
+void ht_stats::get(AmArg& ret) const
+{
+    ret["buckets"] = (long long)buckets;
+    ret["elements"] = (long long)elements;
+    ret["max_occupancy"] = (long long)max_occupancy;
+
+    AmArg& occ = ret["occupancy"];
+    occ["0"] = (long long)occupancy[0];
+    occ["1"] = (long long)occupancy[1];
+    occ["2"] = (long long)occupancy[2];
+    occ["3"] = (long long)occupancy[3];
+    occ["4-7"] = (long long)occupancy[4];
+    occ["8+"] = (long long)occupancy[5];
+
+    ret["locks"] = (long long)locks;
+    ret["contended"] = (long long)contended;
+    ret["avg_wait_us"] = contended ? (long long)(wait_us / contended) : 0LL;
+    ret["max_wait_us"] = (long long)max_wait_us;
+}
@@ -40,9 +40,67 @@ using std::list;
 using std::map;
 using std::less;
 
+class AmArg;
+
+// occupancy histogram: 0, 1, 2, 3, 4-7 and 8+ elements
+#define HT_OCC_SLOTS 6
+
+/**
+ * Statistics of a hash table (see hash_table::get_stats()).
+ */
+struct ht_stats
+{
+    unsigned long buckets;
+    unsigned long elements;
+    unsigned long max_occupancy;
+    unsigned long occupancy[HT_OCC_SLOTS];
+
+    // bucket locks
+    unsigned long long locks;
+    unsigned long long contended;
+    unsigned long long wait_us;
+    unsigned long long max_wait_us;
+
+    ht_stats();
+
+    void add_bucket(unsigned long elmts);
+    void get(AmArg& ret) const;
+};
+
+/**
+ * Bucket mutex counting how often lockers had to wait, and for how
+ * long. The counters are updated while holding the lock. Locking
+ * through the AmMutex interface (ex: AmLock) is not counted.
+ */
+class ht_lock: public AmMutex
+{
+    unsigned long long locks;
+    unsigned long long contended;
+    unsigned long long wait_us;
+    unsigned long long max_wait_us;
+
+    void lock_contended();
+
+public:
+    ht_lock()
+	: locks(0), contended(0),
+	  wait_us(0), max_wait_us(0)
+    {}
+
+    void lock() {
+	if(!trylock()) {
+	    lock_contended();
+	    return;
+	}
+	locks++;
+    }
+
+    void add_lock_stats(ht_stats& s) const;
+};
+
 
 template<class Value>
-class ht_bucket: public AmMutex
+class ht_bucket: public ht_lock
 {
 public:
     typedef list<Value*> value_list;
@@ -87,6 +145,11 @@ public:
 	return id;
     }
 
+    /** Number of elements (unlocked: approximate) */
+    unsigned long size() const {
+	return elmts.size();
+    }
+
     // debug method
     void dump() const {
 
@@ -151,7 +214,7 @@ public:
 template<class Key, class Value, 
 	 class ElmtAlloc = ht_delete<Value>,
 	 class ElmtCompare = less<Key> >
-class ht_map_bucket: public AmMutex
+class ht_map_bucket: public ht_lock
 {
 public:
     typedef map<Key,Value*,ElmtCompare> value_map;
@@ -217,6 +280,11 @@ public:
 	return id;
     }
 
+    /** Number of elements (unlocked: approximate) */
+    unsigned long size() const {
+	return elmts.size();
+    }
+
     // debug method
     void dump() const {
 
@@ -243,6 +311,125 @@ protected:
     value_map     elmts;
 };
 
+/**
+ * Links embedded into the values of an ht_ilist_bucket.
+ */
+template<class Value>
+struct ht_ilink
+{
+    Value* ht_prev;
+    Value* ht_next;
+
+    ht_ilink()
+	: ht_prev(NULL), ht_next(NULL)
+    {}
+};
+
+/**
+ * Bucket of an intrusive hash table: values (derived from
+ * ht_ilink<Value>) are chained through their own links, so that
+ * insertion and removal do not allocate and take constant time.
+ * The bucket owns its values.
+ */
+template<class Value>
+class ht_ilist_bucket: public ht_lock
+{
+public:
+    ht_ilist_bucket(unsigned long id)
+	: id(id), first(NULL), last(NULL), n_elmts(0)
+    {}
+
+    virtual ~ht_ilist_bucket() {
+	while(first) {
+	    Value* v = first;
+	    first = v->ht_next;
+	    delete v;
+	}
+    }
+
+    /**
+     * Caution: The bucket MUST be locked before you can 
+     * do anything with it.
+     */
+
+    /**
+     * Searches for the value ptr in this bucket.
+     * This is used to check if the value
+     * still exists (the pointer is not dereferenced).
+     *
+     * @return true if the value still exists.
+     */
+    bool exist(Value* t) {
+	for(Value* v = first; v; v = v->ht_next)
+	    if(v == t) return true;
+	return false;
+    }
+
+    /**
+     * Append the value to this bucket.
+     */
+    void push_back(Value* t) {
+	t->ht_prev = last;
+	t->ht_next = NULL;
+	if(last) last->ht_next = t;
+	else first = t;
+	last = t;
+	n_elmts++;
+    }
+
+    /**
+     * Remove the value from this bucket
+     * (must be part of it) without deleting it.
+     */
+    void unlink(Value* t) {
+	if(t->ht_prev) t->ht_prev->ht_next = t->ht_next;
+	else first = t->ht_next;
+	if(t->ht_next) t->ht_next->ht_prev = t->ht_prev;
+	else last = t->ht_prev;
+	t->ht_prev = t->ht_next = NULL;
+	n_elmts--;
+    }
+
+    /**
+     * Remove the value from this bucket,
+     * if it was still present.
+     */
+    void remove(Value* t) {
+	if(exist(t)) {
+	    unlink(t);
+	    delete t;
+	}
+    }
+
+    unsigned long get_id() const {
+	return id;
+    }
+
+    /** Number of elements (unlocked: approximate) */
+    unsigned long size() const {
+	return n_elmts;
+    }
+
+    // debug method
+    void dump() const {
+
+	if(!first)
+	    return;
+	
+	DBG("*** Bucket ID: %i ***\n",(int)get_id());
+	
+	for(const Value* v = first; v; v = v->ht_next) {
+	    v->dump();
+	}
+    }
+
+protected:
+    unsigned long  id;
+    Value*         first;
+    Value*         last;
+    unsigned long  n_elmts;
+};
+
 template<class Bucket>
 class hash_table
 {
@@ -281,6 +468,17 @@ public:
     }
 
     unsigned long get_size() { return size; }
+
+    /**
+     * Occupancy and lock statistics. The buckets are
+     * not locked: the numbers are approximate.
+     */
+    void get_stats(ht_stats& s) const {
+	for(unsigned long l=0; l<size; l++){
+	    s.add_bucket(_table[l]->size());
+	    _table[l]->add_lock_stats(s);
+	}
+    }
 };
 
 
@@ -35,8 +35,15 @@
 #include "log.h"
 #include "AmPlugIn.h"
 #include "AmApi.h"
+#include "AmRtpReceiver.h"
+#include "AmMediaProcessor.h"
+#include "AmAppTimer.h"
+#include "AmOverloadControl.h"
 
 #include "sip/trans_table.h"
+#include "sip/trans_layer.h"
+#include "sip/wheeltimer.h"
+#include "sip/resolver.h"
 
 #include <string>
 using std::string;
@@ -303,6 +310,13 @@ int StatsUDPServer::execute(char* msg_buf, string& reply,
       "get_callsmax                       -  get maximum of active calls since the last query\n"
       "get_cpsavg                         -  get calls per second (5 sec average)\n"
       "get_cpsmax                         -  get maximum of CPS since the last query\n"
+      "get_rtprecvstats                   -  get RTP receive/relay calls/packets and batch size histogram\n"
+      "get_rtpportstats                   -  get RTP port pool utilisation per media interface\n"
+      "get_mediastats                     -  get media processor tick timing/overruns per thread\n"
+      "get_timerstats                     -  get SIP/application timer fire lateness per thread\n"
+      "get_keepalivestats                 -  get statelessly answered/passed/dropped SIP keep-alives\n"
+      "get_hashstats                      -  get occupancy/lock waits of the transaction and DNS tables\n"
+      "get_overloadstats                  -  get overload signals and share of new requests rejected\n"
 
       "dump_transactions                  -  dump transaction table to log (loglevel debug)\n"
 
@@ -380,6 +394,57 @@ int StatsUDPServer::execute(char* msg_buf, string& reply,
       reply = "CPS hard limit: " + int2str(sc->getCPSLimit().first) + ", CPS limit: " +
         int2str(sc->getCPSLimit().second) + "\n";
 
+    else if (cmd_str.substr(4, 12) == "rtprecvstats") {
+      AmArg stats;
+      AmRtpReceiver::instance()->getRecvStats(stats);
+      reply = AmArg::print(stats) + "\n";
+    }
+
+    else if (cmd_str.substr(4, 10) == "mediastats") {
+      AmArg stats;
+      AmMediaProcessor::instance()->getStats(stats);
+      reply = AmArg::print(stats) + "\n";
+    }
+
+    else if (cmd_str.substr(4, 10) == "timerstats") {
+      AmArg stats;
+      wheeltimer::instance()->getStats(stats["sip"]);
+      AmAppTimer::instance()->getStats(stats["app"]);
+      reply = AmArg::print(stats) + "\n";
+    }
+
+    else if (cmd_str.substr(4, 9) == "hashstats") {
+      AmArg stats;
+      ht_stats trans_stats, dns_stats;
+      get_trans_table_stats(trans_stats);
+      resolver::instance()->get_cache_stats(dns_stats);
+      trans_stats.get(stats["transactions"]);
+      dns_stats.get(stats["dns_cache"]);
+      reply = AmArg::print(stats) + "\n";
+    }
+
+    else if (cmd_str.substr(4, 13) == "overloadstats") {
+      AmArg stats;
+      AmOverloadControl::instance()->getStats(stats);
+      reply = AmArg::print(stats) + "\n";
+    }
+
+    else if (cmd_str.substr(4, 14) == "keepalivestats") {
+      AmArg stats;
+      trans_layer::instance()->get_sl_responder().getStats(stats);
+      reply = AmArg::print(stats) + "\n";
+    }
+
+    else if (cmd_str.substr(4, 12) == "rtpportstats") {
+      for(unsigned int i=0; i<AmConfig::RTP_Ifs.size(); i++) {
+	unsigned int total, used, quarantined, failed;
+	AmConfig::RTP_Ifs[i].getRtpPortStats(total,used,quarantined,failed);
+	reply += "'" + AmConfig::RTP_Ifs[i].name + "': port pairs total " +
+	  int2str(total) + ", used " + int2str(used) + ", quarantined " +
+	  int2str(quarantined) + ", allocation failures " + int2str(failed) + "\n";
+      }
+    }
+
     else if (cmd_str.substr(4, 12) == "shutdownmode") {
       if(AmConfig::ShutdownMode)
 	{
@@ -2403,6 +2403,71 @@ uint8_t _st_14linear2ulaw[0x4000] = {
 
 #endif /* FAST_ULAW_CONVERSION */
 
+/*
+ * Bulk conversions. The loops are unrolled by four so that the
+ * lookups of consecutive samples do not depend on each other and the
+ * index computations may be vectorized by the compiler.
+ */
+void st_alaw2linear16_buf(int16_t* dst, const uint8_t* src, unsigned int n)
+{
+	unsigned int i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		int16_t s0 = st_alaw2linear16(src[i]);
+		int16_t s1 = st_alaw2linear16(src[i + 1]);
+		int16_t s2 = st_alaw2linear16(src[i + 2]);
+		int16_t s3 = st_alaw2linear16(src[i + 3]);
+		dst[i] = s0; dst[i + 1] = s1; dst[i + 2] = s2; dst[i + 3] = s3;
+	}
+	for (; i < n; i++)
+		dst[i] = st_alaw2linear16(src[i]);
+}
+
+void st_ulaw2linear16_buf(int16_t* dst, const uint8_t* src, unsigned int n)
+{
+	unsigned int i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		int16_t s0 = st_ulaw2linear16(src[i]);
+		int16_t s1 = st_ulaw2linear16(src[i + 1]);
+		int16_t s2 = st_ulaw2linear16(src[i + 2]);
+		int16_t s3 = st_ulaw2linear16(src[i + 3]);
+		dst[i] = s0; dst[i + 1] = s1; dst[i + 2] = s2; dst[i + 3] = s3;
+	}
+	for (; i < n; i++)
+		dst[i] = st_ulaw2linear16(src[i]);
+}
+
+void st_linear162alaw_buf(uint8_t* dst, const int16_t* src, unsigned int n)
+{
+	unsigned int i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		uint8_t a0 = st_13linear2alaw(src[i] >> 3);
+		uint8_t a1 = st_13linear2alaw(src[i + 1] >> 3);
+		uint8_t a2 = st_13linear2alaw(src[i + 2] >> 3);
+		uint8_t a3 = st_13linear2alaw(src[i + 3] >> 3);
+		dst[i] = a0; dst[i + 1] = a1; dst[i + 2] = a2; dst[i + 3] = a3;
+	}
+	for (; i < n; i++)
+		dst[i] = st_13linear2alaw(src[i] >> 3);
+}
+
+void st_linear162ulaw_buf(uint8_t* dst, const int16_t* src, unsigned int n)
+{
+	unsigned int i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		uint8_t u0 = st_14linear2ulaw(src[i] >> 2);
+		uint8_t u1 = st_14linear2ulaw(src[i + 1] >> 2);
+		uint8_t u2 = st_14linear2ulaw(src[i + 2] >> 2);
+		uint8_t u3 = st_14linear2ulaw(src[i + 3] >> 2);
+		dst[i] = u0; dst[i + 1] = u1; dst[i + 2] = u2; dst[i + 3] = u3;
+	}
+	for (; i < n; i++)
+		dst[i] = st_14linear2ulaw(src[i] >> 2);
+}
+
 /* The following code was used to generate the lookup tables */
 #if 0
 int main()
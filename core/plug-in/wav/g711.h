@@ -10,15 +10,22 @@
 ** implied warranty.
 */
 
+#ifndef _G711_H_
+#define _G711_H_
+
 #include <inttypes.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define FAST_ALAW_CONVERSION
 #define FAST_ULAW_CONVERSION
 
 #ifdef FAST_ALAW_CONVERSION
 extern uint8_t _st_13linear2alaw[0x2000];
 extern int16_t _st_alaw2linear16[256];
-#define st_13linear2alaw(sw) (_st_13linear2alaw[(sw + 0x1000)])
+#define st_13linear2alaw(sw) (_st_13linear2alaw[((sw) + 0x1000)])
 #define st_alaw2linear16(uc) (_st_alaw2linear16[uc])
 #else
 unsigned char st_13linear2alaw(int16_t pcm_val); /*  REGPARM(1); */
@@ -28,11 +35,25 @@ int16_t st_alaw2linear16(unsigned char); /*  REGPARM(1); */
 #ifdef FAST_ULAW_CONVERSION
 extern uint8_t _st_14linear2ulaw[0x4000];
 extern int16_t _st_ulaw2linear16[256];
-#define st_14linear2ulaw(sw) (_st_14linear2ulaw[(sw + 0x2000)])
+#define st_14linear2ulaw(sw) (_st_14linear2ulaw[((sw) + 0x2000)])
 #define st_ulaw2linear16(uc) (_st_ulaw2linear16[uc])
 #else
 unsigned char st_14linear2ulaw(int16_t pcm_val); /*  REGPARM(1); */
 int16_t st_ulaw2linear16(unsigned char); /*  REGPARM(1); */
 #endif
 
+/*
+ * Bulk conversion of 'n' samples between 16 bit linear PCM and
+ * A-law/u-law, using the conversions above. Input and output must not
+ * overlap.
+ */
+void st_alaw2linear16_buf(int16_t* dst, const uint8_t* src, unsigned int n);
+void st_ulaw2linear16_buf(int16_t* dst, const uint8_t* src, unsigned int n);
+void st_linear162alaw_buf(uint8_t* dst, const int16_t* src, unsigned int n);
+void st_linear162ulaw_buf(uint8_t* dst, const int16_t* src, unsigned int n);
+
+#ifdef __cplusplus
+}
+#endif
 
+#endif /* _G711_H_ */
@@ -31,6 +31,8 @@
 #include "AmPlugIn.h"
 #include "AmSessionContainer.h"
 #include "AmMediaProcessor.h"
+#include "AmPolyphaseResampler.h"
+#include "AmOverloadControl.h"
 #include "AmRtpReceiver.h"
 #include "AmEventDispatcher.h"
 #include "AmSessionProcessor.h"
@@ -596,6 +598,9 @@ int main(int argc, char* argv[])
   INFO("Starting media processor\n");
   AmMediaProcessor::instance()->init();
 
+  if (AmConfig::ResamplingImplementationType == AmAudio::POLYPHASE_RESAMPLER)
+    AmPolyphaseResampler::init();
+
   // init thread usage with libevent
   // before it's too late
   if(evthread_use_pthreads() != 0) {
@@ -613,6 +618,8 @@ int main(int argc, char* argv[])
   if(sip_ctrl.load()) {
     goto error;
   }
+
+  AmOverloadControl::instance()->init();
   
   INFO("Loading plug-ins\n");
   AmPlugIn::instance()->init();
@@ -637,6 +644,8 @@ int main(int argc, char* argv[])
   if(sip_ctrl.run() != -1)
     success = true;
 
+  AmOverloadControl::dispose();
+
   // session container stops active sessions
   INFO("Disposing session container\n");
   AmSessionContainer::dispose();
@@ -655,6 +664,8 @@ int main(int argc, char* argv[])
   AmEventDispatcher::dispose();
 
  error:
+  AmOverloadControl::dispose();
+
   INFO("Disposing plug-ins\n");
   AmPlugIn::dispose();
 
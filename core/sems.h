@@ -61,10 +61,22 @@
 #define NUM_SESSION_PROCESSORS 10
 // threads to start for RTP processing
 #define NUM_MEDIA_PROCESSORS 1
+// seconds between media processor load rebalancing runs (0: off)
+#define MEDIA_REBALANCE_INTERVAL 10
+// min. load difference to rebalance media processors (% of a tick)
+#define MEDIA_REBALANCE_THRESHOLD 10
+// ms between overload control samples
+#define OVERLOAD_INTERVAL 500
 // number of RTP receiver threads
 #define NUM_RTP_RECEIVERS 1
+// RTP receive buffers preallocated per RTP receiver thread
+#define RTP_PACKET_POOL_SIZE 1024
+// max. RTP receive buffers held by one stream
+#define RTP_PACKET_QUOTA 16
 // number of SIP servers to start
 #define NUM_SIP_SERVERS 4
+// timer wheels (threads) of the SIP stack and of the application timers each
+#define NUM_TIMER_THREADS 2
 
 #define MAX_NET_DEVICES     32
 
@@ -0,0 +1,581 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "dns_client.h"
+#include "ip_util.h"
+
+#include "AmUtils.h"
+#include "log.h"
+
+#include <event2/event.h>
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+
+#include <netinet/in.h>
+#include <resolv.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+#if defined(__linux__) && defined(__GLIBC__) && \
+    ((__GLIBC__ > 2) || (__GLIBC_MINOR__ >= 25))
+#include <sys/random.h>
+#define HAVE_GETRANDOM
+#endif
+
+// DNS header length
+#define DNS_HDR_LEN 12
+
+// larger than any answer without EDNS0
+#define DNS_UDP_BUF_SIZE 4096
+
+// wakeup commands
+#define WAKEUP_QUERY 'q'
+#define WAKEUP_STOP  's'
+
+struct dns_query
+{
+    dns_client*      client;
+
+    string           key;
+    string           name;
+    dns_rr_type      type;
+
+    unsigned short   id;
+    u_char           msg[NS_PACKETSZ];
+    int              msg_len;
+
+    int              attempt;
+    sockaddr_storage server;
+
+    // fresh socket (and source port) for every attempt
+    int                 udp_sd;
+    struct event*       ev_udp;
+
+    struct event*       ev_timer;
+    struct bufferevent* tcp;
+
+    // guarded by dns_client::q_mut
+    list<dns_query_cb*> cbs;
+
+    dns_query(dns_client* client, const string& key,
+	      const string& name, dns_rr_type type)
+	: client(client), key(key), name(name), type(type),
+	  id(0), msg_len(0), attempt(0),
+	  udp_sd(-1), ev_udp(NULL),
+	  ev_timer(NULL), tcp(NULL)
+    {
+	memset(&server,0,sizeof(sockaddr_storage));
+    }
+
+    ~dns_query()
+    {
+	if(ev_timer)
+	    event_free(ev_timer);
+    }
+};
+
+static bool same_sa(const sockaddr_storage* l, const sockaddr_storage* r)
+{
+    if(l->ss_family != r->ss_family)
+	return false;
+
+    if(l->ss_family == AF_INET) {
+	const sockaddr_in* l4 = (const sockaddr_in*)l;
+	const sockaddr_in* r4 = (const sockaddr_in*)r;
+	return (l4->sin_port == r4->sin_port) &&
+	    !memcmp(&l4->sin_addr,&r4->sin_addr,sizeof(in_addr));
+    }
+
+    const sockaddr_in6* l6 = (const sockaddr_in6*)l;
+    const sockaddr_in6* r6 = (const sockaddr_in6*)r;
+    return (l6->sin6_port == r6->sin6_port) &&
+	!memcmp(&l6->sin6_addr,&r6->sin6_addr,sizeof(in6_addr));
+}
+
+// IDs must not be predictable (RFC 5452, 9.2)
+static unsigned short random_id()
+{
+    unsigned short id;
+#ifdef HAVE_GETRANDOM
+    if(getrandom(&id,sizeof(id),0) == sizeof(id))
+	return id;
+#endif
+    return get_random() & 0xFFFF;
+}
+
+// question names come without the trailing dot
+static bool same_name(const char* n, const string& name)
+{
+    size_t len = name.length();
+    if(len && (name[len-1] == '.'))
+	len--;
+
+    return (strlen(n) == len) && !strncasecmp(n,name.c_str(),len);
+}
+
+dns_client::dns_client(dns_answer_handler* handler)
+    : handler(handler), evbase(NULL), ev_wakeup(NULL)
+{
+    wakeup_fds[0] = wakeup_fds[1] = -1;
+
+    evbase = event_base_new();
+
+    if(pipe(wakeup_fds) < 0) {
+	ERROR("pipe(): %s",strerror(errno));
+    }
+    else {
+	fcntl(wakeup_fds[0],F_SETFL,O_NONBLOCK);
+	fcntl(wakeup_fds[1],F_SETFL,O_NONBLOCK);
+
+	ev_wakeup = event_new(evbase,wakeup_fds[0],EV_READ|EV_PERSIST,
+			      wakeup_cb,this);
+	event_add(ev_wakeup,NULL);
+    }
+
+    // name servers from /etc/resolv.conf
+    res_init();
+    for(int i=0; i<_res.nscount; i++) {
+
+	if(_res.nsaddr_list[i].sin_family != AF_INET)
+	    continue;
+
+	sockaddr_storage sa;
+	memset(&sa,0,sizeof(sockaddr_storage));
+	memcpy(&sa,&_res.nsaddr_list[i],sizeof(sockaddr_in));
+	servers.push_back(sa);
+    }
+
+    if(servers.empty()) {
+	sockaddr_storage sa;
+	memset(&sa,0,sizeof(sockaddr_storage));
+	am_inet_pton("127.0.0.1",&sa);
+	am_set_port(&sa,NS_DEFAULTPORT);
+	servers.push_back(sa);
+    }
+}
+
+dns_client::~dns_client()
+{
+    for(map<string,dns_query*>::iterator it = queries.begin();
+	it != queries.end(); ++it) {
+
+	dns_query* q = it->second;
+	for(list<dns_query_cb*>::iterator cb_it = q->cbs.begin();
+	    cb_it != q->cbs.end(); ++cb_it) {
+	    dec_ref(*cb_it);
+	}
+	stop_udp(q);
+	stop_tcp(q);
+	delete q;
+    }
+
+    if(ev_wakeup) event_free(ev_wakeup);
+    if(wakeup_fds[0] >= 0) close(wakeup_fds[0]);
+    if(wakeup_fds[1] >= 0) close(wakeup_fds[1]);
+
+    if(evbase) event_base_free(evbase);
+}
+
+void dns_client::set_servers(const vector<sockaddr_storage>& new_servers)
+{
+    q_mut.lock();
+    servers = new_servers;
+    q_mut.unlock();
+}
+
+void dns_client::query(const string& name, dns_rr_type t, dns_query_cb* cb)
+{
+    string key = string(dns_rr_type_str(t)) + " " + name;
+    bool new_query = false;
+
+    q_mut.lock();
+    dns_query* q = NULL;
+    map<string,dns_query*>::iterator it = queries.find(key);
+    if(it != queries.end()) {
+	DBG("joining running query for '%s' (%s)",
+	    name.c_str(),dns_rr_type_str(t));
+	q = it->second;
+    }
+    else {
+	q = new dns_query(this,key,name,t);
+	queries[key] = q;
+	new_queries.push_back(q);
+	new_query = true;
+    }
+
+    if(cb) {
+	inc_ref(cb);
+	q->cbs.push_back(cb);
+    }
+    q_mut.unlock();
+
+    if(new_query) {
+	char c = WAKEUP_QUERY;
+	if((write(wakeup_fds[1],&c,1) < 0) && (errno != EAGAIN)) {
+	    ERROR("write(): %s",strerror(errno));
+	}
+    }
+}
+
+void dns_client::loop()
+{
+    event_base_dispatch(evbase);
+}
+
+void dns_client::stop()
+{
+    char c = WAKEUP_STOP;
+    if(write(wakeup_fds[1],&c,1) < 0) {
+	ERROR("write(): %s",strerror(errno));
+    }
+}
+
+void dns_client::wakeup_cb(int sd, short what, void* arg)
+{
+    dns_client* c = (dns_client*)arg;
+
+    char buf[64];
+    int len;
+    while((len = read(sd,buf,sizeof(buf))) > 0) {
+	if(memchr(buf,WAKEUP_STOP,len)) {
+	    event_base_loopbreak(c->evbase);
+	    return;
+	}
+    }
+
+    list<dns_query*> new_queries;
+    c->q_mut.lock();
+    new_queries.swap(c->new_queries);
+    c->q_mut.unlock();
+
+    for(list<dns_query*>::iterator it = new_queries.begin();
+	it != new_queries.end(); ++it) {
+	c->start_query(*it);
+    }
+}
+
+int dns_client::start_udp(dns_query* q)
+{
+    stop_udp(q);
+
+    // not bound: the kernel picks a random ephemeral port
+    int sd = socket(q->server.ss_family,SOCK_DGRAM,0);
+    if(sd < 0) {
+	ERROR("socket(): %s",strerror(errno));
+	return -1;
+    }
+    fcntl(sd,F_SETFL,O_NONBLOCK);
+
+    q->ev_udp = event_new(evbase,sd,EV_READ|EV_PERSIST,udp_read_cb,q);
+    event_add(q->ev_udp,NULL);
+
+    q->udp_sd = sd;
+    return sd;
+}
+
+void dns_client::stop_udp(dns_query* q)
+{
+    if(q->ev_udp) {
+	event_free(q->ev_udp);
+	q->ev_udp = NULL;
+    }
+    if(q->udp_sd >= 0) {
+	close(q->udp_sd);
+	q->udp_sd = -1;
+    }
+}
+
+void dns_client::start_query(dns_query* q)
+{
+    q->msg_len = dns_msg_query(q->msg,NS_PACKETSZ,0,
+			       q->name.c_str(),q->type);
+    if(q->msg_len < 0) {
+	ERROR("invalid DNS name '%s'",q->name.c_str());
+	finish(q,NULL,0);
+	return;
+    }
+
+    q->ev_timer = evtimer_new(evbase,timer_cb,q);
+
+    DBG("Querying '%s' (%s)...",q->name.c_str(),dns_rr_type_str(q->type));
+    send_query(q);
+}
+
+void dns_client::send_query(dns_query* q)
+{
+    q_mut.lock();
+    if(servers.empty()) {
+	q_mut.unlock();
+	ERROR("no DNS server configured");
+	finish(q,NULL,0);
+	return;
+    }
+    q->server = servers[q->attempt % servers.size()];
+    q_mut.unlock();
+
+    // new ID for every attempt
+    q->id = random_id();
+    q->msg[0] = (u_char)(q->id >> 8);
+    q->msg[1] = (u_char)(q->id & 0xFF);
+
+    int sd = start_udp(q);
+    if(sd < 0) {
+	next_attempt(q);
+	return;
+    }
+
+    if(sendto(sd,q->msg,q->msg_len,0,(const sockaddr*)&q->server,
+	      SA_len(&q->server)) < 0) {
+	DBG("sendto(%s): %s",am_inet_ntop(&q->server).c_str(),
+	    strerror(errno));
+	next_attempt(q);
+	return;
+    }
+
+    int ms = DNS_RETRANS_TIMEOUT << q->attempt;
+    struct timeval tv;
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    evtimer_add(q->ev_timer,&tv);
+}
+
+void dns_client::next_attempt(dns_query* q)
+{
+    stop_udp(q);
+    stop_tcp(q);
+    evtimer_del(q->ev_timer);
+
+    if(++q->attempt >= DNS_MAX_ATTEMPTS) {
+	DBG("no answer for '%s' (%s)",
+	    q->name.c_str(),dns_rr_type_str(q->type));
+	finish(q,NULL,0);
+	return;
+    }
+
+    send_query(q);
+}
+
+void dns_client::timer_cb(int sd, short what, void* arg)
+{
+    dns_query* q = (dns_query*)arg;
+    DBG("DNS query for '%s' timed out (server %s)",
+	q->name.c_str(),am_inet_ntop(&q->server).c_str());
+    q->client->next_attempt(q);
+}
+
+void dns_client::udp_read_cb(int sd, short what, void* arg)
+{
+    dns_query* q = (dns_query*)arg;
+
+    u_char buf[DNS_UDP_BUF_SIZE];
+    sockaddr_storage from;
+    socklen_t from_len;
+
+    for(;;) {
+	from_len = sizeof(sockaddr_storage);
+	int len = recvfrom(sd,buf,DNS_UDP_BUF_SIZE,0,
+			   (sockaddr*)&from,&from_len);
+	if(len < 0) {
+	    if((errno != EAGAIN) && (errno != EWOULDBLOCK))
+		DBG("recvfrom(): %s",strerror(errno));
+	    break;
+	}
+
+	if(len < DNS_HDR_LEN)
+	    continue;
+
+	if(!same_sa(&from,&q->server)) {
+	    DBG("DNS answer from unexpected source %s",
+		am_inet_ntop(&from).c_str());
+	    continue;
+	}
+
+	if(dns_msg_id(buf) != q->id) {
+	    DBG("DNS answer with wrong ID (id=%u)",dns_msg_id(buf));
+	    continue;
+	}
+
+	// might close the socket or free 'q'
+	q->client->answer(q,buf,len);
+	return;
+    }
+}
+
+void dns_client::answer(dns_query* q, u_char* msg, int len)
+{
+    char name[NS_MAXDNAME];
+    unsigned short type = 0;
+
+    // QR bit, and the question must match ours
+    if(!(msg[2] & 0x80) ||
+       dns_msg_question(msg,len,name,NS_MAXDNAME,&type) ||
+       (type != q->type) || !same_name(name,q->name)) {
+	DBG("DNS answer does not match query for '%s' (%s)",
+	    q->name.c_str(),dns_rr_type_str(q->type));
+	return;
+    }
+
+    if(dns_msg_tc(msg) && !q->tcp) {
+	DBG("truncated answer for '%s' (%s): retrying over TCP",
+	    q->name.c_str(),dns_rr_type_str(q->type));
+	start_tcp(q);
+	return;
+    }
+
+    switch(dns_msg_rcode(msg)) {
+    case ns_r_noerror:
+    case ns_r_nxdomain:
+	finish(q,msg,len);
+	break;
+
+    default:
+	// SERVFAIL, REFUSED, ...: ask the next server
+	DBG("DNS server %s failed on '%s' (%s): rcode=%i",
+	    am_inet_ntop(&q->server).c_str(),q->name.c_str(),
+	    dns_rr_type_str(q->type),dns_msg_rcode(msg));
+	next_attempt(q);
+	break;
+    }
+}
+
+void dns_client::start_tcp(dns_query* q)
+{
+    stop_udp(q);
+    evtimer_del(q->ev_timer);
+
+    q->tcp = bufferevent_socket_new(evbase,-1,BEV_OPT_CLOSE_ON_FREE);
+    if(!q->tcp) {
+	ERROR("bufferevent_socket_new() failed");
+	next_attempt(q);
+	return;
+    }
+
+    if(bufferevent_socket_connect(q->tcp,(sockaddr*)&q->server,
+				  SA_len(&q->server)) < 0) {
+	DBG("could not connect to DNS server %s",
+	    am_inet_ntop(&q->server).c_str());
+	next_attempt(q);
+	return;
+    }
+
+    bufferevent_setcb(q->tcp,tcp_read_cb,NULL,tcp_event_cb,q);
+    bufferevent_enable(q->tcp,EV_READ|EV_WRITE);
+
+    // two bytes length prefix (RFC 1035, 4.2.2)
+    u_char len_buf[2];
+    len_buf[0] = (u_char)(q->msg_len >> 8);
+    len_buf[1] = (u_char)(q->msg_len & 0xFF);
+    bufferevent_write(q->tcp,len_buf,2);
+    bufferevent_write(q->tcp,q->msg,q->msg_len);
+
+    struct timeval tv;
+    tv.tv_sec = DNS_TCP_TIMEOUT / 1000;
+    tv.tv_usec = (DNS_TCP_TIMEOUT % 1000) * 1000;
+    evtimer_add(q->ev_timer,&tv);
+}
+
+void dns_client::stop_tcp(dns_query* q)
+{
+    if(q->tcp) {
+	bufferevent_free(q->tcp);
+	q->tcp = NULL;
+    }
+}
+
+void dns_client::tcp_read_cb(struct bufferevent* bev, void* arg)
+{
+    dns_query* q = (dns_query*)arg;
+    struct evbuffer* in = bufferevent_get_input(bev);
+
+    u_char len_buf[2];
+    if(evbuffer_copyout(in,len_buf,2) < 2)
+	return;
+
+    size_t len = ((size_t)len_buf[0] << 8) | len_buf[1];
+    if(evbuffer_get_length(in) < len + 2)
+	return;
+
+    // copy it out: the connection is closed while processing the answer
+    vector<u_char> msg(len + 1);
+    evbuffer_drain(in,2);
+    evbuffer_remove(in,&msg[0],len);
+
+    if((len < DNS_HDR_LEN) || (dns_msg_id(&msg[0]) != q->id)) {
+	DBG("invalid DNS answer over TCP from %s",
+	    am_inet_ntop(&q->server).c_str());
+	q->client->next_attempt(q);
+	return;
+    }
+
+    q->client->answer(q,&msg[0],len);
+}
+
+void dns_client::tcp_event_cb(struct bufferevent* bev, short what, void* arg)
+{
+    dns_query* q = (dns_query*)arg;
+
+    if(what & (BEV_EVENT_ERROR|BEV_EVENT_EOF)) {
+	DBG("TCP connection to DNS server %s failed",
+	    am_inet_ntop(&q->server).c_str());
+	q->client->next_attempt(q);
+    }
+}
+
+void dns_client::finish(dns_query* q, u_char* msg, int len)
+{
+    stop_udp(q);
+    stop_tcp(q);
+    if(q->ev_timer)
+	evtimer_del(q->ev_timer);
+
+    int err = handler->dns_answer(q->name,q->type,msg,len);
+
+    // whoever joins from now on finds the result in the cache
+    list<dns_query_cb*> cbs;
+    q_mut.lock();
+    queries.erase(q->key);
+    cbs.swap(q->cbs);
+    q_mut.unlock();
+
+    for(list<dns_query_cb*>::iterator it = cbs.begin();
+	it != cbs.end(); ++it) {
+	(*it)->dns_resolved(q->name,q->type,err);
+	dec_ref(*it);
+    }
+
+    delete q;
+}
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset: 4
+ * End:
+ */
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef _dns_client_h_
+#define _dns_client_h_
+
+#include "atomic_types.h"
+#include "parse_dns.h"
+#include "AmThread.h"
+
+#include <sys/socket.h>
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+using std::string;
+using std::vector;
+using std::list;
+using std::map;
+
+struct event_base;
+struct event;
+struct bufferevent;
+
+/* attempts (over all servers) before a query fails */
+#define DNS_MAX_ATTEMPTS 4
+
+/* in ms; doubled with every attempt */
+#define DNS_RETRANS_TIMEOUT 500
+
+/* in ms; for the whole TCP exchange */
+#define DNS_TCP_TIMEOUT 2000
+
+/**
+ * Completion handler of an asynchronous query.
+ */
+class dns_query_cb
+    : public atomic_ref_cnt
+{
+public:
+    /**
+     * Called from the resolver thread once the query is over.
+     * @param err 0 if the result (positive or negative)
+     *            has been cached, -1 otherwise.
+     */
+    virtual void dns_resolved(const string& name, dns_rr_type t, int err)=0;
+};
+
+/**
+ * Receives the answers of a dns_client.
+ */
+class dns_answer_handler
+{
+public:
+    virtual ~dns_answer_handler() {}
+
+    /**
+     * Process the answer to a query ('msg' is NULL
+     * if no server answered).
+     * @return 0 if the result has been cached.
+     */
+    virtual int dns_answer(const string& name, dns_rr_type t,
+			   u_char* msg, int len)=0;
+};
+
+struct dns_query;
+
+/**
+ * Stub resolver speaking DNS over UDP (and TCP, for
+ * truncated answers) on a libevent base.
+ *
+ * Every attempt is sent from a new UDP socket (random source
+ * port) with a random ID; answers must come from the server
+ * queried, with that ID and the question asked (RFC 5452).
+ *
+ * query() may be called from any thread; everything else
+ * runs in the thread calling loop().
+ */
+class dns_client
+{
+    dns_answer_handler* handler;
+
+    struct event_base* evbase;
+    struct event*      ev_wakeup;
+    int                wakeup_fds[2];
+
+    AmMutex                        q_mut;
+    vector<sockaddr_storage>       servers;
+    map<string,dns_query*>         queries;     // by type & name
+    list<dns_query*>               new_queries;
+
+    int  start_udp(dns_query* q);
+    void stop_udp(dns_query* q);
+    void start_query(dns_query* q);
+    void send_query(dns_query* q);
+    void next_attempt(dns_query* q);
+    void start_tcp(dns_query* q);
+    void stop_tcp(dns_query* q);
+    void answer(dns_query* q, u_char* msg, int len);
+    void finish(dns_query* q, u_char* msg, int len);
+
+    static void wakeup_cb(int sd, short what, void* arg);
+    static void udp_read_cb(int sd, short what, void* arg);
+    static void timer_cb(int sd, short what, void* arg);
+    static void tcp_read_cb(struct bufferevent* bev, void* arg);
+    static void tcp_event_cb(struct bufferevent* bev, short what, void* arg);
+
+public:
+    dns_client(dns_answer_handler* handler);
+    ~dns_client();
+
+    /** Servers to query, in order of preference. */
+    void set_servers(const vector<sockaddr_storage>& servers);
+
+    /**
+     * Start a query for 'name', or join the identical query
+     * already running. 'cb' (may be NULL) is referenced
+     * until it has been called.
+     */
+    void query(const string& name, dns_rr_type t, dns_query_cb* cb);
+
+    struct event_base* get_evbase() { return evbase; }
+
+    /** Run the event loop until stop() is called. */
+    void loop();
+    void stop();
+};
+
+#endif
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset: 4
+ * End:
+ */
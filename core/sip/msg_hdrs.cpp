@@ -31,11 +31,11 @@
 #include "msg_hdrs.h"
 
 
-int copy_hdrs_len(const list<sip_header*>& hdrs)
+int copy_hdrs_len(const sip_header_list& hdrs)
 {
     int ret = 0;
 
-    list<sip_header*>::const_iterator it = hdrs.begin();
+    sip_header_list::const_iterator it = hdrs.begin();
     for(;it != hdrs.end(); ++it){
 	ret += copy_hdr_len(*it);
     }
@@ -43,11 +43,11 @@ int copy_hdrs_len(const list<sip_header*>& hdrs)
     return ret;
 }
 
-int  copy_hdrs_len_no_via(const list<sip_header*>& hdrs)
+int  copy_hdrs_len_no_via(const sip_header_list& hdrs)
 {
     int ret = 0;
 
-    list<sip_header*>::const_iterator it = hdrs.begin();
+    sip_header_list::const_iterator it = hdrs.begin();
     for(;it != hdrs.end(); ++it){
 
         if((*it)->type == sip_header::H_VIA)
@@ -59,11 +59,11 @@ int  copy_hdrs_len_no_via(const list<sip_header*>& hdrs)
     return ret;
 }
 
-int  copy_hdrs_len_no_via_contact(const list<sip_header*>& hdrs)
+int  copy_hdrs_len_no_via_contact(const sip_header_list& hdrs)
 {
     int ret = 0;
 
-    list<sip_header*>::const_iterator it = hdrs.begin();
+    sip_header_list::const_iterator it = hdrs.begin();
     for(;it != hdrs.end(); ++it){
 
       switch((*it)->type) {
@@ -80,16 +80,16 @@ int  copy_hdrs_len_no_via_contact(const list<sip_header*>& hdrs)
     return ret;
 }
 
-void copy_hdrs_wr(char** c, const list<sip_header*>& hdrs)
+void copy_hdrs_wr(char** c, const sip_header_list& hdrs)
 {
-    list<sip_header*>::const_iterator it = hdrs.begin();
+    sip_header_list::const_iterator it = hdrs.begin();
     for(;it != hdrs.end(); ++it)
         copy_hdr_wr(c,*it);
 }
 
-void copy_hdrs_wr_no_via(char** c, const list<sip_header*>& hdrs)
+void copy_hdrs_wr_no_via(char** c, const sip_header_list& hdrs)
 {
-    list<sip_header*>::const_iterator it = hdrs.begin();
+    sip_header_list::const_iterator it = hdrs.begin();
     for(;it != hdrs.end(); ++it) {
 
         if((*it)->type == sip_header::H_VIA)
@@ -99,9 +99,9 @@ void copy_hdrs_wr_no_via(char** c, const list<sip_header*>& hdrs)
     }
 }
 
-void copy_hdrs_wr_no_via_contact(char** c, const list<sip_header*>& hdrs)
+void copy_hdrs_wr_no_via_contact(char** c, const sip_header_list& hdrs)
 {
-    list<sip_header*>::const_iterator it = hdrs.begin();
+    sip_header_list::const_iterator it = hdrs.begin();
     for(;it != hdrs.end(); ++it){
 
       switch((*it)->type) {
@@ -178,12 +178,12 @@ inline void content_type_wr(char** c, const cstring& len)
 using std::list;
 
 
-int  copy_hdrs_len(const list<sip_header*>& hdrs);
-int  copy_hdrs_len_no_via_contact(const list<sip_header*>& hdrs);
+int  copy_hdrs_len(const sip_header_list& hdrs);
+int  copy_hdrs_len_no_via_contact(const sip_header_list& hdrs);
 
-void copy_hdrs_wr(char** c, const list<sip_header*>& hdrs);
-void copy_hdrs_wr_no_via(char** c, const list<sip_header*>& hdrs);
-void copy_hdrs_wr_no_via_contact(char** c, const list<sip_header*>& hdrs);
+void copy_hdrs_wr(char** c, const sip_header_list& hdrs);
+void copy_hdrs_wr_no_via(char** c, const sip_header_list& hdrs);
+void copy_hdrs_wr_no_via_contact(char** c, const sip_header_list& hdrs);
 
 
 #endif
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "overload_filter.h"
+#include "sip_parser.h"
+#include "parse_header.h"
+#include "parse_from_to.h"
+#include "parse_via.h"
+#include "trans_layer.h"
+#include "defs.h"
+
+#include "AmUtils.h"
+#include "AmArg.h"
+#include "log.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+overload_filter::overload_filter()
+{
+}
+
+void overload_filter::configure(unsigned int retry_after,
+				const vector<string>& exempt,
+				const string& signature)
+{
+    this->exempt = exempt;
+
+    hdrs.clear();
+    if(retry_after)
+	hdrs = SIP_HDR_COLSP(SIP_HDR_RETRY_AFTER) + int2str(retry_after) + CRLF;
+    if(!signature.empty())
+	hdrs += SIP_HDR_COLSP(SIP_HDR_SERVER) + signature + CRLF;
+}
+
+void overload_filter::set_reject(unsigned int pct, unsigned int validity_ms)
+{
+    if(pct > 100)
+	pct = 100;
+
+    validity.set(validity_ms);
+    if(pct == reject_pct.get())
+	return;
+
+    // RFC 7339: oc-seq increases with every new value
+    unsigned long long now = (unsigned long long)time(NULL) * 100000ULL;
+    unsigned long long seq = oc_seq.get();
+    oc_seq.set(seq >= now ? seq + 1 : now);
+
+    reject_pct.set(pct);
+}
+
+bool overload_filter::is_exempt(const sip_msg* msg)
+{
+    if(exempt.empty())
+	return false;
+
+    // user part without parameters (';phone-context=...')
+    const cstring& user = msg->u.request->ruri.user;
+    unsigned int len = 0;
+    while((len < user.len) && (user.s[len] != ';'))
+	len++;
+
+    for(vector<string>::const_iterator it = exempt.begin();
+	it != exempt.end(); ++it) {
+
+	if((it->length() == len) &&
+	   !memcmp(it->c_str(),user.s,len))
+	    return true;
+    }
+
+    return false;
+}
+
+overload_filter::verdict overload_filter::match(const sip_msg* msg)
+{
+    unsigned int pct = reject_pct.get();
+    if(!pct || (msg->type != SIP_REQUEST))
+	return PASS;
+
+    switch(msg->u.request->method) {
+    case sip_request::INVITE:
+    case sip_request::REGISTER:
+	break;
+
+    default:
+	return PASS;
+    }
+
+    // in-dialog requests belong to calls already admitted
+    sip_from_to* to = msg->to ? get_to(msg) : NULL;
+    if(to && to->tag.len)
+	return PASS;
+
+    if(is_exempt(msg)) {
+	exempted.inc();
+	return PASS;
+    }
+
+    // reject 'pct' out of every 100 requests, evenly spread
+    unsigned long long n = requests.inc();
+    if((n * pct) / 100 == ((n - 1) * pct) / 100) {
+	admitted.inc();
+	return ADMIT;
+    }
+
+    rejected.inc();
+    return REJECT;
+}
+
+/** 'oc' parameter without value in the topmost Via (RFC 7339) */
+static bool supports_oc(const sip_msg* msg)
+{
+    const sip_avp* oc = msg->via_p1 ? get_via_oc(msg->via_p1) : NULL;
+    return oc && !oc->value.len;
+}
+
+int overload_filter::print_oc(char* buf, unsigned int size)
+{
+    // oc-seq is compared as a decimal number: the fraction needs
+    // its leading zeros, else the 10th change would read as .1
+    unsigned long long seq = oc_seq.get();
+    int len = snprintf(buf,size,
+		       "%u;oc-algo=\"loss\";oc-validity=%u;oc-seq=%llu.%05llu",
+		       reject_pct.get(),validity.get(),
+		       seq / 100000ULL, seq % 100000ULL);
+    if((len < 0) || (len >= (int)size))
+	return -1;
+    return len;
+}
+
+void overload_filter::reject(sip_msg* msg)
+{
+    char    oc_buf[128];
+    cstring oc_value;
+    if(supports_oc(msg)) {
+	int len = print_oc(oc_buf,sizeof(oc_buf));
+	if(len > 0)
+	    oc_value.set(oc_buf,len);
+    }
+
+    trans_layer::instance()->
+	send_sl_reply(msg,503,cstring("Server overload"),
+		      stl2cstr(hdrs),cstring(),oc_value);
+}
+
+void overload_filter::getStats(AmArg& ret)
+{
+    ret["reject_pct"] = (int)reject_pct.get();
+    ret["admitted"] = (int)admitted.get();
+    ret["rejected"] = (int)rejected.get();
+    ret["exempted"] = (int)exempted.get();
+}
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset: 4
+ * End:
+ */
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef _overload_filter_h_
+#define _overload_filter_h_
+
+#include "atomic_types.h"
+
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+struct sip_msg;
+class AmArg;
+
+/**
+ * Rejects a share of the new INVITE and REGISTER requests
+ * statelessly with '503' while the server is overloaded
+ * (see AmOverloadControl). The share is spread evenly over
+ * the requests received.
+ *
+ * In-dialog requests and requests to the exempt numbers
+ * (R-URI user part) are never rejected. Clients supporting
+ * RFC 7339 get the loss rate in the 'oc' parameter of the
+ * Via header.
+ */
+class overload_filter
+{
+public:
+    enum verdict {
+	PASS=0, // not subject to overload control
+	ADMIT,  // subject to overload control, but admitted
+	REJECT  // reject with 503
+    };
+
+private:
+    // [%] of the requests to reject
+    atomic_int   reject_pct;
+    // [ms] validity of the RFC 7339 feedback
+    atomic_int   validity;
+    // RFC 7339 oc-seq: secs * 100000 + changes within that second
+    atomic_int64 oc_seq;
+
+    // spreads the rejections
+    atomic_int   requests;
+
+    vector<string> exempt;
+
+    // headers added to every reply
+    string       hdrs;
+
+    atomic_int   admitted;
+    atomic_int   rejected;
+    atomic_int   exempted;
+
+    bool is_exempt(const sip_msg* msg);
+
+public:
+    overload_filter();
+
+    /**
+     * Must be called before the transports are started.
+     * @param retry_after Retry-After value [s] (0: none)
+     * @param exempt      R-URI user parts never rejected
+     */
+    void configure(unsigned int retry_after, const vector<string>& exempt,
+		   const string& signature);
+
+    /**
+     * Set the share of new requests to reject.
+     * @param pct      0 (none) .. 100 (all)
+     * @param validity [ms] how long RFC 7339 clients apply it
+     */
+    void set_reject(unsigned int pct, unsigned int validity_ms);
+
+    unsigned int get_reject() const { return reject_pct.get(); }
+
+    bool rejecting() const { return reject_pct.get() != 0; }
+
+    /**
+     * Classifies a request which would start a new
+     * UAS transaction and updates the counters.
+     */
+    verdict match(const sip_msg* msg);
+
+    /**
+     * Value of the Via 'oc' parameter (RFC 7339) for the
+     * current reject ratio.
+     * @return length, or -1 if 'buf' is too short
+     */
+    int print_oc(char* buf, unsigned int size);
+
+    /** Sends the stateless 503 to a request matched REJECT. */
+    void reject(sip_msg* msg);
+
+    /** Current reject ratio and counters */
+    void getStats(AmArg& ret);
+};
+
+#endif
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset: 4
+ * End:
+ */
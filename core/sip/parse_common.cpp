@@ -64,7 +64,7 @@ int parse_sip_version(const char* beg, int len)
     return 0;
 }
 
-static int _parse_gen_params(list<sip_avp*>* params, const char** c, 
+static int _parse_gen_params(sip_avp_list* params, const char** c, 
 			     int len, char stop_char, bool beg_w_sc)
 {
     enum {
@@ -315,19 +315,19 @@ static int _parse_gen_params(list<sip_avp*>* params, const char** c,
     return 0;
 }
 
-int parse_gen_params_sc(list<sip_avp*>* params, const char** c, 
+int parse_gen_params_sc(sip_avp_list* params, const char** c, 
 			int len, char stop_char)
 {
     return _parse_gen_params(params,c,len,stop_char,true);
 }
 
-int parse_gen_params(list<sip_avp*>* params, const char** c,
+int parse_gen_params(sip_avp_list* params, const char** c,
 		     int len, char stop_char)
 {
     return _parse_gen_params(params,c,len,stop_char,false);
 }
 
-void free_gen_params(list<sip_avp*>* params)
+void free_gen_params(sip_avp_list* params)
 {
     while(!params->empty()) {
 	delete params->front();
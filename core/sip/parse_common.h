@@ -31,6 +31,7 @@
 #define _parse_common_h
 
 #include "cstring.h"
+#include "sip_arena.h"
 
 #include <list>
 using std::list;
@@ -141,7 +142,7 @@ enum {
 // Structs
 //
 
-struct sip_avp
+struct sip_avp: public sip_arena_obj
 {
     cstring name;
     cstring value;
@@ -156,6 +157,8 @@ struct sip_avp
     {}
 };
 
+typedef list<sip_avp*, sip_arena_allocator<sip_avp*> > sip_avp_list;
+
 
 //
 // Functions
@@ -203,7 +206,7 @@ int parse_sip_version(const char* beg, int len);
  * and separated by semi-colons until stop_char or the 
  * end of the string is reached.
  */
-int parse_gen_params_sc(list<sip_avp*>* params, const char** c, 
+int parse_gen_params_sc(sip_avp_list* params, const char** c, 
 			int len, char stop_char);
 
 /** 
@@ -211,10 +214,10 @@ int parse_gen_params_sc(list<sip_avp*>* params, const char** c,
  * by semi-colons until stop_char or the end of 
  * the string is reached.
  */
-int parse_gen_params(list<sip_avp*>* params, const char** c, int len, char stop_char);
+int parse_gen_params(sip_avp_list* params, const char** c, int len, char stop_char);
 
 /** Free the parameters in the list (NOT the list itself) */
-void free_gen_params(list<sip_avp*>* params);
+void free_gen_params(sip_avp_list* params);
 
 #endif
 
@@ -18,6 +18,7 @@ const char* dns_rr_type_str(dns_rr_type t)
   case dns_r_a:     return "A";
   case dns_r_ns:    return "NS";
   case dns_r_cname: return "CNAME";
+  case dns_r_soa:   return "SOA";
   case dns_r_aaaa:  return "AAAA";
   case dns_r_srv:   return "SRV";
   case dns_r_naptr: return "NAPTR";
@@ -79,6 +80,66 @@ int dns_msg_parse(u_char* msg, int len, dns_parse_fct fct, void* data)
   return 0;
 }
 
+int dns_msg_query(u_char* buf, int len, unsigned short id,
+		  const char* name, dns_rr_type t)
+{
+  u_char* p = buf + HEADER_OFFSET;
+  u_char* end = buf + len;
+
+  if(p > end) return -1;
+
+  memset(buf,0,HEADER_OFFSET);
+  buf[0] = id >> 8;
+  buf[1] = id & 0xFF;
+  buf[2] = 0x01; // RD
+  buf[SECTION_COUNTS_OFF + 1] = 1; // QDCOUNT
+
+  // labels
+  const char* l = name;
+  while(*l) {
+    const char* dot = strchr(l,'.');
+    int l_len = dot ? dot - l : strlen(l);
+
+    if(!l_len || (l_len > 63)) return -1;
+    if(p + l_len + 1 > end) return -1;
+
+    *(p++) = l_len;
+    memcpy(p,l,l_len);
+    p += l_len;
+
+    if(!dot) break;
+    l = dot + 1;
+  }
+
+  // root label + type + class
+  if(p + 5 > end) return -1;
+  *(p++) = 0;
+  *(p++) = (u_char)(t >> 8);
+  *(p++) = (u_char)(t & 0xFF);
+  *(p++) = 0;
+  *(p++) = ns_c_in;
+
+  return p - buf;
+}
+
+int dns_msg_question(u_char* msg, int len, char* name, unsigned int name_len,
+		     unsigned short* type)
+{
+  u_char* p = msg + HEADER_OFFSET;
+  u_char* end = msg + len;
+
+  if((p >= end) || !dns_msg_count(msg,dns_s_qd))
+    return -1;
+
+  if(dns_expand_name(&p,msg,end,(u_char*)name,name_len) < 0)
+    return -1;
+
+  if(p + 4 > end) return -1;
+  *type = dns_get_16(p);
+
+  return 0;
+}
+
 unsigned short dns_msg_count(u_char* begin, dns_section_type sect)
 {
   u_char* p = begin + SECTION_COUNTS_OFF + 2*sect;
@@ -19,6 +19,7 @@ enum dns_rr_type {
   dns_r_a     = 1,
   dns_r_ns    = 2,
   dns_r_cname = 5,
+  dns_r_soa   = 6,
   dns_r_aaaa  = 28,
   dns_r_srv   = 33,
   dns_r_naptr = 35
@@ -42,6 +43,27 @@ class dns_entry;
 typedef int (*dns_parse_fct)(dns_record* rr, dns_section_type t, u_char* begin, u_char* end, void* data);
 
 int dns_msg_parse(u_char* msg, int len, dns_parse_fct fct, void* data);
+
+/**
+ * Write a recursive query for 'name' into 'buf'.
+ * @return the length of the query or -1 if the buffer is too small.
+ */
+int dns_msg_query(u_char* buf, int len, unsigned short id,
+		  const char* name, dns_rr_type t);
+
+/**
+ * Fetch the (first) question of a message.
+ * @return 0 on success
+ */
+int dns_msg_question(u_char* msg, int len, char* name, unsigned int name_len,
+		     unsigned short* type);
+
+// header fields
+#define dns_msg_id(msg)    dns_get_16(msg)
+#define dns_msg_tc(msg)    (((msg)[2] & 0x02) != 0)
+#define dns_msg_rcode(msg) ((msg)[3] & 0x0F)
+
+int dns_skip_name(u_char** p, u_char* end);
 int dns_expand_name(u_char** ptr, u_char* begin, u_char* end, 
 		    u_char* buf, unsigned int len);
 
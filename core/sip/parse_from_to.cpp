@@ -50,7 +50,7 @@ int parse_from_to(sip_from_to* ft, const char* beg, int len)
     
     if(!ft->nameaddr.params.empty()){
 
-	list<sip_avp*>::iterator it = ft->nameaddr.params.begin();
+	sip_avp_list::iterator it = ft->nameaddr.params.begin();
 	for(;it!=ft->nameaddr.params.end();++it){
 
 	    const char* c = (*it)->name.s;
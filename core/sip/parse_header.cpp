@@ -262,13 +262,13 @@ int parse_header_type(sip_header* h)
     return h->type;
 }
 
-void add_parsed_header(list<sip_header*>& hdrs, sip_header* hdr)
+void add_parsed_header(sip_header_list& hdrs, sip_header* hdr)
 {
     parse_header_type(hdr);
     hdrs.push_back(hdr);
 }
 
-int parse_headers(list<sip_header*>& hdrs, char** c, char* end)
+int parse_headers(sip_header_list& hdrs, char** c, char* end)
 {
     //
     // Header states
@@ -461,7 +461,7 @@ int parse_headers(list<sip_header*>& hdrs, char** c, char* end)
     return UNEXPECTED_EOT;
 }
 
-void free_headers(list<sip_header*>& hdrs)
+void free_headers(sip_header_list& hdrs)
 {
     while(!hdrs.empty()) {
 	delete hdrs.front();
@@ -31,17 +31,18 @@
 #define _parse_header_h
 
 #include "cstring.h"
+#include "sip_arena.h"
 
 #include <list>
 using std::list;
 
-struct sip_parsed_hdr
+struct sip_parsed_hdr: public sip_arena_obj
 {
     virtual ~sip_parsed_hdr(){}
 };
 
 
-struct sip_header
+struct sip_header: public sip_arena_obj
 {
     //
     // Header types
@@ -80,10 +81,12 @@ struct sip_header
     ~sip_header();
 };
 
+typedef list<sip_header*, sip_arena_allocator<sip_header*> > sip_header_list;
+
 int parse_header_type(sip_header* h);
 
-int parse_headers(list<sip_header*>& hdrs, char** c, char* end);
-void free_headers(list<sip_header*>& hdrs);
+int parse_headers(sip_header_list& hdrs, char** c, char* end);
+void free_headers(sip_header_list& hdrs);
 
 #endif
 
@@ -30,7 +30,7 @@
 
 #include "parse_uri.h"
 
-struct sip_nameaddr
+struct sip_nameaddr: public sip_arena_obj
 {
 
     cstring name;
@@ -38,7 +38,7 @@ struct sip_nameaddr
 
     sip_uri uri;
 
-    list<sip_avp*> params;
+    sip_avp_list params;
 
     sip_nameaddr() {}
     ~sip_nameaddr();
@@ -37,7 +37,7 @@ route_elmt::~route_elmt() {
 
 sip_route::~sip_route()
 {
-  for(list<route_elmt*>::iterator it = elmts.begin();
+  for(route_elmt_list::iterator it = elmts.begin();
       it != elmts.end(); ++it)
     delete *it;
 }
@@ -48,7 +48,7 @@ bool is_loose_route(const sip_uri* fr_uri)
 
     if(!fr_uri->params.empty()){
 	
-	list<sip_avp*>::const_iterator it = fr_uri->params.begin();
+	sip_avp_list::const_iterator it = fr_uri->params.begin();
 	for(;it != fr_uri->params.end(); it++){
 	    
 	    if( ((*it)->name.len == 2) && 
@@ -215,7 +215,7 @@ int parse_first_route_uri(sip_header* fr)
 	return -1;
     }
 
-    list<route_elmt*>::iterator route_it = route->elmts.begin();
+    route_elmt_list::iterator route_it = route->elmts.begin();
     if((*route_it)->addr)
       return 0;
 
@@ -34,7 +34,7 @@
 struct sip_nameaddr;
 struct sip_uri;
 
-struct route_elmt
+struct route_elmt: public sip_arena_obj
 {
   sip_nameaddr* addr;
   cstring       route;
@@ -46,9 +46,11 @@ struct route_elmt
   ~route_elmt();
 };
 
+typedef list<route_elmt*, sip_arena_allocator<route_elmt*> > route_elmt_list;
+
 struct sip_route: public sip_parsed_hdr
 {
-  list<route_elmt*> elmts;
+  route_elmt_list elmts;
 
   sip_route() 
     : sip_parsed_hdr(),
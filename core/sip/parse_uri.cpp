@@ -40,7 +40,7 @@ sip_uri::sip_uri()
 
 sip_uri::~sip_uri()
 {
-    list<sip_avp*>::iterator it;
+    sip_avp_list::iterator it;
     
     for(it = params.begin();
 	it != params.end(); ++it) {
@@ -337,7 +337,7 @@ static int parse_sip_uri(sip_uri* uri, const char* beg, int len)
     DBG("Converted URI port (%.*s) to int (%i)\n",
 	uri->port_str.len,uri->port_str.s,uri->port);
 
-    for(list<sip_avp*>::iterator it = uri->params.begin();
+    for(sip_avp_list::iterator it = uri->params.begin();
 	it != uri->params.end(); it++) {
 
 	if(!lower_cmp_n((*it)->name.s,(*it)->name.len,
@@ -31,11 +31,7 @@
 #define _parse_uri_h
 
 #include "cstring.h"
-
-#include <list>
-using std::list;
-
-struct sip_avp;
+#include "parse_common.h"
 
 struct sip_uri
 {
@@ -53,8 +49,8 @@ struct sip_uri
     cstring    port_str;
     short unsigned int  port;
 
-    list<sip_avp*> params;
-    list<sip_avp*> hdrs;
+    sip_avp_list   params;
+    sip_avp_list   hdrs;
     sip_avp*       trsp;
 
     sip_uri();
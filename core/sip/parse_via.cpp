@@ -71,7 +71,7 @@ sip_via_parm::~sip_via_parm()
 
 sip_via::~sip_via()
 {
-    list<sip_via_parm*>::iterator it = parms.begin();
+    sip_via_parm_list::iterator it = parms.begin();
     for(;it != parms.end(); ++it) {
 
 	delete *it;
@@ -430,7 +430,7 @@ inline int parse_via_params(sip_via_parm* parm, const char** c, int len)
     int ret = parse_gen_params_sc(&parm->params,c,len,',');
     if(ret) return ret;
 
-    list<sip_avp*>::iterator it = parm->params.begin();
+    sip_avp_list::iterator it = parm->params.begin();
     for(;it != parm->params.end();++it){
 	
 	const char* c   = (*it)->name.s;
@@ -650,6 +650,19 @@ int parse_via(sip_via* via, const char* beg, int len)
     return 0;
 }
 
+const sip_avp* get_via_oc(const sip_via_parm* parm)
+{
+    sip_avp_list::const_iterator it = parm->params.begin();
+    for(;it != parm->params.end();++it){
+
+	if(((*it)->name.len == 2) &&
+	   !lower_cmp((*it)->name.s,"oc",2))
+	    return *it;
+    }
+
+    return NULL;
+}
+
 /** EMACS **
  * Local variables:
  * mode: c++
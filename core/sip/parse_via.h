@@ -31,8 +31,7 @@
 #define _parse_via_h
 
 #include "parse_header.h"
-
-struct sip_avp;
+#include "parse_common.h"
 
 struct sip_transport
 {
@@ -49,11 +48,11 @@ struct sip_transport
     cstring val;
 };
 
-struct sip_via_parm
+struct sip_via_parm: public sip_arena_obj
 {
     const char* eop;
 
-    list<sip_avp*> params;
+    sip_avp_list   params;
 
     sip_transport  trans;
     cstring        host;
@@ -73,15 +72,20 @@ struct sip_via_parm
     ~sip_via_parm();
 };
 
+typedef list<sip_via_parm*, sip_arena_allocator<sip_via_parm*> > sip_via_parm_list;
+
 struct sip_via: public sip_parsed_hdr
 {
-    list<sip_via_parm*> parms;
+    sip_via_parm_list parms;
 
     ~sip_via();
 };
 
 int parse_via(sip_via* via, const char* beg, int len);
 
+/** RFC 7339 'oc' parameter of a Via (NULL if missing) */
+const sip_avp* get_via_oc(const sip_via_parm* parm);
+
 #define MAGIC_BRANCH_COOKIE "z9hG4bK"
 #define MAGIC_BRANCH_LEN    7
 
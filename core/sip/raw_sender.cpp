@@ -6,6 +6,7 @@
 
 #include <errno.h>
 #include <string.h>
+#include <sys/socket.h>
 
 int raw_sender::rsock = -1;
 
@@ -50,3 +51,32 @@ int raw_sender::send(const char* buf, unsigned int len, int sys_if_idx,
 
   return 0;
 }
+
+int raw_sender::mk_hdr(char* hdr, const char* buf, unsigned int len,
+		       int sys_if_idx, const sockaddr_storage* from,
+		       const sockaddr_storage* to)
+{
+  unsigned short mtu = AmConfig::SysIfs[sys_if_idx].mtu;
+  if(mtu > RAW_IPHDR_UDP4_HDR_LEN && 
+     len + RAW_IPHDR_UDP4_HDR_LEN > mtu) {
+    // needs fragmentation
+    return -1;
+  }
+
+  int ret = raw_iphdr_udp4_mk_hdr(hdr,buf,len,from,to);
+  return ret < 0 ? -1 : ret;
+}
+
+int raw_sender::send_batch(struct mmsghdr* msgs, unsigned int n)
+{
+#if defined(__linux__)
+  int ret = sendmmsg(rsock,msgs,n,0);
+  if(ret < 0) {
+    ERROR("sendmmsg(): %s",strerror(errno));
+  }
+  return ret;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
@@ -2,6 +2,7 @@
 #define _raw_sender_h_
 
 struct sockaddr_storage;
+struct mmsghdr;
 
 class raw_sender
 {
@@ -14,6 +15,23 @@ public:
   static int init();
   static int send(const char* buf, unsigned int len, int sys_if_idx,
 		  const sockaddr_storage* from, const sockaddr_storage* to);
+
+  /**
+   * Build the ip & udp headers (RAW_IPHDR_UDP4_HDR_LEN bytes) 
+   * to be sent in front of 'buf' with send_batch().
+   * @return header length, or -1 if the datagram has to be 
+   *         fragmented (use send() instead).
+   */
+  static int mk_hdr(char* hdr, const char* buf, unsigned int len, 
+		    int sys_if_idx, const sockaddr_storage* from,
+		    const sockaddr_storage* to);
+
+  /**
+   * Send datagrams prepared with mk_hdr() with a single system
+   * call (sendmmsg), if supported.
+   * @return number of datagrams sent, -1 on error.
+   */
+  static int send_batch(struct mmsghdr* msgs, unsigned int n);
 };
 
 #endif
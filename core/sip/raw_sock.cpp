@@ -673,3 +673,32 @@ end:
 #endif /* RAW_IPHDR_INC_AUTO_FRAG */
 	return ret;
 }
+
+
+
+/** fill in the ip & udp headers for an unfragmented datagram sent over
+ * an IP_HDRINCL raw socket (hdr must be followed by buf on sending).
+ * @param hdr - RAW_IPHDR_UDP4_HDR_LEN bytes to be filled in.
+ * @param buf - data
+ * @param len - data len
+ * @param from - source address:port
+ * @param to - destination address:port
+ * @return  <0 on error (-2: datagram too big), 
+ *          header size on success
+ */
+int raw_iphdr_udp4_mk_hdr(char* hdr, const char* buf, unsigned int len,
+			  const sockaddr_storage* from,
+			  const sockaddr_storage* to)
+{
+	struct ip_udp_hdr {
+		struct ip ip;
+		struct udphdr udp;
+	} *h = (struct ip_udp_hdr*)hdr;
+
+	if (unlikely(len + sizeof(*h) > 65535))
+		return -2;
+	mk_udp_hdr(&h->udp, from, to, (unsigned char*)buf, len, 1);
+	mk_ip_hdr(&h->ip, &SAv4(from)->sin_addr, &SAv4(to)->sin_addr,
+		  len + sizeof(h->udp), IPPROTO_UDP);
+	return sizeof(*h);
+}
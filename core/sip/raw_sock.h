@@ -39,4 +39,11 @@ int raw_iphdr_udp4_send(int rsock, const char* buf, unsigned int len,
 			const sockaddr_storage* to,
 			unsigned short mtu);
 
+/** size of the ip & udp headers built by raw_iphdr_udp4_mk_hdr() */
+#define RAW_IPHDR_UDP4_HDR_LEN 28
+
+int raw_iphdr_udp4_mk_hdr(char* hdr, const char* buf, unsigned int len,
+			  const sockaddr_storage* from,
+			  const sockaddr_storage* to);
+
 #endif /* _raw_sock_h */
@@ -46,6 +46,7 @@
 #include <resolv.h>
 #include <arpa/inet.h>
 #include <arpa/nameser.h> 
+#include <event2/event.h>
 
 #include <list>
 #include <utility>
@@ -70,6 +71,20 @@ using std::list;
 #define DNS_CACHE_SINGLE_CYCLE \
   ((DNS_CACHE_CYCLE*1000000L)/DNS_CACHE_SIZE)
 
+/* in seconds; for failed queries and negative answers without SOA */
+#define DNS_FAILED_TTL 5L
+
+/*
+ * entries looked up at least this often are
+ * refreshed before they expire
+ */
+#define DNS_REFRESH_HITS 10
+
+/* in ms; for blocking look-ups */
+#define DNS_QUERY_TIMEOUT 10000
+
+#define DNS_MAX_CNAME_CHAIN 8
+
 struct srv_entry
     : public dns_base_entry
 {
@@ -169,6 +184,7 @@ public:
 	stable_sort(ip_vec.begin(),ip_vec.end(),srv_less);
     }
 
+    dns_rr_type get_type() { return dns_r_srv; }
     dns_base_entry* get_rr(dns_record* rr, u_char* begin, u_char* end);
 
     int next_ip(dns_handle* h, sockaddr_storage* sa)
@@ -287,7 +303,7 @@ public:
 };
 
 dns_entry::dns_entry()
-    : dns_base_entry()
+    : dns_base_entry(), hits(0)
 {
 }
 
@@ -366,6 +382,23 @@ bool dns_bucket::insert(const string& name, dns_entry* e)
     return true;
 }
 
+void dns_bucket::replace(const string& name, dns_entry* e)
+{
+    inc_ref(e);
+
+    lock();
+    value_map::iterator it = elmts.find(name);
+    if(it != elmts.end()){
+	dns_entry* old_e = it->second;
+	it->second = e;
+	dec_ref(old_e);
+    }
+    else {
+	elmts.insert(std::make_pair(name,e));
+    }
+    unlock();
+}
+
 bool dns_bucket::remove(const string& name)
 {
     lock();
@@ -405,29 +438,12 @@ dns_entry* dns_bucket::find(const string& name)
 	return NULL;
     }
 
+    e->hits++;
     inc_ref(e);
     unlock();
     return e;
 }
 
-static void dns_error(int error, const char* domain)
-{
-    switch(error){
-        case HOST_NOT_FOUND:
-          DBG("Unknown domain: %s\n", domain);
-          break;
-        case NO_DATA:
-	  DBG("No records for %s\n", domain);
-          break;
-        case TRY_AGAIN:
-          DBG("No response for query (try again)\n");
-          break;
-        default:
-          ERROR("Unexpected error\n");
-          break;
-    }
-}
-
 void ip_entry::to_sa(sockaddr_storage* sa)
 {
     switch(type){
@@ -561,10 +577,14 @@ string srv_entry::to_str()
 
 struct dns_search_h
 {
-    dns_entry_map entry_map;
-    uint64_t      now;
+    dns_entry_map      entry_map;
+    map<string,string> cnames;
+    long               soa_ttl;
+    uint64_t           now;
 
-    dns_search_h() {
+    dns_search_h()
+	: soa_ttl(-1)
+    {
 	now = wheeltimer::instance()->unix_clock.get();
     }
 };
@@ -572,13 +592,45 @@ struct dns_search_h
 int rr_to_dns_entry(dns_record* rr, dns_section_type t,
 		    u_char* begin, u_char* end, void* data)
 {
+    dns_search_h* h = (dns_search_h*)data;
+
+    if(t == dns_s_ns) {
+	if(rr->type != dns_r_soa)
+	    return 0;
+
+	// negative caching TTL: min(SOA TTL, SOA minimum)
+	// (RFC 2308, section 5)
+	u_char* p = (u_char*)ns_rr_rdata(*rr);
+	u_char* rdata_end = p + rr->rdata_len;
+	if((dns_skip_name(&p,rdata_end) < 0) ||
+	   (dns_skip_name(&p,rdata_end) < 0) ||
+	   (p + 20 > rdata_end)) {
+	    DBG("malformed SOA record");
+	    return 0;
+	}
+
+	long minimum = dns_get_32(p + 16);
+	h->soa_ttl = (long)rr->ttl < minimum ? (long)rr->ttl : minimum;
+	return 0;
+    }
+
     // only answer and additional sections
     if(t != dns_s_an && t != dns_s_ar)
 	return 0;
 
-    dns_search_h* h = (dns_search_h*)data;
     string name = ns_rr_name(*rr);
 
+    if(rr->type == dns_r_cname) {
+	u_char name_buf[NS_MAXDNAME];
+	u_char* p = (u_char*)ns_rr_rdata(*rr);
+	if(dns_expand_name(&p,begin,end,name_buf,NS_MAXDNAME) < 0) {
+	    DBG("malformed CNAME record");
+	    return 0;
+	}
+	h->cnames[name] = (const char*)name_buf;
+	return 0;
+    }
+
     dns_entry* dns_e = NULL;
     dns_entry_map::iterator it = h->entry_map.find(name);
 
@@ -842,43 +894,130 @@ dns_entry* dns_entry_map::fetch(const key_type& key)
 }
 
 bool _resolver::disable_srv = false;
+vector<sockaddr_storage> _resolver::dns_servers;
+
+/**
+ * Waits for a query on behalf of a blocking look-up.
+ */
+class dns_sync_query
+    : public dns_query_cb
+{
+public:
+    AmCondition<bool> done;
+    int               err;
+
+    dns_sync_query()
+	: done(false), err(-1)
+    {}
+
+    void dns_resolved(const string& name, dns_rr_type t, int err)
+    {
+	this->err = err;
+	done.set(true);
+    }
+};
 
 _resolver::_resolver()
-    : cache(DNS_CACHE_SIZE)
+    : cache(DNS_CACHE_SIZE),
+      client(this),
+      ev_sweep(NULL),
+      sweep_bucket(0)
 {
+    if(!dns_servers.empty())
+	client.set_servers(dns_servers);
+
     start();
 }
 
 _resolver::~_resolver()
 {
-    
+    if(ev_sweep)
+	event_free(ev_sweep);
 }
 
-int _resolver::query_dns(const char* name, dns_entry_map& entry_map, dns_rr_type t)
+void _resolver::set_servers(const vector<sockaddr_storage>& servers)
 {
-    u_char dns_res[NS_PACKETSZ];
+    client.set_servers(servers);
+}
 
-    if(!name) return -1;
+void _resolver::query_async(const string& name, dns_rr_type t,
+			    dns_query_cb* cb)
+{
+    client.query(name,t,cb);
+}
 
-    DBG("Querying '%s' (%s)...",name,dns_rr_type_str(t));
+int _resolver::query_dns(const char* name, dns_rr_type t)
+{
+    if(!name) return -1;
 
-    int dns_res_len = res_search(name,ns_c_in,(ns_type)t,
-				 dns_res,NS_PACKETSZ);
-    if(dns_res_len < 0){
-	dns_error(h_errno,name);
+    if((unsigned long)pthread_self() == _pid) {
+	// would wait for ourselves
+	DBG("no blocking DNS look-up of '%s' in the resolver thread",name);
 	return -1;
     }
 
-    /*
-     * Initialize a handle to this response.  The handle will
-     * be used later to extract information from the response.
-     */
+    dns_sync_query* q = new dns_sync_query();
+    inc_ref(q);
+
+    client.query(name,t,q);
+
+    int err = -1;
+    if(q->done.wait_for_to(DNS_QUERY_TIMEOUT))
+	err = q->err;
+    else
+	DBG("DNS look-up of '%s' (%s) timed out",name,dns_rr_type_str(t));
+
+    dec_ref(q);
+    return err;
+}
+
+dns_entry* _resolver::find_entry(const string& name)
+{
+    dns_bucket* b = cache.get_bucket(hashlittle(name.c_str(),
+						name.length(),0));
+    return b->find(name);
+}
+
+void _resolver::cache_entry(const string& name, dns_entry* e)
+{
+    dns_bucket* b = cache.get_bucket(hashlittle(name.c_str(),
+						name.length(),0));
+    b->replace(name,e);
+
+    DBG("new DNS cache entry: '%s' -> %s",
+	name.c_str(), e->to_str().c_str());
+}
+
+int _resolver::dns_answer(const string& name, dns_rr_type t,
+			  u_char* msg, int len)
+{
     dns_search_h h;
-    if (dns_msg_parse(dns_res, dns_res_len, rr_to_dns_entry, &h) < 0) {
-	DBG("Could not parse DNS reply");
-	return -1;
+    bool parsed = false;
+
+    if(msg) {
+	if(dns_msg_parse(msg, len, rr_to_dns_entry, &h) < 0)
+	    DBG("Could not parse DNS reply");
+	else
+	    parsed = true;
+    }
+
+    // the name actually holding the records
+    string c_name = name;
+    if(!c_name.empty() && (c_name[c_name.length()-1] == '.'))
+	c_name.erase(c_name.length()-1);
+
+    for(int i=0; i<DNS_MAX_CNAME_CHAIN; i++) {
+	map<string,string>::iterator it = h.cnames.begin();
+	while((it != h.cnames.end()) &&
+	      strcasecmp(it->first.c_str(),c_name.c_str()))
+	    ++it;
+
+	if(it == h.cnames.end())
+	    break;
+	c_name = it->second;
     }
 
+    bool found = false;
     for(dns_entry_map::iterator it = h.entry_map.begin();
 	it != h.entry_map.end(); it++) {
 
@@ -886,9 +1025,49 @@ int _resolver::query_dns(const char* name, dns_entry_map& entry_map, dns_rr_type
 	if(!e || e->ip_vec.empty()) continue;
 
 	e->init();
-	entry_map.insert(it->first,e);
+
+	// a zero TTL must not make the record useless at once
+	if(e->expire <= h.now)
+	    e->expire = h.now + 1;
+
+	cache_entry(it->first,e);
+
+	if(!strcasecmp(it->first.c_str(),c_name.c_str()) &&
+	   (e->get_type() == t)) {
+	    if(it->first != name)
+		cache_entry(name,e);
+	    found = true;
+	}
+    }
+
+    if(found)
+	return 0;
+
+    if(!parsed) {
+	// no answer: keep what we have
+	dns_entry* old_e = find_entry(name);
+	if(old_e) {
+	    dec_ref(old_e);
+	    return 0;
+	}
     }
 
+    // negative caching
+    dns_entry* e = dns_entry::make_entry(t);
+    if(!e) {
+	// unsupported type
+	return -1;
+    }
+
+    long ttl = DNS_FAILED_TTL;
+    if(parsed && (h.soa_ttl >= 0))
+	ttl = h.soa_ttl;
+
+    e->expire = h.now + (ttl ? ttl : 1);
+    inc_ref(e);
+    cache_entry(name,e);
+    dec_ref(e);
+
     return 0;
 }
 
@@ -919,42 +1098,22 @@ int _resolver::resolve_name(const char* name,
     }
     
     // name is NOT an IP address -> try a cache look up
-    dns_bucket* b = cache.get_bucket(hashlittle(name,strlen(name),0));
-    dns_entry* e = b->find(name);
-
-    // first attempt to get a valid IP
-    // (from the cache)
-    if(e){
-	int ret = e->next_ip(h,sa);
-	dec_ref(e);
-	return ret;
-    }
+    dns_entry* e = find_entry(name);
 
     // no valid IP, query the DNS
-    dns_entry_map entry_map;
-    if(query_dns(name,entry_map,t) < 0) {
-	return -1;
-    }
-
-    for(dns_entry_map::iterator it = entry_map.begin();
-	it != entry_map.end(); it++) {
-
-	if(!it->second) continue;
-
-	b = cache.get_bucket(hashlittle(it->first.c_str(),
-					it->first.length(),0));
-	// cache the new record
-	if(b->insert(it->first,it->second)) {
-	    // cache insert successful
-	    DBG("new DNS cache entry: '%s' -> %s",
-		it->first.c_str(), it->second->to_str().c_str());
+    // (caches the answer, positive or negative)
+    if(!e) {
+	if(query_dns(name,t) < 0) {
+	    return -1;
 	}
+	e = find_entry(name);
     }
 
-    e = entry_map.fetch(name);
-    if(e) {
-	// now we should have a valid IP
-	return e->next_ip(h,sa);
+    // now we should have a valid IP
+    if(e){
+	int ret = e->next_ip(h,sa);
+	dec_ref(e);
+	return ret;
     }
 
     return -1;
@@ -993,6 +1152,28 @@ int _resolver::str2ip(const char* name,
     return 0;
 }
 
+/**
+ * SRV name of 'host' for transport 'trsp'.
+ * @return false if the transport has no SRV records.
+ */
+static bool get_srv_name(const cstring& trsp, const string& host,
+			 string& srv_name)
+{
+    srv_name = "_sip._";
+    if(!trsp.len || !lower_cmp_n(trsp,"udp")){
+	srv_name += "udp";
+    }
+    else if(!lower_cmp_n(trsp,"tcp")) {
+	srv_name += "tcp";
+    }
+    else {
+	return false;
+    }
+
+    srv_name += "." + host;
+    return true;
+}
+
 int _resolver::set_destination_ip(const cstring& next_hop,
 				  unsigned short next_port,
 				  const cstring& next_trsp,
@@ -1013,20 +1194,12 @@ int _resolver::set_destination_ip(const cstring& next_hop,
 	    if (disable_srv) {
 		DBG("no port specified, but DNS SRV disabled (skipping).\n");
 	    } else {
-		string srv_name = "_sip._";
-		if(!next_trsp.len || !lower_cmp_n(next_trsp,"udp")){
-		    srv_name += "udp";
-		}
-		else if(!lower_cmp_n(next_trsp,"tcp")) {
-		    srv_name += "tcp";
-		}
-		else {
+		string srv_name;
+		if(!get_srv_name(next_trsp,nh,srv_name)) {
 		    DBG("unsupported transport: skip SRV lookup");
 		    goto no_SRV;
 		}
 
-		srv_name += "." + nh;
-
 		DBG("no port specified, looking up SRV '%s'...\n",
 		    srv_name.c_str());
 
@@ -1100,46 +1273,138 @@ int _resolver::resolve_targets(const list<sip_destination>& dest_list,
     return 0;
 }
 
-void _resolver::run()
+bool _resolver::missing_target(const list<sip_destination>& dest_list,
+			       string& name, dns_rr_type& t)
 {
-    struct timespec tick,rem;
-    tick.tv_sec  = (DNS_CACHE_SINGLE_CYCLE/1000000L);
-    tick.tv_nsec = (DNS_CACHE_SINGLE_CYCLE - (tick.tv_sec)*1000000L) * 1000L;
-
-    unsigned long i = 0;
-    for(;;) {
-	nanosleep(&tick,&rem);
+    // same look-ups as set_destination_ip()
+    for(list<sip_destination>::const_iterator it = dest_list.begin();
+	it != dest_list.end(); it++) {
 
-	u_int64_t now = wheeltimer::instance()->unix_clock.get();
-	dns_bucket* bucket = cache.get_bucket(i);
+	string nh = c2stlstr(it->host);
 
-	bucket->lock();
-	    
-	for(dns_bucket::value_map::iterator it = bucket->elmts.begin();
-	    it != bucket->elmts.end(); ++it){
+	sockaddr_storage sa;
+	if(am_inet_pton(nh.c_str(),&sa) == 1)
+	    continue;
 
-	    dns_entry* dns_e = (dns_entry*)it->second;
-	    if(now >= it->second->expire){
+	string srv_name;
+	if(!it->port && !disable_srv &&
+	   get_srv_name(it->trsp,nh,srv_name)) {
 
-		dns_bucket::value_map::iterator tmp_it = it;
-		bool end_of_bucket = (++it == bucket->elmts.end());
+	    dns_entry* e = find_entry(srv_name);
+	    if(!e) {
+		name = srv_name;
+		t = dns_r_srv;
+		return true;
+	    }
 
-		DBG("DNS record expired (%p)",dns_e);
-		bucket->elmts.erase(tmp_it);
-		dec_ref(dns_e);
+	    // targets must be resolved as well
+	    bool target_ip = !e->ip_vec.empty();
+	    for(vector<dns_base_entry*>::iterator srv_it = e->ip_vec.begin();
+		srv_it != e->ip_vec.end(); ++srv_it) {
+
+		const string& target = ((srv_entry*)*srv_it)->target;
+		if(am_inet_pton(target.c_str(),&sa) == 1)
+		    continue;
+
+		dns_entry* target_e = find_entry(target);
+		if(!target_e) {
+		    dec_ref(e);
+		    name = target;
+		    t = dns_r_a;
+		    return true;
+		}
 
-		if(end_of_bucket) break;
-	    }
-	    else {
-		//DBG("######### record %p expires in %li seconds ##########",
-		//    dns_e,it->second->expire-tv_now.tv_sec);
+		if(target_e->ip_vec.empty())
+		    target_ip = false;
+		dec_ref(target_e);
 	    }
+	    dec_ref(e);
+
+	    if(target_ip)
+		continue;
+
+	    // no SRV record, or unresolvable targets: falls back to A
 	}
 
-	bucket->unlock();
+	dns_entry* e = find_entry(nh);
+	if(!e) {
+	    name = nh;
+	    t = dns_r_a;
+	    return true;
+	}
+	dec_ref(e);
+    }
+
+    return false;
+}
+
+void _resolver::sweep_cb(int sd, short what, void* arg)
+{
+    ((_resolver*)arg)->sweep();
+}
+
+void _resolver::sweep()
+{
+    u_int64_t now = wheeltimer::instance()->unix_clock.get();
+    dns_bucket* bucket = cache.get_bucket(sweep_bucket);
+
+    // popular records about to expire before the next sweep
+    list<pair<string,dns_rr_type> > refresh;
+
+    bucket->lock();
+
+    dns_bucket::value_map::iterator it = bucket->elmts.begin();
+    while(it != bucket->elmts.end()) {
+
+	dns_entry* dns_e = (dns_entry*)it->second;
+	if(now >= dns_e->expire){
 
-	if(++i >= cache.get_size()) i = 0;
+	    DBG("DNS record expired (%p)",dns_e);
+	    bucket->elmts.erase(it++);
+	    dec_ref(dns_e);
+	    continue;
+	}
+
+	if((dns_e->hits >= DNS_REFRESH_HITS) &&
+	   !dns_e->ip_vec.empty() &&
+	   (dns_e->expire <= now + DNS_CACHE_CYCLE)) {
+
+	    refresh.push_back(make_pair(it->first,dns_e->get_type()));
+	    dns_e->hits = 0;
+	}
+
+	++it;
     }
+
+    bucket->unlock();
+
+    for(list<pair<string,dns_rr_type> >::iterator r_it = refresh.begin();
+	r_it != refresh.end(); ++r_it) {
+
+	DBG("refreshing DNS record '%s' (%s)",
+	    r_it->first.c_str(),dns_rr_type_str(r_it->second));
+	client.query(r_it->first,r_it->second,NULL);
+    }
+
+    if(++sweep_bucket >= cache.get_size()) sweep_bucket = 0;
+}
+
+void _resolver::run()
+{
+    struct timeval tick;
+    tick.tv_sec  = (DNS_CACHE_SINGLE_CYCLE/1000000L);
+    tick.tv_usec = DNS_CACHE_SINGLE_CYCLE - tick.tv_sec*1000000L;
+
+    ev_sweep = event_new(client.get_evbase(),-1,EV_PERSIST,sweep_cb,this);
+    event_add(ev_sweep,&tick);
+
+    // queries, answers & cache maintenance
+    client.loop();
+}
+
+void _resolver::on_stop()
+{
+    client.stop();
 }
 
 
@@ -34,6 +34,7 @@
 #include "atomic_types.h"
 #include "parse_dns.h"
 #include "parse_next_hop.h"
+#include "dns_client.h"
 
 #include <string>
 #include <vector>
@@ -82,11 +83,15 @@ class dns_entry
 public:
     vector<dns_base_entry*> ip_vec;
 
+    // cache look-ups since the entry has been cached
+    unsigned int hits;
+
     static dns_entry* make_entry(dns_rr_type t);
 
     dns_entry();
     virtual ~dns_entry();
     virtual void init()=0;
+    virtual dns_rr_type get_type()=0;
     virtual void add_rr(dns_record* rr, u_char* begin, u_char* end, long now);
     virtual int next_ip(dns_handle* h, sockaddr_storage* sa)=0;
 
@@ -102,8 +107,13 @@ class dns_bucket
 public:
     dns_bucket(unsigned long id);
     bool insert(const string& name, dns_entry* e);
+    void replace(const string& name, dns_entry* e);
     bool remove(const string& name);
     dns_entry* find(const string& name);
+
+    // see hash_table::get_stats()
+    using dns_bucket_base::size;
+    using dns_bucket_base::add_lock_stats;
 };
 
 typedef hash_table<dns_bucket> dns_cache;
@@ -140,6 +150,7 @@ public:
     {}
 
     void init(){};
+    dns_rr_type get_type() { return dns_r_a; }
     dns_base_entry* get_rr(dns_record* rr, u_char* begin, u_char* end);
     int next_ip(dns_handle* h, sockaddr_storage* sa);
 
@@ -199,6 +210,7 @@ public:
     {}
 
     void init();
+    dns_rr_type get_type() { return dns_r_naptr; }
     dns_base_entry* get_rr(dns_record* rr, u_char* begin, u_char* end);
 
     // not needed
@@ -257,12 +269,16 @@ private:
 };
 
 class _resolver
-    : AmThread
+    : AmThread,
+      dns_answer_handler
 {
 public:
     // disable SRV lookups
     static bool disable_srv;
 
+    // DNS servers to query (empty: those from /etc/resolv.conf)
+    static vector<sockaddr_storage> dns_servers;
+
     int resolve_name(const char* name, 
 		     dns_handle* h,
 		     sockaddr_storage* sa,
@@ -273,7 +289,18 @@ public:
 	       sockaddr_storage* sa,
 	       const address_type types);
 
-    int query_dns(const char* name, dns_entry_map& entry_map, dns_rr_type t);
+    /**
+     * Queries the DNS and waits for the result to be cached.
+     * Must not be called from the resolver thread.
+     */
+    int query_dns(const char* name, dns_rr_type t);
+
+    /**
+     * Queries the DNS without waiting: 'cb' (may be NULL) is
+     * called from the resolver thread once the result is cached.
+     * Identical queries running at the same time are merged.
+     */
+    void query_async(const string& name, dns_rr_type t, dns_query_cb* cb);
 
     /**
      * Transforms all elements of a destination list into
@@ -283,6 +310,20 @@ public:
     int resolve_targets(const list<sip_destination>& dest_list,
 			sip_target_set* targets);
 
+    /**
+     * Finds the first name resolve_targets() would have
+     * to look up in the DNS for 'dest_list'.
+     * @return true if such a name is missing from the cache.
+     */
+    bool missing_target(const list<sip_destination>& dest_list,
+			string& name, dns_rr_type& t);
+
+    /** DNS servers to use instead of those from /etc/resolv.conf */
+    void set_servers(const vector<sockaddr_storage>& servers);
+
+    /** Occupancy and bucket lock statistics of the cache */
+    void get_cache_stats(ht_stats& s) { cache.get_stats(s); }
+
 protected:
     _resolver();
     ~_resolver();
@@ -294,10 +335,23 @@ protected:
 			   dns_handle* h_dns);
 
     void run();
-    void on_stop() {}
+    void on_stop();
 
 private:
-    dns_cache cache;
+    dns_cache  cache;
+    dns_client client;
+
+    struct event* ev_sweep;
+    unsigned long sweep_bucket;
+
+    dns_entry* find_entry(const string& name);
+    void cache_entry(const string& name, dns_entry* e);
+
+    int dns_answer(const string& name, dns_rr_type t,
+		   u_char* msg, int len);
+
+    void sweep();
+    static void sweep_cb(int sd, short what, void* arg);
 };
 
 typedef singleton<_resolver> resolver;
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sip_arena.h"
+
+#include <stdlib.h>
+
+__thread sip_arena* sip_arena::_current = NULL;
+
+// chunk header size, keeping the data aligned
+#define CHUNK_HDR_LEN \
+    ((sizeof(sip_arena::chunk) + SIP_ARENA_ALIGN - 1) & ~(SIP_ARENA_ALIGN - 1))
+
+sip_arena::~sip_arena()
+{
+    while(chunks) {
+	chunk* next = chunks->next;
+	free(chunks);
+	chunks = next;
+    }
+}
+
+void sip_arena::add_chunk(size_t size)
+{
+    chunk* c = (chunk*)malloc(CHUNK_HDR_LEN + size);
+    if(!c)
+	throw std::bad_alloc();
+
+    c->next = chunks;
+    c->end  = (char*)c + CHUNK_HDR_LEN + size;
+    chunks  = c;
+    total  += size;
+
+    cur = (char*)c + CHUNK_HDR_LEN;
+    end = c->end;
+}
+
+void* sip_arena::alloc_chunk(size_t n)
+{
+    // grow geometrically
+    size_t size = total > SIP_ARENA_MIN_CHUNK ? total : SIP_ARENA_MIN_CHUNK;
+    if(size < n)
+	size = n;
+
+    add_chunk(size);
+
+    void* p = cur;
+    cur += n;
+    return p;
+}
+
+void sip_arena::reserve(size_t size)
+{
+    if(!chunks)
+	add_chunk(size);
+}
+
+bool sip_arena::contains(const void* p) const
+{
+    for(chunk* c = chunks; c; c = c->next) {
+	if(((const char*)p >= (const char*)c + CHUNK_HDR_LEN) &&
+	   ((const char*)p < c->end))
+	    return true;
+    }
+
+    return false;
+}
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset: 4
+ * End:
+ */
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _sip_arena_h
+#define _sip_arena_h
+
+#include <stddef.h>
+#include <new>
+
+// alignment of arena allocations
+#define SIP_ARENA_ALIGN  (2*sizeof(void*))
+
+// minimum size of a chunk
+#define SIP_ARENA_MIN_CHUNK 1024
+
+/**
+ * Memory needed for a message of 'len' bytes: the message buffer,
+ * about three times as much for the parsed headers and some more
+ * for the structures every request has (R-URI, From, To, ...).
+ */
+#define SIP_ARENA_SIZE(len) (4*(size_t)(len) + 2048)
+
+/**
+ * Bump allocator owned by a sip_msg.
+ *
+ * The message buffer and all structures parsed from it are
+ * allocated here; the memory is returned to the system in one go
+ * when the arena (and thus the message) is destroyed. Freeing a
+ * single allocation is a no-op.
+ */
+class sip_arena
+{
+    struct chunk {
+	chunk* next;
+	char*  end;
+    };
+
+    chunk* chunks;
+    char*  cur;
+    char*  end;
+    size_t total;
+
+    static __thread sip_arena* _current;
+
+    void  add_chunk(size_t size);
+    void* alloc_chunk(size_t n);
+
+    const sip_arena& operator=(const sip_arena&);
+
+public:
+    sip_arena()
+	: chunks(NULL), cur(NULL), end(NULL), total(0)
+    {}
+
+    /**
+     * Copies start empty: the memory stays with the
+     * original, which must outlive the copy (see sip_msg::release()).
+     */
+    sip_arena(const sip_arena&)
+	: chunks(NULL), cur(NULL), end(NULL), total(0)
+    {}
+
+    ~sip_arena();
+
+    /** Allocate the first chunk, if not already done. */
+    void reserve(size_t size);
+
+    void* alloc(size_t n) {
+	n = (n + SIP_ARENA_ALIGN - 1) & ~(SIP_ARENA_ALIGN - 1);
+	if((size_t)(end - cur) < n)
+	    return alloc_chunk(n);
+
+	void* p = cur;
+	cur += n;
+	return p;
+    }
+
+    /** Is 'p' part of this arena? */
+    bool contains(const void* p) const;
+
+    /** Bytes allocated from the system */
+    size_t size() const { return total; }
+
+    /** Arena new objects are allocated from in this thread (or NULL) */
+    static sip_arena* current() { return _current; }
+
+    friend class sip_arena_scope;
+};
+
+/**
+ * Makes 'arena' the current arena of this thread
+ * until the scope is left.
+ */
+class sip_arena_scope
+{
+    sip_arena* prev;
+
+public:
+    sip_arena_scope(sip_arena* arena)
+	: prev(sip_arena::_current)
+    {
+	sip_arena::_current = arena;
+    }
+
+    ~sip_arena_scope() {
+	sip_arena::_current = prev;
+    }
+};
+
+/**
+ * Base of the parsed structures: instances created while an arena
+ * is current are allocated from that arena, all others from the
+ * heap. Either can be deleted as usual.
+ */
+struct sip_arena_obj
+{
+    static void* operator new(size_t n) {
+	sip_arena* a = sip_arena::current();
+	sip_arena** p = (sip_arena**)(a ? a->alloc(n + SIP_ARENA_ALIGN)
+				      : ::operator new(n + SIP_ARENA_ALIGN));
+	*p = a;
+	return (char*)p + SIP_ARENA_ALIGN;
+    }
+
+    static void operator delete(void* p) {
+	if(!p) return;
+	sip_arena** h = (sip_arena**)((char*)p - SIP_ARENA_ALIGN);
+	if(!*h) ::operator delete(h);
+    }
+};
+
+/**
+ * Allocator for the lists of parsed structures: list nodes
+ * come from the arena current when the list has been created.
+ */
+template<class T>
+struct sip_arena_allocator
+{
+    typedef T value_type;
+
+    sip_arena* arena;
+
+    sip_arena_allocator()
+	: arena(sip_arena::current())
+    {}
+
+    explicit sip_arena_allocator(sip_arena* arena)
+	: arena(arena)
+    {}
+
+    template<class U>
+    sip_arena_allocator(const sip_arena_allocator<U>& a)
+	: arena(a.arena)
+    {}
+
+    // never share the arena of another list
+    sip_arena_allocator select_on_container_copy_construction() const {
+	return sip_arena_allocator();
+    }
+
+    T* allocate(size_t n) {
+	if(arena)
+	    return (T*)arena->alloc(n * sizeof(T));
+	return (T*)::operator new(n * sizeof(T));
+    }
+
+    void deallocate(T* p, size_t) {
+	if(!arena)
+	    ::operator delete(p);
+    }
+};
+
+template<class T, class U>
+inline bool operator == (const sip_arena_allocator<T>& l,
+			 const sip_arena_allocator<U>& r)
+{
+    return l.arena == r.arena;
+}
+
+template<class T, class U>
+inline bool operator != (const sip_arena_allocator<T>& l,
+			 const sip_arena_allocator<U>& r)
+{
+    return l.arena != r.arena;
+}
+
+#endif
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset: 4
+ * End:
+ */
@@ -43,18 +43,22 @@
 #include <memory>
 using std::unique_ptr;
 
+typedef sip_header_list::allocator_type hdr_alloc;
+
 sip_msg::sip_msg(const char* msg_buf, int msg_len)
-    : buf(NULL),
-      hdrs(),
+    : arena(),
+      buf(NULL),
+      hdrs(hdr_alloc(&arena)),
       to(NULL),
       from(NULL),
       cseq(NULL),
       rack(NULL),
+      vias(hdr_alloc(&arena)),
       via1(NULL),via_p1(NULL),
       callid(NULL),
-      contacts(),
-      route(),
-      record_route(),
+      contacts(hdr_alloc(&arena)),
+      route(hdr_alloc(&arena)),
+      record_route(hdr_alloc(&arena)),
       content_type(NULL),
       content_length(NULL),
       body(),
@@ -68,20 +72,23 @@ sip_msg::sip_msg(const char* msg_buf, int msg_len)
 
     memset(&local_ip,0,sizeof(sockaddr_storage));
     memset(&remote_ip,0,sizeof(sockaddr_storage));
+    memset(&recv_ts,0,sizeof(recv_ts));
 }
 
 sip_msg::sip_msg()
-    : buf(NULL),
-      hdrs(),
+    : arena(),
+      buf(NULL),
+      hdrs(hdr_alloc(&arena)),
       to(NULL),
       from(NULL),
       cseq(NULL),
       rack(NULL),
+      vias(hdr_alloc(&arena)),
       via1(NULL),via_p1(NULL),
       callid(NULL),
-      contacts(),
-      route(),
-      record_route(),
+      contacts(hdr_alloc(&arena)),
+      route(hdr_alloc(&arena)),
+      record_route(hdr_alloc(&arena)),
       content_type(NULL),
       content_length(NULL),
       body(),
@@ -93,13 +100,16 @@ sip_msg::sip_msg()
 
     memset(&local_ip,0,sizeof(sockaddr_storage));
     memset(&remote_ip,0,sizeof(sockaddr_storage));
+    memset(&recv_ts,0,sizeof(recv_ts));
 }
 
 sip_msg::~sip_msg()
 {
-    delete [] buf;
+    // buffers generated by the transaction layer are not in the arena
+    if(!arena.contains(buf))
+	delete [] buf;
 
-    list<sip_header*>::iterator it;
+    sip_header_list::iterator it;
     for(it = hdrs.begin();
 	it != hdrs.end(); ++it) {
 
@@ -122,7 +132,8 @@ sip_msg::~sip_msg()
 
 void sip_msg::copy_msg_buf(const char* msg_buf, int msg_len)
 {
-    buf = new char[msg_len+1];
+    arena.reserve(SIP_ARENA_SIZE(msg_len));
+    buf = (char*)arena.alloc(msg_len+1);
     memcpy(buf,msg_buf,msg_len);
     buf[msg_len] = '\0';
     len = msg_len;
@@ -459,10 +470,12 @@ static int parse_first_line(sip_msg* msg, char** c, char* end)
 
 int parse_headers(sip_msg* msg, char** c, char* end)
 {
-    list<sip_header*> hdrs;
+    sip_arena_scope arena_scope(&msg->arena);
+
+    sip_header_list hdrs;
     int err = parse_headers(hdrs,c,end);
     if(!err) {
-	for(list<sip_header*>::iterator it = hdrs.begin();
+	for(sip_header_list::iterator it = hdrs.begin();
 	    it != hdrs.end(); ++it) {
 
 	    sip_header* hdr = *it;
@@ -522,8 +535,10 @@ int parse_headers(sip_msg* msg, char** c, char* end)
 		msg->record_route.push_back(hdr);
 		break;
 	    }
-	    msg->hdrs.push_back(hdr);
 	}
+
+	// same arena: no need to copy the nodes
+	msg->hdrs.splice(msg->hdrs.end(),hdrs);
     }
 
     return err;
@@ -534,6 +549,10 @@ int parse_sip_msg(sip_msg* msg, char*& err_msg)
     char* c = msg->buf;
     char* end = msg->buf + msg->len;
 
+    // allocate the parsed structures from the message's arena
+    msg->arena.reserve(SIP_ARENA_SIZE(msg->len));
+    sip_arena_scope arena_scope(&msg->arena);
+
     int err = parse_first_line(msg,&c,end);
 
     if(err) {
@@ -31,6 +31,8 @@
 #define _SIP_PARSER_H
 
 #include "cstring.h"
+#include "sip_arena.h"
+#include "parse_header.h"
 #include "parse_uri.h"
 #include "resolver.h"
 
@@ -39,6 +41,7 @@ using std::list;
 
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <time.h>
 
 struct sip_request;
 struct sip_reply;
@@ -58,7 +61,7 @@ enum {
 };
 
 
-struct sip_request
+struct sip_request: public sip_arena_obj
 {
     //
     // Request methods
@@ -83,7 +86,7 @@ struct sip_request
 };
 
 
-struct sip_reply
+struct sip_reply: public sip_arena_obj
 {
     int     code;
     cstring reason;
@@ -100,6 +103,10 @@ struct sip_reply
 
 struct sip_msg
 {
+    // owns the buffer and the parsed structures:
+    // must be destroyed last.
+    sip_arena arena;
+
     char*   buf;
     int     len;
 
@@ -111,7 +118,7 @@ struct sip_msg
 	sip_reply*   reply;
     }u;
 
-    list<sip_header*>  hdrs;
+    sip_header_list    hdrs;
     
     sip_header*        to;
     sip_header*        from;
@@ -119,15 +126,15 @@ struct sip_msg
     sip_header*        cseq;
     sip_header*        rack;
 
-    list<sip_header*>  vias;
+    sip_header_list    vias;
     sip_header*        via1;
     sip_via_parm*      via_p1;
 
     sip_header*        callid;
 
-    list<sip_header*>  contacts;
-    list<sip_header*>  route;
-    list<sip_header*>  record_route;
+    sip_header_list    contacts;
+    sip_header_list    route;
+    sip_header_list    record_route;
     sip_header*        content_type;
     sip_header*        content_length;
     cstring            body;
@@ -137,6 +144,9 @@ struct sip_msg
 
     sockaddr_storage   remote_ip;
 
+    // reception by the kernel (zero if unknown)
+    struct timespec    recv_ts;
+
     sip_msg();
     sip_msg(const char* msg_buf, int msg_len);
     ~sip_msg();
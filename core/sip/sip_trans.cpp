@@ -67,7 +67,9 @@ inline trans_timer** fetch_timer(unsigned int timer_type, trans_timer** base)
 }
 
 sip_trans::sip_trans()
-    : msg(NULL),
+    : branch_next(NULL),
+      branch_slot(-1),
+      msg(NULL),
       targets(NULL),
       retr_buf(NULL),
       retr_socket(NULL),
@@ -192,8 +194,9 @@ void sip_trans::reset_timer(trans_timer* t, unsigned int timer_type)
 
     *tp = t;
 
+    // all timers of a bucket fire on the same shard
     if(t)
-	wheeltimer::instance()->insert_timer((timer*)t);
+	wheeltimer::instance()->insert_timer((timer*)t,t->bucket_id);
 }
 
 void trans_timer::fire()
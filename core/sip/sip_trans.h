@@ -32,6 +32,7 @@
 
 #include "cstring.h"
 #include "wheeltimer.h"
+#include "hash_table.h"
 
 #include <sys/socket.h>
 
@@ -105,10 +106,16 @@ public:
 };
 
 class sip_trans
+    : public ht_ilink<sip_trans>
 {
     trans_timer* timers[SIP_TRANS_TIMERS];
 
  public:
+    /** Next transaction in the same branch slot of
+	the bucket (-1: not indexed); see trans_bucket */
+    sip_trans* branch_next;
+    int        branch_slot;
+
     /** Transaction type */
     unsigned int type;
     
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "sl_responder.h"
+#include "sip_parser.h"
+#include "parse_header.h"
+#include "parse_from_to.h"
+#include "trans_layer.h"
+#include "wheeltimer.h"
+#include "ip_util.h"
+#include "hash.h"
+#include "defs.h"
+
+#include "AmConfig.h"
+#include "AmArg.h"
+#include "log.h"
+
+#include <string.h>
+
+#define EVENT_KEEPALIVE     "keep-alive"
+#define EVENT_KEEPALIVE_len (sizeof(EVENT_KEEPALIVE)-1)
+
+sl_responder::sl_responder()
+    : methods(0), any_user(false), rate(0)
+{
+    sources = new source[SL_RESP_SOURCES];
+    for(int i=0; i<SL_RESP_SOURCES; i++) {
+	memset(&sources[i].addr,0,sizeof(sockaddr_storage));
+	sources[i].second = 0;
+	sources[i].count = 0;
+    }
+}
+
+sl_responder::~sl_responder()
+{
+    delete [] sources;
+}
+
+void sl_responder::configure(unsigned int methods, bool any_user,
+			      unsigned int rate, const string& signature)
+{
+    this->methods = methods;
+    this->any_user = any_user;
+    this->rate = rate;
+
+    hdrs.clear();
+    if(!signature.empty())
+	hdrs = SIP_HDR_COLSP(SIP_HDR_SERVER) + signature + CRLF;
+}
+
+static bool is_notify(const sip_msg* msg)
+{
+    const cstring& m = msg->u.request->method_str;
+    return (m.len == sizeof(SIP_METH_NOTIFY)-1) &&
+	!memcmp(m.s,SIP_METH_NOTIFY,m.len);
+}
+
+static bool has_keepalive_event(const sip_msg* msg)
+{
+    for(sip_header_list::const_iterator it = msg->hdrs.begin();
+	it != msg->hdrs.end(); ++it) {
+
+	const sip_header* h = *it;
+	if(h->type != sip_header::H_OTHER)
+	    continue;
+
+	if(lower_cmp_n(h->name.s,h->name.len,
+		       SIP_HDR_EVENT,sizeof(SIP_HDR_EVENT)-1) &&
+	   lower_cmp_n(h->name.s,h->name.len,"o",1))
+	    continue;
+
+	// event type, maybe followed by parameters
+	const cstring& v = h->value;
+	if((v.len < (int)EVENT_KEEPALIVE_len) ||
+	   lower_cmp(v.s,EVENT_KEEPALIVE,EVENT_KEEPALIVE_len))
+	    return false;
+
+	return (v.len == (int)EVENT_KEEPALIVE_len) ||
+	    (v.s[EVENT_KEEPALIVE_len] == ';') ||
+	    (v.s[EVENT_KEEPALIVE_len] == ' ') ||
+	    (v.s[EVENT_KEEPALIVE_len] == '\t');
+    }
+
+    return false;
+}
+
+bool sl_responder::is_keepalive(const sip_msg* msg)
+{
+    // in-dialog requests go to their dialog
+    sip_from_to* to = msg->to ? get_to(msg) : NULL;
+    if(to && to->tag.len)
+	return false;
+
+    switch(msg->u.request->method) {
+    case sip_request::OPTIONS:
+	return any_user || !msg->u.request->ruri.user.len;
+
+    case sip_request::OTHER_METHOD:
+	return is_notify(msg) && has_keepalive_event(msg);
+
+    default:
+	break;
+    }
+
+    return false;
+}
+
+bool sl_responder::below_rate(const sockaddr_storage* addr)
+{
+    if(!rate)
+	return true;
+
+    // by IP only: the port of a NATed client may change
+    const void* ip;
+    size_t      ip_len;
+    if(addr->ss_family == AF_INET6) {
+	ip = &SAv6(addr)->sin6_addr;
+	ip_len = sizeof(in6_addr);
+    }
+    else {
+	ip = &SAv4(addr)->sin_addr;
+	ip_len = sizeof(in_addr);
+    }
+
+    unsigned int second = wheeltimer::instance()->wall_clock
+	/ (1000000/TIMER_RESOLUTION);
+
+    source& s = sources[hashlittle(ip,ip_len,0) % SL_RESP_SOURCES];
+    AmLock l(s.m);
+
+    const void* s_ip = (addr->ss_family == AF_INET6) ?
+	(const void*)&SAv6(&s.addr)->sin6_addr :
+	(const void*)&SAv4(&s.addr)->sin_addr;
+
+    if((s.addr.ss_family != addr->ss_family) ||
+       memcmp(s_ip,ip,ip_len)) {
+	// another source takes over the slot
+	memcpy(&s.addr,addr,SA_len(addr));
+	s.second = second;
+	s.count = 0;
+    }
+    else if(s.second != second) {
+	s.second = second;
+	s.count = 0;
+    }
+
+    return ++s.count <= rate;
+}
+
+sl_responder::verdict sl_responder::match(const sip_msg* msg)
+{
+    if(!methods || (msg->type != SIP_REQUEST))
+	return PASS;
+
+    unsigned int m = 0;
+    switch(msg->u.request->method) {
+    case sip_request::OPTIONS:      m = SL_RESP_OPTIONS; break;
+    case sip_request::OTHER_METHOD: m = SL_RESP_NOTIFY; break;
+    default: return PASS;
+    }
+
+    if(!(methods & m) || ((m == SL_RESP_NOTIFY) && !is_notify(msg)))
+	return PASS;
+
+    if(!is_keepalive(msg)) {
+	misses.inc();
+	return PASS;
+    }
+
+    if(!below_rate(&msg->remote_ip)) {
+	limited.inc();
+	return DROP;
+    }
+
+    hits.inc();
+    return ANSWER;
+}
+
+bool sl_responder::handle(sip_msg* msg)
+{
+    switch(match(msg)) {
+    case ANSWER:
+	if(AmConfig::ShutdownMode) {
+	    trans_layer::instance()->
+		send_sl_reply(msg,AmConfig::ShutdownModeErrCode,
+			      stl2cstr(AmConfig::ShutdownModeErrReason),
+			      stl2cstr(hdrs),cstring());
+	}
+	else {
+	    trans_layer::instance()->
+		send_sl_reply(msg,200,cstring("OK"),
+			      stl2cstr(hdrs),cstring());
+	}
+	return true;
+
+    case DROP:
+	DBG("keep-alive rate of %s exceeded: dropping %.*s\n",
+	    am_inet_ntop(&msg->remote_ip).c_str(),
+	    msg->u.request->method_str.len,
+	    msg->u.request->method_str.s);
+	return true;
+
+    default:
+	break;
+    }
+
+    return false;
+}
+
+void sl_responder::getStats(AmArg& ret)
+{
+    ret["answered"] = (int)hits.get();
+    ret["passed"] = (int)misses.get();
+    ret["rate_limited"] = (int)limited.get();
+}
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset: 4
+ * End:
+ */
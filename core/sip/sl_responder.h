@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2026 The SEMS authors
+ *
+ * This file is part of SEMS, a free SIP media server.
+ *
+ * SEMS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. This program is released under
+ * the GPL with the additional exemption that compiling, linking,
+ * and/or using OpenSSL is allowed.
+ *
+ * For a license to use the SEMS software under conditions
+ * other than those described here, or to purchase support for this
+ * software, please contact iptel.org by e-mail at the following addresses:
+ *    info@iptel.org
+ *
+ * SEMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef _sl_responder_h_
+#define _sl_responder_h_
+
+#include "atomic_types.h"
+#include "AmThread.h"
+
+#include <sys/socket.h>
+
+#include <string>
+using std::string;
+
+struct sip_msg;
+class AmArg;
+
+// requests answered statelessly
+#define SL_RESP_OPTIONS (1<<0)
+#define SL_RESP_NOTIFY  (1<<1)  // with 'Event: keep-alive'
+
+// default max. keep-alives per second and source IP
+#define DEFAULT_SL_KEEPALIVE_RATE 10
+
+// size of the per-source rate limiting table
+#define SL_RESP_SOURCES 256
+
+/**
+ * Answers keep-alive requests (out-of-dialog OPTIONS and,
+ * optionally, NOTIFYs with 'Event: keep-alive') statelessly
+ * from the receiving thread: neither a transaction nor a
+ * session is involved.
+ */
+class sl_responder
+{
+public:
+    enum verdict {
+	PASS=0, // not a keep-alive: process normally
+	ANSWER, // answer statelessly
+	DROP    // source exceeded its rate
+    };
+
+private:
+    struct source {
+	AmMutex          m;
+	sockaddr_storage addr;
+	unsigned int     second;
+	unsigned int     count;
+    };
+
+    unsigned int methods;
+    bool         any_user;
+    unsigned int rate;
+
+    // headers added to every reply
+    string       hdrs;
+
+    source*      sources;
+
+    atomic_int   hits;
+    atomic_int   misses;
+    atomic_int   limited;
+
+    bool is_keepalive(const sip_msg* msg);
+    bool below_rate(const sockaddr_storage* addr);
+
+public:
+    sl_responder();
+    ~sl_responder();
+
+    /**
+     * Must be called before the transports are started.
+     * @param methods  SL_RESP_OPTIONS | SL_RESP_NOTIFY (0 disables)
+     * @param any_user answer OPTIONS with a user part in the R-URI, too
+     * @param rate     max. requests per second and source IP (0: no limit)
+     */
+    void configure(unsigned int methods, bool any_user, unsigned int rate,
+		   const string& signature);
+
+    bool enabled() const { return methods != 0; }
+
+    /**
+     * Classifies a received request and updates the
+     * counters and the rate of its source.
+     */
+    verdict match(const sip_msg* msg);
+
+    /**
+     * Answers or drops the request if it is a keep-alive.
+     * @return true if the message has been consumed
+     *         (the caller still owns it).
+     */
+    bool handle(sip_msg* msg);
+
+    /** Answered / handed to the stateful path / dropped */
+    void getStats(AmArg& ret);
+};
+
+#endif
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset: 4
+ * End:
+ */
@@ -6,6 +6,7 @@
 #include "hash.h"
 
 #include "AmUtils.h"
+#include "AmCpuAffinity.h"
 
 #include <netdb.h>
 #include <event2/event.h>
@@ -358,12 +359,21 @@ void tcp_trsp_socket::on_read(short ev)
 
 int tcp_trsp_socket::parse_input()
 {
+  // all messages of this buffer fill go to the same place
+  _trans_layer* tl = trans_layer::instance();
+
   for(;;) {
     int err = skip_sip_msg_async(&pst, (char*)(input_buf+input_len));
     if(err) {
 
       if(err == UNEXPECTED_EOT) {
 
+	// wait for the rest behind the partial message,
+	// as long as there is room for a decent read
+	if(get_input_free_space() >= MIN_TCP_READ) {
+	  return 0;
+	}
+
 	if(pst.orig_buf > (char*)input_buf) {
 
 	  int addr_shift = pst.orig_buf - (char*)input_buf;
@@ -398,14 +408,14 @@ int tcp_trsp_socket::parse_input()
 
     sip_msg* s_msg = new sip_msg((const char*)pst.orig_buf,msg_len);
 
-    copy_peer_addr(&s_msg->remote_ip);
+    memcpy(&s_msg->remote_ip,&peer_addr,SA_len(&peer_addr));
     copy_addr_to(&s_msg->local_ip);
 
     s_msg->local_socket = this;
     inc_ref(this);
 
     // pass message to the parser / transaction layer
-    trans_layer::instance()->received_msg(s_msg);
+    tl->received_msg(s_msg);
 
     char* msg_end = pst.orig_buf + msg_len;
     char* input_end = (char*)input_buf + input_len;
@@ -437,15 +447,32 @@ void tcp_trsp_socket::on_write(short ev)
 
   while(!send_q.empty()) {
 
-    msg_buf* msg = send_q.front();
-    if(!msg || !msg->bytes_left()) {
-      send_q.pop_front();
-      delete msg;
-      continue;
+    // gather as much of the queue as possible
+    struct iovec iov[MAX_TCP_IOV];
+    int iov_len = 0;
+
+    for(deque<msg_buf*>::iterator it = send_q.begin();
+	(it != send_q.end()) && (iov_len < MAX_TCP_IOV); ++it) {
+
+      if(!*it || !(*it)->bytes_left())
+	continue;
+
+      iov[iov_len].iov_base = (*it)->cursor;
+      iov[iov_len].iov_len = (*it)->bytes_left();
+      iov_len++;
     }
 
-    // send msg
-    int bytes = write(sd,msg->cursor,msg->bytes_left());
+    if(!iov_len) {
+      // nothing but empty messages left
+      while(!send_q.empty()) {
+	delete send_q.front();
+	send_q.pop_front();
+      }
+      return;
+    }
+
+    // send msgs
+    int bytes = writev(sd,iov,iov_len);
     if(bytes < 0) {
       DBG("error on write: %i",bytes);
       switch(errno){
@@ -463,21 +490,54 @@ void tcp_trsp_socket::on_write(short ev)
       return;
     }
 
-    DBG("bytes written: <%.*s>",bytes,msg->cursor);
+    DBG("bytes written: %i (%i messages)",bytes,iov_len);
+
+    // drop what has been written completely
+    while(!send_q.empty()) {
+
+      msg_buf* msg = send_q.front();
+      if(msg && (msg->bytes_left() > bytes)) {
+	msg->cursor += bytes;
+	break;
+      }
+
+      if(msg)
+	bytes -= msg->bytes_left();
+
+      send_q.pop_front();
+      delete msg;
+    }
 
-    if(bytes < msg->bytes_left()) {
-      msg->cursor += bytes;
+    if(!send_q.empty() && (send_q.front()->cursor > send_q.front()->msg)) {
+      // partially written: wait for the socket
       add_write_event();
       return;
     }
-
-    send_q.pop_front();
-    delete msg;
   }
 }
 
+bool tcp_peer_less::operator() (const sockaddr_storage& l,
+				const sockaddr_storage& r) const
+{
+  if(l.ss_family != r.ss_family)
+    return l.ss_family < r.ss_family;
+
+  unsigned short l_port = am_get_port(&l);
+  unsigned short r_port = am_get_port(&r);
+  if(l_port != r_port)
+    return l_port < r_port;
+
+  if(l.ss_family == AF_INET6)
+    return memcmp(&SAv6(&l)->sin6_addr,&SAv6(&r)->sin6_addr,
+		  sizeof(in6_addr)) < 0;
+
+  return memcmp(&SAv4(&l)->sin_addr,&SAv4(&r)->sin_addr,
+		sizeof(in_addr)) < 0;
+}
+
 tcp_server_worker::tcp_server_worker(tcp_server_socket* server_sock)
-  : server_sock(server_sock)
+  : server_sock(server_sock),
+    connections(TCP_CONN_HT_SIZE)
 {
   evbase = event_base_new();
 }
@@ -489,73 +549,66 @@ tcp_server_worker::~tcp_server_worker()
 
 void tcp_server_worker::add_connection(tcp_trsp_socket* client_sock)
 {
-  string conn_id = client_sock->get_peer_ip()
-    + ":" + int2str(client_sock->get_peer_port());
+  sockaddr_storage peer_addr;
+  client_sock->copy_peer_addr(&peer_addr);
 
   DBG("new TCP connection from %s:%u",
       client_sock->get_peer_ip().c_str(),
       client_sock->get_peer_port());
 
-  connections_mut.lock();
-  map<string,tcp_trsp_socket*>::iterator sock_it = connections.find(conn_id);
-  if(sock_it != connections.end()) {
-    dec_ref(sock_it->second);
-    sock_it->second = client_sock;
-  }
-  else {
-    connections[conn_id] = client_sock;
-  }
-  inc_ref(client_sock);
-  connections_mut.unlock();
+  tcp_conn_bucket* bucket =
+    connections.get_bucket(tcp_server_socket::hash_addr(&peer_addr));
+
+  bucket->lock();
+  bucket->remove(peer_addr);
+  bucket->insert(peer_addr,client_sock);
+  bucket->unlock();
 }
 
 void tcp_server_worker::remove_connection(tcp_trsp_socket* client_sock)
 {
-  string conn_id = client_sock->get_peer_ip()
-    + ":" + int2str(client_sock->get_peer_port());
+  sockaddr_storage peer_addr;
+  client_sock->copy_peer_addr(&peer_addr);
+
+  DBG("removing TCP connection from %s:%u",
+      client_sock->get_peer_ip().c_str(),
+      client_sock->get_peer_port());
 
-  DBG("removing TCP connection from %s",conn_id.c_str());
+  tcp_conn_bucket* bucket =
+    connections.get_bucket(tcp_server_socket::hash_addr(&peer_addr));
 
-  connections_mut.lock();
-  map<string,tcp_trsp_socket*>::iterator sock_it = connections.find(conn_id);
-  if(sock_it != connections.end()) {
-    dec_ref(sock_it->second);
-    connections.erase(sock_it);
-    DBG("TCP connection from %s removed",conn_id.c_str());
+  bucket->lock();
+  // might have been replaced by a newer connection
+  if(bucket->get(peer_addr) == client_sock) {
+    bucket->remove(peer_addr);
+    DBG("TCP connection from %s:%u removed",
+	client_sock->get_peer_ip().c_str(),
+	client_sock->get_peer_port());
   }
-  connections_mut.unlock();
+  bucket->unlock();
 }
 
-int tcp_server_worker::send(const sockaddr_storage* sa, const char* msg,
-			    const int msg_len, unsigned int flags)
+int tcp_server_worker::send(const sockaddr_storage* sa, uint32_t h,
+			    const char* msg, const int msg_len,
+			    unsigned int flags)
 {
-  char host_buf[NI_MAXHOST];
-  string dest = am_inet_ntop(sa,host_buf,NI_MAXHOST);
-  dest += ":" + int2str(am_get_port(sa));
-
   tcp_trsp_socket* sock = NULL;
 
   bool new_conn=false;
-  connections_mut.lock();
-  map<string,tcp_trsp_socket*>::iterator sock_it = connections.find(dest);
-  if(sock_it != connections.end()) {
-    sock = sock_it->second;
-    inc_ref(sock);
-  }
-  else {
+  tcp_conn_bucket* bucket = connections.get_bucket(h);
+  bucket->lock();
+  sock = bucket->get(*sa);
+  if(!sock) {
     //TODO: add flags to avoid new connections (ex: UAs behind NAT)
-    tcp_trsp_socket* new_sock = tcp_trsp_socket::new_connection(server_sock,this,
-								sa,evbase);
-    connections[dest] = new_sock;
-    inc_ref(new_sock);
-
-    sock = new_sock;
-    inc_ref(sock);
+    sock = tcp_trsp_socket::new_connection(server_sock,this,
+					   sa,evbase);
+    bucket->insert(*sa,sock);
     new_conn = true;
   }
-  connections_mut.unlock();
+  inc_ref(sock);
+  bucket->unlock();
 
-  // must be done outside from connections_mut
+  // must be done outside from the bucket lock
   // to avoid dead-lock with the event base
   int ret = sock->send(sa,msg,msg_len,flags);
   if((ret < 0) && new_conn) {
@@ -702,6 +755,7 @@ void tcp_server_socket::add_threads(unsigned int n)
 void tcp_server_socket::start_threads()
 {
   for(unsigned int i=0; i<workers.size(); i++) {
+    AmCpuAffinity::apply(workers[i], AmCpuAffinity::SipServer, i);
     workers[i]->start();
   }
 }
@@ -746,7 +800,7 @@ int tcp_server_socket::send(const sockaddr_storage* sa, const char* msg,
   uint32_t h = hash_addr(sa);
   unsigned int idx = h % workers.size();
   DBG("tcp_server_socket::send: idx = %u",idx);
-  return workers[idx]->send(sa,msg,msg_len,flags);
+  return workers[idx]->send(sa,h,msg,msg_len,flags);
 }
 
 void tcp_server_socket::set_connect_timeout(unsigned int ms)
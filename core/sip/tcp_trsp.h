@@ -3,6 +3,7 @@
 
 #include "transport.h"
 #include "sip_parser_async.h"
+#include "hash_table.h"
 
 #include <vector>
 using std::vector;
@@ -13,7 +14,26 @@ using std::vector;
  */
 #define MAX_TCP_MSGLEN 65535
 
+/**
+ * Free space below which a partially received message
+ * is moved to the beginning of the input buffer.
+ */
+#define MIN_TCP_READ 4096
+
+/**
+ * Max. number of queued messages written at once.
+ */
+#define MAX_TCP_IOV 64
+
+/**
+ * Size of the connection table of each worker.
+ * Prime, as the worker has been chosen by the same
+ * address hash (modulo the number of workers).
+ */
+#define TCP_CONN_HT_SIZE 1021
+
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <event2/event.h>
 
 #include <map>
@@ -184,14 +204,28 @@ public:
 	   const int msg_len, unsigned int flags);
 };
 
+/**
+ * Orders peer addresses by family, port and IP.
+ */
+struct tcp_peer_less
+{
+  bool operator() (const sockaddr_storage& l, const sockaddr_storage& r) const;
+};
+
+typedef ht_map_bucket<sockaddr_storage,tcp_trsp_socket,
+		      ht_ref_cnt<tcp_trsp_socket>,
+		      tcp_peer_less> tcp_conn_bucket;
+
+typedef hash_table<tcp_conn_bucket> tcp_conn_table;
+
 class tcp_server_worker
   : public AmThread
 {
   struct event_base* evbase;
   tcp_server_socket* server_sock;
 
-  AmMutex                      connections_mut;
-  map<string,tcp_trsp_socket*> connections;
+  // by peer address
+  tcp_conn_table     connections;
 
 protected:
   void run();
@@ -201,7 +235,10 @@ public:
   tcp_server_worker(tcp_server_socket* server_sock);
   ~tcp_server_worker();
 
-  int send(const sockaddr_storage* sa, const char* msg,
+  /**
+   * @param h address hash (see tcp_server_socket::hash_addr())
+   */
+  int send(const sockaddr_storage* sa, uint32_t h, const char* msg,
 	   const int msg_len, unsigned int flags);
 
   void add_connection(tcp_trsp_socket* client_sock);
@@ -231,9 +268,10 @@ class tcp_server_socket: public trsp_socket
   /* libevent callback on new connection */
   static void on_accept(int sd, short ev, void* arg);
 
+public:
+  /** Hash of IP and port */
   static uint32_t hash_addr(const sockaddr_storage* addr);
 
-public:
   tcp_server_socket(unsigned short if_num);
   ~tcp_server_socket() {}
 
@@ -36,6 +36,7 @@
 #include "parse_100rel.h"
 #include "parse_extensions.h"
 #include "parse_next_hop.h"
+#include "parse_via.h"
 #include "sip_trans.h"
 #include "msg_fline.h"
 #include "msg_hdrs.h"
@@ -51,6 +52,10 @@
 
 #define DEFAULT_BL_TTL 60000 /* 60s */
 
+// how often a request may wait for the DNS
+// (SRV record, then its targets, then A records)
+#define MAX_DNS_ROUNDS 8
+
 #include "log.h"
 
 #include "AmUtils.h"
@@ -180,7 +185,7 @@ static int patch_contact_transport(sip_header* contact, const cstring& trsp,
 	}
 
 	bool found_trsp = false;
-	for(list<sip_avp*>::iterator p_it = na.uri.params.begin();
+	for(sip_avp_list::iterator p_it = na.uri.params.begin();
 	    p_it != na.uri.params.end(); p_it++) {
 
 	    if(!lower_cmp_n((*p_it)->name.s,(*p_it)->name.len,"transport",9)) {
@@ -276,7 +281,7 @@ int _trans_layer::send_reply(sip_msg* msg, const trans_ticket* tt,
 	    contact_buf.resize(msg->contacts.size());
 	    vector<string>::iterator contact_buf_it = contact_buf.begin();
 
-	    for(list<sip_header*>::iterator contact_it = msg->contacts.begin();
+	    for(sip_header_list::iterator contact_it = msg->contacts.begin();
 		contact_it != msg->contacts.end(); contact_it++, contact_buf_it++) {
 	
 		patch_contact_transport(*contact_it,trsp,*contact_buf_it);
@@ -314,7 +319,7 @@ int _trans_layer::send_reply(sip_msg* msg, const trans_ticket* tt,
     int reply_code = msg->u.reply->code;
     
     // copy necessary headers
-    for(list<sip_header*>::iterator it = req->hdrs.begin();
+    for(sip_header_list::iterator it = req->hdrs.begin();
 	it != req->hdrs.end(); ++it) {
 
 	assert((*it));
@@ -414,7 +419,7 @@ int _trans_layer::send_reply(sip_msg* msg, const trans_ticket* tt,
 
     status_line_wr(&c,reply_code,msg->u.reply->reason);
 
-    for(list<sip_header*>::iterator it = req->hdrs.begin();
+    for(sip_header_list::iterator it = req->hdrs.begin();
 	it != req->hdrs.end(); ++it) {
 
 	switch((*it)->type){
@@ -674,7 +679,7 @@ int _trans_layer::send_sf_error_reply(const trans_ticket* tt, const sip_msg* req
 
 int _trans_layer::send_sl_reply(sip_msg* req, int reply_code, 
 			       const cstring& reason, const cstring& hdrs, 
-			       const cstring& body)
+			       const cstring& body, const cstring& oc_value)
 {
     // Ref.: RFC 3261 8.2.6, 12.1.1
     //
@@ -701,7 +706,17 @@ int _trans_layer::send_sl_reply(sip_msg* req, int reply_code,
     bool have_to_tag = false;
     int  reply_len   = status_line_len(reason);
 
-    for(list<sip_header*>::iterator it = req->hdrs.begin();
+    // RFC 7339 feedback: value of the 'oc' parameter in the topmost Via
+    const char* oc_pos = NULL;
+    if(oc_value.len && req->via1 && req->via_p1) {
+	const sip_avp* oc = get_via_oc(req->via_p1);
+	if(oc && !oc->value.len) {
+	    oc_pos = oc->name.s + oc->name.len;
+	    reply_len += 1/* '=' */ + oc_value.len;
+	}
+    }
+
+    for(sip_header_list::iterator it = req->hdrs.begin();
 	it != req->hdrs.end(); ++it) {
 
 	assert(*it);
@@ -748,7 +763,7 @@ int _trans_layer::send_sl_reply(sip_msg* req, int reply_code,
 
     status_line_wr(&c,reply_code,reason);
 
-    for(list<sip_header*>::iterator it = req->hdrs.begin();
+    for(sip_header_list::iterator it = req->hdrs.begin();
 	it != req->hdrs.end(); ++it) {
 
 	switch((*it)->type){
@@ -781,10 +796,33 @@ int _trans_layer::send_sl_reply(sip_msg* req, int reply_code,
 	    }
 	    break;
 
+	case sip_header::H_VIA:
+	    if(oc_pos && (*it == req->via1)) {
+		memcpy(c,(*it)->name.s,(*it)->name.len);
+		c += (*it)->name.len;
+
+		*(c++) = ':';
+		*(c++) = SP;
+
+		int oc_off = oc_pos - (*it)->value.s;
+		memcpy(c,(*it)->value.s,oc_off);
+		c += oc_off;
+
+		*(c++) = '=';
+		memcpy(c,oc_value.s,oc_value.len);
+		c += oc_value.len;
+
+		memcpy(c,oc_pos,(*it)->value.len - oc_off);
+		c += (*it)->value.len - oc_off;
+
+		*(c++) = CR;
+		*(c++) = LF;
+		break;
+	    }
+	    // fall-through-trap
 	case sip_header::H_FROM:
 	case sip_header::H_CALL_ID:
 	case sip_header::H_CSEQ:
-	case sip_header::H_VIA:
 	case sip_header::H_RECORD_ROUTE:
 	    copy_hdr_wr(&c,*it);
 	    break;
@@ -838,7 +876,7 @@ static void prepare_strict_routing(sip_msg* msg, string& ext_uri_buffer)
 	// remove current route header from message
  	msg->route.pop_front();
 
-	list<sip_header*>::iterator h_it = 
+	sip_header_list::iterator h_it = 
 	    std::find(msg->hdrs.begin(),msg->hdrs.end(),fr);
 
 	if(h_it != msg->hdrs.end()) 
@@ -880,7 +918,7 @@ int _trans_layer::set_next_hop(sip_msg* msg,
     static const cstring default_trsp("udp");
     assert(msg);
 
-    list<sip_header*>& route_hdrs = msg->route; 
+    sip_header_list& route_hdrs = msg->route; 
     int err=0;
 
     if(!route_hdrs.empty()){
@@ -1021,6 +1059,7 @@ static void gen_error_reply_from_req(sip_msg& reply, const sip_msg* req,
 				     int code, const char* reason)
 {
     reply.copy_msg_buf(req->buf,req->len);
+    sip_arena_scope arena_scope(&reply.arena);
 
     reply.type = SIP_REPLY;
     reply.u.reply = new sip_reply();
@@ -1129,10 +1168,10 @@ static int generate_and_parse_new_msg(sip_msg* msg, sip_msg*& p_msg)
     // patch Contact-HF transport parameter
     vector<string> contact_buffers(msg->contacts.size());
     vector<string>::iterator contact_buf_it = contact_buffers.begin();
-    list<sip_header*> n_contacts;
+    sip_header_list n_contacts;
     
     //TODO: patch copies of the Contact-HF instead of the original HFs
-    for(list<sip_header*>::iterator contact_it = msg->contacts.begin();
+    for(sip_header_list::iterator contact_it = msg->contacts.begin();
 	contact_it != msg->contacts.end(); contact_it++, contact_buf_it++) {
 	
 	n_contacts.push_back(new sip_header(**contact_it));
@@ -1202,11 +1241,213 @@ static int generate_and_parse_new_msg(sip_msg* msg, sip_msg*& p_msg)
     return 0;
 }
  
+/**
+ * Copy of a request waiting for its destination
+ * to be resolved (see _trans_layer::park_request()).
+ */
+class parked_request
+    : public dns_query_cb
+{
+public:
+    sip_msg*     msg;
+    trans_ticket tt;
+    string       dialog_id;
+    string       next_hop;
+    int          out_interface;
+    unsigned int flags;
+    msg_logger*  logger;
+    unsigned int dns_rounds;
+
+    parked_request(sip_msg* msg, const cstring& dialog_id,
+		   const cstring& next_hop, int out_interface,
+		   unsigned int flags, msg_logger* logger,
+		   unsigned int dns_rounds)
+	: msg(msg),
+	  dialog_id(c2stlstr(dialog_id)),
+	  next_hop(c2stlstr(next_hop)),
+	  out_interface(out_interface),
+	  flags(flags),
+	  logger(logger),
+	  dns_rounds(dns_rounds)
+    {
+	if(logger) inc_ref(logger);
+    }
+
+    ~parked_request()
+    {
+	delete msg;
+	if(logger) dec_ref(logger);
+    }
+
+    void dns_resolved(const string& name, dns_rr_type t, int err)
+    {
+	trans_layer::instance()->resume_request(this);
+    }
+};
+
+/**
+ * Deep copy of a request built by the UA, whose
+ * buffers do not outlive send_request().
+ */
+static sip_msg* copy_uac_request(const sip_msg* msg)
+{
+    const sip_request* req = msg->u.request;
+    int fline_len = request_line_len(req->method_str,req->ruri_str);
+    int request_len = fline_len + copy_hdrs_len(msg->hdrs)
+	+ 2/* CRLF end-of-headers*/ + msg->body.len;
+
+    sip_msg* p_msg = new sip_msg();
+    p_msg->buf = new char[request_len+1];
+    p_msg->len = request_len;
+
+    char* c = p_msg->buf;
+    request_line_wr(&c,req->method_str,req->ruri_str);
+    copy_hdrs_wr(&c,msg->hdrs);
+    *c++ = CR;
+    *c++ = LF;
+
+    char* body = c;
+    if(msg->body.len) {
+	memcpy(c,msg->body.s,msg->body.len);
+	c += msg->body.len;
+    }
+    *c = '\0';
+
+    p_msg->type = SIP_REQUEST;
+    p_msg->u.request = new sip_request();
+    p_msg->u.request->method_str.set(p_msg->buf,req->method_str.len);
+    p_msg->u.request->ruri_str.set(p_msg->buf + req->method_str.len + 1,
+				   req->ruri_str.len);
+    parse_method(&p_msg->u.request->method,
+		 p_msg->u.request->method_str.s,
+		 p_msg->u.request->method_str.len);
+
+    c = p_msg->buf + fline_len;
+    if(parse_headers(p_msg,&c,body) ||
+       !p_msg->callid || !p_msg->cseq) {
+	delete p_msg;
+	return NULL;
+    }
+    p_msg->body.set(body,msg->body.len);
+
+    // needed for the transaction bucket
+    sip_cseq* cseq = new sip_cseq();
+    if(parse_cseq(cseq,p_msg->cseq->value.s,p_msg->cseq->value.len) ||
+       !cseq->num_str.len) {
+	delete cseq;
+	delete p_msg;
+	return NULL;
+    }
+    p_msg->cseq->p = cseq;
+
+    return p_msg;
+}
+
+int _trans_layer::park_request(sip_msg* msg, trans_ticket* tt,
+			       const cstring& dialog_id,
+			       const cstring& _next_hop,
+			       int out_interface, unsigned int flags,
+			       msg_logger* logger, unsigned int dns_rounds,
+			       const string& name, dns_rr_type t)
+{
+    sip_msg* p_msg = copy_uac_request(msg);
+    if(!p_msg) {
+	DBG("could not copy request: not parked");
+	return -1;
+    }
+
+    parked_request* r = new parked_request(p_msg,dialog_id,_next_hop,
+					   out_interface,flags,logger,
+					   dns_rounds);
+    inc_ref(r);
+
+    // the transaction will be created in this bucket
+    tt->_bucket = get_trans_bucket(p_msg->callid->value,
+				   get_cseq(p_msg)->num_str);
+    tt->_t = NULL;
+
+    parked_mut.lock();
+    parked.push_back(r);
+    parked_mut.unlock();
+
+    DBG("request <%.*s %.*s> parked until '%s' (%s) is resolved",
+	p_msg->u.request->method_str.len,p_msg->u.request->method_str.s,
+	p_msg->u.request->ruri_str.len,p_msg->u.request->ruri_str.s,
+	name.c_str(),dns_rr_type_str(t));
+
+    resolver::instance()->query_async(name,t,r);
+    return 0;
+}
+
+void _trans_layer::resume_request(parked_request* r)
+{
+    parked_mut.lock();
+    list<parked_request*>::iterator it =
+	std::find(parked.begin(),parked.end(),r);
+    if(it == parked.end()) {
+	// canceled in the meantime
+	parked_mut.unlock();
+	return;
+    }
+    parked.erase(it);
+    parked_mut.unlock();
+
+    sip_msg* msg = r->msg;
+    int res = send_request(msg,&r->tt,stl2cstr(r->dialog_id),
+			   stl2cstr(r->next_hop),r->out_interface,
+			   r->flags,r->logger,r->dns_rounds);
+
+    // nobody waits for the return code anymore
+    if((res < 0) && (msg->u.request->method != sip_request::ACK)) {
+	sip_msg err;
+	if(res == -478)
+	    set_err_reply_from_req(&err,msg,478,"Unresolvable destination");
+	else
+	    set_err_reply_from_req(&err,msg,500,"Internal Server Error");
+	ua->handle_sip_reply(r->dialog_id,&err);
+    }
+
+    dec_ref(r);
+}
+
+parked_request* _trans_layer::unpark_invite(const cstring& dialog_id,
+					    unsigned int inv_cseq)
+{
+    parked_request* r = NULL;
+
+    parked_mut.lock();
+    for(list<parked_request*>::iterator it = parked.begin();
+	it != parked.end(); ++it) {
+
+	sip_msg* msg = (*it)->msg;
+	if((msg->u.request->method == sip_request::INVITE) &&
+	   (get_cseq(msg)->num == inv_cseq) &&
+	   ((*it)->dialog_id == c2stlstr(dialog_id))) {
+	    r = *it;
+	    parked.erase(it);
+	    break;
+	}
+    }
+    parked_mut.unlock();
+
+    return r;
+}
+
 int _trans_layer::send_request(sip_msg* msg, trans_ticket* tt,
 			       const cstring& dialog_id,
 			       const cstring& _next_hop, 
 			       int out_interface, unsigned int flags,
 			       msg_logger* logger)
+{
+    return send_request(msg,tt,dialog_id,_next_hop,
+			out_interface,flags,logger,0);
+}
+
+int _trans_layer::send_request(sip_msg* msg, trans_ticket* tt,
+			       const cstring& dialog_id,
+			       const cstring& _next_hop, 
+			       int out_interface, unsigned int flags,
+			       msg_logger* logger, unsigned int dns_rounds)
 {
     // Request-URI
     // To
@@ -1242,6 +1483,16 @@ int _trans_layer::send_request(sip_msg* msg, trans_ticket* tt,
 	dest_list.push_back(dest);
     }
 
+    // do not wait for the DNS: send the request once it has answered
+    string dns_name;
+    dns_rr_type dns_type;
+    if((dns_rounds < MAX_DNS_ROUNDS) &&
+       resolver::instance()->missing_target(dest_list,dns_name,dns_type) &&
+       !park_request(msg,tt,dialog_id,_next_hop,out_interface,flags,
+		     logger,dns_rounds+1,dns_name,dns_type)) {
+	return 0;
+    }
+
     std::unique_ptr<sip_target_set> targets(new sip_target_set());
     res = resolver::instance()->resolve_targets(dest_list,targets.get());
     if(res < 0){
@@ -1395,13 +1646,13 @@ int _trans_layer::cancel(trans_ticket* tt, const cstring& dialog_id,
 			 unsigned int inv_cseq, const cstring& hdrs)
 {
     assert(tt);
-    assert(tt->_bucket && tt->_t);
+    assert(tt->_bucket);
 
     trans_bucket* bucket = tt->_bucket;
     sip_trans*    t = tt->_t;
 
     bucket->lock();
-    if(!bucket->exist(t) || (t->state == TS_ABANDONED)){
+    if(!t || !bucket->exist(t) || (t->state == TS_ABANDONED)){
 	if(dialog_id.len)
 	    t = bucket->find_uac_trans(dialog_id,inv_cseq);
 	else
@@ -1410,6 +1661,19 @@ int _trans_layer::cancel(trans_ticket* tt, const cstring& dialog_id,
 
     if(!t){
 	bucket->unlock();
+
+	// still waiting for the DNS?
+	parked_request* r = dialog_id.len ?
+	    unpark_invite(dialog_id,inv_cseq) : NULL;
+	if(r) {
+	    DBG("Canceling parked request\n");
+	    sip_msg reply;
+	    set_err_reply_from_req(&reply,r->msg,487,"Request Terminated");
+	    ua->handle_sip_reply(r->dialog_id,&reply);
+	    dec_ref(r);
+	    return 0;
+	}
+
 	DBG("No transaction to cancel: wrong key or finally replied\n");
 	return 0;
     }
@@ -1578,6 +1842,9 @@ int _trans_layer::cancel(trans_ticket* tt, const cstring& dialog_id,
 
 void _trans_layer::received_msg(sip_msg* msg)
 {
+    // kernel receive time, if the transport has it
+    struct timespec recv_ts = msg->recv_ts;
+
     char* err_msg=0;
     int err = parse_sip_msg(msg,err_msg);
 
@@ -1603,7 +1870,22 @@ void _trans_layer::received_msg(sip_msg* msg)
 	DROP_MSG;
     }
 
+    // keep-alives: no transaction needed
+    if(keepalive.enabled() && keepalive.handle(msg)) {
+	stats.inc_received_requests();
+	DROP_MSG;
+    }
+
     process_rcvd_msg(msg);
+
+    if(recv_ts.tv_sec) {
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME,&now);
+	long long us = (now.tv_sec - recv_ts.tv_sec) * 1000000LL
+	    + (now.tv_nsec - recv_ts.tv_nsec) / 1000;
+	if(us > 0)
+	    stats.add_received_latency(us);
+    }
 }
 
 void _trans_layer::process_rcvd_msg(sip_msg* msg)
@@ -1700,6 +1982,15 @@ void _trans_layer::process_rcvd_msg(sip_msg* msg)
                      // no break
  
                  default:
+                     // Overloaded: reject before a transaction
+                     // and a session get created
+                     if(overload.rejecting() &&
+                        (overload.match(msg) == overload_filter::REJECT)) {
+                         bucket->unlock();
+                         overload.reject(msg);
+                         DROP_MSG;
+                     }
+
                      // New transaction
                      t = bucket->add_trans(msg, TT_UAS);
  
@@ -2750,6 +3041,9 @@ int _trans_layer::try_next_ip(trans_bucket* bucket, sip_trans* tr,
 	    compute_branch((char*)(tr->msg->via_p1->branch.s+MAGIC_BRANCH_LEN),
 			   tr->msg->callid->value,tr->msg->cseq->value);
 	}
+
+	// new branch in any case
+	bucket->update_branch(tr);
     }
    
 
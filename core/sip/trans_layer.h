@@ -34,6 +34,11 @@
 #include "atomic_types.h"
 
 #include "parse_next_hop.h"
+#include "parse_dns.h"
+#include "sl_responder.h"
+#include "overload_filter.h"
+
+#include "AmThread.h"
 
 #include <list>
 using std::list;
@@ -57,6 +62,7 @@ struct sip_target_set;
 
 class trans_ticket;
 class trans_bucket;
+class parked_request;
 class trans_timer;
 class trsp_socket;
 class sip_ua;
@@ -82,6 +88,8 @@ class trans_stats
     atomic_int received_replies;
     atomic_int sent_reply_retrans;
     atomic_int sent_request_retrans;
+    atomic_int received_latency_us;
+    atomic_int received_latency_n;
 
   public:
 
@@ -103,6 +111,12 @@ class trans_stats
     /** increment number of sent reply retransmissions */
     void inc_sent_reply_retrans() { sent_reply_retrans.inc(); }
 
+    /** add the time from reception by the kernel until
+     *  the transaction layer is done with a message */
+    void add_received_latency(unsigned int us) {
+      received_latency_us.inc(us);
+      received_latency_n.inc();
+    }
 
     unsigned get_sent_requests() const { return sent_requests.get(); }
     unsigned get_sent_replies() const { return sent_replies.get(); }
@@ -110,6 +124,10 @@ class trans_stats
     unsigned get_received_replies() const { return received_replies.get(); }
     unsigned get_sent_request_retrans() const { return sent_request_retrans.get(); }
     unsigned get_sent_reply_retrans() const { return sent_reply_retrans.get(); }
+
+    /** both wrap around: only differences are meaningful */
+    unsigned get_received_latency_us() const { return received_latency_us.get(); }
+    unsigned get_received_latency_n() const { return received_latency_n.get(); }
 };
 
 /** 
@@ -119,14 +137,22 @@ class trans_stats
 class _trans_layer
 {
 private:
-    trans_stats stats;
-    sip_ua*     ua;
+    trans_stats  stats;
+    sip_ua*      ua;
+    sl_responder keepalive;
+    overload_filter overload;
 
     struct less_case_i { bool operator ()(const string& lhs, const string& rhs) const; };
     typedef map<string,trsp_socket*,less_case_i> prot_collection;
 
     vector<prot_collection> transports;
 
+    // requests waiting for a DNS answer
+    AmMutex               parked_mut;
+    list<parked_request*> parked;
+
+    friend class parked_request;
+
 public:
 
     /**
@@ -171,8 +197,18 @@ public:
      * Sends a UAC request.
      * Caution: Route headers should not be added to the
      * general header list (msg->hdrs).
+     * If the destination is not in the DNS cache, a copy of
+     * the request is parked and sent from the resolver thread
+     * once the name has been resolved; errors are then reported
+     * as local replies.
      * @param [in]  msg Pre-built message.
-     * @param [out] tt transaction ticket (needed for replies & CANCEL)
+     * @param [out] tt transaction ticket (needed for replies & CANCEL).
+     *                 For a parked request, it only refers to the
+     *                 bucket: the transaction created later is not
+     *                 attached to it (get_trans() returns NULL and
+     *                 remove_trans() does nothing); cancel() looks
+     *                 it up by dialog ID and CSeq instead, and
+     *                 'logger' logs the request when it is sent.
      */
     int send_request(sip_msg* msg, trans_ticket* tt, const cstring& dialog_id,
 		     const cstring& _next_hop, int out_interface = -1,
@@ -215,10 +251,13 @@ public:
      * If a body is included, the hdrs parameter should
      * include a well-formed 'Content-Type', but no
      * 'Content-Length' header.
+     * If the topmost Via carries an 'oc' parameter without
+     * value (RFC 7339), oc_value is set as its value.
      */
     int send_sl_reply(sip_msg* req, int reply_code, 
 		      const cstring& reason, 
-		      const cstring& hdrs, const cstring& body);
+		      const cstring& hdrs, const cstring& body,
+		      const cstring& oc_value = cstring());
     
     /**
      * Sends a stateful error reply.
@@ -245,6 +284,12 @@ public:
 
     const trans_stats &get_stats() { return stats; }
 
+    /** Stateless keep-alive responder (see received_msg()) */
+    sl_responder& get_sl_responder() { return keepalive; }
+
+    /** Stateless rejection of new requests (see process_rcvd_msg()) */
+    overload_filter& get_overload_filter() { return overload; }
+
 protected:
 
     /**
@@ -264,6 +309,36 @@ protected:
 
     sip_trans* copy_uac_trans(sip_trans* tr);
 
+    /**
+     * @param dns_rounds number of times the request
+     *                   has already been parked.
+     */
+    int send_request(sip_msg* msg, trans_ticket* tt, const cstring& dialog_id,
+		     const cstring& _next_hop, int out_interface,
+		     unsigned int flags, msg_logger* logger,
+		     unsigned int dns_rounds);
+
+    /**
+     * Parks a copy of the request until 'name'
+     * has been resolved (see resume_request()).
+     * @return 0 on success, -1 if the request cannot be copied.
+     */
+    int park_request(sip_msg* msg, trans_ticket* tt, const cstring& dialog_id,
+		     const cstring& _next_hop, int out_interface,
+		     unsigned int flags, msg_logger* logger,
+		     unsigned int dns_rounds,
+		     const string& name, dns_rr_type t);
+
+    /** Sends a parked request (resolver thread). */
+    void resume_request(parked_request* r);
+
+    /**
+     * Drops the parked INVITE of the dialog, if any.
+     * @return the request (to be released by the caller) or NULL.
+     */
+    parked_request* unpark_invite(const cstring& dialog_id,
+				  unsigned int inv_cseq);
+
     /**
      * If the destination has multiple IPs (SRV records),
      * try the next destination IP.
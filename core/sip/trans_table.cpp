@@ -41,22 +41,63 @@
 #include "log.h"
 
 #include <assert.h>
+#include <string.h>
 
 //
 // Global transaction table
 //
 
-hash_table<trans_bucket> _trans_table(H_TABLE_ENTRIES);
+static hash_table<trans_bucket>* _trans_table =
+    new hash_table<trans_bucket>(H_TABLE_ENTRIES);
 
 trans_bucket::trans_bucket(unsigned long id)
-    : ht_bucket<sip_trans>::ht_bucket(id)
+    : ht_ilist_bucket<sip_trans>::ht_ilist_bucket(id)
 {
+    memset(branches,0,sizeof(branches));
 }
 
 trans_bucket::~trans_bucket()
 {
 }
 
+static inline int get_branch_slot(const cstring& branch)
+{
+    // the magic cookie is the same for all
+    return hashlittle(branch.s + MAGIC_BRANCH_LEN,
+		      branch.len - MAGIC_BRANCH_LEN,0)
+	% TRANS_BRANCH_SLOTS;
+}
+
+void trans_bucket::link_branch(sip_trans* t)
+{
+    if(!t->msg || !t->msg->via_p1 ||
+       (t->msg->via_p1->branch.len <= MAGIC_BRANCH_LEN)) {
+	// only found by scanning the bucket
+	t->branch_slot = -1;
+	return;
+    }
+
+    t->branch_slot = get_branch_slot(t->msg->via_p1->branch);
+    t->branch_next = branches[t->branch_slot];
+    branches[t->branch_slot] = t;
+}
+
+void trans_bucket::unlink_branch(sip_trans* t)
+{
+    if(t->branch_slot < 0)
+	return;
+
+    sip_trans** p = &branches[t->branch_slot];
+    while(*p && (*p != t))
+	p = &(*p)->branch_next;
+
+    if(*p)
+	*p = t->branch_next;
+
+    t->branch_next = NULL;
+    t->branch_slot = -1;
+}
+
 // return true if equal
 static inline bool compare_branch(sip_trans* t, sip_msg* msg,
 				  const char* branch, unsigned int branch_len)
@@ -101,7 +142,7 @@ sip_trans* trans_bucket::match_request(sip_msg* msg, unsigned int ttype)
     //this should have been checked before
     assert(msg->via_p1);
 
-    if(elmts.empty())
+    if(!first)
 	return NULL;
 
     bool do_3261_match = false;
@@ -121,43 +162,53 @@ sip_trans* trans_bucket::match_request(sip_msg* msg, unsigned int ttype)
 	const char* branch = msg->via_p1->branch.s + MAGIC_BRANCH_LEN;
 	int   len = msg->via_p1->branch.len - MAGIC_BRANCH_LEN;
 	
-	trans_list::iterator it = elmts.begin();
-	for(;it!=elmts.end();++it) {
+	sip_trans* it = branches[get_branch_slot(msg->via_p1->branch)];
+	for(;it;it=it->branch_next) {
 	    
-	    if( ((*it)->msg->type != SIP_REQUEST) ||
-		((*it)->type != ttype)){
+	    if( (it->msg->type != SIP_REQUEST) ||
+		(it->type != ttype)){
 		continue;
 	    }
 
-	    if(msg->u.request->method != (*it)->msg->u.request->method) {
+	    if(msg->u.request->method != it->msg->u.request->method) {
 
 		// ACK is the only request that should match an existing
-		// transaction without being a re-transmission
-		if( ((*it)->msg->u.request->method == sip_request::INVITE)
-		    && (msg->u.request->method == sip_request::ACK)) {
-		
-		    // match non-200 ACK first
-		    if(compare_branch(*it,msg,branch,(unsigned int)len)) {
-			t = *it;
-			break;
-		    }
-
-		    // branches do not match,
-		    // try to match a 200-ACK
-		    if((t = match_200_ack(*it,msg)) != NULL)
-			break;
+		// transaction without being a re-transmission:
+		// match non-200 ACK first
+		if( (it->msg->u.request->method == sip_request::INVITE)
+		    && (msg->u.request->method == sip_request::ACK)
+		    && compare_branch(it,msg,branch,(unsigned int)len)) {
+		    t = it;
+		    break;
 		}
 
 		continue;
 	    }
 
-	    if(!compare_branch(*it,msg,branch,(unsigned int)len))
+	    if(!compare_branch(it,msg,branch,(unsigned int)len))
 		continue;
 
 	    // found matching transaction
-	    t = *it; 
+	    t = it; 
 	    break;
 	}
+
+	if(!t && (msg->u.request->method == sip_request::ACK)) {
+
+	    // branches do not match,
+	    // try to match a 200-ACK
+	    for(it = first; it; it = it->ht_next) {
+
+		if( (it->msg->type != SIP_REQUEST) ||
+		    (it->type != ttype) ||
+		    (it->msg->u.request->method != sip_request::INVITE) ){
+		    continue;
+		}
+
+		if((t = match_200_ack(it,msg)) != NULL)
+		    break;
+	    }
+	}
     }
     else {
 
@@ -169,8 +220,8 @@ sip_trans* trans_bucket::match_request(sip_msg* msg, unsigned int ttype)
 
 	assert(from && to && cseq);
 
-	trans_list::iterator it = elmts.begin();
-	for(;it!=elmts.end();++it) {
+	sip_trans* it = first;
+	for(;it;it=it->ht_next) {
 
 	    
 	    //Request matching:
@@ -189,21 +240,21 @@ sip_trans* trans_bucket::match_request(sip_msg* msg, unsigned int ttype)
 	    // top Via
 	    // + To-tag of reply
 
-	    if( ((*it)->msg->type != SIP_REQUEST) ||
-		((*it)->type != ttype)){
+	    if( (it->msg->type != SIP_REQUEST) ||
+		(it->type != ttype)){
 		continue;
 	    }
 
-	    if( (msg->u.request->method != (*it)->msg->u.request->method) &&
+	    if( (msg->u.request->method != it->msg->u.request->method) &&
 		( (msg->u.request->method != sip_request::ACK) ||
-		  ((*it)->msg->u.request->method != sip_request::INVITE) ) )
+		  (it->msg->u.request->method != sip_request::INVITE) ) )
 		continue;
 
-	    sip_from_to* it_from = dynamic_cast<sip_from_to*>((*it)->msg->from->p);
+	    sip_from_to* it_from = dynamic_cast<sip_from_to*>(it->msg->from->p);
 	    if(from->tag.len != it_from->tag.len)
 		continue;
 
-	    sip_cseq* it_cseq = dynamic_cast<sip_cseq*>((*it)->msg->cseq->p);
+	    sip_cseq* it_cseq = dynamic_cast<sip_cseq*>(it->msg->cseq->p);
 	    if(cseq->num_str.len != it_cseq->num_str.len)
 		continue;
 
@@ -217,26 +268,26 @@ sip_trans* trans_bucket::match_request(sip_msg* msg, unsigned int ttype)
 	    if(msg->u.request->method == sip_request::ACK){
 		
 		// ACKs must include To-tag from previous reply
-		if(to->tag.len != (*it)->to_tag.len)
+		if(to->tag.len != it->to_tag.len)
 		    continue;
 
-		if(memcmp(to->tag.s,(*it)->to_tag.s,to->tag.len))
+		if(memcmp(to->tag.s,it->to_tag.s,to->tag.len))
 		    continue;
 
-		if((*it)->reply_status < 300){
+		if(it->reply_status < 300){
 
 		    // 2xx ACK matching
 
 		    // TODO: additional work for dialog matching???
 		    //      R-URI should match reply Contact ...
 		    //      Anyway, we don't keep the contact from reply.
-		    t = *it;
+		    t = it;
 		    break;
 		}
 	    }
 	    else { 
 		// non-ACK
-		sip_from_to* it_to = dynamic_cast<sip_from_to*>((*it)->msg->to->p);
+		sip_from_to* it_to = dynamic_cast<sip_from_to*>(it->msg->to->p);
 		if(to->tag.len != it_to->tag.len)
 		    continue;
 
@@ -246,19 +297,19 @@ sip_trans* trans_bucket::match_request(sip_msg* msg, unsigned int ttype)
 
 	    // non-ACK and non-2xx ACK matching
 
-	    if((*it)->msg->u.request->ruri_str.len != 
+	    if(it->msg->u.request->ruri_str.len != 
 	       msg->u.request->ruri_str.len )
 		continue;
 	    
 	    if(memcmp(msg->u.request->ruri_str.s,
-		      (*it)->msg->u.request->ruri_str.s,
+		      it->msg->u.request->ruri_str.s,
 		      msg->u.request->ruri_str.len))
 		continue;
 	    
 	    //TODO: missing top-Via matching
 	    
 	    // found matching transaction
-	    t = *it;
+	    t = it;
 	    break;
 	}
     }
@@ -269,7 +320,7 @@ sip_trans* trans_bucket::match_request(sip_msg* msg, unsigned int ttype)
 sip_trans* trans_bucket::match_reply(sip_msg* msg)
 {
 
-    if(elmts.empty())
+    if(!first)
 	return NULL;
 
     assert(msg->via_p1);
@@ -285,36 +336,36 @@ sip_trans* trans_bucket::match_reply(sip_msg* msg)
     
     assert(get_cseq(msg));
 
-    trans_list::iterator it = elmts.begin();
-    for(;it!=elmts.end();++it) {
+    sip_trans* it = branches[get_branch_slot(msg->via_p1->branch)];
+    for(;it;it=it->branch_next) {
 	
-	if((*it)->type != TT_UAC){
+	if(it->type != TT_UAC){
 	    continue;
 	}
 
-	if((*it)->msg->via_p1->branch.len != msg->via_p1->branch.len)
+	if(it->msg->via_p1->branch.len != msg->via_p1->branch.len)
 	    continue;
 	
-	if(get_cseq((*it)->msg)->num_str.len != get_cseq(msg)->num_str.len)
+	if(get_cseq(it->msg)->num_str.len != get_cseq(msg)->num_str.len)
 	    continue;
 
-	if(get_cseq((*it)->msg)->method_str.len != get_cseq(msg)->method_str.len)
+	if(get_cseq(it->msg)->method_str.len != get_cseq(msg)->method_str.len)
 	    continue;
 
-	if(memcmp((*it)->msg->via_p1->branch.s+MAGIC_BRANCH_LEN,
+	if(memcmp(it->msg->via_p1->branch.s+MAGIC_BRANCH_LEN,
 		  branch,len))
 	    continue;
 
-	if(memcmp(get_cseq((*it)->msg)->num_str.s,get_cseq(msg)->num_str.s,
+	if(memcmp(get_cseq(it->msg)->num_str.s,get_cseq(msg)->num_str.s,
 		  get_cseq(msg)->num_str.len))
 	    continue;
 
-	if(memcmp(get_cseq((*it)->msg)->method_str.s,get_cseq(msg)->method_str.s,
+	if(memcmp(get_cseq(it->msg)->method_str.s,get_cseq(msg)->method_str.s,
 		  get_cseq(msg)->method_str.len))
 	    continue;
 
 	// found matching transaction
-	t = *it;
+	t = it;
 	break;
     }
 
@@ -362,16 +413,14 @@ sip_trans* trans_bucket::match_1xx_prack(sip_msg* msg)
 	msg->u.request->method_str.len,
 	msg->u.request->method_str.s);
 
-    if(elmts.empty())
+    if(!first)
 	return NULL;
     
-    trans_list::iterator it = elmts.begin();
-    for(;it!=elmts.end();++it) {
+    for(sip_trans* t = first; t; t = t->ht_next) {
 	    
-	if( (*it)->msg->type != SIP_REQUEST ){
+	if( t->msg->type != SIP_REQUEST ){
 	    continue;
 	}
-	sip_trans* t = *it;
 
 	/* first, check quickly if lenghts match (From tag, To tag, Call-ID) */
 
@@ -421,13 +470,11 @@ sip_trans* trans_bucket::find_uac_trans(const cstring& dialog_id,
     DBG("Matching dialog_id = '%.*s'\n",
 	dialog_id.len, dialog_id.s);
 
-    if(elmts.empty())
+    if(!first)
 	return NULL;
     
-    trans_list::reverse_iterator it = elmts.rbegin();
-    for(;it!=elmts.rend();++it) {
+    for(sip_trans* t = last; t; t = t->ht_prev) {
 	    
-	sip_trans* t = *it;
 	if( t->type != TT_UAC ||
 	    t->msg->type != SIP_REQUEST ){
 	    continue;
@@ -463,14 +510,32 @@ sip_trans* trans_bucket::add_trans(sip_msg* msg, unsigned int ttype)
 	t->state = TS_TRYING;
     }
 
-    elmts.push_back(t);
+    push_back(t);
+    link_branch(t);
     
     return t;
 }
 
 void trans_bucket::append(sip_trans* t)
 {
-    elmts.push_back(t);
+    push_back(t);
+    link_branch(t);
+}
+
+void trans_bucket::remove(sip_trans* t)
+{
+    if(!exist(t))
+	return;
+
+    unlink_branch(t);
+    unlink(t);
+    delete t;
+}
+
+void trans_bucket::update_branch(sip_trans* t)
+{
+    unlink_branch(t);
+    link_branch(t);
 }
 
 unsigned int hash(const cstring& ci, const cstring& cs)
@@ -560,17 +625,31 @@ void compute_branch(char* branch/*[8]*/, const cstring& callid, const cstring& c
 
 trans_bucket* get_trans_bucket(const cstring& callid, const cstring& cseq_num)
 {
-    return _trans_table[hash(callid,cseq_num)];
+    return (*_trans_table)[hash(callid,cseq_num)];
 }
 
 trans_bucket* get_trans_bucket(unsigned int h)
 {
-    return _trans_table[h];
+    return (*_trans_table)[h];
+}
+
+void set_trans_table_size(unsigned long size)
+{
+    if(!size || (size == _trans_table->get_size()))
+	return;
+
+    delete _trans_table;
+    _trans_table = new hash_table<trans_bucket>(size);
+}
+
+void get_trans_table_stats(ht_stats& s)
+{
+    _trans_table->get_stats(s);
 }
 
 void dumps_transactions()
 {
-    _trans_table.dump();
+    _trans_table->dump();
 }
 
 
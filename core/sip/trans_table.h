@@ -8,18 +8,30 @@
 #define H_TABLE_POWER   10
 #define H_TABLE_ENTRIES (1<<H_TABLE_POWER)
 
+// Via branch index slots per bucket
+#define TRANS_BRANCH_SLOTS 8
+
+/**
+ * Transactions are chained through their own links (see
+ * ht_ilist_bucket) and additionally indexed by the branch
+ * of their top Via, which is all it takes to match replies
+ * and RFC 3261 requests.
+ */
 class trans_bucket: 
-    public ht_bucket<sip_trans>
+    public ht_ilist_bucket<sip_trans>
 {
+    sip_trans* branches[TRANS_BRANCH_SLOTS];
+
     trans_bucket(unsigned long id);
     ~trans_bucket();
 
+    void link_branch(sip_trans* t);
+    void unlink_branch(sip_trans* t);
+
     friend class hash_table<trans_bucket>;
 
 public:
 
-    typedef ht_bucket<sip_trans>::value_list trans_list;
-
     
     // Match a request to UAS/UAC transactions
     // in this bucket
@@ -42,6 +54,12 @@ public:
     // Append the provided transaction to this bucket
     void append(sip_trans* t);
 
+    // Remove and delete the transaction, if still present
+    void remove(sip_trans* t);
+
+    // Re-index the transaction after its branch has changed
+    void update_branch(sip_trans* t);
+
 private:
     sip_trans* match_200_ack(sip_trans* t,sip_msg* msg);
 };
@@ -49,6 +67,15 @@ private:
 trans_bucket* get_trans_bucket(const cstring& callid, const cstring& cseq_num);
 trans_bucket* get_trans_bucket(unsigned int h);
 
+/**
+ * Re-creates the (empty) transaction table with 'size' buckets.
+ * Must be called before the first transaction is created.
+ */
+void set_trans_table_size(unsigned long size);
+
+/** Occupancy and bucket lock statistics */
+void get_trans_table_stats(ht_stats& s);
+
 unsigned int hash(const cstring& ci, const cstring& cs);
 
 
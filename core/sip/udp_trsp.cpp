@@ -47,6 +47,12 @@
 #include <errno.h>
 #include <string.h>
 
+#if defined(__linux__)
+#include <linux/filter.h>
+#include <linux/sock_diag.h>
+#define HAVE_RECVMMSG
+#endif
+
 #if defined IP_RECVDSTADDR
 # define DSTADDR_SOCKOPT IP_RECVDSTADDR
 # define DSTADDR_DATASIZE (CMSG_SPACE(sizeof(struct in_addr)))
@@ -69,6 +75,15 @@
 # error "cant't determine v6 socket option (IPV6_RECVPKTINFO or IPV6_PKTINFO)"
 #endif
 
+/* control data buffer large enough for v4 and v6 destination addresses */
+#define DSTADDR_BUFSIZE \
+    (DSTADDR_DATASIZE > CMSG_SPACE(sizeof(struct in6_pktinfo)) ?	\
+     DSTADDR_DATASIZE : CMSG_SPACE(sizeof(struct in6_pktinfo)))
+
+/* ... and the receive time stamp */
+#define CTRL_BUFSIZE \
+    (DSTADDR_BUFSIZE + CMSG_SPACE(sizeof(struct timespec)))
+
 
 /** @see trsp_socket */
 int udp_trsp_socket::bind(const string& bind_ip, unsigned short bind_port)
@@ -99,6 +114,22 @@ int udp_trsp_socket::bind(const string& bind_ip, unsigned short bind_port)
 	ERROR("socket: %s\n",strerror(errno));
 	return -1;
     } 
+
+    if(socket_options & reuse_port) {
+#ifdef SO_REUSEPORT
+	int reuse = 1;
+	if(setsockopt(sd, SOL_SOCKET, SO_REUSEPORT,
+		      (void*)&reuse, sizeof(reuse)) == -1) {
+	    ERROR("setsockopt(SO_REUSEPORT): %s\n",strerror(errno));
+	    close(sd);
+	    return -1;
+	}
+#else
+	ERROR("SO_REUSEPORT is not supported on this platform\n");
+	close(sd);
+	return -1;
+#endif
+    }
     
     if(::bind(sd,(const struct sockaddr*)&addr,SA_len(&addr))) {
 
@@ -164,6 +195,63 @@ int udp_trsp_socket::set_recvbuf_size(int rcvbuf_size)
     return 0;
 }
 
+int udp_trsp_socket::set_cpu_steering(unsigned int n_socks)
+{
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    // socket index = receiving CPU % group size
+    struct sock_filter code[] = {
+	{ BPF_LD  | BPF_W | BPF_ABS, 0, 0, (__u32)(SKF_AD_OFF + SKF_AD_CPU) },
+	{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, n_socks },
+	{ BPF_RET | BPF_A, 0, 0, 0 }
+    };
+    struct sock_fprog prog = { sizeof(code)/sizeof(code[0]), code };
+
+    if(setsockopt(sd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+		  &prog, sizeof(prog)) == -1) {
+	ERROR("setsockopt(SO_ATTACH_REUSEPORT_CBPF): %s\n",strerror(errno));
+	return -1;
+    }
+
+    DBG("SIP/UDP %s:%i: steering by CPU over %u sockets\n",
+	ip.c_str(),port,n_socks);
+    return 0;
+#else
+    ERROR("SO_REUSEPORT CPU steering is not supported on this platform\n");
+    return -1;
+#endif
+}
+
+int udp_trsp_socket::set_timestamping()
+{
+#ifdef SO_TIMESTAMPNS
+    int true_opt = 1;
+    if(setsockopt(sd, SOL_SOCKET, SO_TIMESTAMPNS,
+		  (void*)&true_opt, sizeof (true_opt)) == -1) {
+	ERROR("setsockopt(SO_TIMESTAMPNS): %s\n",strerror(errno));
+	return -1;
+    }
+    return 0;
+#else
+    ERROR("SO_TIMESTAMPNS is not supported on this platform\n");
+    return -1;
+#endif
+}
+
+unsigned int udp_trsp_socket::get_rx_drops()
+{
+#if defined(__linux__) && defined(SO_MEMINFO)
+    u_int32_t mem[SK_MEMINFO_VARS];
+    socklen_t len = sizeof(mem);
+    if(getsockopt(sd, SOL_SOCKET, SO_MEMINFO, mem, &len) == -1) {
+	DBG("getsockopt(SO_MEMINFO): %s\n",strerror(errno));
+	return 0;
+    }
+    return mem[SK_MEMINFO_DROPS];
+#else
+    return 0;
+#endif
+}
+
 int udp_trsp_socket::sendto(const sockaddr_storage* sa, 
 			    const char* msg, 
 			    const int msg_len)
@@ -284,25 +372,6 @@ udp_trsp::~udp_trsp()
 /** @see AmThread */
 void udp_trsp::run()
 {
-    char buf[MAX_UDP_MSGLEN];
-    int buf_len;
-
-    msghdr           msg;
-    cmsghdr*         cmsgptr; 
-    sockaddr_storage from_addr;
-    iovec            iov[1];
-
-    iov[0].iov_base = buf;
-    iov[0].iov_len  = MAX_UDP_MSGLEN;
-
-    memset(&msg,0,sizeof(msg));
-    msg.msg_name       = &from_addr;
-    msg.msg_namelen    = sizeof(sockaddr_storage);
-    msg.msg_iov        = iov;
-    msg.msg_iovlen     = 1;
-    msg.msg_control    = new u_char[DSTADDR_DATASIZE];
-    msg.msg_controllen = DSTADDR_DATASIZE;
-
     if(sock->get_sd()<=0){
 	ERROR("Transport instance not bound\n");
 	return;
@@ -311,75 +380,142 @@ void udp_trsp::run()
     INFO("Started SIP server UDP transport on %s:%i\n",
 	 sock->get_ip(),sock->get_port());
 
+#ifdef HAVE_RECVMMSG
+    const int batch = UDP_RECV_BATCH;
+#else
+    const int batch = 1;
+#endif
+
+    char*            bufs = new char[batch * MAX_UDP_MSGLEN];
+    u_char*          ctrl = new u_char[batch * CTRL_BUFSIZE];
+    sockaddr_storage from_addr[batch];
+    iovec            iov[batch];
+    msghdr*          msg[batch];
+
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr   msgs[batch];
+    memset(msgs,0,sizeof(msgs));
+    for(int i=0; i<batch; i++)
+	msg[i] = &msgs[i].msg_hdr;
+#else
+    msghdr           single_msg;
+    memset(&single_msg,0,sizeof(single_msg));
+    msg[0] = &single_msg;
+#endif
+
+    for(int i=0; i<batch; i++) {
+	iov[i].iov_base = bufs + i * MAX_UDP_MSGLEN;
+	iov[i].iov_len  = MAX_UDP_MSGLEN;
+
+	msg[i]->msg_name    = &from_addr[i];
+	msg[i]->msg_iov     = &iov[i];
+	msg[i]->msg_iovlen  = 1;
+	msg[i]->msg_control = ctrl + i * CTRL_BUFSIZE;
+    }
+
     while(true){
 
-	//DBG("before recvmsg (%s:%i)\n",sock->get_ip(),sock->get_port());
+	// reset the lengths updated by the kernel
+	for(int i=0; i<batch; i++) {
+	    msg[i]->msg_namelen    = sizeof(sockaddr_storage);
+	    msg[i]->msg_controllen = CTRL_BUFSIZE;
+	}
 
-	buf_len = recvmsg(sock->get_sd(),&msg,0);
-	if(buf_len <= 0){
-	    if(!buf_len) continue;
-	    ERROR("recvfrom returned %d: %s\n",buf_len,strerror(errno));
+#ifdef HAVE_RECVMMSG
+	// block for the first message only
+	int n = recvmmsg(sock->get_sd(),msgs,batch,MSG_WAITFORONE,NULL);
+#else
+	int n = recvmsg(sock->get_sd(),msg[0],0);
+#endif
+	if(n <= 0){
+	    if(!n) continue;
+	    if(errno == EINTR) continue;
+	    ERROR("recvmsg returned %d: %s\n",n,strerror(errno));
 	    switch(errno){
 	    case EBADF:
 	    case ENOTSOCK:
 	    case EOPNOTSUPP:
+		delete [] bufs;
+		delete [] ctrl;
 		return;
 	    }
 	    continue;
 	}
 
-	if(buf_len > MAX_UDP_MSGLEN){
-	    ERROR("Message was too big (>%d)\n",MAX_UDP_MSGLEN);
-	    continue;
-	}
+#ifdef HAVE_RECVMMSG
+	for(int i=0; i<n; i++)
+	    handle_msg(msg[i],(char*)iov[i].iov_base,msgs[i].msg_len);
+#else
+	handle_msg(msg[0],(char*)iov[0].iov_base,n);
+#endif
+    }
+}
 
-	sockaddr_storage* sa = (sockaddr_storage*)msg.msg_name;
-	if(!am_get_port(sa)) {
-	    DBG("Source port is 0: dropping");
-	    continue;
-	}
+void udp_trsp::handle_msg(msghdr* msg, char* buf, int buf_len)
+{
+    cmsghdr* cmsgptr;
 
-	sip_msg* s_msg = new sip_msg(buf,buf_len);
-	memcpy(&s_msg->remote_ip,msg.msg_name,msg.msg_namelen);
-
-	if (trsp_socket::log_level_raw_msgs >= 0) {
-	    char host[NI_MAXHOST] = "";
-	    _LOG(trsp_socket::log_level_raw_msgs, 
-		 "vv M [|] u recvd msg via UDP from %s:%i vv\n"
-		 "--++--\n%.*s--++--\n",
-		 am_inet_ntop_sip(&s_msg->remote_ip,host,NI_MAXHOST),
-		 am_get_port(&s_msg->remote_ip),
-		 s_msg->len, s_msg->buf);
-	}
+    if(!buf_len)
+	return;
+
+    if((buf_len > MAX_UDP_MSGLEN) || (msg->msg_flags & MSG_TRUNC)){
+	ERROR("Message was too big (>%d)\n",MAX_UDP_MSGLEN);
+	return;
+    }
+
+    sockaddr_storage* sa = (sockaddr_storage*)msg->msg_name;
+    if(!am_get_port(sa)) {
+	DBG("Source port is 0: dropping");
+	return;
+    }
+
+    sip_msg* s_msg = new sip_msg(buf,buf_len);
+    memcpy(&s_msg->remote_ip,msg->msg_name,msg->msg_namelen);
+
+    if (trsp_socket::log_level_raw_msgs >= 0) {
+	char host[NI_MAXHOST] = "";
+	_LOG(trsp_socket::log_level_raw_msgs, 
+	     "vv M [|] u recvd msg via UDP from %s:%i vv\n"
+	     "--++--\n%.*s--++--\n",
+	     am_inet_ntop_sip(&s_msg->remote_ip,host,NI_MAXHOST),
+	     am_get_port(&s_msg->remote_ip),
+	     s_msg->len, s_msg->buf);
+    }
 
-	s_msg->local_socket = sock;
-	inc_ref(sock);
+    s_msg->local_socket = sock;
+    inc_ref(sock);
 
-	for (cmsgptr = CMSG_FIRSTHDR(&msg);
-             cmsgptr != NULL;
-             cmsgptr = CMSG_NXTHDR(&msg, cmsgptr)) {
+    for (cmsgptr = CMSG_FIRSTHDR(msg);
+	 cmsgptr != NULL;
+	 cmsgptr = CMSG_NXTHDR(msg, cmsgptr)) {
 	    
-            if (cmsgptr->cmsg_level == IPPROTO_IP &&
-                cmsgptr->cmsg_type == DSTADDR_SOCKOPT) {
+	if (cmsgptr->cmsg_level == IPPROTO_IP &&
+	    cmsgptr->cmsg_type == DSTADDR_SOCKOPT) {
 		
-		s_msg->local_ip.ss_family = AF_INET;
-	        am_set_port(&s_msg->local_ip,sock->get_port());
-                memcpy(&((sockaddr_in*)(&s_msg->local_ip))->sin_addr,
-		       dstaddr(cmsgptr),sizeof(in_addr));
-            }
-	    else if(cmsgptr->cmsg_level == IPPROTO_IPV6 &&
-		    cmsgptr->cmsg_type == IPV6_PKTINFO) {
-
-		s_msg->local_ip.ss_family = AF_INET6;
-	        am_set_port(&s_msg->local_ip,sock->get_port());
-                memcpy(&((sockaddr_in6*)(&s_msg->local_ip))->sin6_addr,
-		       dstaddr6(cmsgptr),sizeof(in6_addr));
-	    }
-        }
+	    s_msg->local_ip.ss_family = AF_INET;
+	    am_set_port(&s_msg->local_ip,sock->get_port());
+	    memcpy(&((sockaddr_in*)(&s_msg->local_ip))->sin_addr,
+		   dstaddr(cmsgptr),sizeof(in_addr));
+	}
+	else if(cmsgptr->cmsg_level == IPPROTO_IPV6 &&
+		cmsgptr->cmsg_type == IPV6_PKTINFO) {
 
-	// pass message to the parser / transaction layer
-	trans_layer::instance()->received_msg(s_msg);
+	    s_msg->local_ip.ss_family = AF_INET6;
+	    am_set_port(&s_msg->local_ip,sock->get_port());
+	    memcpy(&((sockaddr_in6*)(&s_msg->local_ip))->sin6_addr,
+		   dstaddr6(cmsgptr),sizeof(in6_addr));
+	}
+#ifdef SO_TIMESTAMPNS
+	else if(cmsgptr->cmsg_level == SOL_SOCKET &&
+		cmsgptr->cmsg_type == SCM_TIMESTAMPNS) {
+
+	    memcpy(&s_msg->recv_ts,CMSG_DATA(cmsgptr),sizeof(struct timespec));
+	}
+#endif
     }
+
+    // pass message to the parser / transaction layer
+    trans_layer::instance()->received_msg(s_msg);
 }
 
 /** @see AmThread */
@@ -37,6 +37,12 @@
  */
 #define MAX_UDP_MSGLEN 65535
 
+/**
+ * Maximum number of messages read
+ * with one system call (recvmmsg)
+ */
+#define UDP_RECV_BATCH 16
+
 #include <sys/socket.h>
 
 #include <string>
@@ -65,6 +71,28 @@ public:
 
     int set_recvbuf_size(int rcvbuf_size);
 
+    /**
+     * Distribute the messages over the sockets of this socket's
+     * SO_REUSEPORT group by the CPU which received them, instead
+     * of the flow hash (source and destination address).
+     * @param n_socks number of sockets in the group
+     * @return -1 if not supported or error(s) occured.
+     */
+    int set_cpu_steering(unsigned int n_socks);
+
+    /**
+     * Have the kernel time-stamp the received messages
+     * (see sip_msg::recv_ts).
+     * @return -1 if not supported or error(s) occured.
+     */
+    int set_timestamping();
+
+    /**
+     * Datagrams dropped by the kernel on this socket so
+     * far (receive queue full); 0 if not supported.
+     */
+    unsigned int get_rx_drops();
+
     /**
      * Sends a message.
      * @return -1 if error(s) occured.
@@ -75,6 +103,9 @@ public:
 
 class udp_trsp: public transport
 {
+    /** pass a received message to the transaction layer */
+    void handle_msg(msghdr* msg, char* buf, int buf_len);
+
 protected:
     /** @see AmThread */
     void run();
@@ -29,37 +29,140 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <time.h>
 #include <sys/time.h>
 
 #include "AmThread.h"
+#include "AmConfig.h"
+#include "AmArg.h"
 #include "wheeltimer.h"
 
 #include "log.h"
 
+#if defined(__linux__)
+#define HAVE_CLOCK_NANOSLEEP
+#endif
 
 timer::~timer()
 {
     // DBG("timer::~timer(this=%p)\n",this);
 }
 
+inline bool less_ts(unsigned int t1, unsigned int t2)
+{
+    // t1 < t2
+    return (t1 - t2 > (unsigned int)(1<<31));
+}
+
+static inline u_int64_t monotonic_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return (u_int64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+static void sleep_until_us(u_int64_t deadline)
+{
+#ifdef HAVE_CLOCK_NANOSLEEP
+    struct timespec ts;
+    ts.tv_sec  = deadline / 1000000ULL;
+    ts.tv_nsec = (deadline % 1000000ULL) * 1000;
+    while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL) == EINTR);
+#else
+    u_int64_t now = monotonic_us();
+    if(now < deadline) {
+	struct timespec sdiff;
+	sdiff.tv_sec  = (deadline - now) / 1000000ULL;
+	sdiff.tv_nsec = ((deadline - now) % 1000000ULL) * 1000;
+	while(nanosleep(&sdiff,&sdiff) && (errno == EINTR));
+    }
+#endif
+}
+
 _wheeltimer::_wheeltimer()
     : wall_clock(0)
+{
+    init(AmConfig::TimerThreads);
+}
+
+_wheeltimer::_wheeltimer(unsigned int n_shards)
+    : wall_clock(0)
+{
+    init(n_shards);
+}
+
+void _wheeltimer::init(unsigned int n_shards)
 {
     struct timeval now;
     gettimeofday(&now,NULL);
     unix_clock.set(now.tv_sec);
+
+    start_us = monotonic_us();
+
+    if(!n_shards)
+	n_shards = 1;
+
+    for(unsigned int i=0; i<n_shards; i++)
+	shards.push_back(new timer_wheel(this));
 }
 
 _wheeltimer::~_wheeltimer()
 {
+    for(unsigned int i=0; i<shards.size(); i++)
+	delete shards[i];
+}
+
+void _wheeltimer::start()
+{
+    // tick 0 is the current clock value
+    start_us = monotonic_us() - (u_int64_t)wall_clock * TIMER_RESOLUTION;
+
+    for(unsigned int i=0; i<shards.size(); i++)
+	shards[i]->start();
+}
+
+void _wheeltimer::stop()
+{
+    for(unsigned int i=0; i<shards.size(); i++)
+	shards[i]->stop();
+
+    for(unsigned int i=0; i<shards.size(); i++) {
+	while(!shards[i]->is_stopped())
+	    usleep(10000); // 10ms
+    }
+}
+
+void _wheeltimer::update_clock(u_int32_t tick)
+{
+    // every shard advances the clock: it goes on
+    // even if one of them is busy firing a slow timer
+#if HAVE_ATOMIC_CAS
+    u_int32_t cur;
+    do {
+	cur = wall_clock;
+	if(!less_ts(cur,tick))
+	    return;
+    } while(!__sync_bool_compare_and_swap(&wall_clock,cur,tick));
+#else
+    clock_m.lock();
+    if(less_ts(wall_clock,tick))
+	wall_clock = tick;
+    clock_m.unlock();
+#endif
+}
+
+void _wheeltimer::insert_timer(timer* t, unsigned int hash)
+{
+    timer_wheel* w = shards[get_shard(hash)];
+    t->wheel = w;
+    w->insert_timer(t);
 }
 
 void _wheeltimer::insert_timer(timer* t)
 {
-    //add new timer to user request list
-    reqs_m.lock();
-    reqs_backlog.push_back(timer_req(t,true));
-    reqs_m.unlock();
+    // skip the bits always cleared by the allocator
+    insert_timer(t,(unsigned int)((unsigned long)t >> 4));
 }
 
 void _wheeltimer::remove_timer(timer* t)
@@ -68,52 +171,137 @@ void _wheeltimer::remove_timer(timer* t)
 	return;
     }
 
-    //add timer to remove to user request list
-    reqs_m.lock();
-    reqs_backlog.push_back(timer_req(t,false));
-    reqs_m.unlock();
+    if (t->wheel == NULL){
+	ERROR("timer %p has not been inserted\n",t);
+	return;
+    }
+
+    t->wheel->remove_timer(t);
 }
 
-void _wheeltimer::run()
+void _wheeltimer::getStats(AmArg& ret)
 {
-  struct timeval now,next_tick,diff,tick;
+    ret.assertArray();
+    for(unsigned int i=0; i<shards.size(); i++) {
+	AmArg s;
+	shards[i]->getStats(s);
+	ret.push(s);
+    }
+}
 
-  tick.tv_sec = 0;
-  tick.tv_usec = TIMER_RESOLUTION;
-  
-  gettimeofday(&now, NULL);
-  timeradd(&tick,&now,&next_tick);
+timer_wheel::timer_wheel(_wheeltimer* owner)
+    : owner(owner), wall_clock(0), reqs(NULL),
+      stop_requested(false)
+{
+}
 
-  while(true){
+timer_wheel::~timer_wheel()
+{
+    // timers still pending are deleted without firing
+    process_reqs();
+
+    for(int i=0; i<WHEELS; i++){
+	for(int j=0; j<ELMTS_PER_WHEEL; j++){
+	    base_timer* t = wheels[i][j].next;
+	    while(t){
+		base_timer* t1 = t->next;
+		delete t;
+		t = t1;
+	    }
+	}
+    }
+}
 
-    gettimeofday(&now,NULL);
+void timer_wheel::insert_timer(timer* t)
+{
+    //add new timer to user request list
+    push_req(new timer_req(t,true));
+}
 
-    if(timercmp(&now,&next_tick,<)){
+void timer_wheel::remove_timer(timer* t)
+{
+    //add timer to remove to user request list
+    push_req(new timer_req(t,false));
+}
+
+void timer_wheel::push_req(timer_req* r)
+{
+#if HAVE_ATOMIC_CAS
+    timer_req* head;
+    do {
+	head = reqs;
+	r->next = head;
+    } while(!__sync_bool_compare_and_swap(&reqs,head,r));
+#else
+    reqs_m.lock();
+    r->next = reqs;
+    reqs = r;
+    reqs_m.unlock();
+#endif
+}
 
-      struct timespec sdiff,rem;
-      timersub(&next_tick, &now,&diff);
-      
-      sdiff.tv_sec = diff.tv_sec;
-      sdiff.tv_nsec = diff.tv_usec * 1000;
+void timer_wheel::process_reqs()
+{
+    if(!reqs)
+	return;
 
-      if(sdiff.tv_nsec > 2000000) // 2 ms 
-	nanosleep(&sdiff,&rem);
+    // take over the whole list
+#if HAVE_ATOMIC_CAS
+    timer_req* r = __sync_lock_test_and_set(&reqs,(timer_req*)NULL);
+#else
+    reqs_m.lock();
+    timer_req* r = reqs;
+    reqs = NULL;
+    reqs_m.unlock();
+#endif
+
+    // restore the order of the requests
+    timer_req* fifo = NULL;
+    while(r) {
+	timer_req* next = r->next;
+	r->next = fifo;
+	fifo = r;
+	r = next;
     }
-    //else {
-    //printf("missed one tick\n");
-    //}
 
-    gettimeofday(&now,NULL);
-    unix_clock.set(now.tv_sec);
+    while(fifo) {
+	timer_req* rq = fifo;
+	fifo = fifo->next;
+
+	if(rq->insert) {
+	    place_timer(rq->t);
+	}
+	else {
+	    delete_timer(rq->t);
+	}
+	delete rq;
+    }
+}
 
-    turn_wheel();
-    timeradd(&tick,&next_tick,&next_tick);
-  }
+void timer_wheel::on_stop()
+{
+    stop_requested.set(true);
 }
 
+void timer_wheel::run()
+{
+    stop_requested.set(false);
+
+    while(!stop_requested.get()){
 
+	// if we are behind, the missed ticks
+	// are turned without sleeping
+	sleep_until_us(owner->start_us + (ticks.get()+1) * TIMER_RESOLUTION);
+
+	struct timeval now;
+	gettimeofday(&now,NULL);
+	owner->unix_clock.set(now.tv_sec);
+
+	turn_wheel();
+    }
+}
 
-void _wheeltimer::update_wheel(int wheel)
+void timer_wheel::update_wheel(int wheel)
 {
     // do not try do update wheel 0
     if(!wheel)
@@ -136,7 +324,7 @@ void _wheeltimer::update_wheel(int wheel)
     }
 }
 
-void _wheeltimer::turn_wheel()
+void timer_wheel::turn_wheel()
 {
     u_int32_t mask = ((1<<BITS_PER_WHEEL)-1); // 0x00 00 00 FF
     int i=0;
@@ -149,36 +337,30 @@ void _wheeltimer::turn_wheel()
     }
 
     //increment time
+    ticks.inc();
     wall_clock++;
+    owner->update_clock(wall_clock);
 		
     // Update existing timer entries
     update_wheel(i);
 	
-    // Swap the lists for timer insertion/deletion requests
-    reqs_m.lock();
-    reqs_process.swap(reqs_backlog);
-    reqs_m.unlock();
-
-    while(!reqs_process.empty()) {
-	timer_req rq = reqs_process.front();
-	reqs_process.pop_front();
-
-	if(rq.insert) {
-	    place_timer(rq.t);
-	}
-	else {
-	    delete_timer(rq.t);
-	}
-    }
+    // Insert/delete the timers requested since the last tick
+    process_reqs();
 	
     //check for expired timer to process
     process_current_timers();
 }
 
-void _wheeltimer::process_current_timers()
+void timer_wheel::process_current_timers()
 {
     timer *t = (timer *)wheels[0][wall_clock & 0xFF].next;
-    
+    wheels[0][wall_clock & 0xFF].next = NULL;
+
+    if(!t)
+	return;
+
+    u_int64_t deadline = owner->start_us + ticks.get() * TIMER_RESOLUTION;
+
     while(t){
 
 	timer* t1 = (timer*)t->next;
@@ -186,21 +368,25 @@ void _wheeltimer::process_current_timers()
 	t->next = NULL;
 	t->prev = NULL;
 
+	// includes the time taken by the timers fired before
+	long long late = (long long)(monotonic_us() - deadline);
+	if(late < 0)
+	    late = 0;
+
+	fired.inc();
+	late_us.inc(late);
+	if(late > TIMER_RESOLUTION)
+	    late_fired.inc();
+	if((unsigned long long)late > max_late_us.get())
+	    max_late_us.set(late);
+
 	t->fire();
 
 	t = t1;
     }
-    
-    wheels[0][wall_clock & 0xFF].next = NULL;
-}
-
-inline bool less_ts(unsigned int t1, unsigned int t2)
-{
-    // t1 < t2
-    return (t1 - t2 > (unsigned int)(1<<31));
 }
 
-void _wheeltimer::place_timer(timer* t)
+void timer_wheel::place_timer(timer* t)
 {
     if(less_ts(t->expires,wall_clock)){
 
@@ -213,7 +399,7 @@ void _wheeltimer::place_timer(timer* t)
     place_timer(t,WHEELS-1);
 }
 
-void _wheeltimer::place_timer(timer* t, int wheel)
+void timer_wheel::place_timer(timer* t, int wheel)
 {
     unsigned int pos;
     unsigned int clock_mask = t->expires ^ wall_clock;
@@ -232,7 +418,7 @@ void _wheeltimer::place_timer(timer* t, int wheel)
     add_timer_to_wheel(t,wheel,pos);
 }
 
-void _wheeltimer::add_timer_to_wheel(timer* t, int wheel, unsigned int pos)
+void timer_wheel::add_timer_to_wheel(timer* t, int wheel, unsigned int pos)
 {
     t->next = wheels[wheel][pos].next;
     wheels[wheel][pos].next = t;
@@ -244,7 +430,7 @@ void _wheeltimer::add_timer_to_wheel(timer* t, int wheel, unsigned int pos)
     t->prev = &(wheels[wheel][pos]);
 }
 
-void _wheeltimer::delete_timer(timer* t)
+void timer_wheel::delete_timer(timer* t)
 {
     if(t->prev)
 	t->prev->next = t->next;
@@ -255,6 +441,18 @@ void _wheeltimer::delete_timer(timer* t)
     delete t;
 }
 
+void timer_wheel::getStats(AmArg& ret)
+{
+    unsigned long long n_fired = fired.get();
+
+    ret["ticks"] = (long long)ticks.get();
+    ret["fired"] = (long long)n_fired;
+    ret["late_fired"] = (long long)late_fired.get();
+    ret["avg_late_us"] =
+	n_fired ? (long long)(late_us.get() / n_fired) : 0LL;
+    ret["max_late_us"] = (long long)max_late_us.get();
+}
+
 
 /** EMACS **
  * Local variables:
@@ -32,10 +32,12 @@
 
 #include "../AmThread.h"
 #include <sys/types.h>
-#include <deque>
+#include <vector>
 
 #include "atomic_types.h"
 
+class AmArg;
+
 #define BITS_PER_WHEEL 8
 #define ELMTS_PER_WHEEL (1 << BITS_PER_WHEEL)
 
@@ -54,20 +56,25 @@ public:
     virtual ~base_timer() {}
 };
 
+class timer_wheel;
+
 class timer: public base_timer
 {
 public:
     base_timer*  prev;
     u_int32_t    expires;
 
+    // shard the timer has been inserted into
+    timer_wheel* wheel;
+
     timer() 
 	: base_timer(),
-	  prev(0), expires(0) 
+	  prev(0), expires(0), wheel(0)
     {}
 
     timer(unsigned int expires)
         : base_timer(),
-	  prev(0), expires(expires)
+	  prev(0), expires(expires), wheel(0)
     {}
 
     ~timer(); 
@@ -77,26 +84,55 @@ public:
 
 #include "singleton.h"
 
-class _wheeltimer:
+class _wheeltimer;
+
+/**
+ * One shard of the timer service: a timer wheel
+ * turned (and its timers fired) by its own thread.
+ *
+ * Insert and remove requests from other threads are
+ * pushed onto a lock-free list, which the wheel thread
+ * takes over at every tick.
+ */
+class timer_wheel:
     public AmThread
 {
     struct timer_req {
 
-	timer* t;
-	bool   insert; // false -> remove
+	timer*     t;
+	bool       insert; // false -> remove
+	timer_req* next;
 	
 	timer_req(timer* t, bool insert)
-	    : t(t), insert(insert)
+	    : t(t), insert(insert), next(NULL)
 	{}
     };
 
+    _wheeltimer* owner;
+
     //the timer wheel
     base_timer wheels[WHEELS][ELMTS_PER_WHEEL];
 
-    // request backlog lock (insert/remove)
-    AmMutex               reqs_m;
-    std::deque<timer_req> reqs_backlog;
-    std::deque<timer_req> reqs_process;
+    // ticks turned so far; wheel position
+    atomic_int64 ticks;
+    u_int32_t    wall_clock;
+
+    // pending requests (insert/remove), latest first
+    timer_req* volatile reqs;
+#if !HAVE_ATOMIC_CAS
+    AmMutex             reqs_m;
+#endif
+
+    AmSharedVar<bool> stop_requested;
+
+    /** fire lateness statistics (written by the thread only) */
+    atomic_int64 fired;
+    atomic_int64 late_fired;
+    atomic_int64 late_us;
+    atomic_int64 max_late_us;
+
+    void push_req(timer_req* r);
+    void process_reqs();
 
     void turn_wheel();
     void update_wheel(int wheel);
@@ -111,10 +147,50 @@ class _wheeltimer:
 
 protected:
     void run();
-    void on_stop(){}
+    void on_stop();
+
+public:
+    timer_wheel(_wheeltimer* owner);
+    ~timer_wheel();
+
+    void insert_timer(timer* t);
+    void remove_timer(timer* t);
 
+    /**
+     * Get the fire lateness statistics: ticks, timers fired,
+     * timers fired more than one tick late, average/max. lateness.
+     */
+    void getStats(AmArg& ret);
+};
+
+/**
+ * Timer service: timers are spread over a number of
+ * independent wheels (shards), each with its own thread,
+ * so that a slow timer only delays the timers of its shard.
+ *
+ * All shards share one clock (wall_clock, in ticks of
+ * TIMER_RESOLUTION).
+ */
+class _wheeltimer
+{
+    std::vector<timer_wheel*> shards;
+
+    // monotonic time [us] of tick 0
+    u_int64_t start_us;
+#if !HAVE_ATOMIC_CAS
+    AmMutex   clock_m;
+#endif
+
+    void init(unsigned int n_shards);
+    void update_clock(u_int32_t tick);
+
+    friend class timer_wheel;
+
+protected:
+    // AmConfig::TimerThreads shards
     _wheeltimer();
-    ~_wheeltimer();
+    _wheeltimer(unsigned int n_shards);
+    virtual ~_wheeltimer();
 
 public:
     //clock reference
@@ -125,8 +201,32 @@ public:
     atomic_int unix_clock; // 32 bits
 #endif
 
+    /** start the threads of all shards */
+    void start();
+    /** stop the threads of all shards and wait for them */
+    void stop();
+
+    unsigned int get_shards() const { return shards.size(); }
+
+    /** shard the timers of the owner identified by 'hash' are placed on */
+    unsigned int get_shard(unsigned int hash) const {
+	return hash % shards.size();
+    }
+
+    /**
+     * Insert 't' on the shard of its owner: timers with
+     * the same 'hash' are fired by the same thread.
+     */
+    void insert_timer(timer* t, unsigned int hash);
+
+    /** Insert 't' on a shard chosen by its address. */
     void insert_timer(timer* t);
+
+    /** Remove (and delete) 't' from the shard it has been inserted into. */
     void remove_timer(timer* t);
+
+    /** Fire lateness statistics of every shard. */
+    void getStats(AmArg& ret);
 };
 
 typedef singleton<_wheeltimer> wheeltimer;
@@ -28,6 +28,19 @@ FCT_BGN() {
   FCTMF_SUITE_CALL(test_uriparser);
   FCTMF_SUITE_CALL(test_jsonarg);
   FCTMF_SUITE_CALL(test_replaces);
+  FCTMF_SUITE_CALL(test_mixer);
+  FCTMF_SUITE_CALL(test_g711);
+  FCTMF_SUITE_CALL(test_affinity);
+  FCTMF_SUITE_CALL(test_sip_parser);
+  FCTMF_SUITE_CALL(test_resolver);
+  FCTMF_SUITE_CALL(test_wheeltimer);
+  FCTMF_SUITE_CALL(test_sl_responder);
+  FCTMF_SUITE_CALL(test_trans_table);
+  FCTMF_SUITE_CALL(test_overload_filter);
+  FCTMF_SUITE_CALL(test_event_queue);
+  FCTMF_SUITE_CALL(test_prompt_encoding);
+  FCTMF_SUITE_CALL(test_resampler);
+  FCTMF_SUITE_CALL(test_rtp_repacketizer);
 } FCT_END();
 
 
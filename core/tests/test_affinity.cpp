@@ -0,0 +1,78 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmCpuAffinity.h"
+#include "AmThread.h"
+
+#include <sched.h>
+
+class AffinityTestThread
+  : public AmThread
+{
+public:
+  cpu_set_t set;
+  bool got_set;
+
+  AffinityTestThread() : got_set(false) {}
+
+  void run() {
+    CPU_ZERO(&set);
+    got_set = !sched_getaffinity(0, sizeof(set), &set);
+  }
+  void on_stop() {}
+};
+
+FCTMF_SUITE_BGN(test_affinity) {
+
+    FCT_TEST_BGN(cpulist_parse) {
+      vector<int> cpus;
+      fct_chk(AmCpuAffinity::parseCpuList("0-3,8,10-11", cpus));
+      fct_chk_eq_int(cpus.size(), 7);
+      fct_chk_eq_int(cpus[0], 0);
+      fct_chk_eq_int(cpus[3], 3);
+      fct_chk_eq_int(cpus[4], 8);
+      fct_chk_eq_int(cpus[6], 11);
+
+      fct_chk(AmCpuAffinity::parseCpuList(" 5 , 1-2, 2 \n", cpus));
+      fct_chk_eq_int(cpus.size(), 3);
+      fct_chk_eq_int(cpus[0], 1);
+      fct_chk_eq_int(cpus[2], 5);
+
+      fct_chk(AmCpuAffinity::parseCpuList("", cpus));
+      fct_chk(cpus.empty());
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(cpulist_parse_wrong) {
+      vector<int> cpus;
+      fct_chk(!AmCpuAffinity::parseCpuList("a", cpus));
+      fct_chk(!AmCpuAffinity::parseCpuList("3-1", cpus));
+      fct_chk(!AmCpuAffinity::parseCpuList("-1", cpus));
+      fct_chk(!AmCpuAffinity::parseCpuList("1-", cpus));
+      fct_chk(!AmCpuAffinity::parseCpuList("1,2;3", cpus));
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(cpulist_print) {
+      vector<int> cpus;
+      fct_chk(AmCpuAffinity::parseCpuList("8,0-3,10-11,5", cpus));
+      fct_chk_eq_str(AmCpuAffinity::printCpuList(cpus).c_str(),
+		     "0-3,5,8,10-11");
+      cpus.clear();
+      fct_chk_eq_str(AmCpuAffinity::printCpuList(cpus).c_str(), "");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(thread_affinity) {
+      vector<int> cpus;
+      cpus.push_back(0);
+
+      AffinityTestThread t;
+      t.setAffinity(cpus);
+      t.start();
+      t.join();
+
+      fct_chk(t.got_set);
+      fct_chk_eq_int(CPU_COUNT(&t.set), 1);
+      fct_chk(CPU_ISSET(0, &t.set));
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,243 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmEventQueue.h"
+#include "AmSipEvent.h"
+#include "AmRtpStream.h"
+
+#include <sys/time.h>
+#include <queue>
+
+#define EVQ_PRODUCERS_MAX 8
+
+/** counts events and checks the order per producer */
+class counting_handler
+  : public AmEventHandler
+{
+public:
+  unsigned int received;
+  unsigned int out_of_order;
+  int last[EVQ_PRODUCERS_MAX];
+
+  counting_handler()
+    : received(0), out_of_order(0)
+  {
+    for(int i=0; i<EVQ_PRODUCERS_MAX; i++)
+      last[i] = -1;
+  }
+
+  void process(AmEvent* ev) {
+    // event_id: producer * 1000000 + sequence number
+    int p = ev->event_id / 1000000;
+    int seq = ev->event_id % 1000000;
+    if(seq <= last[p])
+      out_of_order++;
+    last[p] = seq;
+    received++;
+  }
+};
+
+class counting_sink
+  : public AmEventNotificationSink
+{
+public:
+  atomic_int notified;
+  void notify(AmEventQueue*) { notified.inc(); }
+};
+
+/** the queue as it was: std::queue, mutex and condition */
+class locked_event_queue
+{
+  AmEventHandler*      handler;
+  std::queue<AmEvent*> ev_queue;
+  AmMutex              m_queue;
+  AmCondition<bool>    ev_pending;
+
+public:
+  locked_event_queue(AmEventHandler* h)
+    : handler(h), ev_pending(false) {}
+
+  void postEvent(AmEvent* ev) {
+    m_queue.lock();
+    ev_queue.push(ev);
+    if(!ev_pending.get())
+      ev_pending.set(true);
+    m_queue.unlock();
+  }
+
+  void waitForEvent() { ev_pending.wait_for(); }
+
+  void processEvents() {
+    m_queue.lock();
+    while(!ev_queue.empty()) {
+      AmEvent* ev = ev_queue.front();
+      ev_queue.pop();
+      m_queue.unlock();
+      handler->process(ev);
+      delete ev;
+      m_queue.lock();
+    }
+    ev_pending.set(false);
+    m_queue.unlock();
+  }
+};
+
+template<class Q>
+class evq_producer
+  : public AmThread
+{
+  Q* q;
+  int id;
+  int n;
+
+protected:
+  void run() {
+    for(int i=0; i<n; i++)
+      q->postEvent(new AmEvent(id * 1000000 + i));
+  }
+  void on_stop() {}
+
+public:
+  evq_producer(Q* q, int id, int n)
+    : q(q), id(id), n(n) {}
+};
+
+/** @return us needed to post and process 'events' from 'producers' threads */
+template<class Q>
+static unsigned long evq_run(int producers, int events,
+			     unsigned int& received, unsigned int& out_of_order)
+{
+  counting_handler h;
+  Q q(&h);
+
+  evq_producer<Q>* p[EVQ_PRODUCERS_MAX];
+  for(int i=0; i<producers; i++)
+    p[i] = new evq_producer<Q>(&q,i,events / producers);
+
+  struct timeval start, end;
+  gettimeofday(&start,NULL);
+
+  for(int i=0; i<producers; i++)
+    p[i]->start();
+
+  while(h.received < (unsigned int)(events / producers) * producers) {
+    q.waitForEvent();
+    q.processEvents();
+  }
+
+  gettimeofday(&end,NULL);
+  timersub(&end,&start,&end);
+
+  for(int i=0; i<producers; i++) {
+    p[i]->join();
+    delete p[i];
+  }
+
+  received = h.received;
+  out_of_order = h.out_of_order;
+  return end.tv_sec*1000000 + end.tv_usec;
+}
+
+FCTMF_SUITE_BGN(test_event_queue) {
+
+    FCT_TEST_BGN(fifo_single_producer) {
+      counting_handler h;
+      AmEventQueue q(&h);
+
+      fct_chk(!q.eventPending());
+      for(int i=0; i<100; i++)
+	q.postEvent(new AmEvent(i));
+      fct_chk(q.eventPending());
+
+      q.processSingleEvent();
+      fct_chk_eq_int(h.received, 1);
+
+      q.processEvents();
+      fct_chk_eq_int(h.received, 100);
+      fct_chk_eq_int(h.out_of_order, 0);
+      fct_chk(!q.eventPending());
+
+      // left over events are deleted with the queue
+      AmEventQueue* q2 = new AmEventQueue(&h);
+      unsigned int before = AmEventQueue::getPendingEvents();
+      q2->postEvent(new AmEvent(0));
+      q2->postEvent(new AmEvent(1));
+      delete q2;
+      unsigned int after = AmEventQueue::getPendingEvents();
+      fct_chk_eq_int(after, before);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(notify_on_first_event_only) {
+      counting_handler h;
+      counting_sink s;
+      AmEventQueue q(&h);
+      q.setEventNotificationSink(&s);
+
+      for(int i=0; i<10; i++)
+	q.postEvent(new AmEvent(i));
+      int n = s.notified.get();
+      fct_chk_eq_int(n, 1);
+
+      q.processEvents();
+      q.postEvent(new AmEvent(10));
+      n = s.notified.get();
+      fct_chk_eq_int(n, 2);
+
+      // pending events are signaled to a new sink
+      counting_sink s2;
+      q.setEventNotificationSink(&s2);
+      n = s2.notified.get();
+      fct_chk_eq_int(n, 1);
+      q.setEventNotificationSink(NULL);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(multiple_producers) {
+      unsigned int received = 0, out_of_order = 0;
+      evq_run<AmEventQueue>(4,40000,received,out_of_order);
+      fct_chk_eq_int(received, 40000);
+      fct_chk_eq_int(out_of_order, 0);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(pooled_events) {
+      // deleted objects are reused by the same thread
+      AmRtpTimeoutEvent* e1 = new AmRtpTimeoutEvent();
+      void* p1 = e1;
+      delete e1;
+      AmRtpTimeoutEvent* e2 = new AmRtpTimeoutEvent();
+      fct_chk(p1 == (void*)e2);
+      delete e2;
+
+      AmTimeoutEvent* t = new AmTimeoutEvent(42);
+      fct_chk_eq_int(t->data[0].asInt(), 42);
+      delete t;
+
+      // full batches go to the depot
+      AmSipRequestEvent* ev[3*EVENT_POOL_BATCH];
+      for(int i=0; i<3*EVENT_POOL_BATCH; i++)
+	ev[i] = new AmSipRequestEvent();
+      unsigned int depot = AmEventPool<AmSipRequestEvent>::depot_size();
+      for(int i=0; i<3*EVENT_POOL_BATCH; i++)
+	delete ev[i];
+      unsigned int depot2 = AmEventPool<AmSipRequestEvent>::depot_size();
+      fct_chk(depot2 > depot);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(event_queue_benchmark) {
+      const int events = 200000;
+      for(int producers = 1; producers <= EVQ_PRODUCERS_MAX; producers *= 2) {
+	unsigned int received = 0, out_of_order = 0;
+	unsigned long lf = evq_run<AmEventQueue>(producers,events,
+						 received,out_of_order);
+	fct_chk_eq_int(out_of_order, 0);
+	unsigned long locked = evq_run<locked_event_queue>(producers,events,
+							  received,out_of_order);
+	INFO("event queue: %d producers, %d events: lock-free %lu us "
+	     "(%lu events/s), locked %lu us (%lu events/s)\n",
+	     producers, events,
+	     lf, lf ? (unsigned long)(events * 1000000ULL / lf) : 0,
+	     locked, locked ? (unsigned long)(events * 1000000ULL / locked) : 0);
+      }
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,169 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "plug-in/wav/g711.h"
+
+#include <string.h>
+
+/*
+ * Segment search conversions of the original Sun g711.c, which the
+ * lookup tables have been generated from.
+ */
+static short seg_aend[8] = {0x1F, 0x3F, 0x7F, 0xFF,
+			    0x1FF, 0x3FF, 0x7FF, 0xFFF};
+static short seg_uend[8] = {0x3F, 0x7F, 0xFF, 0x1FF,
+			    0x3FF, 0x7FF, 0xFFF, 0x1FFF};
+
+static short ref_search(short val, short* table, int size)
+{
+  for(int i = 0; i < size; i++) {
+    if(val <= *table++)
+      return i;
+  }
+  return size;
+}
+
+static unsigned char ref_13linear2alaw(short pcm_val)
+{
+  short mask;
+  if(pcm_val >= 0) {
+    mask = 0xD5;
+  } else {
+    mask = 0x55;
+    pcm_val = -pcm_val - 1;
+  }
+
+  short seg = ref_search(pcm_val, seg_aend, 8);
+  if(seg >= 8)
+    return (unsigned char)(0x7F ^ mask);
+
+  unsigned char aval = (unsigned char)seg << 4;
+  if(seg < 2)
+    aval |= (pcm_val >> 1) & 0xf;
+  else
+    aval |= (pcm_val >> seg) & 0xf;
+  return aval ^ mask;
+}
+
+static short ref_alaw2linear16(unsigned char a_val)
+{
+  a_val ^= 0x55;
+
+  short t = (a_val & 0xf) << 4;
+  short seg = ((unsigned)a_val & 0x70) >> 4;
+  switch(seg) {
+  case 0:  t += 8; break;
+  case 1:  t += 0x108; break;
+  default: t += 0x108; t <<= seg - 1;
+  }
+  return (a_val & 0x80) ? t : -t;
+}
+
+static unsigned char ref_14linear2ulaw(short pcm_val)
+{
+  short mask;
+  if(pcm_val < 0) {
+    pcm_val = -pcm_val;
+    mask = 0x7F;
+  } else {
+    mask = 0xFF;
+  }
+  if(pcm_val > 8159) pcm_val = 8159;
+  pcm_val += (0x84 >> 2);
+
+  short seg = ref_search(pcm_val, seg_uend, 8);
+  if(seg >= 8)
+    return (unsigned char)(0x7F ^ mask);
+
+  unsigned char uval = (unsigned char)(seg << 4) | ((pcm_val >> (seg + 1)) & 0xF);
+  return uval ^ mask;
+}
+
+static short ref_ulaw2linear16(unsigned char u_val)
+{
+  u_val = ~u_val;
+
+  short t = ((u_val & 0xf) << 3) + 0x84;
+  t <<= ((unsigned)u_val & 0x70) >> 4;
+  return (u_val & 0x80) ? (0x84 - t) : (t - 0x84);
+}
+
+FCTMF_SUITE_BGN(test_g711) {
+
+    FCT_TEST_BGN(g711_decode) {
+      uint8_t codes[256];
+      int16_t alaw[256];
+      int16_t ulaw[256];
+
+      for(int i = 0; i < 256; i++)
+	codes[i] = i;
+
+      st_alaw2linear16_buf(alaw, codes, 256);
+      st_ulaw2linear16_buf(ulaw, codes, 256);
+
+      int a_errors = 0, u_errors = 0;
+      for(int i = 0; i < 256; i++) {
+	if(alaw[i] != ref_alaw2linear16(i)) a_errors++;
+	if(ulaw[i] != ref_ulaw2linear16(i)) u_errors++;
+      }
+      fct_chk_eq_int(a_errors, 0);
+      fct_chk_eq_int(u_errors, 0);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(g711_encode) {
+      static int16_t pcm[65536];
+      static uint8_t alaw[65536];
+      static uint8_t ulaw[65536];
+
+      for(int i = 0; i < 65536; i++)
+	pcm[i] = (int16_t)(i - 32768);
+
+      st_linear162alaw_buf(alaw, pcm, 65536);
+      st_linear162ulaw_buf(ulaw, pcm, 65536);
+
+      int a_errors = 0, u_errors = 0;
+      for(int i = 0; i < 65536; i++) {
+	if(alaw[i] != ref_13linear2alaw(pcm[i] >> 3)) a_errors++;
+	if(ulaw[i] != ref_14linear2ulaw(pcm[i] >> 2)) u_errors++;
+      }
+      fct_chk_eq_int(a_errors, 0);
+      fct_chk_eq_int(u_errors, 0);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(g711_sizes) {
+      // all lengths around the unrolled blocks, at different offsets
+      int16_t pcm[40];
+      int16_t dec[40];
+      uint8_t enc[40];
+
+      unsigned int seed = 1;
+      for(int i = 0; i < 40; i++) {
+	seed = seed * 1103515245 + 12345;
+	pcm[i] = (int16_t)(seed >> 8);
+      }
+
+      for(unsigned int off = 0; off < 4; off++) {
+	for(unsigned int n = 0; n <= 32; n++) {
+	  memset(enc, 0xAA, sizeof(enc));
+	  st_linear162alaw_buf(enc + off, pcm + off, n);
+	  bool ok = true;
+	  for(unsigned int i = 0; i < 40; i++) {
+	    if(i < off || i >= off + n) ok = ok && enc[i] == 0xAA;
+	    else ok = ok && enc[i] == ref_13linear2alaw(pcm[i] >> 3);
+	  }
+	  fct_chk(ok);
+
+	  memset(dec, 0x55, sizeof(dec));
+	  st_ulaw2linear16_buf(dec + off, enc + off, n);
+	  ok = true;
+	  for(unsigned int i = 0; i < 40; i++) {
+	    if(i < off || i >= off + n) ok = ok && dec[i] == 0x5555;
+	    else ok = ok && dec[i] == ref_ulaw2linear16(enc[i]);
+	  }
+	  fct_chk(ok);
+	}
+      }
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,322 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmMixerKernels.h"
+#include "AmMultiPartyMixer.h"
+#include "AmPlugIn.h"
+#include "amci/codecs.h"
+#include "plug-in/wav/g711.h"
+
+#include <string.h>
+#include <sys/time.h>
+
+#define TEST_MAX_SAMPLES 960
+
+/** deterministic pseudo random numbers */
+static unsigned int test_rand(unsigned int& seed)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) & 0xffffff;
+}
+
+static short test_sample(unsigned int& seed)
+{
+  return (short)(test_rand(seed) & 0xffff);
+}
+
+/** AmMultiPartyMixer::scale() as it was before the kernels */
+static void ref_scale(short* buffer, const int* tmp_buf, unsigned int size,
+		      int& scaling_factor)
+{
+  short* end_dest = buffer + size;
+
+  if(scaling_factor<64)
+    scaling_factor++;
+
+  while(buffer != end_dest){
+    int s = (*tmp_buf * scaling_factor) >> 6;
+    if(abs(s) > MAX_LINEAR_SAMPLE){
+      scaling_factor = abs( (MAX_LINEAR_SAMPLE<<6) / (*tmp_buf) );
+      if(s < 0)
+	s = -MAX_LINEAR_SAMPLE;
+      else
+	s = MAX_LINEAR_SAMPLE;
+    }
+    *(buffer++) = short(s);
+    tmp_buf++;
+  }
+}
+
+static const char* kernel_names[] = { "scalar", "sse2", "avx2", NULL };
+
+#define MIXER_FRAME 160
+#define MIXER_TICK  (WALLCLOCK_RATE/50)
+
+static int test_ulaw_encode(unsigned char* out, unsigned char* in,
+			    unsigned int size, unsigned int channels,
+			    unsigned int rate, long h_codec)
+{
+  st_linear162ulaw_buf(out,(int16_t*)in,PCM16_B2S(size));
+  return PCM16_B2S(size);
+}
+
+static amci_codec_t test_ulaw =
+  { CODEC_ULAW, test_ulaw_encode, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+
+/** puts a frame of constant level per channel, then reads all channels */
+static void mixer_tick(AmMultiPartyMixer& m, unsigned long long ts,
+		       const short* levels, unsigned int channels,
+		       short out[][MIXER_FRAME])
+{
+  short frame[MIXER_FRAME];
+
+  m.lock();
+  for(unsigned int c = 0; c < channels; c++) {
+    for(unsigned int i = 0; i < MIXER_FRAME; i++)
+      frame[i] = levels[c];
+    m.PutChannelPacket(c,ts,(unsigned char*)frame,sizeof(frame));
+  }
+
+  for(unsigned int c = 0; c < channels; c++) {
+    unsigned int size = sizeof(frame), rate = 0;
+    m.GetChannelPacket(c,ts,(unsigned char*)out[c],size,rate);
+  }
+  m.unlock();
+}
+
+static const unsigned int test_sizes[] = 
+  { 0, 1, 7, 8, 15, 16, 17, 31, 80, 160, 240, 320, 333, 480, 960 };
+
+FCTMF_SUITE_BGN(test_mixer) {
+
+    FCT_TEST_BGN(mixer_kernels_get) {
+      fct_chk(AmMixerKernels::get("scalar") != NULL);
+      fct_chk(AmMixerKernels::get("unknown") == NULL);
+      fct_chk(AmMixerKernels::get().name != NULL);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(mixer_kernels_mix) {
+      int    src1[TEST_MAX_SAMPLES];
+      short  src2[TEST_MAX_SAMPLES];
+      int    ref[TEST_MAX_SAMPLES];
+      int    dest[TEST_MAX_SAMPLES];
+      unsigned int seed = 1;
+
+      for(const char** n = kernel_names; *n; n++) {
+	const AmMixerKernels* k = AmMixerKernels::get(*n);
+	if(!k) continue;
+
+	for(unsigned int t = 0; t < sizeof(test_sizes)/sizeof(unsigned int); t++) {
+	  unsigned int size = test_sizes[t];
+	  for(unsigned int i = 0; i < TEST_MAX_SAMPLES; i++) {
+	    src1[i] = (int)test_rand(seed) - 0x800000;
+	    src2[i] = test_sample(seed);
+	  }
+
+	  for(unsigned int i = 0; i < size; i++)
+	    ref[i] = src1[i] + src2[i];
+	  k->mix_add(dest,src1,src2,size);
+	  fct_chk(!memcmp(dest,ref,size*sizeof(int)));
+
+	  // in place, as used by the mixer
+	  k->mix_sub(dest,dest,src2,size);
+	  fct_chk(!memcmp(dest,src1,size*sizeof(int)));
+	}
+      }
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(mixer_kernels_scale) {
+      int   mixed[TEST_MAX_SAMPLES];
+      short ref[TEST_MAX_SAMPLES];
+      short out[TEST_MAX_SAMPLES];
+
+      for(const char** n = kernel_names; *n; n++) {
+	const AmMixerKernels* k = AmMixerKernels::get(*n);
+	if(!k) continue;
+
+	// from silence to loud conferences of up to 100 parties
+	for(unsigned int parties = 0; parties <= 100; parties += 5) {
+	  unsigned int seed = parties + 1;
+	  int ref_factor = 16, factor = 16;
+
+	  for(unsigned int frame = 0; frame < 50; frame++) {
+	    unsigned int size = test_sizes[frame % (sizeof(test_sizes)/sizeof(unsigned int))];
+	    for(unsigned int i = 0; i < size; i++) {
+	      mixed[i] = 0;
+	      for(unsigned int p = 0; p < parties; p++)
+		mixed[i] += test_sample(seed) >> (frame % 8);
+	    }
+
+	    ref_scale(ref,mixed,size,ref_factor);
+	    k->scale(out,mixed,size,factor);
+	    fct_chk(!memcmp(out,ref,size*sizeof(short)));
+	    fct_chk_eq_int(factor,ref_factor);
+	  }
+	}
+      }
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(mixer_kernels_benchmark) {
+      // one 20 ms tick of a 100 party conference
+      const unsigned int parties = 100;
+      const unsigned int samples = 320;
+      const unsigned int ticks = 200;
+
+      static short channels[parties][samples];
+      static int   mixed[samples];
+      static int   tmp[samples];
+      static short out[samples];
+
+      unsigned int seed = 42;
+      for(unsigned int p = 0; p < parties; p++)
+	for(unsigned int i = 0; i < samples; i++)
+	  channels[p][i] = test_sample(seed) >> 4;
+
+      for(const char** n = kernel_names; *n; n++) {
+	const AmMixerKernels* k = AmMixerKernels::get(*n);
+	if(!k) continue;
+
+	int factor = 16;
+	struct timeval start, end;
+	gettimeofday(&start,NULL);
+
+	for(unsigned int t = 0; t < ticks; t++) {
+	  memset(mixed,0,sizeof(mixed));
+	  for(unsigned int p = 0; p < parties; p++)
+	    k->mix_add(mixed,mixed,channels[p],samples);
+
+	  for(unsigned int p = 0; p < parties; p++) {
+	    k->mix_sub(tmp,mixed,channels[p],samples);
+	    k->scale(out,tmp,samples,factor);
+	  }
+	}
+
+	gettimeofday(&end,NULL);
+	timersub(&end,&start,&end);
+	INFO("mixer kernels '%s': %u parties, %u samples: %lu us per tick\n",
+	     k->name, parties, samples,
+	     (end.tv_sec*1000000 + end.tv_usec) / ticks);
+      }
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(mixer_active_speakers) {
+      const short levels[] = { 2000, 1000, 10, 0, 0 };
+      const unsigned int channels = 5;
+      short out[channels][MIXER_FRAME];
+
+      AmMultiPartyMixer all, nbest;
+      for(unsigned int c = 0; c < channels; c++) {
+	all.addChannel(8000);
+	nbest.addChannel(8000);
+      }
+      nbest.setActiveSpeakers(2);
+
+      // until the scaling factor has reached 64
+      unsigned long long ts = 0;
+      for(int t = 0; t < 30; t++, ts += MIXER_TICK)
+	mixer_tick(all,ts,levels,channels,out);
+      fct_chk_eq_int(out[0][0], 1010);
+      fct_chk_eq_int(out[3][0], 3010);
+
+      ts = 0;
+      for(int t = 0; t < 30; t++, ts += MIXER_TICK)
+	mixer_tick(nbest,ts,levels,channels,out);
+
+      // only the two loudest channels are mixed
+      fct_chk(nbest.isSpeaker(0));
+      fct_chk(nbest.isSpeaker(1));
+      fct_chk(!nbest.isSpeaker(2));
+      fct_chk_eq_int(out[0][0], 1000);
+      fct_chk_eq_int(out[1][0], 2000);
+      fct_chk_eq_int(out[2][0], 3000);
+      fct_chk_eq_int(out[3][MIXER_FRAME-1], 3000);
+      fct_chk(!memcmp(out[3],out[4],sizeof(out[3])));
+
+      // a new louder speaker replaces the quietest one
+      const short levels2[] = { 2000, 1000, 10, 8000, 0 };
+      for(int t = 0; t < 5; t++, ts += MIXER_TICK)
+	mixer_tick(nbest,ts,levels2,channels,out);
+      fct_chk(nbest.isSpeaker(0));
+      fct_chk(!nbest.isSpeaker(1));
+      fct_chk(nbest.isSpeaker(3));
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(mixer_shared_encoding) {
+      AmPlugIn::instance()->addCodec(&test_ulaw);
+
+      const short levels[] = { 2000, 1000, 0, 0 };
+      const unsigned int channels = 4;
+      short out[channels][MIXER_FRAME];
+
+      AmMultiPartyMixer m;
+      for(unsigned int c = 0; c < channels; c++)
+	m.addChannel(8000);
+
+      unsigned char enc[MIXER_FRAME], enc2[MIXER_FRAME], ref[MIXER_FRAME];
+      unsigned long long ts = 0;
+      mixer_tick(m,ts,levels,channels,out);
+
+      // not in N-best mode
+      m.lock();
+      int s = m.GetEncodedChannelPacket(2,ts,enc,CODEC_ULAW,8000,MIXER_FRAME);
+      fct_chk_eq_int(s, 0);
+      m.unlock();
+
+      m.setActiveSpeakers(2);
+      for(int t = 0; t < 30; t++) {
+	ts += MIXER_TICK;
+	mixer_tick(m,ts,levels,channels,out);
+      }
+
+      m.lock();
+      s = m.GetEncodedChannelPacket(2,ts,enc,CODEC_ULAW,8000,MIXER_FRAME);
+      fct_chk_eq_int(s, MIXER_FRAME);
+      s = m.GetEncodedChannelPacket(3,ts,enc2,CODEC_ULAW,8000,MIXER_FRAME);
+      fct_chk_eq_int(s, MIXER_FRAME);
+      // speakers get their own mix, other codecs are not shared
+      s = m.GetEncodedChannelPacket(0,ts,enc2,CODEC_ULAW,8000,MIXER_FRAME);
+      fct_chk_eq_int(s, 0);
+      s = m.GetEncodedChannelPacket(3,ts,enc2,CODEC_GSM0610,8000,MIXER_FRAME);
+      fct_chk_eq_int(s, 0);
+      s = m.GetEncodedChannelPacket(3,ts,enc2,CODEC_ULAW,8000,MIXER_FRAME);
+      fct_chk_eq_int(s, MIXER_FRAME);
+      m.unlock();
+
+      st_linear162ulaw_buf(ref,out[2],MIXER_FRAME);
+      fct_chk(!memcmp(enc,ref,MIXER_FRAME));
+      fct_chk(!memcmp(enc,enc2,MIXER_FRAME));
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(mixer_active_speakers_benchmark) {
+      // 20 ms ticks of a 200 party conference with three speakers
+      const unsigned int parties = 200;
+      const unsigned int ticks = 100;
+
+      static short levels[parties];
+      static short out[parties][MIXER_FRAME];
+      for(unsigned int p = 0; p < parties; p++)
+	levels[p] = (p < 3) ? 4000 * (p + 1) : 20;
+
+      for(unsigned int n = 0; n <= 3; n += 3) {
+	AmMultiPartyMixer m;
+	for(unsigned int p = 0; p < parties; p++)
+	  m.addChannel(8000);
+	m.setActiveSpeakers(n);
+
+	struct timeval start, end;
+	gettimeofday(&start,NULL);
+
+	unsigned long long ts = 0;
+	for(unsigned int t = 0; t < ticks; t++, ts += MIXER_TICK)
+	  mixer_tick(m,ts,levels,parties,out);
+
+	gettimeofday(&end,NULL);
+	timersub(&end,&start,&end);
+	INFO("conference mixer, %s: %u parties: %.3f us per participant and tick\n",
+	     n ? "3 active speakers" : "all channels", parties,
+	     (double)(end.tv_sec*1000000 + end.tv_usec) / ticks / parties);
+      }
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,159 @@
+#include "fct.h"
+
+#include "log.h"
+#include "AmArg.h"
+
+#include "sip/sip_parser.h"
+#include "sip/parse_via.h"
+#include "sip/overload_filter.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+static string request(const string& method, const string& ruri,
+		      const string& to_tag, const string& via_params = "")
+{
+  string m = method + " " + ruri + " SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP 192.0.2.1:5060;branch=z9hG4bK776asdhds" + via_params + "\r\n"
+    "From: <sip:ua@192.0.2.1>;tag=1928301774\r\n"
+    "To: <" + ruri + ">";
+  if(!to_tag.empty())
+    m += ";tag=" + to_tag;
+  m += "\r\n"
+    "Call-ID: a84b4c76e66710@192.0.2.1\r\n"
+    "CSeq: 1 " + method + "\r\n"
+    "Content-Length: 0\r\n"
+    "\r\n";
+  return m;
+}
+
+static int match(overload_filter& f, const string& m)
+{
+  sip_msg msg(m.c_str(), m.length());
+  char* err_msg = NULL;
+  if(parse_sip_msg(&msg, err_msg))
+    return -1;
+  return f.match(&msg);
+}
+
+FCTMF_SUITE_BGN(test_overload_filter) {
+
+    FCT_TEST_BGN(not_rejecting_by_default) {
+      overload_filter f;
+      fct_chk(!f.rejecting());
+      int v = match(f, request("INVITE", "sip:bob@192.0.2.2", ""));
+      fct_chk_eq_int(v, overload_filter::PASS);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(reject_share_spread) {
+      overload_filter f;
+      f.set_reject(25, 1000);
+      string m = request("INVITE", "sip:bob@192.0.2.2", "");
+
+      // every fourth request is rejected
+      int rejected = 0;
+      for(int i=0; i<8; i++) {
+	int v = match(f, m);
+	fct_chk(v == overload_filter::ADMIT || v == overload_filter::REJECT);
+	if(v == overload_filter::REJECT) {
+	  fct_chk_eq_int(i % 4, 3);
+	  rejected++;
+	}
+      }
+      fct_chk_eq_int(rejected, 2);
+
+      f.set_reject(100, 1000);
+      int v = match(f, request("REGISTER", "sip:192.0.2.2", ""));
+      fct_chk_eq_int(v, overload_filter::REJECT);
+
+      f.set_reject(0, 1000);
+      fct_chk(!f.rejecting());
+      v = match(f, m);
+      fct_chk_eq_int(v, overload_filter::PASS);
+
+      AmArg s;
+      f.getStats(s);
+      fct_chk_eq_int(s["admitted"].asInt(), 6);
+      fct_chk_eq_int(s["rejected"].asInt(), 3);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(priority_requests_pass) {
+      overload_filter f;
+      vector<string> exempt;
+      exempt.push_back("112");
+      exempt.push_back("sos");
+      f.configure(0, exempt, "");
+      f.set_reject(100, 1000);
+
+      // in-dialog and other methods
+      int v = match(f, request("INVITE", "sip:bob@192.0.2.2", "a6c85cf"));
+      fct_chk_eq_int(v, overload_filter::PASS);
+      v = match(f, request("OPTIONS", "sip:bob@192.0.2.2", ""));
+      fct_chk_eq_int(v, overload_filter::PASS);
+      v = match(f, request("BYE", "sip:bob@192.0.2.2", ""));
+      fct_chk_eq_int(v, overload_filter::PASS);
+
+      // emergency numbers
+      v = match(f, request("INVITE", "sip:112@192.0.2.2", ""));
+      fct_chk_eq_int(v, overload_filter::PASS);
+      v = match(f, request("INVITE", "sip:112;phone-context=+49@192.0.2.2;user=phone", ""));
+      fct_chk_eq_int(v, overload_filter::PASS);
+      v = match(f, request("INVITE", "sip:sos@192.0.2.2", ""));
+      fct_chk_eq_int(v, overload_filter::PASS);
+      v = match(f, request("INVITE", "sip:1120@192.0.2.2", ""));
+      fct_chk_eq_int(v, overload_filter::REJECT);
+
+      AmArg s;
+      f.getStats(s);
+      fct_chk_eq_int(s["exempted"].asInt(), 3);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(via_oc_param) {
+      string m = request("INVITE", "sip:bob@192.0.2.2", "", ";oc");
+      sip_msg msg(m.c_str(), m.length());
+      char* err_msg = NULL;
+      fct_chk(!parse_sip_msg(&msg, err_msg));
+      const sip_avp* oc = get_via_oc(msg.via_p1);
+      fct_chk(oc != NULL);
+      if(oc) {
+	fct_chk_eq_int(oc->value.len, 0);
+	// the value is inserted right after the name
+	fct_chk(oc->name.s + oc->name.len == msg.via_p1->eop);
+      }
+
+      string m2 = request("INVITE", "sip:bob@192.0.2.2", "");
+      sip_msg msg2(m2.c_str(), m2.length());
+      fct_chk(!parse_sip_msg(&msg2, err_msg));
+      fct_chk(get_via_oc(msg2.via_p1) == NULL);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(oc_seq_increases) {
+      overload_filter f;
+      long double last = 0;
+
+      // more than ten changes, most likely within one second
+      for(int i=0; i<12; i++) {
+	f.set_reject(i % 2 ? 10 : 20, 1000);
+
+	char buf[128];
+	fct_req(f.print_oc(buf, sizeof(buf)) > 0);
+	const char* seq = strstr(buf, ";oc-seq=");
+	fct_req(seq != NULL);
+	seq += 8;
+
+	// RFC 7339: a decimal number, the newer one is greater
+	const char* dot = strchr(seq, '.');
+	fct_req(dot != NULL);
+	fct_chk_eq_int(strlen(dot + 1), 5);
+	long double v = strtold(seq, NULL);
+	fct_chk(v > last);
+	last = v;
+      }
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,133 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmCachedAudioFile.h"
+#include "AmPlugIn.h"
+#include "amci/codecs.h"
+#include "plug-in/wav/g711.h"
+
+#include <string.h>
+
+#include <vector>
+using std::vector;
+
+#define PROMPT_RATE  8000
+#define PROMPT_FRAME 160
+
+static int test_alaw_encode(unsigned char* out, unsigned char* in,
+			    unsigned int size, unsigned int channels,
+			    unsigned int rate, long h_codec)
+{
+  st_linear162alaw_buf(out,(int16_t*)in,PCM16_B2S(size));
+  return PCM16_B2S(size);
+}
+
+static amci_codec_t test_alaw =
+  { CODEC_ALAW, test_alaw_encode, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+
+/** PCM16 prompt, read like AmCachedAudioFile reads a file */
+class test_prompt
+  : public AmAudio
+{
+  vector<short> pcm;
+  size_t pos;
+
+protected:
+  int read(unsigned int user_ts, unsigned int size) {
+    size_t len = pcm.size() * sizeof(short);
+    if(pos >= len)
+      return -2;
+
+    unsigned int got = size;
+    if(pos + got > len)
+      got = len - pos;
+    memcpy((unsigned char*)samples,(unsigned char*)&pcm[0] + pos,got);
+    pos += got;
+
+    // 0-stuffing as AmCachedAudioFile::read()
+    if(got < size)
+      memset((unsigned char*)samples + got,0,size - got);
+    return size;
+  }
+
+  int write(unsigned int user_ts, unsigned int size) { return -1; }
+
+public:
+  test_prompt(unsigned int n_samples)
+    : AmAudio(new AmAudioFormat(CODEC_PCM16,PROMPT_RATE)), pos(0)
+  {
+    unsigned int seed = 42;
+    for(unsigned int i = 0; i < n_samples; i++) {
+      seed = seed * 1103515245 + 12345;
+      pcm.push_back((short)((seed >> 8) & 0xffff));
+    }
+  }
+};
+
+/** encodes like the RTP stream of a session */
+class test_stream
+  : public AmAudio
+{
+protected:
+  int read(unsigned int user_ts, unsigned int size) { return -1; }
+  int write(unsigned int user_ts, unsigned int size) { return -1; }
+
+public:
+  test_stream(int codec_id)
+    : AmAudio(new AmAudioFormat(codec_id,PROMPT_RATE)) {}
+
+  int encodeFrame(const unsigned char* pcm, unsigned int size,
+		  unsigned char* out) {
+    memcpy((unsigned char*)samples,pcm,size);
+    int s = encode(size);
+    if(s > 0)
+      memcpy(out,(unsigned char*)samples,s);
+    return s;
+  }
+};
+
+FCTMF_SUITE_BGN(test_prompt_encoding) {
+
+    FCT_TEST_BGN(precodable_codecs) {
+      fct_chk(AmFileCache::isPrecodable(CODEC_ULAW));
+      fct_chk(AmFileCache::isPrecodable(CODEC_ALAW));
+      fct_chk(AmFileCache::isPrecodable(CODEC_L16));
+      // frames depend on the encoder state
+      fct_chk(!AmFileCache::isPrecodable(CODEC_G722_NB));
+      fct_chk(!AmFileCache::isPrecodable(CODEC_GSM0610));
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(precoded_matches_live) {
+      // built-in PCM16, and A-law as the wav plug-in would add it
+      AmPlugIn::instance()->init();
+      AmPlugIn::instance()->addCodec(&test_alaw);
+
+      // 10.5 frames: the last one is filled up with silence
+      const unsigned int n_samples = PROMPT_FRAME * 10 + PROMPT_FRAME / 2;
+
+      test_prompt src(n_samples);
+      AmEncodedPrompt e(CODEC_ALAW,PROMPT_RATE,PROMPT_FRAME);
+      fct_req(e.encode(&src,"test"));
+      fct_req(e.frames() == 11);
+
+      // what a session sends, frame by frame
+      test_prompt live_src(n_samples);
+      test_stream stream(CODEC_ALAW);
+      unsigned char pcm[AUDIO_BUFFER_SIZE], out[AUDIO_BUFFER_SIZE];
+      unsigned long long ts = 0;
+      unsigned int i = 0;
+      for(;; i++, ts += PROMPT_FRAME * WALLCLOCK_RATE / PROMPT_RATE) {
+	int got = live_src.get(ts,pcm,PROMPT_RATE,PROMPT_FRAME);
+	if(got <= 0)
+	  break;
+
+	int s = stream.encodeFrame(pcm,got,out);
+	fct_req(i < e.frames());
+	fct_chk_eq_int(s, e.frameLength(i));
+	fct_chk(!memcmp(out,e.frame(i),s));
+      }
+      fct_chk_eq_int(i, e.frames());
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,202 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmPolyphaseResampler.h"
+#include "resample/resample.h"
+
+#include <sys/time.h>
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+using std::vector;
+
+/** AmInternalResamplerState as set up by AmAudio */
+class internal_resampler
+  : public AmResamplingState
+{
+  Resample* rstate;
+
+public:
+  internal_resampler()
+    : rstate(ResampleFactory::createResampleObj(true, 4.0,
+						ResampleFactory::INTERPOL_SINC,
+						ResampleFactory::SAMPLE_MONO))
+  {}
+
+  ~internal_resampler() { ResampleFactory::destroyResampleObj(rstate); }
+
+  unsigned int resample(unsigned char* samples, unsigned int s, double ratio) {
+    rstate->put_samples((signed short *)samples, PCM16_B2S(s));
+    s = rstate->resample((signed short *)samples, ratio, PCM16_B2S(s) * ratio);
+    return PCM16_S2B(s);
+  }
+};
+
+static vector<short> sine(unsigned int rate, double freq, double amplitude,
+			  unsigned int samples)
+{
+  vector<short> s(samples);
+  for(unsigned int i = 0; i < samples; i++)
+    s[i] = (short)lrint(amplitude * sin(2.0 * M_PI * freq * i / rate));
+  return s;
+}
+
+/** resample 'in' in frames of 20 ms */
+static vector<short> run(AmResamplingState& r, const vector<short>& in,
+			 unsigned int in_rate, unsigned int out_rate)
+{
+  unsigned int frame = in_rate / 50;
+  double ratio = (double)out_rate / (double)in_rate;
+
+  vector<short> out;
+  short buf[PCM16_B2S(AUDIO_BUFFER_SIZE)];
+  for(unsigned int i = 0; i + frame <= in.size(); i += frame) {
+    memcpy(buf, &in[i], frame * sizeof(short));
+    unsigned int s = PCM16_B2S(r.resample((unsigned char*)buf, PCM16_S2B(frame), ratio));
+    out.insert(out.end(), buf, buf + s);
+  }
+  return out;
+}
+
+/**
+ * Signal to noise and distortion of the last 100 ms of 's' which
+ * should be a tone of 'freq' (a whole number of periods).
+ */
+static double sinad(const vector<short>& s, unsigned int rate, double freq)
+{
+  unsigned int n = rate / 10;
+  if(s.size() < n)
+    return 0.0;
+
+  const short* x = &s[s.size() - n];
+  double a = 0.0, b = 0.0, total = 0.0;
+  for(unsigned int i = 0; i < n; i++) {
+    a += x[i] * sin(2.0 * M_PI * freq * i / rate);
+    b += x[i] * cos(2.0 * M_PI * freq * i / rate);
+    total += double(x[i]) * x[i];
+  }
+
+  double tone = 2.0 * (a * a + b * b) / n;
+  if(total <= tone)
+    return 200.0;
+  return 10.0 * log10(tone / (total - tone));
+}
+
+/** level of the last 100 ms of 's' relative to a full scale sine, in dB */
+static double level(const vector<short>& s, unsigned int rate)
+{
+  unsigned int n = rate / 10;
+  if(s.size() < n)
+    return 0.0;
+
+  double total = 0.0;
+  for(unsigned int i = s.size() - n; i < s.size(); i++)
+    total += double(s[i]) * s[i];
+
+  if(total == 0.0)
+    return -200.0;
+  return 10.0 * log10(total / n / (32767.0 * 32767.0 / 2.0));
+}
+
+struct rate_pair {
+  unsigned int in, out;
+};
+
+static const rate_pair rate_pairs[] = {
+  { 8000, 16000 }, { 16000, 8000 },
+  { 16000, 48000 }, { 48000, 16000 },
+  { 8000, 48000 }, { 48000, 8000 },
+  { 44100, 48000 }, { 48000, 44100 },
+  { 0, 0 }
+};
+
+FCTMF_SUITE_BGN(test_resampler) {
+
+    FCT_TEST_BGN(resampler_ratios) {
+      fct_chk(AmPolyphaseResampler::isSupported(2.0));
+      fct_chk(AmPolyphaseResampler::isSupported(0.5));
+      fct_chk(AmPolyphaseResampler::isSupported(3.0));
+      fct_chk(AmPolyphaseResampler::isSupported(16000.0 / 48000.0));
+      fct_chk(AmPolyphaseResampler::isSupported(6.0));
+      fct_chk(AmPolyphaseResampler::isSupported(8000.0 / 48000.0));
+      fct_chk(AmPolyphaseResampler::isSupported(48000.0 / 44100.0));
+      fct_chk(AmPolyphaseResampler::isSupported(44100.0 / 48000.0));
+      fct_chk(!AmPolyphaseResampler::isSupported(1.5));
+      fct_chk(!AmPolyphaseResampler::isSupported(32000.0 / 44100.0));
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(resampler_output_length) {
+      for(const rate_pair* r = rate_pairs; r->in; r++) {
+	AmPolyphaseResampler p;
+	vector<short> in(r->in);  // one second
+	vector<short> out = run(p, in, r->in, r->out);
+	fct_chk_eq_int(out.size(), r->out);
+      }
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(resampler_quality) {
+      for(const rate_pair* r = rate_pairs; r->in; r++) {
+	AmPolyphaseResampler p;
+	vector<short> out = run(p, sine(r->in, 1000.0, 16000.0, r->in / 2),
+				r->in, r->out);
+	double q = sinad(out, r->out, 1000.0);
+	if(q < 60.0)
+	  WARN("%u -> %u Hz: SINAD %.1f dB\n", r->in, r->out, q);
+	fct_chk(q >= 60.0);
+      }
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(resampler_alias_rejection) {
+      // tones above the output Nyquist frequency must not fold back
+      struct { unsigned int in, out; double freq; } tones[] = {
+	{ 16000, 8000, 6000.0 },
+	{ 48000, 16000, 12000.0 },
+	{ 48000, 8000, 10000.0 },
+	{ 48000, 44100, 23000.0 },
+	{ 0, 0, 0.0 }
+      };
+
+      for(unsigned int i = 0; tones[i].in; i++) {
+	AmPolyphaseResampler p;
+	vector<short> out = run(p, sine(tones[i].in, tones[i].freq, 32000.0,
+					tones[i].in / 2),
+				tones[i].in, tones[i].out);
+	double l = level(out, tones[i].out);
+	if(l > -55.0)
+	  WARN("%u -> %u Hz, %.0f Hz tone: %.1f dB\n",
+	       tones[i].in, tones[i].out, tones[i].freq, l);
+	fct_chk(l <= -55.0);
+      }
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(resampler_benchmark) {
+      INFO("polyphase resampler kernel: '%s'\n",
+	   AmPolyphaseResampler::getKernelName());
+
+      const unsigned int seconds = 10;
+      for(const rate_pair* r = rate_pairs; r->in; r++) {
+	vector<short> in = sine(r->in, 1000.0, 16000.0, r->in * seconds);
+
+	AmPolyphaseResampler p;
+	internal_resampler ir;
+	AmResamplingState* impl[] = { &p, &ir };
+	const char* names[] = { "polyphase", "internal" };
+
+	for(unsigned int i = 0; i < 2; i++) {
+	  struct timeval start, end;
+	  gettimeofday(&start,NULL);
+	  vector<short> out = run(*impl[i], in, r->in, r->out);
+	  gettimeofday(&end,NULL);
+	  timersub(&end,&start,&end);
+
+	  unsigned long us = end.tv_sec*1000000 + end.tv_usec;
+	  INFO("resampler '%s' %u -> %u Hz: %.2f us per 20 ms frame, "
+	       "SINAD %.1f dB\n", names[i], r->in, r->out,
+	       (double)us / (seconds * 50), sinad(out, r->out, 1000.0));
+	}
+      }
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,462 @@
+#include "fct.h"
+
+#include "log.h"
+#include "AmThread.h"
+#include "AmUtils.h"
+
+#include "sip/resolver.h"
+#include "sip/ip_util.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <string>
+#include <map>
+#include <set>
+using std::string;
+using std::map;
+using std::set;
+
+/**
+ * Local DNS server answering a few fixed names:
+ *  a.test      A     10.0.0.1
+ *  cname.test  CNAME a.test
+ *  slow.test   A     10.0.0.3 (after 200ms)
+ *  big.test    A     10.0.0.2 (truncated over UDP)
+ *  _sip._udp.srv.test SRV a.test:5070
+ *  spoofed.test A     10.0.0.4 (over UDP after a forged
+ *                     answer with another ID: 10.0.0.66)
+ *  everything else: NXDOMAIN, SOA minimum 30s
+ */
+class dns_stub
+  : public AmThread
+{
+  int udp_sd;
+  int tcp_sd;
+
+  AmMutex          m;
+  map<string,int>  queries;
+  int              tcp_queries;
+  set<unsigned short> src_ports;
+
+  static void put_16(u_char*& p, unsigned short v) {
+    *(p++) = v >> 8;
+    *(p++) = v & 0xFF;
+  }
+
+  static void put_32(u_char*& p, unsigned int v) {
+    put_16(p, v >> 16);
+    put_16(p, v & 0xFFFF);
+  }
+
+  static void put_name(u_char*& p, const char* name) {
+    while(*name) {
+      const char* dot = strchr(name,'.');
+      int len = dot ? dot - name : strlen(name);
+      *(p++) = len;
+      memcpy(p,name,len);
+      p += len;
+      name += len;
+      if(*name) name++;
+    }
+    *(p++) = 0;
+  }
+
+  // RR owned by the question name
+  static void put_rr_hdr(u_char*& p, unsigned short type, unsigned int ttl) {
+    put_16(p, 0xC00C);
+    put_16(p, type);
+    put_16(p, ns_c_in);
+    put_32(p, ttl);
+  }
+
+  static void put_a(u_char*& p, unsigned int ttl, const char* ip) {
+    put_rr_hdr(p, dns_r_a, ttl);
+    put_16(p, 4);
+    inet_pton(AF_INET, ip, p);
+    p += 4;
+  }
+
+  int answer(u_char* q, int q_len, u_char* r, bool tcp)
+  {
+    char name[NS_MAXDNAME];
+    unsigned short type;
+    if(dns_msg_question(q,q_len,name,NS_MAXDNAME,&type))
+      return -1;
+
+    m.lock();
+    queries[name]++;
+    if(tcp) tcp_queries++;
+    m.unlock();
+
+    // header + question
+    u_char* p = q + 12;
+    if(dns_skip_name(&p,q+q_len) < 0)
+      return -1;
+    p += 4;
+    memcpy(r,q,p-q);
+
+    r[2] = 0x81; // QR, RD
+    r[3] = 0x80; // RA
+    memset(r+6,0,6);
+
+    p = r + (p-q);
+    unsigned short an = 0, ns = 0;
+
+    if(!strcmp(name,"a.test")) {
+      put_a(p,300,"10.0.0.1");
+      an = 1;
+    }
+    else if(!strcmp(name,"cname.test")) {
+      u_char* rdlen;
+      put_rr_hdr(p,dns_r_cname,300);
+      rdlen = p; p += 2;
+      put_name(p,"a.test");
+      u_char* rd_end = p;
+      p = rdlen; put_16(p, rd_end - rdlen - 2); p = rd_end;
+
+      put_name(p,"a.test");
+      put_16(p, dns_r_a);
+      put_16(p, ns_c_in);
+      put_32(p, 300);
+      put_16(p, 4);
+      inet_pton(AF_INET, "10.0.0.1", p);
+      p += 4;
+      an = 2;
+    }
+    else if(!strcmp(name,"slow.test")) {
+      usleep(200000);
+      put_a(p,300,"10.0.0.3");
+      an = 1;
+    }
+    else if(!strcmp(name,"big.test")) {
+      if(!tcp) {
+	r[2] |= 0x02; // TC
+      }
+      else {
+	put_a(p,300,"10.0.0.2");
+	an = 1;
+      }
+    }
+    else if(!strcmp(name,"spoofed.test")) {
+      put_a(p,300,"10.0.0.4");
+      an = 1;
+    }
+    else if(!strcmp(name,"_sip._udp.srv.test")) {
+      put_rr_hdr(p,dns_r_srv,300);
+      put_16(p, 6 + 8);
+      put_16(p, 0);    // priority
+      put_16(p, 0);    // weight
+      put_16(p, 5070); // port
+      put_name(p,"a.test");
+      an = 1;
+    }
+    else {
+      r[3] |= 3; // NXDOMAIN
+
+      put_name(p,"test");
+      put_16(p, dns_r_soa);
+      put_16(p, ns_c_in);
+      put_32(p, 60);
+      u_char* rdlen = p; p += 2;
+      put_name(p,"ns.test");
+      put_name(p,"hm.test");
+      put_32(p, 1);    // serial
+      put_32(p, 3600); // refresh
+      put_32(p, 600);  // retry
+      put_32(p, 86400);// expire
+      put_32(p, 30);   // minimum
+      u_char* rd_end = p;
+      p = rdlen; put_16(p, rd_end - rdlen - 2); p = rd_end;
+      ns = 1;
+    }
+
+    r[6] = an >> 8; r[7] = an & 0xFF;
+    r[8] = ns >> 8; r[9] = ns & 0xFF;
+
+    return p - r;
+  }
+
+  void serve_tcp()
+  {
+    int sd = accept(tcp_sd,NULL,NULL);
+    if(sd < 0) return;
+
+    u_char q[NS_PACKETSZ+2], r[NS_PACKETSZ+2];
+    int len = 0, n;
+    while((len < 2 || len < 2 + dns_get_16(q)) &&
+	  (n = read(sd,q+len,sizeof(q)-len)) > 0)
+      len += n;
+
+    if(len > 2) {
+      int r_len = answer(q+2,len-2,r+2,true);
+      if(r_len > 0) {
+	r[0] = r_len >> 8;
+	r[1] = r_len & 0xFF;
+	if(write(sd,r,r_len+2) < 0) {}
+      }
+    }
+    close(sd);
+  }
+
+public:
+  unsigned short port;
+
+  dns_stub()
+    : tcp_queries(0), port(0)
+  {
+    sockaddr_storage sa;
+    memset(&sa,0,sizeof(sa));
+    am_inet_pton("127.0.0.1",&sa);
+
+    udp_sd = socket(AF_INET,SOCK_DGRAM,0);
+    bind(udp_sd,(sockaddr*)&sa,SA_len(&sa));
+
+    socklen_t sa_len = sizeof(sa);
+    getsockname(udp_sd,(sockaddr*)&sa,&sa_len);
+    port = am_get_port(&sa);
+
+    int on = 1;
+    tcp_sd = socket(AF_INET,SOCK_STREAM,0);
+    setsockopt(tcp_sd,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+    bind(tcp_sd,(sockaddr*)&sa,SA_len(&sa));
+    listen(tcp_sd,4);
+  }
+
+  void get_addr(sockaddr_storage* sa) {
+    memset(sa,0,sizeof(sockaddr_storage));
+    am_inet_pton("127.0.0.1",sa);
+    am_set_port(sa,port);
+  }
+
+  int count(const string& name) {
+    m.lock();
+    int n = queries[name];
+    m.unlock();
+    return n;
+  }
+
+  int count_tcp() {
+    m.lock();
+    int n = tcp_queries;
+    m.unlock();
+    return n;
+  }
+
+  int count_src_ports() {
+    m.lock();
+    int n = src_ports.size();
+    m.unlock();
+    return n;
+  }
+
+  void run()
+  {
+    for(;;) {
+      struct pollfd fds[2];
+      fds[0].fd = udp_sd; fds[0].events = POLLIN;
+      fds[1].fd = tcp_sd; fds[1].events = POLLIN;
+      if(poll(fds,2,-1) < 0)
+	continue;
+
+      if(fds[0].revents & POLLIN) {
+	u_char q[NS_PACKETSZ], r[NS_PACKETSZ];
+	sockaddr_storage from;
+	socklen_t from_len = sizeof(from);
+	int len = recvfrom(udp_sd,q,NS_PACKETSZ,0,(sockaddr*)&from,&from_len);
+	if(len > 0) {
+	  m.lock();
+	  src_ports.insert(am_get_port(&from));
+	  m.unlock();
+
+	  int r_len = answer(q,len,r,false);
+	  char name[NS_MAXDNAME];
+	  unsigned short type;
+	  if((r_len > 0) && !dns_msg_question(q,len,name,NS_MAXDNAME,&type) &&
+	     !strcmp(name,"spoofed.test")) {
+	    u_char f[NS_PACKETSZ];
+	    memcpy(f,r,r_len);
+	    f[1] ^= 0x01;       // ID
+	    f[r_len-1] = 66;    // 10.0.0.66
+	    sendto(udp_sd,f,r_len,0,(sockaddr*)&from,from_len);
+	  }
+	  if(r_len > 0)
+	    sendto(udp_sd,r,r_len,0,(sockaddr*)&from,from_len);
+	}
+      }
+
+      if(fds[1].revents & POLLIN)
+	serve_tcp();
+    }
+  }
+
+  void on_stop() {}
+};
+
+class test_query_cb
+  : public dns_query_cb
+{
+public:
+  AmCondition<bool> done;
+  int err;
+
+  test_query_cb()
+    : done(false), err(-1)
+  {}
+
+  void dns_resolved(const string& name, dns_rr_type t, int err) {
+    this->err = err;
+    done.set(true);
+  }
+};
+
+static dns_stub* get_stub()
+{
+  static dns_stub* stub = NULL;
+  if(!stub) {
+    stub = new dns_stub();
+    stub->start();
+
+    sockaddr_storage sa;
+    stub->get_addr(&sa);
+    resolver::instance()->set_servers(vector<sockaddr_storage>(1,sa));
+  }
+  return stub;
+}
+
+FCTMF_SUITE_BGN(test_resolver) {
+
+    FCT_TEST_BGN(resolve_a) {
+      dns_stub* stub = get_stub();
+
+      dns_handle h;
+      sockaddr_storage sa;
+      memset(&sa,0,sizeof(sa));
+      int err = resolver::instance()->resolve_name("a.test",&h,&sa,IPv4);
+      fct_chk_eq_int(err, 0);
+      fct_chk(am_inet_ntop(&sa) == "10.0.0.1");
+
+      // cached
+      dns_handle h2;
+      err = resolver::instance()->resolve_name("a.test",&h2,&sa,IPv4);
+      fct_chk_eq_int(err, 0);
+      int n = stub->count("a.test");
+      fct_chk_eq_int(n, 1);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(resolve_cname) {
+      get_stub();
+
+      dns_handle h;
+      sockaddr_storage sa;
+      memset(&sa,0,sizeof(sa));
+      int err = resolver::instance()->resolve_name("cname.test",&h,&sa,IPv4);
+      fct_chk_eq_int(err, 0);
+      fct_chk(am_inet_ntop(&sa) == "10.0.0.1");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(negative_cache) {
+      dns_stub* stub = get_stub();
+
+      dns_handle h;
+      sockaddr_storage sa;
+      int err = resolver::instance()->resolve_name("nx.test",&h,&sa,IPv4);
+      fct_chk_eq_int(err, -1);
+
+      // answered from the cache
+      dns_handle h2;
+      err = resolver::instance()->resolve_name("nx.test",&h2,&sa,IPv4);
+      fct_chk_eq_int(err, -1);
+      int n = stub->count("nx.test");
+      fct_chk_eq_int(n, 1);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(coalesce_queries) {
+      dns_stub* stub = get_stub();
+
+      test_query_cb* cb1 = new test_query_cb();
+      test_query_cb* cb2 = new test_query_cb();
+      inc_ref(cb1);
+      inc_ref(cb2);
+
+      resolver::instance()->query_async("slow.test",dns_r_a,cb1);
+      resolver::instance()->query_async("slow.test",dns_r_a,cb2);
+
+      fct_chk(cb1->done.wait_for_to(2000));
+      fct_chk(cb2->done.wait_for_to(2000));
+      fct_chk_eq_int(cb1->err, 0);
+      fct_chk_eq_int(cb2->err, 0);
+      int n = stub->count("slow.test");
+      fct_chk_eq_int(n, 1);
+
+      dec_ref(cb1);
+      dec_ref(cb2);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(tcp_fallback) {
+      dns_stub* stub = get_stub();
+
+      dns_handle h;
+      sockaddr_storage sa;
+      memset(&sa,0,sizeof(sa));
+      int err = resolver::instance()->resolve_name("big.test",&h,&sa,IPv4);
+      fct_chk_eq_int(err, 0);
+      fct_chk(am_inet_ntop(&sa) == "10.0.0.2");
+      int n = stub->count_tcp();
+      fct_chk_eq_int(n, 1);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(query_spoofing) {
+      dns_stub* stub = get_stub();
+
+      // the forged answer with the wrong ID is dropped
+      dns_handle h;
+      sockaddr_storage sa;
+      memset(&sa,0,sizeof(sa));
+      int err = resolver::instance()->resolve_name("spoofed.test",&h,&sa,IPv4);
+      fct_chk_eq_int(err, 0);
+      fct_chk(am_inet_ntop(&sa) == "10.0.0.4");
+
+      // no fixed source port
+      for(int i=0; i<4; i++) {
+	dns_handle h_nx;
+	string name = "port" + int2str(i) + ".test";
+	resolver::instance()->resolve_name(name.c_str(),&h_nx,&sa,IPv4);
+      }
+      fct_chk(stub->count_src_ports() > 1);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(missing_target) {
+      get_stub();
+
+      list<sip_destination> dest_list;
+      sip_destination dest;
+      dest.host = cstring("srv.test");
+      dest_list.push_back(dest);
+
+      string name;
+      dns_rr_type t;
+      bool missing = resolver::instance()->missing_target(dest_list,name,t);
+      fct_chk(missing);
+      fct_chk(name == "_sip._udp.srv.test");
+      fct_chk_eq_int(t, dns_r_srv);
+
+      int err = resolver::instance()->query_dns(name.c_str(),t);
+      fct_chk_eq_int(err, 0);
+
+      // SRV target a.test is cached already
+      missing = resolver::instance()->missing_target(dest_list,name,t);
+      fct_chk(!missing);
+
+      sip_target_set targets;
+      err = resolver::instance()->resolve_targets(dest_list,&targets);
+      fct_chk_eq_int(err, 0);
+      fct_chk_eq_int(targets.dest_list.size(), 1);
+      fct_chk(am_inet_ntop(&targets.dest_list.front().ss) == "10.0.0.1");
+      fct_chk_eq_int(am_get_port(&targets.dest_list.front().ss), 5070);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
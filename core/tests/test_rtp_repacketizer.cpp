@@ -0,0 +1,281 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmRtpRepacketizer.h"
+#include "AmSdp.h"
+
+#include <sys/time.h>
+#include <string.h>
+
+#include <vector>
+using std::vector;
+
+struct sent_packet {
+  int            payload;
+  unsigned short seq;
+  unsigned int   ts;
+  bool           marker;
+  vector<unsigned char> data;
+};
+
+/** packet whose payload bytes count on from its timestamp */
+static void make_packet(AmRtpPacket& p, unsigned char* buf, int payload,
+			unsigned short seq, unsigned int ts, bool marker,
+			unsigned int size)
+{
+  unsigned char data[RTP_PACKET_BUF_SIZE];
+  for(unsigned int i = 0; i < size; i++)
+    data[i] = (unsigned char)(ts + i);
+
+  p.setBuffer(buf,RTP_PACKET_BUF_SIZE);
+  p.payload = payload;
+  p.sequence = seq;
+  p.timestamp = ts;
+  p.marker = marker;
+  p.ssrc = 0x1234;
+  p.compile(data,size);
+  p.parse();
+}
+
+static void push(AmRtpRepacketizer& r, vector<sent_packet>& sent, int payload,
+		 unsigned short seq, unsigned int ts, bool marker,
+		 unsigned int size)
+{
+  unsigned char buf[RTP_PACKET_BUF_SIZE];
+  AmRtpPacket p;
+  make_packet(p,buf,payload,seq,ts,marker,size);
+
+  r.push(&p);
+  for(AmRtpPacket* o = r.pop(); o != NULL; o = r.pop()) {
+    // as it goes to the network
+    o->parse();
+    sent_packet s;
+    s.payload = o->payload;
+    s.seq = o->sequence;
+    s.ts = o->timestamp;
+    s.marker = o->marker;
+    s.data.assign(o->getData(),o->getData() + o->getDataSize());
+    sent.push_back(s);
+  }
+  p.releaseBuffer();
+}
+
+/** payload of 's' continues its timestamp */
+static bool contiguous(const sent_packet& s)
+{
+  for(unsigned int i = 0; i < s.data.size(); i++)
+    if(s.data[i] != (unsigned char)(s.ts + i))
+      return false;
+  return true;
+}
+
+FCTMF_SUITE_BGN(test_rtp_repacketizer) {
+
+    FCT_TEST_BGN(repacketizer_split) {
+      // PCMU 30 ms -> 20 ms
+      AmRtpRepacketizer* r = AmRtpRepacketizer::create(SdpPayload(0),20);
+      fct_req(r != NULL);
+      fct_chk_eq_int(r->getPacketSize(), 160);
+
+      vector<sent_packet> sent;
+      for(unsigned int i = 0; i < 4; i++)
+	push(*r,sent,0,100 + i,i * 240,i == 0,240);
+
+      fct_req(sent.size() == 6);
+      for(unsigned int i = 0; i < 6; i++) {
+	fct_chk_eq_int(sent[i].seq, 100 + i);
+	fct_chk_eq_int(sent[i].ts, i * 160);
+	fct_chk_eq_int(sent[i].data.size(), 160);
+	fct_chk(contiguous(sent[i]));
+	fct_chk(sent[i].marker == (i == 0));
+      }
+      delete r;
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(repacketizer_merge) {
+      // G.729 20 ms -> 40 ms, packet 12 lost
+      SdpPayload g729(18);
+      AmRtpRepacketizer* r = AmRtpRepacketizer::create(g729,40);
+      fct_req(r != NULL);
+      fct_chk_eq_int(r->getPacketSize(), 40);
+
+      vector<sent_packet> sent;
+      unsigned short seqs[] = { 10, 11, 13, 14, 15 };
+      for(unsigned int i = 0; i < 5; i++)
+	push(*r,sent,18,seqs[i],(seqs[i] - 10) * 160,false,20);
+
+      // 10+11, 12 lost, 13+14, 15 waits for 16
+      fct_req(sent.size() == 2);
+      fct_chk_eq_int(sent[0].seq, 10);
+      fct_chk_eq_int(sent[0].ts, 0);
+      fct_chk_eq_int(sent[0].data.size(), 40);
+      fct_chk_eq_int(sent[1].seq, 12);
+      fct_chk_eq_int(sent[1].ts, 3 * 160);
+      fct_chk_eq_int(sent[1].data.size(), 40);
+      delete r;
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(repacketizer_marker_and_passthrough) {
+      // PCMA 20 ms -> 30 ms
+      AmRtpRepacketizer* r = AmRtpRepacketizer::create(SdpPayload(8),30);
+      fct_req(r != NULL);
+
+      vector<sent_packet> sent;
+      push(*r,sent,8,1,0,true,160);     // buffered
+      fct_chk_eq_int(sent.size(), 0);
+
+      // telephone-event: flushes 20 ms, then goes out as it is
+      push(*r,sent,101,2,160,true,4);
+      fct_req(sent.size() == 2);
+      fct_chk_eq_int(sent[0].payload, 8);
+      fct_chk_eq_int(sent[0].data.size(), 160);
+      fct_chk(sent[0].marker);
+      fct_chk_eq_int(sent[1].payload, 101);
+      fct_chk_eq_int(sent[1].seq, sent[0].seq + 1);
+      fct_chk_eq_int(sent[1].ts, 160);
+
+      // new talk spurt after a pause
+      sent.clear();
+      push(*r,sent,8,3,8000,true,160);
+      push(*r,sent,8,4,8160,false,160);
+      fct_req(sent.size() == 1);
+      fct_chk(sent[0].marker);
+      fct_chk_eq_int(sent[0].ts, 8000);
+      fct_chk_eq_int(sent[0].data.size(), 240);
+      fct_chk(contiguous(sent[0]));
+
+      // a marker flushes the rest (80 bytes) first
+      sent.clear();
+      push(*r,sent,8,5,16000,true,160);
+      fct_req(sent.size() == 1);
+      fct_chk(!sent[0].marker);
+      fct_chk_eq_int(sent[0].ts, 8240);
+      fct_chk_eq_int(sent[0].data.size(), 80);
+      fct_chk(contiguous(sent[0]));
+      delete r;
+
+      // G.729B SID frames are not cut
+      r = AmRtpRepacketizer::create(SdpPayload(18),40);
+      fct_req(r != NULL);
+      sent.clear();
+      push(*r,sent,18,1,0,false,20);
+      push(*r,sent,18,2,160,false,2);
+      fct_req(sent.size() == 2);
+      fct_chk_eq_int(sent[0].data.size(), 20);
+      fct_chk_eq_int(sent[1].data.size(), 2);
+      fct_chk_eq_int(sent[1].seq, sent[0].seq + 1);
+      delete r;
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(repacketizer_flush) {
+      // PCMU 20 ms -> 30 ms
+      AmRtpRepacketizer* r = AmRtpRepacketizer::create(SdpPayload(0),30);
+      fct_req(r != NULL);
+
+      vector<sent_packet> sent;
+      push(*r,sent,0,1,0,true,160);
+      fct_chk_eq_int(sent.size(), 0);
+
+      // relaying stops: the 20 ms buffered go out right away
+      r->flush();
+      AmRtpPacket* o = r->pop();
+      fct_req(o != NULL);
+      fct_chk_eq_int(o->sequence, 1);
+      fct_chk_eq_int(o->timestamp, 0);
+      fct_chk_eq_int(o->getDataSize(), 160);
+      fct_chk(o->marker);
+      fct_chk(r->pop() == NULL);
+
+      // nothing left for the next talk spurt, sequence goes on
+      push(*r,sent,0,2,8000,true,160);
+      push(*r,sent,0,3,8160,false,160);
+      fct_req(sent.size() == 1);
+      fct_chk_eq_int(sent[0].seq, 2);
+      fct_chk_eq_int(sent[0].ts, 8000);
+      fct_chk_eq_int(sent[0].data.size(), 240);
+      fct_chk(contiguous(sent[0]));
+
+      r->flush();
+      fct_req((o = r->pop()) != NULL);
+      fct_chk_eq_int(o->sequence, 3);
+      fct_chk_eq_int(o->getDataSize(), 80);
+      r->flush();
+      fct_chk(r->pop() == NULL);
+
+      // as after an SDP update with the same payload and ptime
+      AmRtpRepacketizer* same = AmRtpRepacketizer::create(SdpPayload(0),30);
+      AmRtpRepacketizer* other = AmRtpRepacketizer::create(SdpPayload(0),20);
+      fct_req((same != NULL) && (other != NULL));
+      fct_chk(r->hasFormatOf(*same));
+      fct_chk(!r->hasFormatOf(*other));
+      delete same;
+      delete other;
+      delete r;
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(repacketizer_formats) {
+      unsigned int bytes = 0, ts = 0;
+
+      SdpPayload l16(96,"L16",8000,2);
+      fct_chk(AmRtpRepacketizer::getFrameFormat(l16,bytes,ts));
+      fct_chk_eq_int(bytes, 4);
+      fct_chk_eq_int(ts, 1);
+
+      SdpPayload ilbc(97,"iLBC",8000,0);
+      fct_chk(AmRtpRepacketizer::getFrameFormat(ilbc,bytes,ts));
+      fct_chk_eq_int(bytes, 50);
+      fct_chk_eq_int(ts, 240);
+      ilbc.sdp_format_parameters = "mode=20";
+      fct_chk(AmRtpRepacketizer::getFrameFormat(ilbc,bytes,ts));
+      fct_chk_eq_int(bytes, 38);
+      fct_chk_eq_int(ts, 160);
+
+      // 30 ms is no multiple of 20 ms frames
+      AmRtpRepacketizer* r = AmRtpRepacketizer::create(ilbc,30);
+      fct_chk(r == NULL);
+      r = AmRtpRepacketizer::create(ilbc,40);
+      fct_chk(r != NULL);
+      delete r;
+
+      SdpPayload gsm(3);
+      fct_chk(!AmRtpRepacketizer::getFrameFormat(gsm,bytes,ts));
+      r = AmRtpRepacketizer::create(SdpPayload(96,"opus",48000,2),20);
+      fct_chk(r == NULL);
+
+      SdpMedia m;
+      ilbc.sdp_format_parameters.clear();
+      fct_chk_eq_int(AmRtpRepacketizer::getPtime(m,SdpPayload(0)), 20);
+      fct_chk_eq_int(AmRtpRepacketizer::getPtime(m,ilbc), 30);
+      m.attributes.push_back(SdpAttribute("ptime","40"));
+      fct_chk_eq_int(AmRtpRepacketizer::getPtime(m,SdpPayload(0)), 40);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(repacketizer_benchmark) {
+      const unsigned int packets = 100000;
+      AmRtpRepacketizer* r = AmRtpRepacketizer::create(SdpPayload(0),20);
+      fct_req(r != NULL);
+
+      unsigned char buf[RTP_PACKET_BUF_SIZE];
+      AmRtpPacket p;
+      unsigned int sent = 0;
+
+      struct timeval start, end;
+      gettimeofday(&start,NULL);
+      for(unsigned int i = 0; i < packets; i++) {
+	make_packet(p,buf,0,i,i * 240,false,240);
+	r->push(&p);
+	while(r->pop())
+	  sent++;
+      }
+      gettimeofday(&end,NULL);
+      timersub(&end,&start,&end);
+      p.releaseBuffer();
+
+      fct_chk_eq_int(sent, packets * 3 / 2);
+      INFO("RTP repacketizer: PCMU 30 ms -> 20 ms: %.3f us per packet\n",
+	   (double)(end.tv_sec*1000000 + end.tv_usec) / packets);
+      delete r;
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
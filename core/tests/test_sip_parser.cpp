@@ -0,0 +1,117 @@
+#include "fct.h"
+
+#include "log.h"
+#include "AmUtils.h"
+
+#include "sip/sip_parser.h"
+#include "sip/parse_header.h"
+#include "sip/parse_via.h"
+#include "sip/parse_from_to.h"
+
+#include <string>
+using std::string;
+
+static string big_invite(int n_vias, int n_rr)
+{
+  string m = "INVITE sip:bob@example.com;transport=udp SIP/2.0\r\n";
+  for(int i=0; i<n_vias; i++)
+    m += "Via: SIP/2.0/UDP proxy" + int2str(i) + ".example.com:5060"
+      ";branch=z9hG4bK" + int2str(i) + "abcdef;rport\r\n";
+  for(int i=0; i<n_rr; i++)
+    m += "Record-Route: <sip:proxy" + int2str(i) + ".example.com;lr;ftag=x>\r\n";
+  m += "From: \"Alice\" <sip:alice@example.com>;tag=1928301774\r\n"
+    "To: <sip:bob@example.com>\r\n"
+    "Call-ID: a84b4c76e66710@pc33.example.com\r\n"
+    "CSeq: 314159 INVITE\r\n"
+    "Contact: <sip:alice@pc33.example.com>\r\n"
+    "Max-Forwards: 70\r\n"
+    "Content-Type: application/sdp\r\n"
+    "Content-Length: 4\r\n"
+    "\r\n"
+    "v=0\n";
+  return m;
+}
+
+FCTMF_SUITE_BGN(test_sip_parser) {
+
+    FCT_TEST_BGN(parse_big_invite) {
+      string m = big_invite(10, 10);
+      sip_msg msg(m.c_str(), m.length());
+      char* err_msg = NULL;
+      int err = parse_sip_msg(&msg, err_msg);
+      fct_chk_eq_int(err, 0);
+      fct_chk_eq_int(msg.type, SIP_REQUEST);
+      fct_chk_eq_int(msg.u.request->method, sip_request::INVITE);
+      fct_chk_eq_int(msg.vias.size(), 10);
+      fct_chk_eq_int(msg.record_route.size(), 10);
+      fct_chk_eq_int(msg.contacts.size(), 1);
+      fct_chk_eq_int(msg.hdrs.size(), 28);
+      fct_chk(msg.via_p1 != NULL);
+      fct_chk(c2stlstr(msg.via_p1->branch) == "z9hG4bK0abcdef");
+      fct_chk(c2stlstr(get_from(&msg)->tag) == "1928301774");
+      fct_chk(c2stlstr(msg.body) == "v=0\n");
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(arena_backs_message) {
+      string m = big_invite(10, 10);
+      sip_msg msg(m.c_str(), m.length());
+      char* err_msg = NULL;
+      int err = parse_sip_msg(&msg, err_msg);
+      fct_chk_eq_int(err, 0);
+
+      // everything fits in the first chunk
+      fct_chk_eq_int(msg.arena.size(), SIP_ARENA_SIZE(m.length()));
+      fct_chk(msg.arena.contains(msg.buf));
+      fct_chk(msg.arena.contains(msg.via1));
+      fct_chk(msg.arena.contains(msg.via1->p));
+      fct_chk(msg.arena.contains(msg.via_p1));
+      fct_chk(msg.arena.contains(msg.u.request));
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(arena_mixed_headers) {
+      string m = big_invite(2, 2);
+      sip_msg* msg = new sip_msg(m.c_str(), m.length());
+      char* err_msg = NULL;
+      int err = parse_sip_msg(msg, err_msg);
+      fct_chk_eq_int(err, 0);
+
+      // created outside of the parser: from the heap
+      sip_header* h = new sip_header(0, "X-Test", "1");
+      fct_chk(!msg->arena.contains(h));
+      msg->hdrs.push_back(h);
+
+      // deletes arena and heap headers alike
+      delete msg;
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(arena_shallow_copy) {
+      string m = big_invite(3, 0);
+      sip_msg msg(m.c_str(), m.length());
+      char* err_msg = NULL;
+      int err = parse_sip_msg(&msg, err_msg);
+      fct_chk_eq_int(err, 0);
+
+      sip_msg tmp_msg(msg);
+      fct_chk_eq_int(tmp_msg.arena.size(), 0);
+      tmp_msg.vias.pop_front();
+      fct_chk_eq_int(tmp_msg.vias.size(), 2);
+      fct_chk_eq_int(msg.vias.size(), 3);
+      tmp_msg.release();
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(arena_grows) {
+      sip_arena a;
+      a.reserve(64);
+      fct_chk_eq_int(a.size(), 64);
+      void* p1 = a.alloc(40);
+      void* p2 = a.alloc(40);
+      fct_chk(a.contains(p1));
+      fct_chk(a.contains(p2));
+      fct_chk(a.size() > 64);
+      fct_chk_eq_int((size_t)p1 % SIP_ARENA_ALIGN, 0);
+      fct_chk_eq_int((size_t)p2 % SIP_ARENA_ALIGN, 0);
+      int x;
+      fct_chk(!a.contains(&x));
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
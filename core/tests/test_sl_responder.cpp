@@ -0,0 +1,125 @@
+#include "fct.h"
+
+#include "log.h"
+#include "AmUtils.h"
+#include "AmArg.h"
+
+#include "sip/sip_parser.h"
+#include "sip/sl_responder.h"
+#include "sip/ip_util.h"
+
+#include <string>
+using std::string;
+
+static string keepalive(const string& method, const string& ruri,
+			const string& to_tag, const string& event)
+{
+  string m = method + " " + ruri + " SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP 192.0.2.1:5060;branch=z9hG4bK776asdhds\r\n"
+    "From: <sip:ua@192.0.2.1>;tag=1928301774\r\n"
+    "To: <" + ruri + ">";
+  if(!to_tag.empty())
+    m += ";tag=" + to_tag;
+  m += "\r\n"
+    "Call-ID: a84b4c76e66710@192.0.2.1\r\n"
+    "CSeq: 1 " + method + "\r\n";
+  if(!event.empty())
+    m += "Event: " + event + "\r\n";
+  m += "Content-Length: 0\r\n"
+    "\r\n";
+  return m;
+}
+
+static sl_responder::verdict match(sl_responder& r, const string& m,
+				   const char* src = "192.0.2.1")
+{
+  sip_msg msg(m.c_str(), m.length());
+  char* err_msg = NULL;
+  if(parse_sip_msg(&msg, err_msg))
+    return (sl_responder::verdict)-1;
+  am_inet_pton(src, &msg.remote_ip);
+  return r.match(&msg);
+}
+
+FCTMF_SUITE_BGN(test_sl_responder) {
+
+    FCT_TEST_BGN(disabled_by_default) {
+      sl_responder r;
+      fct_chk(!r.enabled());
+      int v = match(r, keepalive("OPTIONS", "sip:192.0.2.2", "", ""));
+      fct_chk_eq_int(v, sl_responder::PASS);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(options_out_of_dialog) {
+      sl_responder r;
+      r.configure(SL_RESP_OPTIONS, false, 0, "");
+
+      int v = match(r, keepalive("OPTIONS", "sip:192.0.2.2", "", ""));
+      fct_chk_eq_int(v, sl_responder::ANSWER);
+
+      // in-dialog and to a user: left to the application
+      v = match(r, keepalive("OPTIONS", "sip:192.0.2.2", "a6c85cf", ""));
+      fct_chk_eq_int(v, sl_responder::PASS);
+      v = match(r, keepalive("OPTIONS", "sip:bob@192.0.2.2", "", ""));
+      fct_chk_eq_int(v, sl_responder::PASS);
+
+      // other methods are not counted
+      v = match(r, keepalive("INVITE", "sip:192.0.2.2", "", ""));
+      fct_chk_eq_int(v, sl_responder::PASS);
+
+      AmArg s;
+      r.getStats(s);
+      fct_chk_eq_int(s["answered"].asInt(), 1);
+      fct_chk_eq_int(s["passed"].asInt(), 2);
+
+      r.configure(SL_RESP_OPTIONS, true, 0, "");
+      v = match(r, keepalive("OPTIONS", "sip:bob@192.0.2.2", "", ""));
+      fct_chk_eq_int(v, sl_responder::ANSWER);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(notify_keepalive) {
+      sl_responder r;
+      int v = 0;
+
+      r.configure(SL_RESP_OPTIONS, false, 0, "");
+      v = match(r, keepalive("NOTIFY", "sip:192.0.2.2", "", "keep-alive"));
+      fct_chk_eq_int(v, sl_responder::PASS);
+
+      r.configure(SL_RESP_OPTIONS|SL_RESP_NOTIFY, false, 0, "");
+      v = match(r, keepalive("NOTIFY", "sip:192.0.2.2", "", "keep-alive"));
+      fct_chk_eq_int(v, sl_responder::ANSWER);
+      v = match(r, keepalive("NOTIFY", "sip:192.0.2.2", "", "Keep-Alive;id=1"));
+      fct_chk_eq_int(v, sl_responder::ANSWER);
+      v = match(r, keepalive("NOTIFY", "sip:192.0.2.2", "", "keep-alive-not"));
+      fct_chk_eq_int(v, sl_responder::PASS);
+      v = match(r, keepalive("NOTIFY", "sip:192.0.2.2", "", "presence"));
+      fct_chk_eq_int(v, sl_responder::PASS);
+      v = match(r, keepalive("NOTIFY", "sip:192.0.2.2", "", ""));
+      fct_chk_eq_int(v, sl_responder::PASS);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(rate_per_source) {
+      sl_responder r;
+      r.configure(SL_RESP_OPTIONS, false, 2, "");
+      string m = keepalive("OPTIONS", "sip:192.0.2.2", "", "");
+
+      // the clock does not advance: all in the same second
+      int v = match(r, m);
+      fct_chk_eq_int(v, sl_responder::ANSWER);
+      v = match(r, m);
+      fct_chk_eq_int(v, sl_responder::ANSWER);
+      v = match(r, m);
+      fct_chk_eq_int(v, sl_responder::DROP);
+
+      v = match(r, m, "192.0.2.9");
+      fct_chk_eq_int(v, sl_responder::ANSWER);
+      v = match(r, m, "2001:db8::1");
+      fct_chk_eq_int(v, sl_responder::ANSWER);
+
+      AmArg s;
+      r.getStats(s);
+      fct_chk_eq_int(s["answered"].asInt(), 4);
+      fct_chk_eq_int(s["rate_limited"].asInt(), 1);
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
@@ -0,0 +1,136 @@
+#include "fct.h"
+
+#include "log.h"
+#include "AmUtils.h"
+
+#include "hash_table.h"
+#include "sip/sip_parser.h"
+#include "sip/parse_header.h"
+#include "sip/parse_via.h"
+#include "sip/parse_cseq.h"
+#include "sip/sip_trans.h"
+#include "sip/trans_table.h"
+
+#include <string.h>
+#include <string>
+using std::string;
+
+struct ilist_val
+  : public ht_ilink<ilist_val>
+{
+  int n;
+  ilist_val(int n) : n(n) {}
+  void dump() const {}
+};
+
+static sip_msg* parsed_msg(const string& fline, const string& branch)
+{
+  string m = fline + "\r\n"
+    "Via: SIP/2.0/UDP 192.0.2.1:5060;branch=" + branch + "\r\n"
+    "From: <sip:alice@example.com>;tag=1928301774\r\n"
+    "To: <sip:bob@example.com>\r\n"
+    "Call-ID: a84b4c76e66710@pc33.example.com\r\n"
+    "CSeq: 314159 INVITE\r\n"
+    "Contact: <sip:alice@192.0.2.1>\r\n"
+    "Content-Length: 0\r\n"
+    "\r\n";
+  sip_msg* msg = new sip_msg(m.c_str(), m.length());
+  char* err_msg = NULL;
+  if(parse_sip_msg(msg, err_msg)) {
+    delete msg;
+    return NULL;
+  }
+  return msg;
+}
+
+FCTMF_SUITE_BGN(test_trans_table) {
+
+    FCT_TEST_BGN(ilist_bucket) {
+      ht_ilist_bucket<ilist_val> b(0);
+      ilist_val* v1 = new ilist_val(1);
+      ilist_val* v2 = new ilist_val(2);
+      ilist_val* v3 = new ilist_val(3);
+      b.push_back(v1);
+      b.push_back(v2);
+      b.push_back(v3);
+      fct_chk_eq_int(b.size(), 3);
+      fct_chk(b.exist(v2));
+
+      b.remove(v2);
+      fct_chk_eq_int(b.size(), 2);
+      fct_chk(!b.exist(v2));
+      fct_chk(v1->ht_next == v3);
+      fct_chk(v3->ht_prev == v1);
+
+      b.unlink(v1);
+      fct_chk_eq_int(b.size(), 1);
+      delete v1;
+      // v3 deleted with the bucket
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(match_by_branch) {
+      sip_msg* inv = parsed_msg("INVITE sip:bob@example.com SIP/2.0",
+				"z9hG4bK776asdhds");
+      fct_chk(inv != NULL);
+
+      trans_bucket* bucket = get_trans_bucket(inv->callid->value,
+					      get_cseq(inv)->num_str);
+      bucket->lock();
+      sip_trans* t = bucket->add_trans(inv, TT_UAS);
+
+      sip_msg* retr = parsed_msg("INVITE sip:bob@example.com SIP/2.0",
+				 "z9hG4bK776asdhds");
+      sip_msg* other = parsed_msg("INVITE sip:bob@example.com SIP/2.0",
+				  "z9hG4bK776asdhdX");
+      fct_chk(bucket->match_request(retr, TT_UAS) == t);
+      fct_chk(bucket->match_request(other, TT_UAS) == NULL);
+      fct_chk(bucket->match_request(retr, TT_UAC) == NULL);
+
+      // the branch has been changed in place
+      memcpy((char*)t->msg->via_p1->branch.s + MAGIC_BRANCH_LEN, "776asdhdX", 9);
+      bucket->update_branch(t);
+      fct_chk(bucket->match_request(other, TT_UAS) == t);
+      fct_chk(bucket->match_request(retr, TT_UAS) == NULL);
+
+      ht_stats s;
+      get_trans_table_stats(s);
+      fct_chk_eq_int(s.buckets, H_TABLE_ENTRIES);
+      fct_chk_eq_int(s.elements, 1);
+
+      bucket->remove(t);
+      fct_chk(!bucket->exist(t));
+      fct_chk(bucket->match_request(other, TT_UAS) == NULL);
+      bucket->unlock();
+
+      delete retr;
+      delete other;
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(match_reply_by_branch) {
+      sip_msg* inv = parsed_msg("INVITE sip:bob@example.com SIP/2.0",
+				"z9hG4bKuac1");
+      trans_bucket* bucket = get_trans_bucket(inv->callid->value,
+					      get_cseq(inv)->num_str);
+      bucket->lock();
+      sip_trans* t1 = bucket->add_trans(inv, TT_UAC);
+      sip_trans* t2 = bucket->add_trans(parsed_msg("INVITE sip:bob@example.com SIP/2.0",
+						   "z9hG4bKuac2"), TT_UAC);
+
+      sip_msg* r1 = parsed_msg("SIP/2.0 180 Ringing", "z9hG4bKuac1");
+      sip_msg* r2 = parsed_msg("SIP/2.0 200 OK", "z9hG4bKuac2");
+      sip_msg* r3 = parsed_msg("SIP/2.0 200 OK", "z9hG4bKuac3");
+      fct_chk(bucket->match_reply(r1) == t1);
+      fct_chk(bucket->match_reply(r2) == t2);
+      fct_chk(bucket->match_reply(r3) == NULL);
+
+      bucket->remove(t1);
+      bucket->remove(t2);
+      fct_chk(bucket->match_reply(r2) == NULL);
+      bucket->unlock();
+
+      delete r1;
+      delete r2;
+      delete r3;
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();
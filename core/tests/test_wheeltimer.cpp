@@ -0,0 +1,160 @@
+#include "fct.h"
+
+#include "log.h"
+
+#include "AmArg.h"
+#include "sip/wheeltimer.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+class sharded_wheeltimer
+  : public _wheeltimer
+{
+public:
+  sharded_wheeltimer(unsigned int n_shards)
+    : _wheeltimer(n_shards) {}
+};
+
+static atomic_int test_timers_fired;
+static atomic_int test_timers_deleted;
+
+class test_timer
+  : public timer
+{
+public:
+  pthread_t fired_by;
+  u_int32_t fired_at;
+  volatile bool fired;
+  sharded_wheeltimer* wt;
+
+  test_timer(sharded_wheeltimer* wt, unsigned int ticks)
+    : timer(wt->wall_clock + ticks), fired(false), wt(wt) {}
+
+  ~test_timer() { test_timers_deleted.inc(); }
+
+  void fire() {
+    fired_by = pthread_self();
+    fired_at = wt->wall_clock;
+    fired = true;
+    test_timers_fired.inc();
+  }
+};
+
+static bool wait_fired(unsigned int n, int ms)
+{
+  for(int i=0; i<ms/10; i++) {
+    if(test_timers_fired.get() >= n)
+      return true;
+    usleep(10000);
+  }
+  return test_timers_fired.get() >= n;
+}
+
+FCTMF_SUITE_BGN(test_wheeltimer) {
+
+    FCT_TEST_BGN(fire_in_time) {
+      test_timers_fired.set(0);
+      sharded_wheeltimer wt(2);
+      wt.start();
+
+      test_timer* t = new test_timer(&wt, 5);
+      u_int32_t expires = t->expires;
+      wt.insert_timer(t, 1);
+
+      fct_chk(wait_fired(1, 1000));
+      fct_chk(t->fired);
+      fct_chk(!(t->fired_at - expires > (1U<<31))); // not early
+
+      wt.stop();
+      delete t;
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(same_hash_same_shard) {
+      test_timers_fired.set(0);
+      sharded_wheeltimer wt(4);
+      fct_chk_eq_int(wt.get_shards(), 4);
+      wt.start();
+
+      test_timer* t[8];
+      for(int i=0; i<8; i++) {
+	t[i] = new test_timer(&wt, 1 + i);
+	wt.insert_timer(t[i], i % 2 ? 7 : 9); // shards 3 and 1
+      }
+
+      fct_chk(wait_fired(8, 2000));
+      for(int i=2; i<8; i++)
+	fct_chk(pthread_equal(t[i]->fired_by, t[i % 2]->fired_by));
+      fct_chk(!pthread_equal(t[0]->fired_by, t[1]->fired_by));
+
+      wt.stop();
+      for(int i=0; i<8; i++)
+	delete t[i];
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(remove_before_fire) {
+      test_timers_fired.set(0);
+      test_timers_deleted.set(0);
+      sharded_wheeltimer wt(2);
+      wt.start();
+
+      test_timer* t1 = new test_timer(&wt, 10);
+      test_timer* t2 = new test_timer(&wt, 10);
+      wt.insert_timer(t1);
+      wt.insert_timer(t2);
+      // removed within the same tick: never placed on the wheel
+      wt.remove_timer(t1);
+
+      fct_chk(wait_fired(1, 1000));
+      usleep(100000);
+      unsigned int fired = test_timers_fired.get();
+      unsigned int deleted = test_timers_deleted.get();
+      fct_chk_eq_int(fired, 1);
+      fct_chk_eq_int(deleted, 1);
+      fct_chk(t2->fired);
+
+      wt.stop();
+      delete t2;
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(pending_deleted_on_destroy) {
+      test_timers_deleted.set(0);
+      {
+	sharded_wheeltimer wt(1);
+	wt.insert_timer(new test_timer(&wt, 1000));
+	wt.start();
+	usleep(50000);
+	wt.stop();
+	wt.insert_timer(new test_timer(&wt, 1000));
+      }
+      unsigned int deleted = test_timers_deleted.get();
+      fct_chk_eq_int(deleted, 2);
+    } FCT_TEST_END();
+
+    FCT_TEST_BGN(lateness_stats) {
+      test_timers_fired.set(0);
+      sharded_wheeltimer wt(2);
+      wt.start();
+
+      test_timer* t[4];
+      for(int i=0; i<4; i++) {
+	t[i] = new test_timer(&wt, 2);
+	wt.insert_timer(t[i], 0);
+      }
+      fct_chk(wait_fired(4, 1000));
+      wt.stop();
+
+      AmArg stats;
+      wt.getStats(stats);
+      fct_chk_eq_int(stats.size(), 2);
+      fct_chk_eq_int(stats.get(0)["fired"].asLongLong(), 4);
+      fct_chk_eq_int(stats.get(1)["fired"].asLongLong(), 0);
+      fct_chk(stats.get(0)["ticks"].asLongLong() > 0);
+      fct_chk(stats.get(0)["max_late_us"].asLongLong() >= 
+	      stats.get(0)["avg_late_us"].asLongLong());
+
+      for(int i=0; i<4; i++)
+	delete t[i];
+    } FCT_TEST_END();
+
+} FCTMF_SUITE_END();